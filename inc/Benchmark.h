@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <ostream>
+#include <cstdint>
+#include <limits>
+
+// frame times of a benchmark run and their distribution
+// written as csv or json depending on the extension of the output file
+class Benchmark final
+{
+public:
+	// frame is the wall time of the whole iteration, waiting on the gpu included
+	struct Frame
+	{
+		double frameMs;
+		double gpuMs;
+	};
+
+	struct Summary
+	{
+		double mean;
+		double variance;
+		double min;
+		double p50;
+		double p95;
+		double p99;
+		double max;
+	};
+
+	// path names the camera path in the output, step is the simulated time per frame
+	Benchmark(uint32_t frameCount, float stepMs, const std::string& path);
+
+	void AddFrame(double frameMs) { m_Frames.push_back(Frame{ frameMs, std::numeric_limits<double>::quiet_NaN() }); }
+	// gpu times are only known once the frame finished, usually while the next one is recorded, nan for frames not measured
+	void SetGpuMs(size_t frame, double gpuMs) { m_Frames[frame].gpuMs = gpuMs; }
+	size_t GetFrameCount() const { return m_Frames.size(); }
+
+	// percentiles are nearest rank, variance is the sample variance, nan values are left out
+	static Summary Summarize(std::vector<double> values);
+
+	void PrintSummary(std::ostream& stream) const;
+	// csv has a row per frame followed by a row per statistic named in the frame column
+	void Write(const std::string& fileName) const;
+
+private:
+	std::vector<double> GetFrameMs() const;
+	std::vector<double> GetGpuMs() const;
+	void WriteCsv(std::ostream& stream) const;
+	void WriteJson(std::ostream& stream) const;
+
+	std::vector<Frame> m_Frames;
+	float m_StepMs;
+	std::string m_Path;
+};
@@ -2,6 +2,8 @@
 #include <vulkan/vulkan.h>
 #include <memory>
 #include <vector>
+#include <optional>
+#include "MemoryTracker.h"
 
 class Device;
 class CommandPool;
@@ -10,16 +12,28 @@ class CommandBuffer;
 class Buffer final
 {
 public:
+	struct Barrier
+	{
+		VkAccessFlags2		 srcAccess;
+		VkAccessFlags2		 dstAccess;
+		VkPipelineStageFlags srcStage;
+		VkPipelineStageFlags dstStage;
+	};
+
 	~Buffer() = default;
 
 	VkBuffer*		GetBufferPtr() { return &m_Buffer;	}
 	VkDeviceMemory* GetMemoryPtr() { return &m_Memory;	}
 	void*			GetMappedData(){ return m_Data;		}
 
-	void UpdateMappedData(void* newData, size_t size, size_t offset);
+	void UpdateMappedData(const void* newData, size_t size, size_t offset);
 
 	void CopyTo(Buffer* buffer, CommandBuffer* command, Device* device, CommandPool* commandPool);
 	void CopyTo(Image* image, CommandBuffer* command, Device* device, CommandPool* commandPool);
+	// image has to be in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, every layer and level is copied
+	void CopyFrom(Image* image, CommandBuffer* command);
+
+	void MakeBarrier(CommandBuffer* command, const Barrier& barrier);
 
 	void Destroy(Device* device);
 
@@ -30,6 +44,8 @@ private:
 	friend class BufferBuilder;
 	Buffer() = default;
 
+	static std::vector<VkBufferImageCopy> GetImageCopyRegions(Image* image);
+
 	VkBuffer		m_Buffer;
 	VkDeviceMemory	m_Memory;
 	VkDeviceSize	m_Size;
@@ -53,6 +69,9 @@ public:
 	// bind data to stage and copy to created buffer
 	BufferBuilder& BindData(void* data, CommandPool* commandPool);
 
+	// taken from usage if not set, vertex and index buffers are geometry and transfer only buffers staging
+	BufferBuilder& SetCategory(MemoryCategory category);
+
 	void Build(std::unique_ptr<Buffer>& buffer, Device* device, CommandPool* commandPool, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
 	void Build(std::vector<Buffer>& buffers, Device* device, CommandPool* commandPool, uint32_t amount, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
 	Buffer Build(Device* device, CommandPool* commandPool, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
@@ -65,4 +84,5 @@ private:
 	CommandPool* m_CommandPool;
 	void*	m_BoundData{ nullptr };
 	bool	m_MapMemory{ false };
+	std::optional<MemoryCategory> m_Category;
 };
\ No newline at end of file
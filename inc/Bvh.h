@@ -0,0 +1,198 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <limits>
+#include <utility>
+#include <new>
+#include <glm/glm.hpp>
+
+// bounding volume hierarchy over axis aligned boxes, split by the surface area heuristic evaluated on bins of the centroids
+// works on any boxes, the scene builds one over its meshes and optionally one per mesh over its triangles
+// siblings are stored next to each other in one cache line aligned array of 32 byte nodes, both children of a node are tested from one cache line
+class Bvh final
+{
+public:
+	struct Node
+	{
+		glm::vec3 min;
+		uint32_t first;	// first primitive of a leaf, left child otherwise, the right child follows it
+		glm::vec3 max;
+		uint32_t count;	// primitives of a leaf, 0 for inner nodes
+	};
+
+	// a vector allocates with the alignment of its type, which is too little for nodes to start on a cache line
+	template<typename T>
+	struct CacheLineAllocator
+	{
+		using value_type = T;
+
+		CacheLineAllocator() = default;
+		template<typename U>
+		CacheLineAllocator(const CacheLineAllocator<U>&) noexcept {}
+
+		T* allocate(size_t count) { return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t{ CACHE_LINE_SIZE })); }
+		void deallocate(T* pointer, size_t) noexcept { ::operator delete(pointer, std::align_val_t{ CACHE_LINE_SIZE }); }
+
+		template<typename U>
+		bool operator==(const CacheLineAllocator<U>&) const noexcept { return true; }
+	};
+	using NodeArray = std::vector<Node, CacheLineAllocator<Node>>;
+
+	// how a box relates to a query volume, inside skips the tests of everything below
+	enum class Overlap
+	{
+		Outside,
+		Partial,
+		Inside
+	};
+
+	// large subtrees are built on other threads
+	void Build(const std::vector<glm::vec3>& mins, const std::vector<glm::vec3>& maxs);
+	// moves the node bounds to new primitive bounds and keeps the tree, quality drops the further things move
+	void Refit(const std::vector<glm::vec3>& mins, const std::vector<glm::vec3>& maxs);
+
+	// classify(min, max) returns the overlap of a box with the query, visit(primitive) gets every primitive not outside
+	template<typename Classify, typename Visit>
+	void Traverse(Classify&& classify, Visit&& visit) const;
+
+	// primitives whose boxes are not fully behind one of the planes of the view projection
+	void QueryFrustum(const glm::mat4& viewProjection, std::vector<uint32_t>& primitives) const;
+	void QueryAABB(const glm::vec3& min, const glm::vec3& max, std::vector<uint32_t>& primitives) const;
+
+	// closest primitive along the ray, NO_HIT without one, distance is the limit on the way in and the hit on the way out
+	// intersect(primitive, distance) returns the distance of its hit or anything not below distance when missed
+	template<typename Intersect>
+	uint32_t Raycast(const glm::vec3& origin, const glm::vec3& direction, float& distance, Intersect&& intersect) const;
+	// distance to the boxes of the primitives, enough where they are the only geometry known
+	uint32_t RaycastBounds(const glm::vec3& origin, const glm::vec3& direction, float& distance) const;
+
+	// entry distance of the ray into the box, infinity when it misses or enters beyond distance
+	static float IntersectAABB(const glm::vec3& origin, const glm::vec3& inverseDirection, const glm::vec3& min, const glm::vec3& max, float distance);
+
+	// the node after the root is unused padding
+	const NodeArray& GetNodes() const { return m_Nodes; }
+	size_t GetPrimitiveCount() const { return m_Primitives.size(); }
+	// expected cost of a random ray relative to testing one primitive, lower is better
+	float CalculateCost() const;
+	size_t GetMemorySize() const { return m_Nodes.size() * sizeof(Node) + m_Primitives.size() * (sizeof(uint32_t) + 2 * sizeof(glm::vec3)); }
+
+	inline static const uint32_t NO_HIT{ UINT32_MAX };
+
+private:
+	// pairs of children are taken from nodeCount by several threads
+	void BuildNode(std::atomic<uint32_t>& nodeCount, uint32_t node, uint32_t first, uint32_t count, uint32_t depth);
+	void FitNode(Node& node) const;
+
+	NodeArray m_Nodes;
+	// leaves address ranges of this, the boxes stay in the order they were given
+	std::vector<uint32_t> m_Primitives;
+	std::vector<glm::vec3> m_Mins;
+	std::vector<glm::vec3> m_Maxs;
+	std::vector<glm::vec3> m_Centroids;
+
+	inline static const size_t CACHE_LINE_SIZE{ 64 };
+	// children are taken in pairs from here on, so every pair starts at an even node and fills half a cache line
+	inline static const uint32_t FIRST_CHILD{ 2 };
+	inline static const uint32_t BIN_COUNT{ 16 };
+	inline static const uint32_t MAX_LEAF_SIZE{ 4 };
+	// bounds the stacks of the traversals, deeper nodes become leaves
+	inline static const uint32_t MAX_DEPTH{ 64 };
+	// cost of visiting a node relative to testing a primitive
+	inline static const float TRAVERSAL_COST{ 1.f };
+	// smaller subtrees are not worth a thread
+	inline static const uint32_t PARALLEL_BUILD_SIZE{ 4096 };
+};
+
+template<typename Classify, typename Visit>
+void Bvh::Traverse(Classify&& classify, Visit&& visit) const
+{
+	if (m_Nodes.empty())
+		return;
+
+	// the second entry marks subtrees already known to be inside
+	std::pair<uint32_t, bool> stack[MAX_DEPTH * 2];
+	uint32_t stackSize{};
+	stack[stackSize++] = { 0, false };
+	while (stackSize > 0)
+	{
+		const auto [index, inside] { stack[--stackSize] };
+		const Node& node{ m_Nodes[index] };
+		Overlap overlap{ Overlap::Inside };
+		if (!inside)
+		{
+			overlap = classify(node.min, node.max);
+			if (overlap == Overlap::Outside)
+				continue;
+		}
+
+		if (node.count == 0)
+		{
+			stack[stackSize++] = { node.first + 1, overlap == Overlap::Inside };
+			stack[stackSize++] = { node.first, overlap == Overlap::Inside };
+			continue;
+		}
+
+		for (uint32_t primitive{ node.first }; primitive < node.first + node.count; ++primitive)
+		{
+			const uint32_t primitiveIndex{ m_Primitives[primitive] };
+			if (overlap == Overlap::Inside || classify(m_Mins[primitiveIndex], m_Maxs[primitiveIndex]) != Overlap::Outside)
+				visit(primitiveIndex);
+		}
+	}
+}
+
+template<typename Intersect>
+uint32_t Bvh::Raycast(const glm::vec3& origin, const glm::vec3& direction, float& distance, Intersect&& intersect) const
+{
+	uint32_t hit{ NO_HIT };
+	if (m_Nodes.empty() || IntersectAABB(origin, 1.f / direction, m_Nodes[0].min, m_Nodes[0].max, distance) == std::numeric_limits<float>::infinity())
+		return hit;
+
+	// divisions by zero give infinities, which the slab test handles
+	const glm::vec3 inverseDirection{ 1.f / direction };
+	// entry distances are kept, hits found after a node was pushed can still skip it
+	std::pair<uint32_t, float> stack[MAX_DEPTH * 2];
+	uint32_t stackSize{};
+	stack[stackSize++] = { 0, .0f };
+	while (stackSize > 0)
+	{
+		const auto [index, entryDistance] { stack[--stackSize] };
+		if (entryDistance >= distance)
+			continue;
+
+		const Node& node{ m_Nodes[index] };
+		if (node.count > 0)
+		{
+			for (uint32_t primitive{ node.first }; primitive < node.first + node.count; ++primitive)
+			{
+				const float primitiveDistance{ intersect(m_Primitives[primitive], distance) };
+				if (primitiveDistance < distance)
+				{
+					distance = primitiveDistance;
+					hit = m_Primitives[primitive];
+				}
+			}
+			continue;
+		}
+
+		// the nearer child is visited first, so hits in it can prune the other one
+		const Node& left{ m_Nodes[node.first] };
+		const Node& right{ m_Nodes[node.first + 1] };
+		float leftDistance{ IntersectAABB(origin, inverseDirection, left.min, left.max, distance) };
+		float rightDistance{ IntersectAABB(origin, inverseDirection, right.min, right.max, distance) };
+		uint32_t nearChild{ node.first };
+		uint32_t farChild{ node.first + 1 };
+		if (rightDistance < leftDistance)
+		{
+			std::swap(leftDistance, rightDistance);
+			std::swap(nearChild, farChild);
+		}
+		if (rightDistance != std::numeric_limits<float>::infinity())
+			stack[stackSize++] = { farChild, rightDistance };
+		if (leftDistance != std::numeric_limits<float>::infinity())
+			stack[stackSize++] = { nearChild, leftDistance };
+	}
+	return hit;
+}
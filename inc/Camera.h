@@ -71,8 +71,6 @@ public:
 	{
 		double xPos{};
 		double yPos{};
-		static double cache_xPos{ 0 };
-		static double cache_yPos{ 0 };
 		glfwGetCursorPos(window, &xPos, &yPos);
 
 		if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_2) == GLFW_PRESS)
@@ -98,32 +96,39 @@ public:
 				m_Position -= right * travelThisUpdate; 
 			}
 
-			double deltaX{ cache_xPos - xPos };
-			double deltaY{ cache_yPos - yPos }; 
+			double deltaX{ m_CursorX - xPos };
+			double deltaY{ m_CursorY - yPos }; 
 
 			if (abs(deltaX) > FLT_EPSILON || abs(deltaY) > FLT_EPSILON)
 			{
-				static float totalYaw{};
-				static float totalPitch{}; 
-				totalYaw += deltaX * m_Sensitivity;
-				totalPitch += deltaY * m_Sensitivity;
-				totalPitch = std::clamp(totalPitch, -89.f, 89.f);
+				m_Yaw += static_cast<float>(deltaX) * m_Sensitivity;
+				m_Pitch += static_cast<float>(deltaY) * m_Sensitivity;
+				m_Pitch = std::clamp(m_Pitch, -89.f, 89.f);
 				 
-				m_Forward.x = cos(glm::radians(totalYaw)) * cos(glm::radians(totalPitch));
-				m_Forward.y = sin(glm::radians(totalYaw)) * cos(glm::radians(totalPitch));
-				m_Forward.z = sin(glm::radians(totalPitch));
+				m_Forward.x = cos(glm::radians(m_Yaw)) * cos(glm::radians(m_Pitch));
+				m_Forward.y = sin(glm::radians(m_Yaw)) * cos(glm::radians(m_Pitch));
+				m_Forward.z = sin(glm::radians(m_Pitch));
 			}
 		}  
 		 
-		cache_xPos = xPos; 
-		cache_yPos = yPos;
+		m_CursorX = xPos; 
+		m_CursorY = yPos;
 	} 
+
+	// places the camera without input, used by camera paths
+	// yaw and pitch follow so mouse look continues from the new direction
+	void SetPose(const glm::vec3& position, const glm::vec3& forward)
+	{
+		m_Position = position;
+		m_Forward = glm::normalize(forward);
+		m_Yaw = glm::degrees(std::atan2(m_Forward.y, m_Forward.x));
+		m_Pitch = std::clamp(glm::degrees(std::asin(m_Forward.z)), -89.f, 89.f);
+	}
 	   
 	glm::mat4x4& CalculateView()
 	{
-		static glm::mat4x4 view{};
-		view = glm::lookAt(m_Position, m_Position + m_Forward, m_Up);
-		return view;
+		m_View = glm::lookAt(m_Position, m_Position + m_Forward, m_Up);
+		return m_View;
 	}
 	 
 	glm::mat4x4& GetProjection()
@@ -131,6 +136,14 @@ public:
 		return m_Projection; 
 	}
 
+	const glm::vec3& GetPosition() const	{ return m_Position; }
+	const glm::vec3& GetForward() const		{ return m_Forward; }
+
+	float GetFov() const			{ return m_Fov;			}
+	float GetAspectRatio() const	{ return m_AspectRatio;	}
+	float GetNear() const			{ return m_Near;		}
+	float GetFar() const			{ return m_Far;			}
+
 private:
 	glm::vec3 m_Position;
 	const glm::vec3 m_Up			{ .0f, .0f, 1.f };
@@ -139,9 +152,16 @@ private:
 	float m_Speed		{ 2.f };
 	float m_Boost		{ 1.f };
 	float m_Sensitivity	{ 0.3f };
+	// degrees, m_Forward is rebuilt from these when the mouse moves
+	float m_Yaw			{};
+	float m_Pitch		{};
+	// cursor position of the previous update
+	double m_CursorX	{};
+	double m_CursorY	{};
 	float m_Fov;
 	float m_AspectRatio;
 	float m_Near;
 	float m_Far;
 	glm::mat4x4 m_Projection		{ glm::perspective(glm::radians(m_Fov), m_AspectRatio, m_Near, m_Far) };
+	glm::mat4x4 m_View				{};
 };
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <glm/glm.hpp>
+
+// camera positions and view directions over time, sampled by a catmull-rom spline through the keys
+// a recorded path is just keys at every frame, files hold one "time x y z forwardX forwardY forwardZ" line per key
+class CameraPath final
+{
+public:
+	struct Key
+	{
+		float time;
+		glm::vec3 position;
+		glm::vec3 forward;
+	};
+
+	// keys have to be added in order of time
+	void AddKey(float time, const glm::vec3& position, const glm::vec3& forward);
+	void Clear() { m_Keys.clear(); }
+
+	// times past the last key wrap around to the first one
+	void Sample(float time, glm::vec3& position, glm::vec3& forward) const;
+
+	float GetDuration() const { return m_Keys.empty() ? .0f : m_Keys.back().time - m_Keys.front().time; }
+	bool IsEmpty() const { return m_Keys.empty(); }
+
+	// empty lines and lines starting with # are skipped
+	void Load(const std::string& path);
+	void Save(const std::string& path) const;
+
+	// a loop through the sponza atrium and along its upper gallery, used when no path file is given
+	static CameraPath CreateDefault();
+
+private:
+	std::vector<Key> m_Keys;
+};
@@ -6,12 +6,15 @@
 
 namespace datatype
 { 
+	// entry of the material table, meshes sharing all four textures share the entry
 	struct TextureIndices
 	{
 		uint32_t albedo;
 		uint32_t roughness;
 		uint32_t metalness;
 		uint32_t normal;
+
+		bool operator==(const TextureIndices&) const = default;
 	}; 
 	  
 	struct ModelViewProjection
@@ -19,8 +22,113 @@ namespace datatype
 		glm::mat4 model;
 		glm::mat4 view;
 		glm::mat4 projection;
+		// inverted once per frame instead of per pixel in lighting
+		glm::mat4 inverseView;
+		glm::mat4 inverseProjection;
+		// rendered part of the g-buffer and hdr target, 1 unless dynamic resolution scaled it down
+		glm::vec2 renderScale;
+		// previous frame for the lighting cache, the scale is 0 while there is no valid history
+		alignas(16) glm::mat4 previousViewProjection;
+		glm::vec2 previousRenderScale;
+		uint32_t frameIndex;
 	}; 
 
+	struct TiledLightingConstants
+	{
+		glm::ivec2 extent;
+		uint32_t tileCapacity;
+	};
+
+	// shared by the luminance histogram and average passes
+	struct AutoExposureConstants
+	{
+		float minLogLuminance;
+		float logLuminanceRange;
+		float adaptation;		// blend factor towards the new average this frame
+		uint32_t pixelCount;
+		glm::uvec2 extent;		// rendered part of the hdr target
+	};
+
+	// accumulated by lighting while the cache is validated, errors are relative and fixed point
+	struct LightingCacheStatistics
+	{
+		uint32_t evaluatedCount;
+		uint32_t cachedCount;
+		uint32_t errorSum;
+		uint32_t maxError;
+	};
+
+	// level of detail of a mesh, a range of its index buffer sharing the vertices of every other level
+	struct MeshLod
+	{
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		// distance the simplified surface may be off from the full detail one, in units of the vertex positions
+		float error;
+	};
+
+	// world space bounds of a mesh for the occlusion cull, laid out like MeshCullData in occlusion_cull.comp
+	// the index range is the level of detail picked for the frame, bounds and draws cover every instance
+	struct MeshCullData
+	{
+		glm::vec3 aabbMin;
+		uint32_t indexCount;
+		glm::vec3 aabbMax;
+		uint32_t firstIndex;
+		uint32_t firstInstance;
+		uint32_t instanceCount;
+		uint32_t padding[2];
+	};
+
+	// cluster of a mesh, a contiguous range of its index buffer with bounds in the space of its vertices
+	// laid out like Meshlet in cluster_cull.comp
+	struct Meshlet
+	{
+		glm::vec3 center;
+		float radius;
+		// average normal, the cluster faces away from every position behind the cone
+		glm::vec3 coneAxis;
+		float coneCutoff;		// 1 when the normals spread too far to ever cull
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		uint32_t meshIndex;
+		uint32_t firstMeshMeshlet;	// first cluster of the same mesh, start of its draw commands
+	};
+
+	// finest level the g-buffer pass sampled of a texture, laid out like TextureFeedback in gbuffer_generation.frag
+	// the size is that of level 0 even while a coarser one is resident
+	struct TextureFeedback
+	{
+		uint32_t width;
+		uint32_t height;
+		uint32_t level;		// UINT32_MAX when not sampled since the last reset
+		uint32_t padding;
+	};
+
+	// shared by the depth pyramid, occlusion and cluster cull passes
+	struct OcclusionCullingConstants
+	{
+		glm::mat4 viewProjection;
+		glm::uvec2 sourceExtent;	// rendered part of the depth buffer
+		uint32_t level;				// pyramid level written by the reduction
+		uint32_t meshCount;
+		glm::vec3 cameraPosition;
+		uint32_t meshletCount;
+	};
+
+	// meshes of the last late cull, every mesh lands in exactly one count
+	// clusters are only counted for visible meshes and only with cluster culling
+	struct OcclusionStatistics
+	{
+		uint32_t visibleCount;
+		uint32_t frustumCulledCount;
+		uint32_t occlusionCulledCount;
+		uint32_t visibleClusterCount;
+		uint32_t frustumCulledClusterCount;
+		uint32_t backfaceCulledClusterCount;
+		uint32_t occlusionCulledClusterCount;
+	};
+
 	struct PointLight
 	{
 		glm::vec3 Position;
@@ -33,8 +141,15 @@ namespace datatype
 		glm::vec3 Direction;
 		alignas(16)glm::vec3 Color;
 		float Lux;
-		glm::mat4 View;
-		glm::mat4 Projection;
+	};
+
+	// one per light and cascade, laid out light major
+	struct ShadowCascade
+	{
+		glm::mat4 ViewProjection;
+		// view space distance where the cascade ends
+		float SplitDepth;
+		float padding[3];
 	};
 	 
 	struct Vertex  
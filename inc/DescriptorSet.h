@@ -16,6 +16,10 @@ public:
 	DescriptorSet& AddWriteDescriptorSet(Buffer* buffer, uint32_t offset, uint32_t binding, uint32_t arrayElement, VkDescriptorType type);
 	DescriptorSet& AddWriteDescriptorSet(Image* image, VkSampler sampler, uint32_t binding, uint32_t arrayElement);
 	DescriptorSet& AddWriteDescriptorSet(Image* image, uint32_t binding, uint32_t arrayElement);
+	// storage images are written in the layout they are used in rather than the current one
+	DescriptorSet& AddWriteDescriptorSet(Image* image, VkDescriptorType type, VkImageLayout layout, uint32_t binding, uint32_t arrayElement);
+	// for views that are not owned by an image, e.g. a single level or a reinterpreted format
+	DescriptorSet& AddWriteDescriptorSet(VkImageView view, VkDescriptorType type, VkImageLayout layout, uint32_t binding, uint32_t arrayElement);
 	DescriptorSet& AddWriteDescriptorSet(VkSampler sampler, uint32_t binding, uint32_t arrayElement);
 	DescriptorSet& AddWriteDescriptorSet(std::vector<Image>& images, uint32_t binding, uint32_t arrayElement);
 
@@ -4,7 +4,9 @@
 #include <cassert>
 #include <memory>
 #include <optional>
+#include <string>
 #include "Globals.h"
+#include "MemoryTracker.h"
 
 class Device final
 {
@@ -17,6 +19,16 @@ public:
 		bool IsComplete() { return graphicsFamily.has_value() && presentFamily.has_value(); }
 	};
 
+	struct HeapBudget
+	{
+		VkMemoryHeapFlags flags;
+		VkDeviceSize	  size;
+		// what this process may use, the heap size without VK_EXT_memory_budget
+		VkDeviceSize	  budget;
+		// what this process uses, 0 without VK_EXT_memory_budget
+		VkDeviceSize	  usage;
+	};
+
 	~Device() = default;
 
 	Device(const Device &) = delete;
@@ -40,8 +52,21 @@ public:
 
 	QueueFamilyIndices FindQueueFamilies(VkSurfaceKHR surface);
 
+	// names of buffers and images also label their memory in the tracker, in release builds as well
 	void SetObjectName(VkObjectType type, uint64_t handle, const char *name);
 
+	MemoryTracker &GetMemoryTracker() { return m_MemoryTracker; }
+
+	// required extensions and the optional ones the device supports
+	bool IsExtensionEnabled(const char *extension) const;
+
+	// required features and the optional ones the device supports
+	const VkPhysicalDeviceFeatures &        GetEnabledFeatures() const { return m_EnabledFeatures; }
+	const VkPhysicalDeviceVulkan12Features &GetEnabledFeatures12() const { return m_EnabledFeatures12; }
+
+	// one entry per memory heap, queried again on every call as budgets change with other processes
+	std::vector<HeapBudget> GetHeapBudgets();
+
 	void Destroy();
 
 private:
@@ -56,6 +81,11 @@ private:
 	VkQueue          m_GraphicsQueue{};
 	VkQueue          m_PresentQueue{};
 
+	std::vector<std::string>         m_EnabledExtensions;
+	VkPhysicalDeviceFeatures         m_EnabledFeatures{};
+	VkPhysicalDeviceVulkan12Features m_EnabledFeatures12{};
+	MemoryTracker                    m_MemoryTracker;
+
 	PFN_vkSetDebugUtilsObjectNameEXT vkSetDebugUtilsObjectNameEXT{ nullptr };
 };
 
@@ -82,6 +112,13 @@ public:
 		return *this;
 	}
 
+	// enabled only when the picked device supports it, does not affect which device is picked
+	DeviceBuilder &AddOptionalExtension(const char *extension)
+	{
+		m_OptionalExtensions.emplace_back(extension);
+		return *this;
+	}
+
 	DeviceBuilder &AddMultipleExtensions(const std::vector<const char *> &extensions)
 	{
 		m_Extensions.insert(m_Extensions.end(), extensions.begin(), extensions.end());
@@ -108,6 +145,12 @@ public:
 	// sets pnext and stype when build is triggered
 	DeviceBuilder &SetEnabledFeatures(const VkPhysicalDeviceFeatures &features);
 
+	// enabled only where the picked device supports them, do not affect which device is picked
+	DeviceBuilder &SetOptionalFeatures(const VkPhysicalDeviceFeatures &features);
+
+	// enabled only where the picked device supports them, do not affect which device is picked
+	DeviceBuilder &SetOptionalFeatures(const VkPhysicalDeviceVulkan12Features &features);
+
 	DeviceBuilder &PreferDedicatedGPU()
 	{
 		m_PreferdGPU = true;
@@ -125,6 +168,9 @@ private:
 
 	void CreateLogicalDevice();
 
+	// enables every optional feature the device has, count booleans starting at each pointer
+	static void AddSupportedFeatures(const VkBool32 *available, const VkBool32 *optional, VkBool32 *enabled, size_t count);
+
 	template<typename FeatureType>
 	bool CompareFeatures(FeatureType *available, FeatureType *enabled)
 	{
@@ -154,8 +200,11 @@ private:
 	VkPhysicalDeviceVulkan12Features             m_DeviceFeatures12{};
 	VkPhysicalDeviceVulkan11Features             m_DeviceFeatures11{};
 	VkPhysicalDeviceFeatures2                    m_DeviceFeatures{};
+	VkPhysicalDeviceFeatures                     m_OptionalFeatures{};
+	VkPhysicalDeviceVulkan12Features             m_OptionalFeatures12{};
 
 	std::vector<const char *> m_Extensions{};
+	std::vector<const char *> m_OptionalExtensions{};
 
 	bool m_PreferdGPU{};
 };
@@ -0,0 +1,38 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// draws of one pass ordered by a 64 bit key, rebuilt every frame
+// from the most significant bits: pipeline, material, depth and the mesh, so the state that is most expensive to change changes least often
+class DrawList final
+{
+public:
+	void Clear() { m_Keys.clear(); }
+	// depth is a distance from the viewer, only its order is kept so any non negative measure works
+	void Add(uint32_t pipeline, uint32_t material, float depth, uint32_t meshIndex);
+	// least significant digit radix sort on bytes, bytes every key shares are skipped
+	void Sort();
+
+	size_t GetSize() const { return m_Keys.size(); }
+	uint32_t GetMeshIndex(size_t draw) const { return static_cast<uint32_t>(m_Keys[draw] & MESH_MASK); }
+	uint32_t GetMaterial(size_t draw) const { return static_cast<uint32_t>((m_Keys[draw] >> MATERIAL_SHIFT) & MATERIAL_MASK); }
+
+	// times the material changes from one draw to the next in the current order
+	uint32_t CountMaterialChanges() const;
+
+	inline static const uint32_t MAX_PIPELINES{ 1u << 4 };
+	inline static const uint32_t MAX_MATERIALS{ 1u << 12 };
+	inline static const uint32_t MAX_MESHES{ 1u << 16 };
+
+private:
+	inline static const uint32_t MATERIAL_SHIFT{ 48 };
+	inline static const uint32_t PIPELINE_SHIFT{ 60 };
+	inline static const uint32_t DEPTH_SHIFT{ 16 };
+	inline static const uint64_t MATERIAL_MASK{ MAX_MATERIALS - 1 };
+	inline static const uint64_t MESH_MASK{ MAX_MESHES - 1 };
+
+	std::vector<uint64_t> m_Keys;
+	// ping pong target of the sort, kept to avoid an allocation per frame
+	std::vector<uint64_t> m_Scratch;
+};
@@ -7,11 +7,16 @@
 #include <vector>
 #include <memory>
 #include <string>
+#include <array>
 #include "DeletionQueue.h"
 #include "DataTypes.h"
 #include "Globals.h"
 #include "Scene.h"
 #include "SwapChain.h"
+#include "Settings.h"
+#include "IBLCache.h"
+#include "DrawList.h"
+#include "CameraPath.h"
 
 class Image;
 class Buffer;
@@ -23,17 +28,20 @@ class PipelineLayout;
 class DescriptorSetLayout;
 class Swapchain;
 class Device;
+class TextureStreamer;
 class DebugMessenger;
 class Instance;
 class DescriptorSet;
 class Sampler;
 class Camera;
 class ShaderStage;
+class GPUProfiler;
+class ShadowCascades;
 
 class DynamicRenderingApp final : public Application
 {
 public:
-	DynamicRenderingApp();
+	explicit DynamicRenderingApp(const Settings& settings);
 	~DynamicRenderingApp();
 
 	void Run() override;
@@ -43,11 +51,115 @@ public:
 	static void MouseMovedCallback(GLFWwindow* window, double xpos, double ypos);
 
 private:
+	// order matches tile classes in lighting_common.glsl
+	enum class TileClass : uint32_t
+	{
+		Sky,
+		Unlit,
+		Shadowed,
+		Full,
+		Count
+	};
+
+	// sections of the indirect draw buffer, order matches occlusion_cull.comp
+	enum class DrawSection : uint32_t
+	{
+		EarlyPrepass,	// visible last frame
+		LatePrepass,	// became visible this frame
+		GBuffer,		// every visible mesh
+		Count
+	};
+
+	// formats of the deferred targets for a g-buffer profile
+	struct GBufferLayout
+	{
+		VkFormat albedo;
+		VkFormat material;				// normal, and roughness/metalness when not split
+		VkFormat roughnessMetalness;	// VK_FORMAT_UNDEFINED when packed into material
+		VkFormat hdr;
+
+		bool IsMaterialSplit() const { return roughnessMetalness != VK_FORMAT_UNDEFINED; }
+		uint32_t GetBytesPerPixel() const;
+	};
+
+	static GBufferLayout GetGBufferLayout(GBufferProfile profile);
+
 	void RenderToCubeMap(ShaderStage* vertexShader, ShaderStage* pixelShader
 						 , Image* inputImage, Sampler* sampler
 						 , Image* outputCubeMapImage);
 
-	void GenerateShadowMap();
+	// projects the environment into 9 rgb l2 spherical harmonics coefficients, convolved for diffuse irradiance
+	void ProjectToSphericalHarmonics(Image* cubeMap, Sampler* sampler, Buffer* outputCoefficients);
+
+	// split sum specular, the environment convolved per roughness level and the brdf scale and bias lut
+	void CreateSpecularImages();
+	void PrefilterEnvironment(Image* cubeMap, Sampler* sampler, Image* outputCubeMap);
+	void IntegrateBRDF(Image* outputLUT);
+
+	// cube map the environment is rendered or uploaded into
+	void CreateEnvironmentCubeMap(uint32_t faceSize);
+	static VkFormat GetEnvironmentFormat(EnvironmentFormat format);
+	// can be rendered to, blitted for mipmaps and filtered
+	bool IsEnvironmentFormatRenderable(VkFormat format);
+	// e5b9g9r9 and b10g11r11 that are not renderable are baked in half float and packed in compute
+	bool IsEnvironmentFormatPacked(VkFormat format);
+	// falls back to rgba16f when the requested format can neither be rendered nor packed
+	void ValidateEnvironmentFormat();
+	// resident size of the cube in every supported format
+	void PrintEnvironmentReport(uint32_t faceSize, uint32_t mipLevels);
+	// encodes every level of source into target through an r32ui alias
+	void PackEnvironment(Image* source, Image* target);
+	// guards against a cache written with the same key but unexpected contents
+	static bool IsBakedEnvironmentValid(const IBLCache::BakedEnvironment& environment, VkFormat format);
+	static bool IsCachedImageValid(const IBLCache::CachedImage& image, VkFormat format, uint32_t width, uint32_t height, uint32_t layers, uint32_t mipLevels);
+	// leaves the image shader readable
+	void UploadCachedImage(const IBLCache::CachedImage& cachedImage, Image* image);
+	void ReadBackImage(Image* image, IBLCache::CachedImage& cachedImage);
+	// copies every baked image and the irradiance back to the host for the ibl cache
+	void ReadBackEnvironment(IBLCache::BakedEnvironment& environment);
+
+	// layered cascade map and the pipeline rendering it, layers are filled by RecordShadows
+	void CreateShadowMaps();
+
+	// fits cascades to the current view and returns which cascade indices have to be rendered this frame
+	// every cascade is rendered again when the scene moved, the far ones would keep stale casters otherwise
+	uint32_t UpdateShadowCascades(bool hasSceneMoved);
+
+	// trades update frequency of far cascades against the shadow budget
+	void AdjustShadowUpdateInterval();
+
+	// renders every updated layer in a single pass, meshes are instanced once per layer they overlap
+	void RecordShadows(CommandBuffer& commandBuffer, uint32_t updateMask);
+
+	// feedback on the gpu frame time, picks the scale of the next recorded frame
+	void AdjustRenderScale();
+	// part of the g-buffer and hdr target rendered at the current scale, the images are never reallocated
+	VkExtent2D GetRenderExtent() const;
+
+	// coarsest level of every mesh whose error projects below the pixel threshold, shared by every pass of the frame
+	void SelectLods();
+	// sorts the meshes of every pass once the levels are known, the prepass front to back and the g-buffer and shadows by material
+	void BuildDrawLists();
+
+	// history images the lighting cache reprojects from and the buffers its validation accumulates into
+	void CreateLightingCache();
+	// copies the rendered part of the hdr target and depth into the history, leaves both targets in transfer source layout
+	void RecordLightingHistory(CommandBuffer& commandBuffer, VkExtent2D renderExtent, bool computeLighting);
+
+	// depth pyramid, mesh bounds and the indirect draws written by both cull phases
+	void CreateOcclusionCulling();
+	// picks the meshes of the early prepass from last frame's visibility and the current frustum
+	void RecordEarlyOcclusionCull(CommandBuffer& commandBuffer);
+	// reduces the early prepass into the pyramid and tests every mesh against it, then the clusters of the visible meshes
+	// when cluster culling is on, leaves depth as an attachment
+	void RecordLateOcclusionCull(CommandBuffer& commandBuffer, VkExtent2D renderExtent);
+	// every mesh without occlusion culling, otherwise the indirect draws of the section
+	// the g-buffer draws the surviving clusters with cluster culling, both in the order of the draw list of the pass
+	void DrawMeshes(CommandBuffer& commandBuffer, VkPipelineLayout pipelineLayout, DrawSection section);
+
+	// luminance histogram of the hdr target reduced to a temporally smoothed exposure, never read back
+	void CreateAutoExposure();
+	void RecordAutoExposure(CommandBuffer& commandBuffer);
 
 	void InitWindow();
 
@@ -73,7 +185,29 @@ private:
 
 	void RecreateSwapChain();
 
-	void RecordCommandBufferWithPrepass(CommandBuffer& commandBuffer, uint32_t imageIndex);
+	void RecordCommandBufferWithPrepass(CommandBuffer& commandBuffer, uint32_t imageIndex, uint32_t shadowUpdateMask);
+
+	// classifies screen tiles and lights each class with its own pipeline permutation
+	void RecordComputeLighting(CommandBuffer& commandBuffer);
+
+	bool IsComputeLightingActive() const { return m_Settings.computeLighting && m_IsComputeLightingSupported; }
+
+	// false when lighting can tonemap straight into the swapchain
+	// compute lighting, any pass reading the hdr target after lighting, the dynamic resolution upscale and the lighting cache need the round trip
+	bool NeedsHDRRoundTrip() const { return !m_Settings.fusedTonemap || IsComputeLightingActive() || m_Settings.exposureMode == ExposureMode::Auto || m_Settings.dynamicResolution || m_Settings.lightingCache; }
+
+	uint32_t GetTileCapacity();
+
+	void ToggleLightingPath();
+
+	void PrintStatistics();
+	// R starts a recording of the camera path, the next press saves it for --benchmark-path
+	void TogglePathRecording();
+	// N spins the node of the mesh hit through the view center, the next press puts it back
+	void ToggleNodeAnimation();
+	void AnimateNode();
+	// times frustum queries and camera rays against the bvh of the scene from the current view
+	void BenchmarkBvh();
 
 	void DrawFrame();
 
@@ -84,6 +218,8 @@ private:
 	void Present(uint32_t imageIndex);
 
 	void MainLoop();
+	// flies the camera path at a fixed timestep and writes the frame times, see Settings::benchmarkFrames
+	void RunBenchmark();
 
 	void End();
 
@@ -91,6 +227,9 @@ private:
 
 	const std::string m_AppName{ "Refactor" };
 
+	Settings m_Settings;
+	GBufferLayout m_GBufferLayout{};
+
 	template<typename T>
 	using uptr = std::unique_ptr<T>;
 
@@ -105,12 +244,33 @@ private:
 	uptr<PipelineLayout>		m_PrepassPipelineLayoutPtr;
 	uptr<PipelineLayout>		m_GBufferPipelineLayoutPtr;
 	uptr<PipelineLayout>		m_LightingPipelineLayoutPtr;
+	uptr<DescriptorSetLayout>	m_TiledLightingSetLayoutPtr;
+	uptr<PipelineLayout>		m_TiledLightingPipelineLayoutPtr;
+	uptr<PipelineLayout>		m_ShadowPipelineLayoutPtr;
+	uptr<DescriptorSetLayout>	m_AutoExposureSetLayoutPtr;
+	uptr<PipelineLayout>		m_AutoExposurePipelineLayoutPtr;
+	uptr<DescriptorSetLayout>	m_OcclusionSetLayoutPtr;
+	uptr<PipelineLayout>		m_OcclusionPipelineLayoutPtr;
 	uptr<Pipeline>				m_PrepassPipelinePtr;
 	uptr<Pipeline>				m_GBufferPipelinePtr;
 	uptr<Pipeline>				m_LightingPipelinePtr;
+	uptr<Pipeline>				m_FusedLightingPipelinePtr;
 	uptr<Pipeline>				m_BlitPipelinePtr;
+	uptr<Pipeline>				m_TileClassificationPipelinePtr;
+	uptr<Pipeline>				m_ShadowPipelinePtr;
+	uptr<Pipeline>				m_LuminanceHistogramPipelinePtr;
+	uptr<Pipeline>				m_LuminanceAveragePipelinePtr;
+	uptr<Pipeline>				m_DepthPyramidPipelinePtr;
+	uptr<Pipeline>				m_EarlyCullPipelinePtr;
+	uptr<Pipeline>				m_LateCullPipelinePtr;
+	uptr<Pipeline>				m_ClusterCullPipelinePtr;
+	// one permutation per tile class
+	std::vector<Pipeline>		m_TiledLightingPipelines;
 	uptr<CommandPool>			m_CommandPoolPtr;
 	uptr<DescriptorPool>		m_DescriptorPoolPtr; 
+	uptr<GPUProfiler>			m_GPUProfilerPtr;
+	uptr<ShadowCascades>		m_ShadowCascadesPtr;
+	uptr<TextureStreamer>		m_TextureStreamerPtr;
 	 
 	uptr<Camera>	m_CameraPtr	{};
 	uptr<Scene>		m_ScenePtr	{ std::make_unique<Scene>() };
@@ -123,10 +283,19 @@ private:
 	uptr<Image>		m_DepthTexturePtr;
 	uptr<Image>		m_AlbedoTexturePtr;
 	uptr<Image>		m_MaterialPropsTexturePtr; 
+	uptr<Image>		m_RoughnessMetalnessTexturePtr;
 	uptr<Image>		m_HDRRenderTargetPtr;
 	uptr<Image>		m_CubeMapPtr; 
-	uptr<Image>		m_DiffuseIrradiancePtr;
-	std::vector<Image> m_ShadowDepthMaps;
+	uptr<Image>		m_PrefilteredCubeMapPtr;
+	uptr<Image>		m_BRDFLUTPtr;
+	uptr<Image>		m_ShadowMapArrayPtr;
+	// lighting and depth of the previous frame, only created with the lighting cache
+	uptr<Image>		m_LightingHistoryPtr;
+	uptr<Image>		m_DepthHistoryPtr;
+	// nearest and farthest depth per texel, a power of two no larger than the targets, only created with occlusion culling
+	uptr<Image>		m_DepthPyramidPtr;
+	// storage view of every pyramid level, the first view of the image covers the whole chain
+	std::vector<VkImageView>	m_DepthPyramidLevelViews;
 
 	uptr<Sampler>	m_TextureSamplerPtr;
 	uptr<Sampler>	m_ShadowSamplerPtr;
@@ -137,9 +306,132 @@ private:
 	std::vector<Buffer>			m_MVPUBuffers;
 	std::vector<Buffer>			m_PointLightsSSBO;
 	std::vector<Buffer>			m_DirectionalLightsSSBO;
+	std::vector<Buffer>			m_ShadowCascadeSSBO;
+	std::vector<Buffer>			m_TileListSSBO;
+	std::vector<Buffer>			m_TileDispatchBuffers;
+	std::vector<Buffer>			m_LightingCacheStatisticsBuffers;
+	uptr<Buffer>				m_IrradianceSHPtr;
+	uptr<Buffer>				m_LuminanceHistogramPtr;
+	uptr<Buffer>				m_ExposurePtr;
+	uptr<DescriptorSet>			m_AutoExposureDescriptorSetPtr;
+	uptr<Buffer>				m_MeshCullDataPtr;
+	// one command per mesh and draw section
+	uptr<Buffer>				m_DrawCommandsPtr;
+	// late cull result per mesh, read by the early cull of the next frame
+	uptr<Buffer>				m_MeshVisibilityPtr;
+	uptr<Buffer>				m_OcclusionStatisticsPtr;
+	uptr<Buffer>				m_MeshletsPtr;
+	// every cluster of a mesh has a command slot after the first cluster of the mesh, only the counted ones are drawn
+	uptr<Buffer>				m_ClusterCommandsPtr;
+	uptr<Buffer>				m_ClusterCountsPtr;
+	// sized for the pyramid levels, which are only known once the targets exist
+	uptr<DescriptorPool>		m_OcclusionDescriptorPoolPtr;
+	uptr<DescriptorSet>			m_OcclusionDescriptorSetPtr;
 	std::vector<DescriptorSet>	m_GlobalDescriptorSets;
 	std::vector<DescriptorSet>	m_LocalDescriptorSets;
 	std::vector<DescriptorSet>	m_FrameDescriptorSets;
+	std::vector<DescriptorSet>	m_TiledLightingDescriptorSets;
+
+	// hdr target has to support storage image writes
+	bool m_IsComputeLightingSupported{};
+	// tiles per class of the last finished frame
+	std::array<uint32_t, static_cast<size_t>(TileClass::Count)> m_TileCounts{};
+
+	// cascades past the second are rendered once every interval frames, staggered per cascade
+	uint32_t m_ShadowUpdateInterval{ 1 };
+	uint64_t m_ShadowFrame{};
+	inline static const uint32_t MAX_SHADOW_UPDATE_INTERVAL{ 8 };
+	// frames between changes of the update interval
+	inline static const uint32_t SHADOW_BUDGET_PERIOD{ 60 };
+	inline static const float SHADOW_SPLIT_LAMBDA{ .75f };
+
+	// camera and render scale the history was rendered with
+	glm::mat4 m_PreviousViewProjection{ 1.f };
+	glm::vec2 m_PreviousRenderScale{};
+	uint32_t m_LightingCacheFrame{};
+	// of the last finished frame, only filled while validating
+	datatype::LightingCacheStatistics m_LightingCacheStatistics{};
+	// matches CACHE_ERROR_SCALE in lighting_cache.glsl
+	inline static const float LIGHTING_CACHE_ERROR_SCALE{ 1024.f };
+
+	// of the last finished frame
+	datatype::OcclusionStatistics m_OcclusionStatistics{};
+	uint32_t m_MeshletCount{};
+	// cluster commands of a mesh start at its first cluster, draw lists do not follow mesh order
+	std::vector<uint32_t> m_FirstMeshlets;
+
+	// level picked per mesh for the frame being recorded
+	std::vector<uint32_t> m_MeshLods;
+	// meshes per level and triangles submitted before culling, of the last selection
+	std::vector<uint32_t> m_LodMeshCounts;
+	uint64_t m_LodTriangleCount{};
+	// from the camera to the nearest point of the bounds, sorts the draw lists
+	std::vector<float> m_MeshDistances;
+
+	DrawList m_PrepassDrawList;
+	DrawList m_GBufferDrawList;
+	DrawList m_ShadowDrawList;
+	// nearest depth in r and farthest in g
+	inline static const VkFormat DEPTH_PYRAMID_FORMAT{ VK_FORMAT_R32G32_SFLOAT };
+
+	// side of the rendered region relative to the swapchain, only changed when dynamic resolution is on
+	float m_RenderScale{ 1.f };
+	inline static const float MIN_RENDER_SCALE{ .5f };
+	// fraction of the way to the measured target scale taken per frame
+	inline static const float RENDER_SCALE_DAMPING{ .1f };
+	// relative distance to the frame budget that is left alone
+	inline static const double RENDER_SCALE_TOLERANCE{ .05 };
+	// contrast adaptive sharpening of the blit upscale, 0 to 1
+	inline static const float UPSCALE_SHARPNESS{ .5f };
+
+	// log2 luminance covered by the histogram, the hdr target is in physical units so the sun is near the top
+	inline static const float MIN_LOG_LUMINANCE{ -10.f };
+	inline static const float LOG_LUMINANCE_RANGE{ 28.f };
+	// matches BIN_COUNT of the luminance shaders
+	inline static const uint32_t LUMINANCE_BIN_COUNT{ 256 };
+	// rate of the exponential adaptation per second
+	inline static const float EXPOSURE_ADAPTATION_SPEED{ 1.5f };
+
+	// rgb triplets of the l2 irradiance spherical harmonics
+	inline static const uint32_t SH_COEFFICIENT_COUNT{ 9 };
+	// face texels covered by one projection workgroup per axis, matches sh_projection.comp
+	inline static const uint32_t SH_PROJECTION_TILE_SIZE{ 128 };
+
+	inline static const char* ENVIRONMENT_PATH{ "resources\\golden_gate_hills_4k.hdr" };
+	// cube face size is the width of the equirectangular source divided by this
+	inline static const uint32_t ENVIRONMENT_FACE_DIVISOR{ 3 };
+
+	// roughness is 0 at the first prefiltered level and 1 at the last
+	inline static const VkFormat PREFILTERED_FORMAT{ VK_FORMAT_R16G16B16A16_SFLOAT };
+	inline static const uint32_t PREFILTERED_FACE_SIZE{ 256 };
+	inline static const uint32_t PREFILTERED_MIP_LEVELS{ 6 };
+	inline static const uint32_t PREFILTERED_SAMPLE_COUNT{ 64 };
+	// x is NdotV and y is roughness
+	inline static const VkFormat BRDF_LUT_FORMAT{ VK_FORMAT_R16G16_SFLOAT };
+	inline static const uint32_t BRDF_LUT_SIZE{ 256 };
+	inline static const uint32_t BRDF_SAMPLE_COUNT{ 512 };
+
+	// timestamp pairs per frame, passes past it are not timed
+	inline static const uint32_t MAX_PROFILED_PASSES{ 16 };
+
+	// repeats of the frustum query and rays per side of the grid cast by BenchmarkBvh
+	inline static const uint32_t BVH_BENCHMARK_QUERIES{ 1000 };
+	inline static const uint32_t BVH_BENCHMARK_GRID{ 128 };
+
+	// frames drawn at the start of the path before measuring, lets streaming and exposure settle
+	inline static const uint32_t BENCHMARK_WARMUP_FRAMES{ 60 };
+	inline static const char* RECORDED_PATH_FILE{ "camera_path.txt" };
+
+	CameraPath m_RecordedPath;
+	float m_RecordingTime{};
+	bool m_IsRecordingPath{};
+
+	// radians per second of the node spun by ToggleNodeAnimation
+	inline static const float NODE_SPIN_SPEED{ 1.f };
+
+	uint32_t m_AnimatedNode{ SceneGraph::NO_PARENT };
+	glm::mat4 m_AnimatedNodeTransform{ 1.f };
+	float m_AnimationAngle{};
 	 
 	std::vector<CommandBuffer>	m_CommandBuffers;
 	std::vector<VkSemaphore>	m_ImageAvailableSemaphores;
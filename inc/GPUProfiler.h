@@ -0,0 +1,79 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include <map>
+#include <ostream>
+
+class Device;
+class CommandBuffer;
+
+// measures gpu time of named passes with timestamp queries
+// results of a frame are read back the next time the same frame in flight is recorded
+// so no extra synchronization is needed besides the in flight fence
+class GPUProfiler final
+{
+public:
+	struct PassTiming
+	{
+		double lastMs{};
+		double averageMs{};
+		uint64_t samples{};
+	};
+
+	GPUProfiler(Device* device, uint32_t queueFamilyIndex, uint32_t maxPassesPerFrame, uint32_t framesInFlight);
+	~GPUProfiler() = default;
+
+	GPUProfiler(const GPUProfiler&) 				= delete;
+	GPUProfiler(GPUProfiler&&) noexcept 			= delete;
+	GPUProfiler& operator=(const GPUProfiler&) 	 	= delete;
+	GPUProfiler& operator=(GPUProfiler&&) noexcept 	= delete;
+
+	// call after the frame fence is waited on, reads timestamps written the last time this frame was recorded
+	void Resolve(Device* device, uint32_t frame);
+
+	// resets the queries of the frame and stamps its start, must be recorded before any pass
+	void BeginFrame(CommandBuffer* command, uint32_t frame);
+	// stamps the end of the frame, the last command before the buffer ends
+	void EndFrame(CommandBuffer* command);
+
+	void BeginPass(CommandBuffer* command, const std::string& name);
+	void EndPass(CommandBuffer* command);
+
+	// 0 if pass was never measured
+	double GetAverageMs(const std::string& name) const;
+	double GetLastMs(const std::string& name) const;
+	// between the stamps of BeginFrame and EndFrame of the last resolved frame, including work outside of passes
+	// nan when the last resolve read nothing
+	double GetLastFrameMs() const { return m_LastFrameMs; }
+
+	void PrintReport(std::ostream& stream) const;
+
+	bool IsSupported() const { return m_IsSupported; }
+
+	void Destroy(Device* device);
+
+private:
+	// every frame has a pair per pass followed by the pair of the whole frame
+	uint32_t GetFirstQuery(uint32_t frame) const { return frame * (m_MaxPasses + 1) * 2; }
+
+	VkQueryPool m_QueryPool{ VK_NULL_HANDLE };
+	uint32_t	m_MaxPasses;
+	uint32_t	m_CurrentFrame{};
+	float		m_TimestampPeriod{};
+	uint64_t	m_TimestampMask{};
+	double		m_LastFrameMs{};
+	bool		m_IsSupported{};
+	// passes begun over the cap this frame, passes follow each other so their ends come first
+	uint32_t	m_SkippedPasses{};
+	bool		m_HasWarnedOverflow{};
+
+	// names of passes recorded for each frame in flight, index is the pass slot
+	std::vector<std::vector<std::string>> m_FramePasses;
+	// bytes instead of a bit vector, whether EndFrame was recorded since the frame was last resolved
+	std::vector<uint8_t> m_IsFrameRecorded;
+	std::map<std::string, PassTiming> m_Timings;
+
+	// weight of the newest sample in the moving average
+	inline static const double SMOOTHING{ .05 };
+};
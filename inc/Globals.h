@@ -6,4 +6,8 @@
 	const bool ENABLE_VALIDATION_LAYERS{ true };
 #endif
 
-	const int MAX_FRAMES_IN_FLIGHT{ 1 };  
\ No newline at end of file
+	// once DrawFrame waited on the fence the gpu is done with everything the previous frame read
+	const int MAX_FRAMES_IN_FLIGHT{ 1 };
+	// buffers without a copy per frame, like instance transforms, lod ranges and streamed meshes, are rewritten or dropped in place
+	// code relying on it asserts this, more frames in flight need those buffers per frame or deferred deletion
+	constexpr bool HAS_SINGLE_FRAME_IN_FLIGHT{ MAX_FRAMES_IN_FLIGHT == 1 };  
\ No newline at end of file
@@ -14,4 +14,13 @@ namespace HELP
 	void LoadScene();
 
 	bool HasStencilComponent(VkFormat format);
+
+	// bytes per texel of the formats used by render targets, 0 if unknown
+	uint32_t GetFormatSize(VkFormat format);
+
+	// length of the full chain down to 1x1
+	uint32_t GetMipLevelCount(uint32_t width, uint32_t height);
+
+	// bytes of every level and layer tightly packed, level after level
+	VkDeviceSize GetImageSize(VkFormat format, uint32_t width, uint32_t height, uint32_t layers, uint32_t mipLevels);
 }
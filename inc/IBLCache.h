@@ -0,0 +1,72 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// versioned binary file holding the baked image based lighting of one environment
+// keyed on a hash of the source file and the bake parameters, any change of either is a cache miss
+class IBLCache final
+{
+public:
+	// every field changes the baked result, keep it free of padding since it is hashed as bytes
+	struct BakeParameters
+	{
+		VkFormat	cubeMapFormat;
+		uint32_t	faceSizeDivisor; // face size is the source width divided by this
+		uint32_t	shCoefficientCount;
+		uint32_t	prefilteredFaceSize;
+		uint32_t	prefilteredMipLevels;
+		uint32_t	prefilteredSampleCount;
+		uint32_t	brdfLUTSize;
+		uint32_t	brdfSampleCount;
+	};
+
+	struct CachedImage
+	{
+		VkFormat			format{ VK_FORMAT_UNDEFINED };
+		uint32_t			width{};
+		uint32_t			height{};
+		uint32_t			layers{ 1 };
+		uint32_t			mipLevels{ 1 };
+		// mip levels one after another, every level holds its layers tightly packed
+		std::vector<char>	data;
+	};
+
+	struct BakedEnvironment
+	{
+		CachedImage			cubeMap;
+		std::vector<float>	irradianceSH;
+		CachedImage			prefilteredCubeMap;
+		CachedImage			brdfLUT;
+	};
+
+	IBLCache(const std::string& sourcePath, const BakeParameters& parameters);
+	~IBLCache() = default;
+
+	IBLCache(const IBLCache&) 					= delete;
+	IBLCache(IBLCache&&) noexcept 				= delete;
+	IBLCache& operator=(const IBLCache&) 	 	= delete;
+	IBLCache& operator=(IBLCache&&) noexcept 	= delete;
+
+	// false if the file is missing, outdated or was written for another source or bake
+	bool Load(BakedEnvironment& environment) const;
+	// failing to write is reported but not fatal, the next launch bakes again
+	void Save(const BakedEnvironment& environment) const;
+
+	const std::string& GetPath() const { return m_Path; }
+	uint64_t GetKey() const { return m_Key; }
+
+private:
+	static uint64_t HashFile(const std::string& path);
+	static uint64_t Hash(uint64_t hash, const void* data, size_t size);
+
+	std::string m_Path;
+	uint64_t	m_Key;
+
+	// bump whenever the file layout or any bake shader changes
+	inline static const uint32_t VERSION{ 3 };
+	inline static const uint32_t MAGIC{ 0x434c4249 }; // "IBLC" in file byte order
+	inline static const uint64_t FNV_OFFSET_BASIS{ 0xcbf29ce484222325ull };
+	inline static const uint64_t FNV_PRIME{ 0x100000001b3ull };
+};
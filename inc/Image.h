@@ -3,6 +3,8 @@
 #include <string>
 #include <memory>
 #include <vector>
+#include <optional>
+#include "MemoryTracker.h"
 
 class Device;
 class CommandBuffer;
@@ -20,6 +22,8 @@ public:
 		VkPipelineStageFlags dstStage;
 		uint32_t			 layerCount{ 1 };
 		uint32_t			 baseLayerLevel{};
+		uint32_t			 levelCount{ VK_REMAINING_MIP_LEVELS };
+		uint32_t			 baseMipLevel{};
 	};
 
 	~Image() = default;
@@ -32,10 +36,15 @@ public:
 	VkExtent2D			GetExtent()			{ return m_Extent; }
 	VkFormat			GetFormat()			{ return m_Format; }
 	uint32_t			GetLayers()			{ return m_Layers; }
+	uint32_t			GetMipLevels()		{ return m_MipLevels; }
 
 	void DestroyExtraViews(Device* device);
 
 	void MakeTransition(Device* device, CommandBuffer* command, const Transition& transition);
+
+	// blits every level from the previous one, level 0 of every layer has to be written
+	// requires blit and linear filter support of the format, leaves the image in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+	void GenerateMipmaps(CommandBuffer* command);
 	 
 	void Destroy(VkDevice device);
 
@@ -52,8 +61,11 @@ private:
 	VkFormat					m_Format;
 	VkImageAspectFlags			m_Aspect;
 	uint32_t					m_Layers;
+	uint32_t					m_MipLevels{ 1 };
 
 	VkImageLayout	m_CurrentLayout{ VK_IMAGE_LAYOUT_UNDEFINED };
+	// destroy only gets the vulkan device, swapchain images have none
+	MemoryTracker*	m_MemoryTrackerPtr{ nullptr };
 };
  
 class ImageBuilder final
@@ -79,6 +91,9 @@ public:
 
 	ImageBuilder& SetLayers(uint32_t layers);
 
+	// layered views cover every level, the 2d view per layer only the first one so it stays renderable
+	ImageBuilder& SetMipLevels(uint32_t mipLevels);
+
 	ImageBuilder& SetViewType(VkImageViewType type);
 	
 	ImageBuilder& SetImageType(VkImageType type);
@@ -88,6 +103,13 @@ public:
 	ImageBuilder& SetAspect(VkImageAspectFlags m_Aspect);
 
 	ImageBuilder& SetFilePath(const std::string& path);
+
+	// taken from the image if not set, cube maps are environment, attachments and storage images render targets
+	ImageBuilder& SetCategory(MemoryCategory category);
+
+	// every level tightly packed after the previous one, has to stay valid until build returns
+	// ignored if loaded from file
+	ImageBuilder& SetPixels(const void* data, VkDeviceSize size);
 	
 	void Build(std::unique_ptr<Image>& image, Device* device, CommandPool* commandPool, VkImageUsageFlags usage, VkMemoryPropertyFlags properties);
 	Image Build(Device* device, CommandPool* commandPool, VkImageUsageFlags usage, VkMemoryPropertyFlags properties);
@@ -105,8 +127,13 @@ private:
 	VkImageType		m_ImageType{ VK_IMAGE_TYPE_2D };
 	VkImageViewType m_ViewType{ VK_IMAGE_VIEW_TYPE_2D };
 	VkImageCreateFlags m_Flags{};
+	VkImageUsageFlags m_Usage{};
 	uint32_t m_Width;
 	uint32_t m_Height;
 	uint32_t m_Layers{ 1 };
+	uint32_t m_MipLevels{ 1 };
 	std::string m_FilePath;
+	std::optional<MemoryCategory> m_Category;
+	const void* m_Pixels{};
+	VkDeviceSize m_PixelsSize{};
 };
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "DataTypes.h"
+
+// reorders triangle lists and vertices at import, replaces the vertex cache pass of assimp
+// triangles are first sorted for the post-transform cache, then runs of them are sorted front to back for overdraw
+// and finally the vertices are laid out in order of first use for the fetch
+class IndexOptimizer final
+{
+public:
+	struct Statistics
+	{
+		float acmr;		// transformed vertices per triangle
+		float atvr;		// transformed vertices per vertex referenced
+		float overdraw;	// shaded per covered pixel, averaged over views along every axis
+	};
+
+	IndexOptimizer() = delete;
+
+	// linear speed vertex cache optimization, triangles using vertices of the simulated cache are emitted first
+	static std::vector<uint32_t> OptimizeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount);
+	// expects a vertex cache optimized list, splits it where the cache restarts anyway and orders the pieces outside in
+	// threshold is the acmr a piece may lose relative to its whole run, 1.05 keeps nearly all of the cache efficiency
+	static std::vector<uint32_t> OptimizeOverdraw(const std::vector<datatype::Vertex>& vertices, const std::vector<uint32_t>& indices, float threshold);
+	// renumbers vertices in order of first use and drops unreferenced ones, indices are rewritten in place
+	static void OptimizeVertexFetch(std::vector<datatype::Vertex>& vertices, std::vector<uint32_t>& indices);
+
+	static Statistics Analyze(const std::vector<datatype::Vertex>& vertices, const uint32_t* indices, size_t indexCount);
+
+	// fifo size used for the statistics and the overdraw split, close to the reuse window of current hardware
+	inline static const uint32_t ANALYSIS_CACHE_SIZE{ 16 };
+
+private:
+	static std::vector<uint32_t> SimulateCacheMisses(const uint32_t* indices, size_t indexCount, uint32_t vertexCount);
+	// software depth test of the triangles in order, returns shaded and covered pixels
+	static void RasterizeOverdraw(const std::vector<datatype::Vertex>& vertices, const uint32_t* indices, size_t indexCount, uint64_t& shaded, uint64_t& covered);
+
+	// lru cache the scores of the optimization are based on
+	inline static const uint32_t OPTIMIZER_CACHE_SIZE{ 32 };
+	// pixels per side of every overdraw view
+	inline static const int OVERDRAW_GRID_SIZE{ 256 };
+};
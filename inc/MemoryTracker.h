@@ -0,0 +1,74 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Device;
+
+// what an allocation is used for, picked by the buffer and image builders from usage unless set explicitly
+enum class MemoryCategory
+{
+	RenderTarget,
+	Texture,
+	Environment,	// ibl cube maps, their source and lookup tables
+	Geometry,
+	Staging,
+	Buffer,			// uniform and storage data
+	Count
+};
+
+// accounts every device memory allocation of buffers and images to its heap and category
+// names come from Device::SetObjectName of the buffer or image the memory is bound to
+class MemoryTracker final
+{
+public:
+	struct Usage
+	{
+		VkDeviceSize live;
+		VkDeviceSize peak;
+		uint32_t count;
+	};
+
+	// maps memory types to heaps, called by the device builder once the physical device is picked
+	void Initialize(VkPhysicalDevice physicalDevice);
+
+	void Add(VkDeviceMemory memory, uint64_t object, MemoryCategory category, uint32_t memoryType, VkDeviceSize size);
+	// unknown memory is ignored, copies of a buffer or image may each be destroyed
+	void Remove(VkDeviceMemory memory);
+	void SetName(uint64_t object, const char* name);
+
+	const std::vector<Usage>& GetHeapUsages() const { return m_Heaps; }
+	const Usage& GetCategoryUsage(MemoryCategory category) const { return m_Categories[static_cast<size_t>(category)]; }
+
+	// heaps with the budget VK_EXT_memory_budget reports, categories and the largest live allocations, each sorted by size
+	void PrintReport(std::ostream& stream, Device* device) const;
+
+	static const char* GetCategoryName(MemoryCategory category);
+
+private:
+	struct Allocation
+	{
+		uint64_t object;
+		MemoryCategory category;
+		uint32_t heap;
+		VkDeviceSize size;
+		std::string name;
+	};
+
+	static void Grow(Usage& usage, VkDeviceSize size);
+	static void Shrink(Usage& usage, VkDeviceSize size);
+
+	std::unordered_map<VkDeviceMemory, Allocation> m_Allocations;
+	// the memory bound to every buffer and image, names are given to those
+	std::unordered_map<uint64_t, VkDeviceMemory> m_Objects;
+	std::vector<uint32_t> m_TypeHeaps;
+	std::vector<Usage> m_Heaps;
+	std::array<Usage, static_cast<size_t>(MemoryCategory::Count)> m_Categories{};
+
+	// allocations listed in a report, the rest are summed up
+	inline static const size_t REPORT_ALLOCATION_COUNT{ 20 };
+};
@@ -2,8 +2,12 @@
 #include "DataTypes.h"
 #include "Image.h"
 #include <vector>
+#include <cfloat>
+#include <algorithm>
+#include <limits>
 #include "Buffer.h"
 #include "Device.h"
+#include "Bvh.h"
 
 class CommandPool;
 class Mesh final
@@ -13,37 +17,106 @@ public:
 	
 	Buffer* GetVertexBuffer() { return &m_VertexBuffer; }
 	Buffer* GetIndexBuffer() { return &m_IndexBuffer; }
+	// 16 bit whenever every vertex can be addressed with it
+	VkIndexType GetIndexType() const { return m_IndexType; }
 
-	datatype::TextureIndices* GetTextureIndices() { return &m_TextureIndices; }
+	// entry of the material table of the scene
+	uint32_t GetMaterialIndex() const { return m_MaterialIndex; }
+
+	// every placement by the scene graph and every copy found at import, drawn as instances with world matrices from the instance buffer of the scene
+	uint32_t GetFirstInstance() const { return m_FirstInstance; }
+	uint32_t GetInstanceCount() const { return static_cast<uint32_t>(m_Instances.size()); }
+
+	// world space bounds of every instance together, used for culling
+	const glm::vec3& GetAABBMin() const { return m_AABBMin; }
+	const glm::vec3& GetAABBMax() const { return m_AABBMax; }
+	// largest scale of any instance, turns errors in mesh space into world space
+	float GetWorldScale() const { return m_WorldScale; }
+	// clusters of the full detail level in index buffer order with bounds in the space of the vertices
+	const std::vector<datatype::Meshlet>& GetMeshlets() const { return m_Meshlets; }
+	// full detail first, every level is a range of the one index buffer
+	const std::vector<datatype::MeshLod>& GetLods() const { return m_Lods; }
+	// triangles of the full detail level in mesh space, empty unless Scene::BuildTriangleBvhs was called
+	const Bvh& GetTriangleBvh() const { return m_TriangleBvh; }
+
+	// streaming drops the gpu buffers of far meshes, they must not be drawn until loaded again
+	bool IsResident() const { return m_IsResident; }
+	// bytes of the vertex and index buffers, whether they are loaded or not
+	VkDeviceSize GetGpuSize() const { return sizeof(datatype::Vertex) * m_Vertices.size() + ((m_IndexType == VK_INDEX_TYPE_UINT16) ? sizeof(uint16_t) : sizeof(uint32_t)) * m_Indices.size(); }
 
 	void Destroy(Device* device)
 	{
+		if (!m_IsResident)
+			return;
 		m_VertexBuffer.Destroy(device);
 		m_IndexBuffer.Destroy(device);
+		m_IsResident = false;
 	}
 
 private:
 	friend class Scene;
-	Mesh(Device* device, CommandPool* commandPool, const std::vector<datatype::Vertex>& vertices, const std::vector<uint32_t>& indices, const datatype::TextureIndices& textureIndices) :
-		  m_TextureIndices{ textureIndices }
+	Mesh(Device* device, CommandPool* commandPool, const std::vector<datatype::Vertex>& vertices, const std::vector<uint32_t>& indices, uint32_t materialIndex) :
+		  m_MaterialIndex{ materialIndex }
 		, m_Vertices{ vertices }
 		, m_Indices{ indices }
 	{
-		VkDeviceSize vertBufferSize = sizeof(vertices[0]) * vertices.size();
-		VkDeviceSize indBufferSize = sizeof(indices[0]) * indices.size();
+		// primitive restart is off, so the largest 16 bit value is an ordinary index
+		m_IndexType = (vertices.size() <= std::numeric_limits<uint16_t>::max() + size_t{ 1 }) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+		CreateBuffers(device, commandPool);
+	}
+
+	// uploads the cooked data kept on the cpu, again after every time streaming dropped it
+	void CreateBuffers(Device* device, CommandPool* commandPool)
+	{
+		VkDeviceSize vertBufferSize = sizeof(m_Vertices[0]) * m_Vertices.size();
 		BufferBuilder builder{};
 		builder
 			.BindData((void*)m_Vertices.data(), commandPool)
 			.CreateBufferWithData(m_VertexBuffer, device, commandPool, vertBufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 		device->SetObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)*m_VertexBuffer.GetBufferPtr(), "Vertex buffer");
-		builder
-			.BindData((void*)m_Indices.data(), commandPool)
-			.CreateBufferWithData(m_IndexBuffer, device, commandPool, indBufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		if (m_IndexType == VK_INDEX_TYPE_UINT16)
+		{
+			std::vector<uint16_t> shortIndices(m_Indices.size());
+			std::transform(m_Indices.begin(), m_Indices.end(), shortIndices.begin(), [](uint32_t index) { return static_cast<uint16_t>(index); });
+			builder
+				.BindData((void*)shortIndices.data(), commandPool)
+				.CreateBufferWithData(m_IndexBuffer, device, commandPool, sizeof(uint16_t) * shortIndices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		}
+		else
+		{
+			builder
+				.BindData((void*)m_Indices.data(), commandPool)
+				.CreateBufferWithData(m_IndexBuffer, device, commandPool, sizeof(uint32_t) * m_Indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		}
 		device->SetObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)*m_IndexBuffer.GetBufferPtr(), "Index buffer");
+		m_IsResident = true;
 	}
-	datatype::TextureIndices m_TextureIndices;
+
+	// a scene graph node and where the copy sits relative to the imported mesh
+	struct Instance
+	{
+		uint32_t node;
+		glm::mat4 offset;
+	};
+
+	uint32_t m_MaterialIndex;
+	// the first instance is where the mesh was imported
+	std::vector<Instance> m_Instances;
+	uint32_t m_FirstInstance{};
+	glm::vec3 m_LocalMin{ FLT_MAX };
+	glm::vec3 m_LocalMax{ -FLT_MAX };
+	glm::vec3 m_AABBMin{ FLT_MAX };
+	glm::vec3 m_AABBMax{ -FLT_MAX };
+	float m_WorldScale{ 1.f };
+	std::vector<datatype::Meshlet> m_Meshlets;
+	std::vector<datatype::MeshLod> m_Lods;
+	Bvh m_TriangleBvh;
 	std::vector<datatype::Vertex> m_Vertices;
 	Buffer m_VertexBuffer;
+	// the cooked indices stay 32 bit on the cpu, only the gpu copy is narrowed
 	std::vector<uint32_t> m_Indices;
 	Buffer m_IndexBuffer;
+	VkIndexType m_IndexType{ VK_INDEX_TYPE_UINT32 };
+	bool m_IsResident{};
 };
\ No newline at end of file
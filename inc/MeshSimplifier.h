@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "DataTypes.h"
+
+// quadric error edge collapse, every level keeps the vertices of the input so one vertex buffer serves all of them
+// collapses only move a vertex onto a neighbour, vertices on borders and attribute seams never move
+class MeshSimplifier final
+{
+public:
+	struct Result
+	{
+		// every level after each other, full detail first
+		std::vector<uint32_t> indices;
+		std::vector<datatype::MeshLod> lods;
+	};
+
+	MeshSimplifier() = delete;
+
+	// stops at the target index count or once the next collapse would exceed the target error, in units of the positions
+	static std::vector<uint32_t> Simplify(const std::vector<datatype::Vertex>& vertices, const std::vector<uint32_t>& indices, size_t targetIndexCount, float targetError, float& resultError);
+	// up to MAX_LOD_COUNT levels, each simplified from the full detail input with a shrinking index budget
+	static Result BuildLodChain(const std::vector<datatype::Vertex>& vertices, const std::vector<uint32_t>& indices);
+
+	inline static const uint32_t MAX_LOD_COUNT{ 5 };
+
+private:
+	// symmetric 4x4 error matrix of the planes around a vertex, weighted by triangle area
+	struct Quadric
+	{
+		double a00, a01, a02, a11, a12, a22;
+		double b0, b1, b2;
+		double c;
+		double weight;
+
+		void AddPlane(const glm::dvec3& normal, double distance, double area);
+		void Add(const Quadric& other);
+		// mean squared distance of a position to the planes
+		double Evaluate(const glm::dvec3& position) const;
+	};
+
+	// index budget of every level relative to the one before
+	inline static const float LOD_REDUCTION{ .5f };
+	// a level that could not get below this share of the one before is not worth its memory
+	inline static const float MIN_LOD_GAIN{ .8f };
+	inline static const size_t MIN_LOD_TRIANGLES{ 32 };
+	// of the diagonal of the mesh bounds
+	inline static const float MAX_RELATIVE_ERROR{ .02f };
+};
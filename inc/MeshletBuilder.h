@@ -0,0 +1,32 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "DataTypes.h"
+
+// splits an indexed triangle list into clusters small enough for a mesh shader workgroup
+// runs once at import, the clusters are drawn as index ranges so the index buffer is reordered cluster by cluster
+class MeshletBuilder final
+{
+public:
+	struct Result
+	{
+		// every index of the input, grouped by cluster
+		std::vector<uint32_t> indices;
+		// bounds in the space of the vertices, mesh and first cluster of the mesh are left to the caller
+		std::vector<datatype::Meshlet> meshlets;
+	};
+
+	MeshletBuilder() = delete;
+
+	static Result Build(const std::vector<datatype::Vertex>& vertices, const std::vector<uint32_t>& indices);
+
+	// limits of VK_EXT_mesh_shader implementations are at least 256 of each, these keep output in on chip memory
+	inline static const uint32_t MAX_VERTICES{ 64 };
+	inline static const uint32_t MAX_TRIANGLES{ 124 };
+
+private:
+	static void ComputeBounds(const std::vector<datatype::Vertex>& vertices, const uint32_t* indices, uint32_t indexCount, datatype::Meshlet& meshlet);
+
+	// normals closer than this to perpendicular to the average make the cone useless
+	inline static const float MIN_CONE_DOT{ .1f };
+};
@@ -15,6 +15,7 @@ public:
 
 private:
 	friend class PipelineBuilder;
+	friend class ComputePipelineBuilder;
 	Pipeline() = default;
 
 	VkPipeline m_Pipeline;
@@ -92,3 +93,24 @@ private:
 	VkVertexInputBindingDescription	  m_VertexBindingDescription{};
 	uint32_t m_VertexAttributeCount{};
 };
+
+class ComputePipelineBuilder final
+{
+public:
+	ComputePipelineBuilder() = default;
+	~ComputePipelineBuilder() = default;
+	
+	ComputePipelineBuilder(const ComputePipelineBuilder&) 				= delete;
+	ComputePipelineBuilder(ComputePipelineBuilder&&) noexcept 			= delete;
+	ComputePipelineBuilder& operator=(const ComputePipelineBuilder&) 	 	= delete;
+	ComputePipelineBuilder& operator=(ComputePipelineBuilder&&) noexcept 	= delete;
+
+	// shader stage has to outlive the build call, specialization data is referenced not copied
+	ComputePipelineBuilder& SetShaderStage(ShaderStage& shaderStage);
+
+	void Build(std::unique_ptr<Pipeline>& pipeline, Device* device, VkPipelineLayout layout);
+	Pipeline Build(Device* device, VkPipelineLayout layout);
+
+private:
+	VkPipelineShaderStageCreateInfo m_StageInfo{};
+};
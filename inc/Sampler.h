@@ -65,6 +65,13 @@ public:
 		return *this;
 	}
 
+	// defaults to 0, only the first level is sampled unless raised
+	SamplerBuilder& SetMaxLod(float maxLod)
+	{
+		m_SamplerInfo.maxLod = maxLod;
+		return *this;
+	}
+
 	SamplerBuilder& SetCompareOp(VkCompareOp op)
 	{
 		m_SamplerInfo.compareEnable = VK_TRUE;
@@ -2,8 +2,13 @@
 #include "Mesh.h"
 #include "DataTypes.h"
 #include "DeletionQueue.h"
+#include "SceneGraph.h"
+#include "Bvh.h"
+#include "StreamingGrid.h"
 #include <vector>
 #include <memory>
+#include <unordered_map>
+#include <string>
 
 struct aiNode;
 struct aiScene;
@@ -16,16 +21,67 @@ public:
 
 	void Load(Device* device, CommandPool* commandPool, const char* filepath);
 
+	// where every texture comes from, indexed like the textures
+	struct TextureSource
+	{
+		std::string path;
+		VkFormat format;
+	};
+
+	// load only records the texture sources, a texture streamer fills the textures, call before load
+	void DeferTextures() { m_AreTexturesDeferred = true; }
+
 	void Flush()
 	{
 		m_DeletionQueue.Flush();
 	}
 
-	void CalculateLightViewProj(datatype::DirectionalLight& light);
+	const glm::vec3& GetAABBMin() const { return m_AABBMin; }
+	const glm::vec3& GetAABBMax() const { return m_AABBMax; }
+
+	// fits an axis aligned box around the transformed corners of another one
+	static void TransformAABB(const glm::mat4& transform, glm::vec3& min, glm::vec3& max);
 
 	std::vector<Mesh>& GetMeshes();
 
 	std::vector<Image>& GetTextures();
+	const std::vector<TextureSource>& GetTextureSources() const { return m_TextureSources; }
+
+	// deduplicated texture sets, indexed by the material index of a mesh
+	const std::vector<datatype::TextureIndices>& GetMaterials() const { return m_Materials; }
+	Buffer* GetMaterialBuffer() { return m_MaterialBufferPtr.get(); }
+	// world matrices of every instance of every mesh back to back
+	Buffer* GetInstanceBuffer() { return m_InstanceBufferPtr.get(); }
+
+	// the root node holds the model matrix, below it the nodes of the file
+	const SceneGraph& GetGraph() const { return m_Graph; }
+	void SetNodeTransform(uint32_t node, const glm::mat4& localTransform) { m_Graph.SetLocalTransform(node, localTransform); }
+	// writes the instances of moved nodes and refits the bounds of their meshes, false while nothing moved
+	bool UpdateTransforms();
+
+	// world space bounds of every mesh, primitives are mesh indices
+	const Bvh& GetMeshBvh() const { return m_MeshBvh; }
+	// lets raycasts hit triangles instead of mesh bounds, costs memory so it is not done at load
+	void BuildTriangleBvhs();
+	// closest mesh along the ray, Bvh::NO_HIT without one, distance is the limit on the way in and the hit on the way out
+	uint32_t Raycast(const glm::vec3& origin, const glm::vec3& direction, float& distance) const;
+
+	struct StreamingStatistics
+	{
+		uint32_t loadedCells;
+		uint32_t evictedCells;
+		uint64_t loadedBytes;
+	};
+
+	// groups the meshes into cells whose gpu buffers come and go with the distance to the camera
+	// the cooked vertices and indices stay on the cpu, uploads need no file access
+	void EnableStreaming(float cellSize);
+	// drops the farthest cells over budget bytes and uploads missing near ones, called once the frame in flight finished
+	void UpdateStreaming(Device* device, CommandPool* commandPool, const glm::vec3& position, uint64_t budget);
+	bool IsStreaming() const { return m_IsStreaming; }
+	const StreamingGrid& GetStreamingGrid() const { return m_StreamingGrid; }
+	// totals since streaming was enabled
+	const StreamingStatistics& GetStreamingStatistics() const { return m_StreamingStatistics; }
 
 	glm::mat4 GetModelMatrix() 
 	{
@@ -33,14 +89,69 @@ public:
 	}
 
 private:
-	void ProcessNode(Device* device, CommandPool* commandPool, aiNode* node, const aiScene* scene);
+	// a mesh as imported, kept while loading to recognize copies of it
+	struct ImportedGeometry
+	{
+		std::vector<datatype::Vertex> vertices;
+		std::vector<uint32_t> indices;
+		uint32_t materialIndex;
+		glm::vec3 min;
+	};
+
+	static uint64_t HashGeometry(const ImportedGeometry& geometry);
+	// index of a mesh with the same data up to a translation, UINT32_MAX without one
+	uint32_t FindDuplicate(uint64_t hash, const ImportedGeometry& geometry) const;
+
+	// index of the texture, loaded the first time the name is seen
+	uint32_t LoadTexture(Device* device, CommandPool* commandPool, const std::string& name, VkFormat format);
+	void ProcessNode(Device* device, CommandPool* commandPool, const aiNode* node, uint32_t graphNode, const aiScene* scene);
+	// bounds of every instance of the mesh in world space
+	void UpdateBounds(Mesh& mesh);
+	void UpdateSceneBounds();
+	void BuildMeshBvh();
+	void GetMeshBounds(std::vector<glm::vec3>& mins, std::vector<glm::vec3>& maxs) const;
 
 	std::unordered_map<std::string, uint32_t> m_LoadedTextures;
 	std::vector<Image> m_Textures;
+	std::vector<TextureSource> m_TextureSources;
+	bool m_AreTexturesDeferred{};
 	std::vector<Mesh> m_Meshes;
+	std::vector<datatype::TextureIndices> m_Materials;
+	std::unique_ptr<Buffer> m_MaterialBufferPtr;
+	std::vector<glm::mat4> m_InstanceTransforms;
+	std::unique_ptr<Buffer> m_InstanceBufferPtr;
+
+	SceneGraph m_Graph;
+	// instances placed by every node and the mesh of every instance
+	std::vector<std::vector<uint32_t>> m_NodeInstances;
+	std::vector<uint32_t> m_InstanceMeshes;
+
+	Bvh m_MeshBvh;
+	// cost right after the last build, refits only degrade it
+	float m_MeshBvhCost{};
+
+	StreamingGrid m_StreamingGrid;
+	bool m_IsStreaming{};
+	StreamingStatistics m_StreamingStatistics{};
+	// cells picked by the last update, kept to avoid an allocation per frame
+	std::vector<uint32_t> m_StreamingEvictions;
+	std::vector<uint32_t> m_StreamingLoads;
+
+	std::unordered_multimap<uint64_t, uint32_t> m_GeometryHashes;
+	std::vector<ImportedGeometry> m_ImportedGeometry;
+	uint64_t m_DuplicateBytes{};
 
 	glm::vec3 m_AABBMin{ FLT_MAX };
-	glm::vec3 m_AABBMax{ FLT_MIN };
+	glm::vec3 m_AABBMax{ -FLT_MAX };
 
 	DeletionQueue m_DeletionQueue;
+
+	// acmr a piece of a mesh may lose to be ordered for overdraw
+	inline static const float OVERDRAW_THRESHOLD{ 1.05f };
+	// largest difference of an attribute, positions relative to the bounds, for two meshes to count as copies
+	inline static const float INSTANCE_TOLERANCE{ 1e-4f };
+	// cost a refitted mesh bvh may reach relative to its last build before it is rebuilt
+	inline static const float BVH_REBUILD_RATIO{ 1.5f };
+	// bytes uploaded per frame at most, more cells wait for the next frames instead of stalling one
+	inline static const uint64_t STREAMING_LOAD_LIMIT{ 16 * 1024 * 1024 };
 };
\ No newline at end of file
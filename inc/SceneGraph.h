@@ -0,0 +1,42 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <glm/glm.hpp>
+
+// node transforms of the scene in flat arrays, added breadth first so every level is a contiguous range following its parents
+// an update scans every node once and multiplies only those below a changed one, large levels are spread over threads
+class SceneGraph final
+{
+public:
+	// the parent has to be added before and the depth may never go back, roots have no parent
+	uint32_t AddNode(uint32_t parent, const glm::mat4& localTransform);
+
+	void SetLocalTransform(uint32_t node, const glm::mat4& localTransform);
+
+	const glm::mat4& GetLocalTransform(uint32_t node) const { return m_LocalTransforms[node]; }
+	const glm::mat4& GetWorldTransform(uint32_t node) const { return m_WorldTransforms[node]; }
+	uint32_t GetParent(uint32_t node) const { return m_Parents[node]; }
+	size_t GetNodeCount() const { return m_Parents.size(); }
+
+	// propagates changed local transforms down the hierarchy, returns every node whose world transform changed
+	// returns immediately while nothing was changed since the last update
+	const std::vector<uint32_t>& Update();
+
+	inline static const uint32_t NO_PARENT{ UINT32_MAX };
+
+private:
+	std::vector<uint32_t> m_Parents;
+	std::vector<uint32_t> m_Depths;
+	std::vector<glm::mat4> m_LocalTransforms;
+	std::vector<glm::mat4> m_WorldTransforms;
+	// bytes instead of a bit vector, nodes of one level are written from several threads
+	std::vector<uint8_t> m_Dirty;
+	// first node of every level
+	std::vector<uint32_t> m_LevelOffsets;
+	std::vector<uint32_t> m_Changed;
+	bool m_HasChanges{};
+
+	// smaller levels are not worth the cost of waking other threads
+	inline static const uint32_t PARALLEL_LEVEL_SIZE{ 1024 };
+};
@@ -0,0 +1,117 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// trades g-buffer precision for bandwidth, see DynamicRenderingApp::GetGBufferLayout
+enum class GBufferProfile : uint32_t
+{
+	Reference,	// rgba16 material, rgba32f hdr
+	Balanced,	// rgba16 material, rgba16f hdr
+	Compact		// rg16 normal, rg8 roughness/metalness, b10g11r11 hdr
+};
+
+// storage of the baked environment cube, see DynamicRenderingApp::GetEnvironmentFormat
+enum class EnvironmentFormat : uint32_t
+{
+	RGBA32F,
+	RGBA16F,
+	B10G11R11,	// no alpha, 6 and 5 bit mantissas
+	E5B9G9R9	// shared exponent, not renderable so it is packed from a half float bake
+};
+
+// how the tonemapper picks its exposure, order matches the exposure modes in tonemap.glsl
+enum class ExposureMode : uint32_t
+{
+	Auto,		// adapts to a luminance histogram of the hdr target built on the gpu
+	Indoor,		// fixed physical camera, f/1.6 1/60s iso 1600
+	Sunny16		// fixed physical camera, f/5 1/200s iso 100
+};
+
+// startup options, parsed once from the command line
+// defaults are the configuration the renderer is tuned for, compute lighting, auto exposure and lod selection are on
+struct Settings final
+{
+	// deferred lighting done by tile classified compute dispatches instead of a full screen triangle
+	// toggled at runtime with L
+	bool		computeLighting{ true };
+	// 8 or 16, size of the square tiles used for classification
+	uint32_t	tileSize{ 16 };
+	GBufferProfile gbufferProfile{ GBufferProfile::Reference };
+	// fragment lighting tonemaps directly into the swapchain when no pass needs the hdr target
+	bool		fusedTonemap{ false };
+	// cascades per directional light, fitted to slices of the camera frustum
+	uint32_t	shadowCascadeCount{ 4 };
+	// width and height of every cascade
+	uint32_t	shadowResolution{ 1024 };
+	// gpu time the shadow pass may take, far cascades are refreshed less often when exceeded
+	float		shadowBudgetMs{ 1.5f };
+	// every format gets a full mip chain generated on the gpu
+	EnvironmentFormat environmentFormat{ EnvironmentFormat::RGBA32F };
+	// baked environment and irradiance are loaded from and saved to a file next to the source image
+	bool		iblCache{ true };
+	// the fixed indoor camera needed a shader rebuild to change, auto replaces it
+	// auto exposure measures the hdr target so it keeps the hdr round trip even when tonemapping is fused
+	ExposureMode exposureMode{ ExposureMode::Auto };
+	// g-buffer and lighting are rendered at a scale picked from gpu frame times and upscaled by the blit
+	bool		dynamicResolution{ false };
+	// gpu time per frame the dynamic resolution controller aims for
+	float		frameBudgetMs{ 16.6f };
+	// lighting reprojects the previous frame and only evaluates a rotating subset and disoccluded pixels
+	bool		lightingCache{ false };
+	// 2, 4, 8 or 16, one in this many pixels is evaluated every frame
+	uint32_t	cacheRefreshRatio{ 4 };
+	// evaluates every pixel anyway and reports the error of the cached ones
+	bool		cacheValidation{ false };
+	// meshes hidden behind the depth prepass of the previous frame and this one are dropped from the g-buffer
+	bool		occlusionCulling{ false };
+	// clusters of the visible meshes are culled by frustum, normal cone and depth pyramid, implies occlusion culling
+	bool		clusterCulling{ false };
+	// screen space error in pixels a coarser level of detail may cause, 0 keeps full detail
+	float		lodErrorPixels{ 1.f };
+	// raycasts of the scene test triangles through a bvh per mesh instead of stopping at the mesh bounds
+	bool		triangleBvh{ false };
+	// gpu memory in MB the geometry may use, far cells of the scene are dropped beyond it, 0 keeps everything loaded
+	float		streamingBudgetMB{ .0f };
+	// edge length of the cubes the meshes are grouped in for streaming
+	float		streamingCellSize{ 8.f };
+	// gpu memory in MB the scene textures may use, they start small and are refined where the g-buffer samples them finely, 0 loads them at full resolution
+	float		textureBudgetMB{ .0f };
+	// frames measured while the camera follows a path at a fixed timestep, the app exits afterwards, 0 runs interactively
+	uint32_t	benchmarkFrames{ 0 };
+	// camera path file of the benchmark, empty flies the built in sponza loop, R records one interactively
+	std::string	benchmarkPath{};
+	// per frame times and their distribution, json when the name ends in .json and csv otherwise
+	std::string	benchmarkOutput{ "benchmark.csv" };
+	// simulated time per benchmark frame, drives the camera path and auto exposure
+	float		benchmarkStepMs{ 1000.f / 60.f };
+	// the benchmark renders to a hidden window, ignored without a benchmark as nothing could close it
+	bool		headless{ false };
+
+	// --lighting=fragment|compute
+	// --tile-size=8|16
+	// --gbuffer=reference|balanced|compact
+	// --tonemap=separate|fused
+	// --cascades=1..4
+	// --shadow-resolution=512|1024|2048|4096
+	// --shadow-budget=<ms>
+	// --environment=rgba32f|rgba16f|b10g11r11|e5b9g9r9
+	// --ibl-cache=on|off
+	// --exposure=auto|indoor|sunny16
+	// --dynamic-resolution=on|off
+	// --frame-budget=<ms>
+	// --lighting-cache=on|off|validate
+	// --cache-refresh=2|4|8|16
+	// --occlusion-culling=on|off
+	// --cluster-culling=on|off
+	// --lod-error=<pixels>
+	// --triangle-bvh=on|off
+	// --streaming-budget=<MB>
+	// --streaming-cell=<size>
+	// --texture-budget=<MB>
+	// --benchmark=<frames>
+	// --benchmark-path=<file>
+	// --benchmark-output=<file.csv|file.json>
+	// --benchmark-step=<ms>
+	// --headless=on|off
+	static Settings FromCommandLine(int argc, char* argv[]);
+};
@@ -15,6 +15,7 @@ public:
 	VkShaderModule GetModule() { return m_ShaderModule; }
 
 	// supports only data of the same size
+	// data is referenced until the pipeline is built
 	void AddSpecialization(uint32_t sizes, uint32_t count, void* data);
 
 	void Destroy(Device* device);
@@ -0,0 +1,58 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "DataTypes.h"
+
+class Camera;
+class Bvh;
+
+// fits cascaded shadow maps of every directional light to slices of the camera frustum
+// cpu side only, the app renders the maps and uploads GetCascades() every frame
+class ShadowCascades final
+{
+public:
+	// splitLambda blends logarithmic (1) and uniform (0) split distances
+	ShadowCascades(uint32_t lightCount, uint32_t cascadeCount, uint32_t resolution, float splitLambda);
+	~ShadowCascades() = default;
+
+	ShadowCascades(const ShadowCascades&) 				= delete;
+	ShadowCascades(ShadowCascades&&) noexcept 			= delete;
+	ShadowCascades& operator=(const ShadowCascades&) 	 	= delete;
+	ShadowCascades& operator=(ShadowCascades&&) noexcept 	= delete;
+
+	// cascades outside of updateMask keep the matrix their map was last rendered with
+	void Update(const Camera* camera, const glm::mat4& view, const std::vector<datatype::DirectionalLight>& lights
+				, const glm::vec3& sceneMin, const glm::vec3& sceneMax, uint32_t updateMask);
+
+	// marks the layers each mesh overlaps among the updated cascades, casters between the light and the cascade are kept
+	// meshes are found through the bvh over their bounds, whole subtrees inside a cascade are taken without tests
+	void Cull(const Bvh& meshBvh, uint32_t meshCount, uint32_t updateMask);
+
+	uint32_t GetCascadeCount() const { return m_CascadeCount; }
+	uint32_t GetResolution() const { return m_Resolution; }
+
+	// index is light * cascade count + cascade, which is also the layer of the shadow map array
+	const std::vector<datatype::ShadowCascade>& GetCascades() const { return m_Cascades; }
+
+	// bit per layer the mesh has to be rendered to this frame, 0 when culled from every updated layer
+	uint32_t GetLayerMask(uint32_t meshIndex) const { return m_MeshLayerMasks[meshIndex]; }
+	// casters found the last time the layer was updated
+	uint32_t GetCasterCount(uint32_t layer) const { return m_CasterCounts[layer]; }
+
+	inline static const uint32_t MAX_CASCADES{ 4 };
+	// layers are addressed by the bits of a 32 bit mask
+	inline static const uint32_t MAX_LAYERS{ 32 };
+
+private:
+	void CalculateSplits(float near, float far);
+
+	uint32_t m_CascadeCount;
+	uint32_t m_Resolution;
+	float	 m_SplitLambda;
+
+	// view space distances, m_CascadeCount + 1 entries starting at camera near
+	std::vector<float> m_SplitDepths;
+	std::vector<datatype::ShadowCascade> m_Cascades;
+	std::vector<uint32_t> m_MeshLayerMasks;
+	std::vector<uint32_t> m_CasterCounts;
+};
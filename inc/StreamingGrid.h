@@ -0,0 +1,44 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <glm/glm.hpp>
+
+// spatial cells of a streamed scene, decides which cells should be on the gpu and leaves the uploads to the scene
+// cells are ranked by distance to the camera and kept from the nearest on until the memory budget is full
+class StreamingGrid final
+{
+public:
+	struct Cell
+	{
+		glm::vec3 min;
+		glm::vec3 max;
+		std::vector<uint32_t> items;
+		uint64_t size;
+		bool isResident;
+	};
+
+	// items go to the cell their bounds are centered in, every item starts resident
+	void Build(const std::vector<glm::vec3>& mins, const std::vector<glm::vec3>& maxs, const std::vector<uint64_t>& sizes, float cellSize);
+	// cell bounds follow items that moved
+	void UpdateBounds(const std::vector<glm::vec3>& mins, const std::vector<glm::vec3>& maxs);
+
+	// cells to drop and to upload this frame, nearest first, uploads stop after loadLimit bytes but at least one cell is loaded
+	// the nearest cell is always wanted, even when it does not fit the budget on its own
+	void Update(const glm::vec3& position, uint64_t budget, uint64_t loadLimit, std::vector<uint32_t>& evictions, std::vector<uint32_t>& loads);
+	// the scene confirms every eviction and load it carried out
+	void SetResident(uint32_t cell, bool isResident);
+
+	const std::vector<Cell>& GetCells() const { return m_Cells; }
+	uint64_t GetResidentSize() const { return m_ResidentSize; }
+
+private:
+	std::vector<Cell> m_Cells;
+	uint64_t m_ResidentSize{};
+	float m_CellSize{};
+	// ranking scratch, kept to avoid an allocation per frame
+	std::vector<std::pair<float, uint32_t>> m_Order;
+
+	// fraction of a cell resident cells are moved closer by when ranked
+	inline static const float HYSTERESIS{ .25f };
+};
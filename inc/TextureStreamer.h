@@ -0,0 +1,112 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <memory>
+#include <future>
+#include <cstdint>
+#include "Scene.h"
+
+class Device;
+class CommandPool;
+class CommandBuffer;
+class Buffer;
+class DescriptorSet;
+
+// keeps every scene texture at the resolution it is seen at, within a memory budget
+// the g-buffer pass writes the finest level it sampled of each texture to a feedback buffer, read once the frame finished
+// textures start at a small tail, other levels are decoded on worker threads and the finished image replaces the old one in the descriptor array
+// the copies of replaced images are recorded into the frame, nothing waits on the gpu outside of the frame fence
+class TextureStreamer final
+{
+public:
+	struct Statistics
+	{
+		uint32_t uploads;
+		uint64_t uploadedBytes;
+	};
+
+	// a budget of 0 leaves the textures the scene loaded alone, the feedback buffer is created either way
+	// otherwise the scene has to have deferred its textures, they are created here at their tails
+	TextureStreamer(Device* device, CommandPool* commandPool, Scene* scene, uint64_t budget);
+	~TextureStreamer() = default;
+
+	TextureStreamer(const TextureStreamer&) 				= delete;
+	TextureStreamer(TextureStreamer&&) noexcept 			= delete;
+	TextureStreamer& operator=(const TextureStreamer&) 	 	= delete;
+	TextureStreamer& operator=(TextureStreamer&&) noexcept 	= delete;
+
+	// call after the frame fence is waited on, picks levels from the feedback of the last frame and swaps in finished textures
+	// the new images are written to binding of every descriptor set, their pixels only arrive with RecordUploads
+	// a texture whose file fails to decode is reported and kept at the level it has
+	void Update(Device* device, CommandPool* commandPool, Scene* scene, std::vector<DescriptorSet>& descriptorSets, uint32_t binding);
+	// copies the images swapped in by the last update, has to be recorded before anything samples the scene textures
+	void RecordUploads(Device* device, CommandBuffer* commandBuffer, Scene* scene);
+
+	Buffer* GetFeedbackBuffer() { return m_FeedbackBufferPtr.get(); }
+	bool IsEnabled() const { return m_IsEnabled; }
+	// the requested budget lowered to what the device heap has left, as of the last update
+	uint64_t GetBudget() const { return m_Budget; }
+	uint64_t GetResidentSize() const { return m_ResidentSize; }
+	// 0 is full resolution
+	uint32_t GetResidentLevel(uint32_t texture) const { return m_Textures[texture].residentLevel; }
+	// totals since the textures were created
+	const Statistics& GetStatistics() const { return m_Statistics; }
+
+	void Destroy(Device* device);
+
+private:
+	// levels from first down to 1x1, tightly packed
+	struct DecodedTexture
+	{
+		uint32_t width;
+		uint32_t height;
+		uint32_t firstLevel;
+		std::vector<uint8_t> pixels;
+	};
+
+	struct Texture
+	{
+		uint32_t width{};
+		uint32_t height{};
+		uint32_t levelCount{};
+		uint32_t tailLevel{};
+		uint32_t residentLevel{};
+		uint32_t wantedLevel{};
+		uint32_t unseenFrames{};
+		bool hasFailed{};
+		std::future<DecodedTexture> pending;
+	};
+
+	// staging memory of a swapped in image, freed once the frame that copied it finished
+	struct Upload
+	{
+		uint32_t texture;
+		std::unique_ptr<Buffer> stagingBufferPtr;
+	};
+
+	// reads the file and box filters it down, srgb textures are averaged in linear space, runs on worker threads
+	static DecodedTexture Decode(const Scene::TextureSource& source, uint32_t firstLevel);
+	static Image CreateImage(Device* device, CommandPool* commandPool, const Scene::TextureSource& source, const DecodedTexture& decoded);
+	// the image without its pixels and a staging buffer holding them for RecordUploads
+	static Image CreateImage(Device* device, CommandPool* commandPool, const Scene::TextureSource& source, const DecodedTexture& decoded, std::unique_ptr<Buffer>& stagingBufferPtr);
+	// bytes of the texture with level as its first one
+	uint64_t GetSize(const Texture& texture, uint32_t level) const;
+	// what the budget allows of the wanted levels, the largest textures lose a level first
+	void FitBudget(Device* device);
+
+	std::vector<Texture> m_Textures;
+	std::vector<Upload> m_Uploads;
+	std::unique_ptr<Buffer> m_FeedbackBufferPtr;
+	uint64_t m_RequestedBudget{};
+	uint64_t m_Budget{};
+	uint64_t m_ResidentSize{};
+	Statistics m_Statistics{};
+	bool m_IsEnabled{};
+
+	// largest edge of the level every texture starts at and falls back to
+	inline static const uint32_t TAIL_SIZE{ 128 };
+	// decodes in flight at once, each holds a full resolution copy of its file
+	inline static const uint32_t MAX_PENDING{ 4 };
+	// frames a texture may go unsampled before it drops to its tail
+	inline static const uint32_t UNSEEN_FRAMES{ 120 };
+};
@@ -5,4 +5,7 @@ namespace WorldTime
 	float GetElapsedSec();
 
 	void Tick();
-}
\ No newline at end of file
+
+	// every tick advances by step instead of the measured time, 0 measures again
+	void SetFixedStep(float step);
+}
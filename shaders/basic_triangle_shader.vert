@@ -1,4 +1,5 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
 
 layout(set = 1, binding = 0) uniform ModelViewProjection
 {
@@ -7,6 +8,8 @@ layout(set = 1, binding = 0) uniform ModelViewProjection
 	mat4 projection;
 } mvp;
 
+#include "instancing.glsl"
+
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColour;
 layout(location = 2) in vec2 inTexCoord;
@@ -19,7 +22,7 @@ layout(location = 1) out vec2 fragTexCoord;
 
 void main()
 {
-	gl_Position = mvp.projection * mvp.view * mvp.model * vec4(inPosition, 1.);
+	gl_Position = mvp.projection * mvp.view * instances.Transforms[gl_InstanceIndex] * vec4(inPosition, 1.);
 	fragColour = inColour;
 	fragTexCoord = inTexCoord;
 }
\ No newline at end of file
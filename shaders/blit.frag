@@ -1,75 +1,80 @@
 #version 450
 #extension GL_EXT_nonuniform_qualifier : require
 #extension GL_EXT_samplerless_texture_functions : require
-#define INDOOR
+#extension GL_GOOGLE_include_directive : require
+
+#include "tonemap.glsl"
 
 layout(location = 0) out vec4 outColour;
 layout(location = 1) in vec2 fragTexCoord;
 
+layout(constant_id = 0) const uint EXPOSURE_MODE = EXPOSURE_AUTO;
+// sharpening of the upscale from 0 to 1, only used while dynamic resolution renders below native
+layout(constant_id = 1) const float SHARPNESS = .5f;
+
 layout(set = 0, binding = 4) uniform sampler samp;
 
+// written by the auto exposure pass earlier in the frame
+layout(std430, set = 0, binding = 9) readonly buffer ExposureSSBO
+{
+	float AverageLuminance;
+	float Exposure;
+} exposureData;
+
+layout(set = 2, binding = 0) uniform ModelViewProjection
+{
+	mat4 model;
+	mat4 view;
+	mat4 projection;
+	mat4 inverseView;
+	mat4 inverseProjection;
+	vec2 renderScale;
+} mvp;
+
 layout(set = 2, binding = 1) uniform texture2D albedoTexture;
 layout(set = 2, binding = 2) uniform texture2D materialProps;
 layout(set = 2, binding = 3) uniform texture2D depthBuffer;
 layout(set = 2, binding = 4) uniform texture2D hdrImage;
 
-float CalculateEV100FromPhysicalCamera(in float aperture, in float shutterTime, in float ISO)
+// bilinear tap of the rendered part of the target, clamped so the filter never reaches stale texels
+vec3 SampleScaled(vec2 uv, vec2 texelSize)
 {
-	return log2(pow(aperture, 2) / shutterTime * 100 / ISO);
+	const vec2 maxUV = mvp.renderScale - .5f * texelSize;
+	return textureLod(sampler2D(hdrImage, samp), clamp(uv, .5f * texelSize, maxUV), 0).rgb;
 }
 
-float CalculateEV100FromAverageLuminance(in float averageLuminance)
+vec3 ToneMap(vec3 hdrColor, float exposure)
 {
-	const float K = 12.5f;
-	return log2((averageLuminance * 100.f) / K);
+	return Uncharted2ToneMapping(hdrColor * exposure);
 }
 
-float ConvertEV100ToExposure(in float EV100)
+void main()
 {
-	const float maxLuminance = 1.2f * pow(2.f, EV100);
-	return 1.f / max(maxLuminance, 0.0001f);
-}
+	const float exposure = (EXPOSURE_MODE == EXPOSURE_AUTO) ? exposureData.Exposure : CalculateCameraExposure(EXPOSURE_MODE);
 
-vec3 Uncharted2ToneMappingCurve(in vec3 color)
-{
-	const float a = .15f;
-	const float b = .5f;
-	const float c = .1f;
-	const float d = .2f;
-	const float e = .02f;
-	const float f = .3f;
-	return ((color * (a * color + c * b) + d * e)
-		  / (color * (a * color + b) + d * f)) 
-		  - e / f;
-}
+	if (all(greaterThanEqual(mvp.renderScale, vec2(1.f))))
+	{
+		const vec3 hdrColor = texelFetch(sampler2D(hdrImage, samp), ivec2(fragTexCoord.xy * textureSize(hdrImage, 0)), 0).rgb;
+		outColour = vec4(ToneMap(hdrColor, exposure), 1.f);
+		return;
+	}
 
-vec3 Uncharted2ToneMapping(in vec3 color)
-{
-	const float W = 11.2f;
-	const vec3 curvedColor = Uncharted2ToneMappingCurve(color);
-	const float whiteScale = 1.f / Uncharted2ToneMappingCurve(vec3(W)).r;
-	return clamp(curvedColor * whiteScale, .0f, 1.f);
-}
+	// upscale the rendered region, sharpened after tonemapping so bright hdr texels do not ring
+	const vec2 texelSize = 1.f / vec2(textureSize(hdrImage, 0));
+	const vec2 uv = fragTexCoord * mvp.renderScale;
 
-void main()
-{
-	float currentEV = 1.f;
-#ifdef SUNNY_16
-	const float aperture = 5.f;
-	const float ISO = 100.f;
-	const float shutterSpeed = 1.f / 200.f;
-	currentEV = CalculateEV100FromPhysicalCamera(aperture, shutterSpeed, ISO);
-#else
-#ifdef INDOOR
-	const float aperture = 1.6f;
-	const float ISO = 1600.f;
-	const float shutterSpeed = 1.f / 60.f;
-	currentEV = CalculateEV100FromPhysicalCamera(aperture, shutterSpeed, ISO);
-#endif
-#endif
+	const vec3 center = ToneMap(SampleScaled(uv, texelSize), exposure);
+	const vec3 north = ToneMap(SampleScaled(uv - vec2(.0f, texelSize.y), texelSize), exposure);
+	const vec3 south = ToneMap(SampleScaled(uv + vec2(.0f, texelSize.y), texelSize), exposure);
+	const vec3 west = ToneMap(SampleScaled(uv - vec2(texelSize.x, .0f), texelSize), exposure);
+	const vec3 east = ToneMap(SampleScaled(uv + vec2(texelSize.x, .0f), texelSize), exposure);
 
-	const float exposure = ConvertEV100ToExposure(currentEV);
-	const vec3 hdrColor = texelFetch(sampler2D(hdrImage, samp), ivec2(fragTexCoord.xy * textureSize(hdrImage, 0)), 0).rgb;
+	// amd contrast adaptive sharpening, less sharpening where the neighbourhood is already close to clipping
+	const vec3 minColor = min(center, min(min(north, south), min(west, east)));
+	const vec3 maxColor = max(center, max(max(north, south), max(west, east)));
+	const vec3 amount = sqrt(clamp(min(minColor, 1.f - maxColor) / max(maxColor, vec3(.0001f)), .0f, 1.f));
+	const vec3 weight = amount * mix(-.125f, -.2f, SHARPNESS);
 
-	outColour = vec4(Uncharted2ToneMapping(hdrColor * exposure), 1.f);
-}
\ No newline at end of file
+	const vec3 color = (center + (north + south + west + east) * weight) / (1.f + 4.f * weight);
+	outColour = vec4(clamp(color, .0f, 1.f), 1.f);
+}
@@ -0,0 +1,61 @@
+// visibility tests of bounding boxes given as their 8 corners in clip space
+// requires the depthPyramid texture, nearest depth in r and farthest in g
+
+// corners outside the same clip plane, boxes crossing the near plane are kept whole
+bool IsInFrustum(vec4 corners[8])
+{
+	for (int plane = 0; plane < 5; ++plane)
+	{
+		bool isOutside = true;
+		for (int index = 0; index < 8 && isOutside; ++index)
+		{
+			const vec4 corner = corners[index];
+			const float distance = (plane == 0) ? corner.w + corner.x
+								 : (plane == 1) ? corner.w - corner.x
+								 : (plane == 2) ? corner.w + corner.y
+								 : (plane == 3) ? corner.w - corner.y
+								 : corner.z;
+			isOutside = distance < .0f;
+		}
+		if (isOutside)
+			return false;
+	}
+	return true;
+}
+
+// nearest depth of the box against the farthest depth of the pyramid texels covering its screen rectangle
+bool IsOccluded(vec4 corners[8])
+{
+	vec3 ndcMin = vec3(1.f);
+	vec3 ndcMax = vec3(-1.f);
+	for (int index = 0; index < 8; ++index)
+	{
+		// part of the box is behind the camera, its projection is meaningless
+		if (corners[index].w <= .0f)
+			return false;
+
+		const vec3 ndc = corners[index].xyz / corners[index].w;
+		ndcMin = min(ndcMin, ndc);
+		ndcMax = max(ndcMax, ndc);
+	}
+
+	const vec2 uvMin = clamp(ndcMin.xy * .5f + .5f, .0f, 1.f);
+	const vec2 uvMax = clamp(ndcMax.xy * .5f + .5f, .0f, 1.f);
+
+	// the level where the rectangle spans at most two texels per axis
+	const vec2 size = vec2(textureSize(depthPyramid, 0));
+	const vec2 extent = (uvMax - uvMin) * size;
+	const int levelCount = textureQueryLevels(depthPyramid);
+	const int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.f)))), 0, levelCount - 1);
+
+	const ivec2 levelSize = textureSize(depthPyramid, level);
+	const ivec2 first = clamp(ivec2(uvMin * vec2(levelSize)), ivec2(0), levelSize - 1);
+	const ivec2 last = clamp(ivec2(uvMax * vec2(levelSize)), ivec2(0), levelSize - 1);
+
+	float farthest = .0f;
+	for (int y = first.y; y <= last.y; ++y)
+		for (int x = first.x; x <= last.x; ++x)
+			farthest = max(farthest, texelFetch(depthPyramid, ivec2(x, y), level).g);
+
+	return ndcMin.z > farthest;
+}
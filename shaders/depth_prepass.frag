@@ -1,5 +1,6 @@
 #version 450
 #extension GL_EXT_nonuniform_qualifier : require
+#extension GL_GOOGLE_include_directive : require
 
 layout(location = 1) in	 vec2 fragTexCoord;
 
@@ -7,12 +8,11 @@ layout(constant_id = 0) const uint TEXTURE_ARRAY_SIZE = 1;
 
 layout(push_constant) uniform constants
 {
-	uint textureIndex;
-	uint roughnessIndex;
-	uint metalnessIndex;
-	uint normalIndex;
+	uint materialIndex;
 } pushConstants;
 
+#include "material.glsl"
+
 layout(set = 0, binding = 4) uniform sampler samp;
 
 layout(set = 0, binding = 5) uniform texture2D textures[TEXTURE_ARRAY_SIZE];
@@ -20,6 +20,6 @@ layout(set = 0, binding = 5) uniform texture2D textures[TEXTURE_ARRAY_SIZE];
 void main()
 {
 	const float alphaThreshold = .95f;
-	if (texture(sampler2D(textures[nonuniformEXT(pushConstants.textureIndex)], samp), fragTexCoord).a < alphaThreshold)
+	if (texture(sampler2D(textures[nonuniformEXT(materials.Materials[pushConstants.materialIndex].albedo)], samp), fragTexCoord).a < alphaThreshold)
 		discard;
 }
\ No newline at end of file
@@ -0,0 +1,36 @@
+// helpers shared by the environment bake shaders
+// the including shader includes lighting_common.glsl first
+
+// direction through a face texel, uv in [-1, 1], matches the cube face selection of the vulkan specification
+vec3 FaceDirection(uint face, vec2 uv)
+{
+	switch (face)
+	{
+	case 0: return vec3( 1.f, -uv.y, -uv.x);
+	case 1: return vec3(-1.f, -uv.y,  uv.x);
+	case 2: return vec3( uv.x,  1.f,  uv.y);
+	case 3: return vec3( uv.x, -1.f, -uv.y);
+	case 4: return vec3( uv.x, -uv.y,  1.f);
+	default: return vec3(-uv.x, -uv.y, -1.f);
+	}
+}
+
+// low discrepancy point set, radical inverse of the index paired with its fraction
+vec2 Hammersley(uint index, uint count)
+{
+	return vec2(float(index) / float(count), float(bitfieldReverse(index)) * 2.3283064365386963e-10f);
+}
+
+// half vector around N distributed like DistributionGGX, which does not square roughness either
+vec3 ImportanceSampleGGX(vec2 Xi, vec3 N, float roughness)
+{
+	const float a = roughness;
+	const float phi = 2.f * PI * Xi.x;
+	const float cosTheta = sqrt((1.f - Xi.y) / (1.f + (a * a - 1.f) * Xi.y));
+	const float sinTheta = sqrt(1.f - cosTheta * cosTheta);
+
+	const vec3 up = (abs(N.z) < .999f) ? vec3(.0f, .0f, 1.f) : vec3(1.f, .0f, .0f);
+	const vec3 tangent = normalize(cross(up, N));
+	const vec3 bitangent = cross(N, tangent);
+	return normalize(tangent * cos(phi) * sinTheta + bitangent * sin(phi) * sinTheta + N * cosTheta);
+}
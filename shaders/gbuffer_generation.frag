@@ -1,22 +1,26 @@
 #version 450
 #extension GL_EXT_nonuniform_qualifier : require
+#extension GL_GOOGLE_include_directive : require
 
 layout(location = 0) in	 vec2 fragTexCoord;
 layout(location = 1) in  mat3 TBN;
 
 layout(location = 0) out vec4 albedo;
 layout(location = 1) out vec4 material;
+// only bound when roughness and metalness are split from the normal target
+layout(location = 2) out vec2 roughnessMetalness;
 
 layout(constant_id = 0) const uint TEXTURE_ARRAY_SIZE = 1;
+layout(constant_id = 1) const bool SPLIT_MATERIAL = false;
+layout(constant_id = 2) const bool TEXTURE_FEEDBACK = false;
 
 layout(push_constant) uniform constants
 {
-	uint textureIndex;
-	uint roughnessIndex;
-	uint metalnessIndex;
-	uint normalIndex;
+	uint materialIndex;
 } pushConstants;
 
+#include "material.glsl"
+
 // https://knarkowicz.wordpress.com/2014/04/16/octahedron-normal-vector-encoding/
 vec2 OctWrap(vec2 v)
 {
@@ -36,16 +40,61 @@ layout(set = 0, binding = 4) uniform sampler samp;
 
 layout(set = 0, binding = 5) uniform texture2D textures[TEXTURE_ARRAY_SIZE];
 
+// finest level sampled of every texture since the cpu last read it, sizes are of level 0 whatever is resident
+struct TextureFeedback
+{
+	uint width;
+	uint height;
+	uint level;
+	uint padding;
+};
+
+layout(std430, set = 0, binding = 12) buffer TextureFeedbackSSBO
+{
+	TextureFeedback Textures[];
+} feedback;
+
+// one pixel of every 4x4 block reports, the levels of neighbours hardly differ
+const uint FEEDBACK_STRIDE = 4;
+
+// level whose texels match the footprint of the pixel, the same the sampler would pick from a full chain
+void WriteFeedback(uint texture, vec2 uvDx, vec2 uvDy)
+{
+	const vec2 size = vec2(feedback.Textures[texture].width, feedback.Textures[texture].height);
+	const vec2 dx = uvDx * size;
+	const vec2 dy = uvDy * size;
+	const float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8));
+	atomicMin(feedback.Textures[texture].level, uint(max(floor(lod), 0.0)));
+}
+
 layout(early_fragment_tests) in;
 
 void main()
 {
-	albedo = texture(sampler2D(textures[nonuniformEXT(pushConstants.textureIndex)], samp), fragTexCoord);
+	const Material mat = materials.Materials[pushConstants.materialIndex];
 
-	vec3 normal = texture(sampler2D(textures[nonuniformEXT(pushConstants.normalIndex)], samp), fragTexCoord).rgb;
+	// derivatives need the whole quad, they are taken before the branch
+	const vec2 uvDx = dFdx(fragTexCoord);
+	const vec2 uvDy = dFdy(fragTexCoord);
+	if (TEXTURE_FEEDBACK && all(equal(uvec2(gl_FragCoord.xy) % FEEDBACK_STRIDE, uvec2(0))))
+	{
+		WriteFeedback(mat.albedo, uvDx, uvDy);
+		WriteFeedback(mat.normal, uvDx, uvDy);
+		WriteFeedback(mat.roughness, uvDx, uvDy);
+		WriteFeedback(mat.metalness, uvDx, uvDy);
+	}
+
+	albedo = texture(sampler2D(textures[nonuniformEXT(mat.albedo)], samp), fragTexCoord);
+
+	vec3 normal = texture(sampler2D(textures[nonuniformEXT(mat.normal)], samp), fragTexCoord).rgb;
 	normal = normal * 2.0 - vec3(1.0, 1.0, 1.0);
 	normal = normalize(TBN * normal);
 	material.rg = Encode(normal);
-	material.b = texture(sampler2D(textures[nonuniformEXT(pushConstants.roughnessIndex)], samp), fragTexCoord).g;
-	material.a = texture(sampler2D(textures[nonuniformEXT(pushConstants.metalnessIndex)], samp), fragTexCoord).b;
+
+	const float roughness = texture(sampler2D(textures[nonuniformEXT(mat.roughness)], samp), fragTexCoord).g;
+	const float metalness = texture(sampler2D(textures[nonuniformEXT(mat.metalness)], samp), fragTexCoord).b;
+	if (SPLIT_MATERIAL)
+		roughnessMetalness = vec2(roughness, metalness);
+	else
+		material.ba = vec2(roughness, metalness);
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
 
 layout(set = 1, binding = 0) uniform ModelViewProjection
 {
@@ -7,6 +8,8 @@ layout(set = 1, binding = 0) uniform ModelViewProjection
 	mat4 projection;
 } mvp;
 
+#include "instancing.glsl"
+
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColour;
 layout(location = 2) in vec2 inTexCoord;
@@ -19,11 +22,12 @@ layout(location = 0) out vec2 fragTexCoord;
 
 void main()
 {
-	const vec3 T = normalize(vec3(mvp.model * vec4(tangent,   0.0)));
-	const vec3 B = normalize(vec3(mvp.model * vec4(bitangent, 0.0)));
-	const vec3 N = normalize(vec3(mvp.model * vec4(normal,    0.0)));
+	const mat4 model = instances.Transforms[gl_InstanceIndex];
+	const vec3 T = normalize(vec3(model * vec4(tangent,   0.0)));
+	const vec3 B = normalize(vec3(model * vec4(bitangent, 0.0)));
+	const vec3 N = normalize(vec3(model * vec4(normal,    0.0)));
 	TBN = mat3(T, B, N);
 
-	gl_Position = mvp.projection * mvp.view * mvp.model * vec4(inPosition, 1.);
+	gl_Position = mvp.projection * mvp.view * model * vec4(inPosition, 1.);
 	fragTexCoord = inTexCoord;
 }
@@ -0,0 +1,7 @@
+// transforms of every instance of every mesh, indexed by the instance index of the draw
+// world matrices from the scene graph, the model matrix is its root
+
+layout(std430, set = 0, binding = 11) readonly buffer InstanceSSBO
+{
+	mat4 Transforms[];
+} instances;
@@ -0,0 +1,77 @@
+// temporal cache of the lighting result, last frame's output is reprojected with depth and camera matrices
+// requires the mvp uniform with the previous frame members and the CACHE_REFRESH_RATIO specialization constant
+
+layout(set = 2, binding = 6) uniform texture2D lightingHistory;
+layout(set = 2, binding = 7) uniform texture2D depthHistory;
+
+// only written while validating, cleared every frame and read back for statistics
+layout(std430, set = 2, binding = 8) buffer LightingCacheStatisticsSSBO
+{
+	uint EvaluatedCount;
+	uint CachedCount;
+	uint ErrorSum;
+	uint MaxError;
+} cacheStatistics;
+
+// relative error of a cached pixel is clamped to 1 and accumulated in these units
+const float CACHE_ERROR_SCALE = 1024.f;
+// difference of linear depth relative to the depth itself that still counts as the same surface
+const float CACHE_DEPTH_TOLERANCE = .02f;
+
+// every frame refreshes one band of consecutive bayer ranks, each band is spread evenly over the 4x4 block
+// taking ranks by modulo instead would pick clumped pixels, like 2x2 blocks for a ratio of 4
+bool IsRefreshedThisFrame(ivec2 pixel)
+{
+	const uint bayer[16] = uint[](0, 8, 2, 10, 12, 4, 14, 6, 3, 11, 1, 9, 15, 7, 13, 5);
+	const uint rank = bayer[(pixel.y & 3) * 4 + (pixel.x & 3)];
+	return rank / (16u / CACHE_REFRESH_RATIO) == mvp.frameIndex % CACHE_REFRESH_RATIO;
+}
+
+// distance along the view axis, the projection does not change between frames
+float LinearDepth(float depth)
+{
+	return mvp.projection[3][2] / (depth + mvp.projection[2][2]);
+}
+
+// false when there is no history or the surface was outside the previous view or hidden behind other geometry
+bool ReprojectLighting(vec3 worldPos, out vec3 color)
+{
+	color = vec3(.0f);
+	if (mvp.previousRenderScale.x <= .0f)
+		return false;
+
+	const vec4 previousClip = mvp.previousViewProjection * vec4(worldPos, 1.f);
+	if (previousClip.w <= .0f)
+		return false;
+
+	const vec3 previousNDC = previousClip.xyz / previousClip.w;
+	const vec2 previousUV = previousNDC.xy * .5f + .5f;
+	if (any(lessThan(previousUV, vec2(.0f))) || any(greaterThanEqual(previousUV, vec2(1.f))))
+		return false;
+
+	// dynamic resolution may have rendered a different part of the history
+	const ivec2 previousPixel = ivec2(previousUV * vec2(textureSize(lightingHistory, 0)) * mvp.previousRenderScale);
+	const float expectedDepth = LinearDepth(previousNDC.z);
+	const float previousDepth = LinearDepth(texelFetch(depthHistory, previousPixel, 0).r);
+	if (abs(previousDepth - expectedDepth) > CACHE_DEPTH_TOLERANCE * expectedDepth)
+		return false;
+
+	color = texelFetch(lightingHistory, previousPixel, 0).rgb;
+	return true;
+}
+
+// compares a cached pixel against the full evaluation it replaced
+void RecordCacheSample(bool isCached, vec3 cached, vec3 evaluated)
+{
+	if (!isCached)
+	{
+		atomicAdd(cacheStatistics.EvaluatedCount, 1);
+		return;
+	}
+
+	const float error = min(length(cached - evaluated) / max(length(evaluated), .001f), 1.f);
+	const uint quantized = uint(error * CACHE_ERROR_SCALE);
+	atomicAdd(cacheStatistics.CachedCount, 1);
+	atomicAdd(cacheStatistics.ErrorSum, quantized);
+	atomicMax(cacheStatistics.MaxError, quantized);
+}
@@ -0,0 +1,181 @@
+// shared between fragment and compute lighting
+// requires GL_GOOGLE_include_directive in the including shader
+
+const float PI = 3.14159265358979323846;
+
+struct PointLight
+{
+	vec3 Position;
+	vec3 Color;
+	float Lumen;
+};
+
+struct DirectionalLight
+{
+	vec3 Direction;
+	vec3 Color;
+	float Lux;
+};
+
+// https://stackoverflow.com/questions/32227283/getting-world-position-from-depth-buffer-value
+// inverse matrices are calculated once per frame on cpu
+vec3 WorldPosFromDepth(float depth, vec2 texCoord, mat4 inverseProjection, mat4 inverseView)
+{
+    vec4 clipSpacePosition = vec4(texCoord * 2.0 - vec2(1.0, 1.0), depth, 1.0);
+    vec4 viewSpacePosition = inverseProjection * clipSpacePosition;
+
+    // Perspective division
+    viewSpacePosition /= viewSpacePosition.w;
+
+    vec4 worldSpacePosition = inverseView * viewSpacePosition;
+
+    return worldSpacePosition.xyz;
+}
+
+// https://knarkowicz.wordpress.com/2014/04/16/octahedron-normal-vector-encoding/
+vec3 Decode(vec2 f)
+{
+    f = f * 2.0 - vec2(1.0, 1.0);
+
+    // https://twitter.com/Stubbesaurus/status/937994790553227264
+    vec3 n = vec3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.xy += vec2((n.x >= 0.0) ? -t : t,
+				 (n.y >= 0.0) ? -t : t);
+    return normalize(n);
+}
+
+vec3 FresnelSchlick(float cosTheta, vec3 F0)
+{
+	return F0 + (1. - F0) * pow(clamp(1. - cosTheta, .0, 1.), 5.);
+}
+
+vec3 FresnelSchlickRoughness(float cosTheta, vec3 F0, float roughness)
+{
+    return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
+}
+
+float DistributionGGX(vec3 N, vec3 H, float roughness)
+{
+    float a      = roughness;
+	const bool squareRoughness = false;
+	if (squareRoughness)
+		a = roughness * roughness;
+    const float a2     = a*a;
+    const float NdotH  = max(dot(N, H), 0.0);
+    const float NdotH2 = NdotH*NdotH;
+
+    const float num   = a2;
+    float denom = (NdotH2 * (a2 - 1.0) + 1.0);
+    denom = PI * denom * denom;
+
+    return num / denom;
+}
+
+float GeometrySchlickGGX_Direct(float NdotV, float roughness)
+{
+    const float r = (roughness + 1.0);
+    const float k = (r*r) / 8.0;
+
+    const float num   = NdotV;
+    const float denom = NdotV * (1.0 - k) + k;
+
+    return num / denom;
+}
+
+float GeometrySchlickGGX_Indirect(float NdotV, float roughness)
+{
+    const float a = (roughness);
+    const float k = (a*a) / 2.0;
+
+    const float num   = NdotV;
+    const float denom = NdotV * (1.0 - k) + k;
+
+    return num / denom;
+}
+
+float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness, bool directLighting)
+{
+    const float NdotV = max(dot(N, V), 0.0);
+    const float NdotL = max(dot(N, L), 0.0);
+    float ggx2  = 0;
+    float ggx1  = 0;
+	if (directLighting)
+	{
+		ggx2 = GeometrySchlickGGX_Direct(NdotV, roughness);
+		ggx1 = GeometrySchlickGGX_Direct(NdotL, roughness);
+	}
+	else
+	{
+		ggx2 = GeometrySchlickGGX_Indirect(NdotV, roughness);
+		ggx1 = GeometrySchlickGGX_Indirect(NdotL, roughness);
+	}
+
+    return ggx1 * ggx2;
+}
+
+struct Surface
+{
+	vec3 worldPos;
+	vec3 normal;
+	vec3 albedo;
+	float roughness;
+	float metalness;
+	vec3 viewDirection;
+	vec3 F0;
+};
+
+// cook-torrance response to a single light of given irradiance
+vec3 DirectLighting(Surface surface, vec3 L, vec3 irradiance)
+{
+	const vec3 H = normalize(surface.viewDirection + L);
+
+	const float NDF = DistributionGGX(surface.normal, H, surface.roughness);
+	const float G = GeometrySmith(surface.normal, surface.viewDirection, L, surface.roughness, true);
+	const vec3 F = FresnelSchlick(max(dot(H, surface.viewDirection), .0), surface.F0);
+
+	const vec3 num = NDF * G * F;
+	const float denom = 4. * max(dot(surface.normal, surface.viewDirection), .0) * max(dot(surface.normal, surface.viewDirection), .0) + .00001f;
+	const vec3 specular = num / denom;
+
+	const vec3 kS = F;
+	const vec3 kD = (vec3(1.) - kS) * (1. - surface.metalness);
+	const float NdotL = max(dot(surface.normal, L), .0);
+	return (kD * surface.albedo / PI + specular) * irradiance * NdotL;
+}
+
+vec3 PointLightIrradiance(PointLight light, vec3 worldPos, out vec3 L)
+{
+	L = normalize(light.Position - worldPos);
+
+	const float luminousIntensity = light.Lumen / (4. * PI);
+
+	const float distance = length(light.Position - worldPos);
+	const float attenuation = 1. / max((distance * distance), 0.0001f);
+	const float illuminance = luminousIntensity * attenuation;
+	return light.Color * illuminance;
+}
+
+vec3 ShadowMapUV(mat4 viewProjection, vec3 worldPos)
+{
+	vec4 lightSpacePosition = viewProjection * vec4(worldPos, 1.f);
+	lightSpacePosition /= lightSpacePosition.w;
+	return vec3(lightSpacePosition.xy * .5f + .5f, lightSpacePosition.z);
+}
+
+// specular is the split sum result of SpecularIBL
+vec3 AmbientLighting(Surface surface, vec3 irradiance, vec3 specular)
+{
+	const float exposureCompensation = 2.f;
+	const vec3 kS = FresnelSchlickRoughness(max(dot(surface.normal, surface.viewDirection), 0.0), surface.F0, surface.roughness);
+	const vec3 kD = (1.0 - kS) * (1.f - surface.metalness);
+	const vec3 diffuse    = irradiance * surface.albedo;
+	return (kD * diffuse + specular) * exposureCompensation;
+}
+
+// tile classes of the compute lighting path, order matches DynamicRenderingApp::TileClass
+const uint TILE_CLASS_SKY		= 0; // only environment
+const uint TILE_CLASS_UNLIT		= 1; // geometry facing away from every light, ambient only
+const uint TILE_CLASS_SHADOWED	= 2; // every directional light is occluded, point lights and ambient
+const uint TILE_CLASS_FULL		= 3; // full brdf with shadow lookups
+const uint TILE_CLASS_COUNT		= 4;
@@ -0,0 +1,68 @@
+// counts hdr pixels per log2 luminance bin, one invocation per bin flushes the group histogram
+// bin 0 holds pixels too dark to matter, the others span the log luminance range evenly
+// included by luminance_histogram.comp and, with USE_SUBGROUPS defined, by luminance_histogram_subgroup.comp
+const uint BIN_COUNT = 256;
+
+layout(local_size_x = 16, local_size_y = 16) in;
+
+layout(set = 0, binding = 0) uniform texture2D hdrImage;
+
+layout(std430, set = 0, binding = 1) buffer HistogramSSBO
+{
+	uint Bins[BIN_COUNT];
+} histogram;
+
+layout(push_constant) uniform constants
+{
+	float minLogLuminance;
+	float logLuminanceRange;
+	float adaptation;
+	uint pixelCount;
+	uvec2 extent;
+} pc;
+
+shared uint groupBins[BIN_COUNT];
+
+uint LuminanceBin(vec3 color)
+{
+	const float luminance = dot(color, vec3(.2126f, .7152f, .0722f));
+	if (luminance < .0001f)
+		return 0;
+
+	const float logLuminance = clamp((log2(luminance) - pc.minLogLuminance) / pc.logLuminanceRange, .0f, 1.f);
+	return uint(logLuminance * float(BIN_COUNT - 2) + 1.f);
+}
+
+void main()
+{
+	groupBins[gl_LocalInvocationIndex] = 0;
+	barrier();
+
+	const ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+	// only the rendered part of the target, dynamic resolution leaves the rest stale
+	bool isPending = all(lessThan(uvec2(pixel), pc.extent));
+	const uint bin = isPending ? LuminanceBin(texelFetch(hdrImage, pixel, 0).rgb) : 0;
+
+#ifdef USE_SUBGROUPS
+	// neighbouring pixels mostly share a bin, so this takes one atomic per distinct bin in the subgroup
+	while (isPending)
+	{
+		const uint leaderBin = subgroupBroadcastFirst(bin);
+		if (bin == leaderBin)
+		{
+			const uint count = subgroupBallotBitCount(subgroupBallot(true));
+			if (subgroupElect())
+				atomicAdd(groupBins[bin], count);
+			isPending = false;
+		}
+	}
+#else
+	if (isPending)
+		atomicAdd(groupBins[bin], 1);
+#endif
+	barrier();
+
+	const uint count = groupBins[gl_LocalInvocationIndex];
+	if (count > 0)
+		atomicAdd(histogram.Bins[gl_LocalInvocationIndex], count);
+}
@@ -0,0 +1,14 @@
+// material table of the scene, draws push only their index into it
+
+struct Material
+{
+	uint albedo;
+	uint roughness;
+	uint metalness;
+	uint normal;
+};
+
+layout(std430, set = 0, binding = 10) readonly buffer MaterialSSBO
+{
+	Material Materials[];
+} materials;
@@ -1,13 +1,14 @@
 #version 450
+#extension GL_ARB_shader_viewport_layer_array : require
+#extension GL_GOOGLE_include_directive : require
 
+// every instance renders one instance of the mesh to one layer of the shadow map array
+// the draw starts at the first mesh instance times the layer count, so the instance index splits into both
 layout(push_constant) uniform constants
 {
-	mat4 model;
-	uint lightIndex;
+	uint layerMask; // layers the mesh is visible in, instance count is the amount of set bits
 } pushConstants;
 
-layout(constant_id = 1) const uint DIRECTIONAL_LIGHT_COUNT = 1;
-
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColour;
 layout(location = 2) in vec2 inTexCoord;
@@ -17,23 +18,32 @@ layout(location = 5) in vec3 bitangent;
 
 layout(location = 1) out vec2 fragTexCoord;
 layout(location = 2) out vec3 fragColour;
-struct DirectionalLight
+struct ShadowCascade
 {
-	vec3 Direction;
-	vec3 Color;
-	float Lux;
-	mat4 View;
-	mat4 Projection;
+	mat4 ViewProjection;
+	float SplitDepth;
 };
 
-layout(std430, binding = 1) readonly buffer DirectionalLightDataSSBO
+layout(std430, binding = 6) readonly buffer ShadowCascadeSSBO
 {
-	DirectionalLight	Lights[DIRECTIONAL_LIGHT_COUNT];
-} dirLightData;
+	ShadowCascade Cascades[];
+} cascadeData;
+
+#include "instancing.glsl"
 
 void main()
 {
-	gl_Position = dirLightData.Lights[pushConstants.lightIndex].Projection * dirLightData.Lights[pushConstants.lightIndex].View * pushConstants.model * vec4(inPosition, 1.);
+	const int layerCount = bitCount(pushConstants.layerMask);
+	const int meshInstance = gl_InstanceIndex / layerCount;
+
+	// drop the lowest set bits until the one of this instance is the lowest
+	uint mask = pushConstants.layerMask;
+	for (int index = 0; index < gl_InstanceIndex % layerCount; ++index)
+		mask &= mask - 1;
+	const int layer = findLSB(mask);
+
+	gl_Position = cascadeData.Cascades[layer].ViewProjection * instances.Transforms[meshInstance] * vec4(inPosition, 1.);
+	gl_Layer = layer;
 	fragColour = inColour;
 	fragTexCoord = inTexCoord;
-}
\ No newline at end of file
+}
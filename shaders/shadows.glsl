@@ -0,0 +1,35 @@
+// cascaded shadow lookups shared between fragment and compute lighting
+// the including shader declares CASCADE_COUNT and includes lighting_common.glsl first
+
+struct ShadowCascade
+{
+	mat4 ViewProjection;
+	float SplitDepth; // view space distance where the cascade ends
+};
+
+layout(set = 1, binding = 0) uniform sampler shadowSampler;
+// light major layers, cascade c of light l is at l * CASCADE_COUNT + c
+layout(set = 1, binding = 1) uniform texture2DArray shadowMaps;
+
+layout(std430, set = 0, binding = 6) readonly buffer ShadowCascadeSSBO
+{
+	ShadowCascade Cascades[];
+} cascadeData;
+
+// split depths are the same for every light
+uint SelectCascade(float viewDepth)
+{
+	uint cascade = 0;
+	for (uint index = 0; index < CASCADE_COUNT - 1; ++index)
+		if (viewDepth > cascadeData.Cascades[index].SplitDepth)
+			cascade = index + 1;
+	return cascade;
+}
+
+float SampleShadow(uint lightIndex, vec3 worldPos, float viewDepth)
+{
+	const uint slot = lightIndex * CASCADE_COUNT + SelectCascade(viewDepth);
+	const vec3 shadowMapUV = ShadowMapUV(cascadeData.Cascades[slot].ViewProjection, worldPos);
+	// textureLod has no array shadow overload, zero gradients select the base level in every stage
+	return textureGrad(sampler2DArrayShadow(shadowMaps, shadowSampler), vec4(shadowMapUV.xy, slot, shadowMapUV.z), vec2(.0f), vec2(.0f));
+}
@@ -0,0 +1,23 @@
+// split sum specular image based lighting shared between fragment and compute lighting
+// the including shader declares samp and includes lighting_common.glsl first
+
+// ggx prefiltered environment, roughness grows linearly with the level
+layout(set = 0, binding = 7) uniform textureCube prefilteredMap;
+// scale and bias applied to F0, indexed by NdotV and roughness
+layout(set = 0, binding = 8) uniform texture2D brdfLUT;
+
+vec3 SpecularIBL(Surface surface)
+{
+	const float NdotV = max(dot(surface.normal, surface.viewDirection), .0f);
+	const vec3 R = reflect(-surface.viewDirection, surface.normal);
+
+	const float maxLevel = float(textureQueryLevels(samplerCube(prefilteredMap, samp)) - 1);
+	const vec3 prefiltered = textureLod(samplerCube(prefilteredMap, samp), R, surface.roughness * maxLevel).rgb;
+
+	// kept half a texel inside the lut, the shared sampler repeats
+	const vec2 halfTexel = .5f / vec2(textureSize(sampler2D(brdfLUT, samp), 0));
+	const vec2 brdf = textureLod(sampler2D(brdfLUT, samp), clamp(vec2(NdotV, surface.roughness), halfTexel, 1.f - halfTexel), .0f).rg;
+
+	const vec3 F = FresnelSchlickRoughness(NdotV, surface.F0, surface.roughness);
+	return prefiltered * (F * brdf.x + brdf.y);
+}
@@ -0,0 +1,40 @@
+// real l2 spherical harmonics, shared by the environment projection and lighting
+// requires GL_GOOGLE_include_directive in the including shader
+
+const uint SH_COEFFICIENT_COUNT = 9;
+
+void SHBasis(vec3 n, out float basis[SH_COEFFICIENT_COUNT])
+{
+	basis[0] = .282095f;
+	basis[1] = .488603f * n.y;
+	basis[2] = .488603f * n.z;
+	basis[3] = .488603f * n.x;
+	basis[4] = 1.092548f * n.x * n.y;
+	basis[5] = 1.092548f * n.y * n.z;
+	basis[6] = .315392f * (3.f * n.z * n.z - 1.f);
+	basis[7] = 1.092548f * n.x * n.z;
+	basis[8] = .546274f * (n.x * n.x - n.y * n.y);
+}
+
+// clamped cosine lobe per band divided by pi, so the evaluated result matches the former irradiance cube
+float SHBandFactor(uint coefficient)
+{
+	if (coefficient == 0)
+		return 1.f;
+	if (coefficient < 4)
+		return 2.f / 3.f;
+	return .25f;
+}
+
+// coefficients are tightly packed rgb triplets and already convolved by SHBandFactor
+vec3 EvaluateIrradianceSH(float coefficients[SH_COEFFICIENT_COUNT * 3], vec3 normal)
+{
+	float basis[SH_COEFFICIENT_COUNT];
+	SHBasis(normal, basis);
+
+	vec3 irradiance = vec3(.0);
+	for (uint index = 0; index < SH_COEFFICIENT_COUNT; ++index)
+		irradiance += vec3(coefficients[index * 3], coefficients[index * 3 + 1], coefficients[index * 3 + 2]) * basis[index];
+
+	return clamp(irradiance, .0, 1.);
+}
@@ -0,0 +1,66 @@
+// shared between blit, fused lighting and the auto exposure reduction
+
+float CalculateEV100FromPhysicalCamera(in float aperture, in float shutterTime, in float ISO)
+{
+	return log2(pow(aperture, 2) / shutterTime * 100 / ISO);
+}
+
+float CalculateEV100FromAverageLuminance(in float averageLuminance)
+{
+	const float K = 12.5f;
+	return log2((averageLuminance * 100.f) / K);
+}
+
+float ConvertEV100ToExposure(in float EV100)
+{
+	const float maxLuminance = 1.2f * pow(2.f, EV100);
+	return 1.f / max(maxLuminance, 0.0001f);
+}
+
+vec3 Uncharted2ToneMappingCurve(in vec3 color)
+{
+	const float a = .15f;
+	const float b = .5f;
+	const float c = .1f;
+	const float d = .2f;
+	const float e = .02f;
+	const float f = .3f;
+	return ((color * (a * color + c * b) + d * e)
+		  / (color * (a * color + b) + d * f)) 
+		  - e / f;
+}
+
+vec3 Uncharted2ToneMapping(in vec3 color)
+{
+	const float W = 11.2f;
+	const vec3 curvedColor = Uncharted2ToneMappingCurve(color);
+	const float whiteScale = 1.f / Uncharted2ToneMappingCurve(vec3(W)).r;
+	return clamp(curvedColor * whiteScale, .0f, 1.f);
+}
+
+// exposure modes, order matches ExposureMode in Settings.h
+const uint EXPOSURE_AUTO		= 0; // read from the buffer written by luminance_average.comp
+const uint EXPOSURE_INDOOR		= 1;
+const uint EXPOSURE_SUNNY_16	= 2;
+
+// exposure of the fixed physical camera presets
+float CalculateCameraExposure(uint mode)
+{
+	float currentEV = 1.f;
+	if (mode == EXPOSURE_SUNNY_16)
+	{
+		const float aperture = 5.f;
+		const float ISO = 100.f;
+		const float shutterSpeed = 1.f / 200.f;
+		currentEV = CalculateEV100FromPhysicalCamera(aperture, shutterSpeed, ISO);
+	}
+	else if (mode == EXPOSURE_INDOOR)
+	{
+		const float aperture = 1.6f;
+		const float ISO = 1600.f;
+		const float shutterSpeed = 1.f / 60.f;
+		currentEV = CalculateEV100FromPhysicalCamera(aperture, shutterSpeed, ISO);
+	}
+
+	return ConvertEV100ToExposure(currentEV);
+}
@@ -0,0 +1,159 @@
+#include "Benchmark.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+namespace
+{
+	double Percentile(const std::vector<double>& sorted, double fraction)
+	{
+		const size_t rank{ static_cast<size_t>(std::ceil(fraction * sorted.size())) };
+		return sorted[std::clamp(rank, size_t{ 1 }, sorted.size()) - 1];
+	}
+
+	// the path is a file name, only quotes and backslashes need escaping
+	std::string EscapeJson(const std::string& text)
+	{
+		std::string escaped{};
+		for (char character : text)
+		{
+			if (character == '"' || character == '\\')
+				escaped += '\\';
+			escaped += character;
+		}
+		return escaped;
+	}
+
+	void WriteJsonSummary(std::ostream& stream, const Benchmark::Summary& summary)
+	{
+		stream << "{ \"mean\": " << summary.mean << ", \"variance\": " << summary.variance << ", \"min\": " << summary.min
+			   << ", \"p50\": " << summary.p50 << ", \"p95\": " << summary.p95 << ", \"p99\": " << summary.p99 << ", \"max\": " << summary.max << " }";
+	}
+
+	// json has no nan, frames without a time are null
+	void WriteJsonArray(std::ostream& stream, const std::vector<double>& values)
+	{
+		stream << '[';
+		for (size_t index{}; index < values.size(); ++index)
+		{
+			stream << ((index == 0) ? "" : ", ");
+			if (std::isnan(values[index]))
+				stream << "null";
+			else
+				stream << values[index];
+		}
+		stream << ']';
+	}
+}
+
+Benchmark::Benchmark(uint32_t frameCount, float stepMs, const std::string& path)
+	: m_StepMs{ stepMs }
+	, m_Path{ path }
+{
+	m_Frames.reserve(frameCount);
+}
+
+Benchmark::Summary Benchmark::Summarize(std::vector<double> values)
+{
+	values.erase(std::remove_if(values.begin(), values.end(), [](double value) { return std::isnan(value); }), values.end());
+	if (values.empty())
+		return Summary{};
+
+	std::sort(values.begin(), values.end());
+	double sum{};
+	for (double value : values)
+		sum += value;
+	const double mean{ sum / values.size() };
+
+	double squares{};
+	for (double value : values)
+		squares += (value - mean) * (value - mean);
+	const double variance{ (values.size() > 1) ? squares / (values.size() - 1) : .0 };
+
+	return Summary{ mean, variance, values.front(), Percentile(values, .5), Percentile(values, .95), Percentile(values, .99), values.back() };
+}
+
+void Benchmark::PrintSummary(std::ostream& stream) const
+{
+	const std::ios::fmtflags flags{ stream.flags() };
+	const std::streamsize precision{ stream.precision() };
+	stream << std::fixed << std::setprecision(3) << "benchmark: " << m_Frames.size() << " frames of " << m_StepMs << " ms along "
+		   << (m_Path.empty() ? "the default path" : m_Path) << '\n';
+
+	const auto print{ [&stream](const char* name, const Summary& summary)
+		{
+			stream << "  " << name << " ms: mean " << summary.mean << ", stddev " << std::sqrt(summary.variance) << ", p50 " << summary.p50
+				   << ", p95 " << summary.p95 << ", p99 " << summary.p99 << ", max " << summary.max << '\n';
+		} };
+	print("frame", Summarize(GetFrameMs()));
+	print("gpu", Summarize(GetGpuMs()));
+	stream.flags(flags);
+	stream.precision(precision);
+}
+
+void Benchmark::Write(const std::string& fileName) const
+{
+	std::ofstream file(fileName, std::ios::trunc);
+	if (!file.is_open())
+		throw std::runtime_error("failed to write benchmark results to " + fileName);
+
+	file << std::setprecision(6);
+	const std::string extension{ ".json" };
+	if (fileName.size() >= extension.size() && fileName.compare(fileName.size() - extension.size(), extension.size(), extension) == 0)
+		WriteJson(file);
+	else
+		WriteCsv(file);
+}
+
+std::vector<double> Benchmark::GetFrameMs() const
+{
+	std::vector<double> values(m_Frames.size());
+	std::transform(m_Frames.begin(), m_Frames.end(), values.begin(), [](const Frame& frame) { return frame.frameMs; });
+	return values;
+}
+
+std::vector<double> Benchmark::GetGpuMs() const
+{
+	std::vector<double> values(m_Frames.size());
+	std::transform(m_Frames.begin(), m_Frames.end(), values.begin(), [](const Frame& frame) { return frame.gpuMs; });
+	return values;
+}
+
+void Benchmark::WriteCsv(std::ostream& stream) const
+{
+	stream << "frame,frame_ms,gpu_ms\n";
+	for (size_t index{}; index < m_Frames.size(); ++index)
+		stream << index << ',' << m_Frames[index].frameMs << ',' << m_Frames[index].gpuMs << '\n';
+
+	const Summary frame{ Summarize(GetFrameMs()) };
+	const Summary gpu{ Summarize(GetGpuMs()) };
+	stream << "mean," << frame.mean << ',' << gpu.mean << '\n'
+		   << "variance," << frame.variance << ',' << gpu.variance << '\n'
+		   << "min," << frame.min << ',' << gpu.min << '\n'
+		   << "p50," << frame.p50 << ',' << gpu.p50 << '\n'
+		   << "p95," << frame.p95 << ',' << gpu.p95 << '\n'
+		   << "p99," << frame.p99 << ',' << gpu.p99 << '\n'
+		   << "max," << frame.max << ',' << gpu.max << '\n';
+}
+
+void Benchmark::WriteJson(std::ostream& stream) const
+{
+	const std::vector<double> frameMs{ GetFrameMs() };
+	const std::vector<double> gpuMs{ GetGpuMs() };
+
+	stream << "{\n"
+		   << "  \"frames\": " << m_Frames.size() << ",\n"
+		   << "  \"step_ms\": " << m_StepMs << ",\n"
+		   << "  \"path\": \"" << EscapeJson(m_Path) << "\",\n"
+		   << "  \"frame_ms\": ";
+	WriteJsonSummary(stream, Summarize(frameMs));
+	stream << ",\n  \"gpu_ms\": ";
+	WriteJsonSummary(stream, Summarize(gpuMs));
+	stream << ",\n  \"per_frame_ms\": ";
+	WriteJsonArray(stream, frameMs);
+	stream << ",\n  \"per_frame_gpu_ms\": ";
+	WriteJsonArray(stream, gpuMs);
+	stream << "\n}\n";
+}
@@ -4,8 +4,11 @@
 #include <cassert>
 #include "CommandPool.h"
 #include "../inc/Image.h"
+#include "Helper.h"
+#include <algorithm>
+#include <utility>
 
-void Buffer::UpdateMappedData(void* newData, size_t size, size_t offset)
+void Buffer::UpdateMappedData(const void* newData, size_t size, size_t offset)
 {
 	memcpy(static_cast<char*>(m_Data) + offset, newData, size);
 }
@@ -23,22 +26,65 @@ void Buffer::CopyTo(Buffer* buffer, CommandBuffer* command, Device* device, Comm
 
 void Buffer::CopyTo(Image* image, CommandBuffer* command, Device* device, CommandPool* commandPool)
 {
-	VkBufferImageCopy region{};
-	region.bufferOffset = 0;
-	region.bufferRowLength = 0;
-	region.bufferImageHeight = 0;
-
-	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	region.imageSubresource.layerCount = 1;
-	VkExtent2D extent = image->GetExtent();
-	region.imageOffset = { 0, 0, 0 };
-	region.imageExtent = { extent.width, extent.height, 1 };
-
-	vkCmdCopyBufferToImage(*command->GetBufferPtr(), m_Buffer, image->m_Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+	const std::vector<VkBufferImageCopy> regions{ GetImageCopyRegions(image) };
+	vkCmdCopyBufferToImage(*command->GetBufferPtr(), m_Buffer, image->m_Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+}
+
+void Buffer::CopyFrom(Image* image, CommandBuffer* command)
+{
+	const std::vector<VkBufferImageCopy> regions{ GetImageCopyRegions(image) };
+	vkCmdCopyImageToBuffer(*command->GetBufferPtr(), image->m_Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_Buffer, static_cast<uint32_t>(regions.size()), regions.data());
+}
+
+std::vector<VkBufferImageCopy> Buffer::GetImageCopyRegions(Image* image)
+{
+	// one region per level, layers are tightly packed one after another
+	std::vector<VkBufferImageCopy> regions(image->GetMipLevels());
+	const VkExtent2D extent{ image->GetExtent() };
+	VkDeviceSize offset{};
+	for (uint32_t level{}; level < image->GetMipLevels(); ++level)
+	{
+		VkBufferImageCopy& region{ regions[level] };
+		region.bufferOffset = offset;
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = level;
+		region.imageSubresource.layerCount = image->GetLayers();
+		region.imageOffset = { 0, 0, 0 };
+		region.imageExtent = { std::max(extent.width >> level, 1u), std::max(extent.height >> level, 1u), 1 };
+
+		offset += HELP::GetImageSize(image->GetFormat(), region.imageExtent.width, region.imageExtent.height, image->GetLayers(), 1);
+	}
+	return regions;
+}
+
+void Buffer::MakeBarrier(CommandBuffer* command, const Barrier& barrier)
+{
+	VkBufferMemoryBarrier bufferBarrier{};
+	bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	bufferBarrier.srcAccessMask = barrier.srcAccess;
+	bufferBarrier.dstAccessMask = barrier.dstAccess;
+	bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.buffer = m_Buffer;
+	bufferBarrier.offset = 0;
+	bufferBarrier.size = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(
+		*command->GetBufferPtr(),
+		barrier.srcStage, barrier.dstStage,
+		0,
+		0, nullptr,
+		1, &bufferBarrier,
+		0, nullptr
+	);
 }
 
 void Buffer::Destroy(Device* device)
 {
+	device->GetMemoryTracker().Remove(m_Memory);
 	vkDestroyBuffer(*device->GetDevicePtr(), m_Buffer, nullptr);
 	vkFreeMemory(*device->GetDevicePtr(), m_Memory, nullptr);
 }
@@ -56,6 +102,12 @@ BufferBuilder& BufferBuilder::BindData(void* data, CommandPool* commandPool)
 	return *this;
 }
 
+BufferBuilder& BufferBuilder::SetCategory(MemoryCategory category)
+{
+	m_Category = category;
+	return *this;
+}
+
 void BufferBuilder::Build(std::unique_ptr<Buffer>& buffer, Device* device, CommandPool* commandPool, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties)
 {
 	buffer.reset(new Buffer());
@@ -115,6 +167,13 @@ void BufferBuilder::CreateBuffer(Buffer& buffer, Device* device, CommandPool* co
 	}
 	vkBindBufferMemory(*device->GetDevicePtr(), buffer.m_Buffer, buffer.m_Memory, 0);
 
+	MemoryCategory category{ MemoryCategory::Buffer };
+	if (usage & (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT))
+		category = MemoryCategory::Geometry;
+	else if ((usage & ~(VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT)) == 0)
+		category = MemoryCategory::Staging;
+	device->GetMemoryTracker().Add(buffer.m_Memory, (uint64_t)buffer.m_Buffer, m_Category.value_or(category), allocInfo.memoryTypeIndex, allocInfo.allocationSize);
+
 	if (mapMemory)
 	{
 		assert(properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
@@ -127,8 +186,11 @@ void BufferBuilder::CreateBufferWithData(Buffer& buffer, Device* device, Command
 {
 	buffer.m_Size = size;
 
+	// the staging buffer is staging whatever the category of the buffer is
 	Buffer stagingBuffer{};
+	const std::optional<MemoryCategory> category{ std::exchange(m_Category, MemoryCategory::Staging) };
 	CreateBuffer(stagingBuffer, device, commandPool, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, true);
+	m_Category = category;
 
 	stagingBuffer.UpdateMappedData(m_BoundData, size, 0);
 
@@ -0,0 +1,283 @@
+#include "Bvh.h"
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <future>
+#include <numeric>
+#include <stdexcept>
+
+namespace
+{
+	float SurfaceArea(const glm::vec3& min, const glm::vec3& max)
+	{
+		const glm::vec3 extent{ glm::max(max - min, glm::vec3{ .0f }) };
+		return 2.f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+	}
+
+	struct Bin
+	{
+		glm::vec3 min{ FLT_MAX };
+		glm::vec3 max{ -FLT_MAX };
+		uint32_t count{};
+
+		void Grow(const glm::vec3& otherMin, const glm::vec3& otherMax, uint32_t otherCount)
+		{
+			min = glm::min(min, otherMin);
+			max = glm::max(max, otherMax);
+			count += otherCount;
+		}
+	};
+}
+
+void Bvh::Build(const std::vector<glm::vec3>& mins, const std::vector<glm::vec3>& maxs)
+{
+	if (mins.size() != maxs.size())
+		throw std::runtime_error("failed to build bvh, every primitive needs a min and a max");
+
+	m_Mins = mins;
+	m_Maxs = maxs;
+	const uint32_t count{ static_cast<uint32_t>(mins.size()) };
+	m_Primitives.resize(count);
+	std::iota(m_Primitives.begin(), m_Primitives.end(), 0);
+	m_Centroids.resize(count);
+	for (uint32_t index{}; index < count; ++index)
+		m_Centroids[index] = (mins[index] + maxs[index]) * .5f;
+
+	m_Nodes.clear();
+	if (count == 0)
+		return;
+
+	// a leaf per primitive is the most a binary tree can need, plus the padding after the root
+	m_Nodes.resize(2 * count);
+	m_Nodes[1] = Node{ glm::vec3{ .0f }, 0, glm::vec3{ .0f }, 0 };
+	std::atomic<uint32_t> nodeCount{ FIRST_CHILD };
+	BuildNode(nodeCount, 0, 0, count, 0);
+	m_Nodes.resize(nodeCount);
+	m_Nodes.shrink_to_fit();
+
+	// only needed to build
+	m_Centroids = std::vector<glm::vec3>{};
+}
+
+void Bvh::BuildNode(std::atomic<uint32_t>& nodeCount, uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t depth)
+{
+	Node& node{ m_Nodes[nodeIndex] };
+	node.first = first;
+	node.count = count;
+	FitNode(node);
+	if (count == 1 || depth + 1 >= MAX_DEPTH)
+		return;
+
+	// bins span the centroids, with the boxes one large primitive would push the rest into a few bins
+	glm::vec3 centroidMin{ FLT_MAX };
+	glm::vec3 centroidMax{ -FLT_MAX };
+	for (uint32_t primitive{ first }; primitive < first + count; ++primitive)
+	{
+		centroidMin = glm::min(centroidMin, m_Centroids[m_Primitives[primitive]]);
+		centroidMax = glm::max(centroidMax, m_Centroids[m_Primitives[primitive]]);
+	}
+
+	// costs are relative to the area of the node, a leaf costs one test per primitive
+	const float leafCost{ static_cast<float>(count) };
+	const float inverseArea{ 1.f / std::max(SurfaceArea(node.min, node.max), FLT_MIN) };
+	float bestCost{ FLT_MAX };
+	int bestAxis{ -1 };
+	uint32_t bestSplit{};
+	for (int axis{}; axis < 3; ++axis)
+	{
+		const float extent{ centroidMax[axis] - centroidMin[axis] };
+		if (extent <= .0f)
+			continue;
+
+		std::array<Bin, BIN_COUNT> bins{};
+		const float scale{ BIN_COUNT / extent };
+		for (uint32_t primitive{ first }; primitive < first + count; ++primitive)
+		{
+			const uint32_t index{ m_Primitives[primitive] };
+			const uint32_t bin{ std::min(static_cast<uint32_t>((m_Centroids[index][axis] - centroidMin[axis]) * scale), BIN_COUNT - 1) };
+			bins[bin].Grow(m_Mins[index], m_Maxs[index], 1);
+		}
+
+		// a sweep from the left stores the cost of everything before each plane, one from the right completes it
+		std::array<float, BIN_COUNT - 1> leftCosts{};
+		std::array<uint32_t, BIN_COUNT - 1> leftCounts{};
+		Bin left{};
+		for (uint32_t split{}; split < BIN_COUNT - 1; ++split)
+		{
+			left.Grow(bins[split].min, bins[split].max, bins[split].count);
+			leftCounts[split] = left.count;
+			leftCosts[split] = (left.count > 0) ? SurfaceArea(left.min, left.max) * left.count : .0f;
+		}
+		Bin right{};
+		for (uint32_t split{ BIN_COUNT - 1 }; split > 0; --split)
+		{
+			right.Grow(bins[split].min, bins[split].max, bins[split].count);
+			if (right.count == 0 || leftCounts[split - 1] == 0)
+				continue;
+
+			const float cost{ TRAVERSAL_COST + (leftCosts[split - 1] + SurfaceArea(right.min, right.max) * right.count) * inverseArea };
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = split;
+			}
+		}
+	}
+
+	uint32_t leftCount{};
+	if (bestAxis >= 0 && (bestCost < leafCost || count > MAX_LEAF_SIZE))
+	{
+		const float scale{ BIN_COUNT / (centroidMax[bestAxis] - centroidMin[bestAxis]) };
+		const auto middle{ std::partition(m_Primitives.begin() + first, m_Primitives.begin() + first + count, [&](uint32_t index)
+			{
+				return std::min(static_cast<uint32_t>((m_Centroids[index][bestAxis] - centroidMin[bestAxis]) * scale), BIN_COUNT - 1) < bestSplit;
+			}) };
+		leftCount = static_cast<uint32_t>(middle - (m_Primitives.begin() + first));
+	}
+	else if (bestAxis < 0 && count > MAX_LEAF_SIZE)
+	{
+		// every centroid is the same point, halves of the range are as good as any split
+		leftCount = count / 2;
+	}
+	else
+	{
+		return;
+	}
+
+	const uint32_t leftChild{ nodeCount.fetch_add(2) };
+	node.first = leftChild;
+	node.count = 0;
+
+	// the ranges of the children are disjoint, a thread for the right one needs no locking
+	if (count >= PARALLEL_BUILD_SIZE)
+	{
+		std::future<void> right{ std::async(std::launch::async, [&, leftChild, first, leftCount, count, depth]()
+			{
+				BuildNode(nodeCount, leftChild + 1, first + leftCount, count - leftCount, depth + 1);
+			}) };
+		BuildNode(nodeCount, leftChild, first, leftCount, depth + 1);
+		right.get();
+	}
+	else
+	{
+		BuildNode(nodeCount, leftChild, first, leftCount, depth + 1);
+		BuildNode(nodeCount, leftChild + 1, first + leftCount, count - leftCount, depth + 1);
+	}
+}
+
+void Bvh::FitNode(Node& node) const
+{
+	node.min = glm::vec3{ FLT_MAX };
+	node.max = glm::vec3{ -FLT_MAX };
+	for (uint32_t primitive{ node.first }; primitive < node.first + node.count; ++primitive)
+	{
+		node.min = glm::min(node.min, m_Mins[m_Primitives[primitive]]);
+		node.max = glm::max(node.max, m_Maxs[m_Primitives[primitive]]);
+	}
+}
+
+void Bvh::Refit(const std::vector<glm::vec3>& mins, const std::vector<glm::vec3>& maxs)
+{
+	if (mins.size() != m_Mins.size() || maxs.size() != m_Maxs.size())
+		throw std::runtime_error("failed to refit bvh, the primitive count changed");
+
+	m_Mins = mins;
+	m_Maxs = maxs;
+	// children are always taken after their parent, so going backwards finishes them first
+	for (size_t index{ m_Nodes.size() }; index > 0; --index)
+	{
+		// the padding after the root has no children to fit
+		if (index - 1 == 1)
+			continue;
+
+		Node& node{ m_Nodes[index - 1] };
+		if (node.count > 0)
+		{
+			FitNode(node);
+			continue;
+		}
+		const Node& left{ m_Nodes[node.first] };
+		const Node& right{ m_Nodes[node.first + 1] };
+		node.min = glm::min(left.min, right.min);
+		node.max = glm::max(left.max, right.max);
+	}
+}
+
+void Bvh::QueryFrustum(const glm::mat4& viewProjection, std::vector<uint32_t>& primitives) const
+{
+	// rows of the matrix combined, clip space depth is 0 to 1
+	const glm::mat4 transposed{ glm::transpose(viewProjection) };
+	const glm::vec4 planes[]
+	{
+		transposed[3] + transposed[0],
+		transposed[3] - transposed[0],
+		transposed[3] + transposed[1],
+		transposed[3] - transposed[1],
+		transposed[2],
+		transposed[3] - transposed[2]
+	};
+
+	Traverse([&planes](const glm::vec3& min, const glm::vec3& max)
+		{
+			Overlap overlap{ Overlap::Inside };
+			for (const glm::vec4& plane : planes)
+			{
+				// the corners furthest in front of and behind the plane
+				const glm::vec3 normal{ plane };
+				const glm::vec3 front{ glm::mix(min, max, glm::greaterThan(normal, glm::vec3{ .0f })) };
+				const glm::vec3 back{ glm::mix(max, min, glm::greaterThan(normal, glm::vec3{ .0f })) };
+				if (glm::dot(normal, front) + plane.w < .0f)
+					return Overlap::Outside;
+				if (glm::dot(normal, back) + plane.w < .0f)
+					overlap = Overlap::Partial;
+			}
+			return overlap;
+		}, [&primitives](uint32_t primitive) { primitives.push_back(primitive); });
+}
+
+void Bvh::QueryAABB(const glm::vec3& min, const glm::vec3& max, std::vector<uint32_t>& primitives) const
+{
+	Traverse([&min, &max](const glm::vec3& otherMin, const glm::vec3& otherMax)
+		{
+			if (glm::any(glm::lessThan(otherMax, min)) || glm::any(glm::greaterThan(otherMin, max)))
+				return Overlap::Outside;
+			if (glm::all(glm::greaterThanEqual(otherMin, min)) && glm::all(glm::lessThanEqual(otherMax, max)))
+				return Overlap::Inside;
+			return Overlap::Partial;
+		}, [&primitives](uint32_t primitive) { primitives.push_back(primitive); });
+}
+
+uint32_t Bvh::RaycastBounds(const glm::vec3& origin, const glm::vec3& direction, float& distance) const
+{
+	const glm::vec3 inverseDirection{ 1.f / direction };
+	return Raycast(origin, direction, distance, [&](uint32_t primitive, float maxDistance)
+		{
+			return IntersectAABB(origin, inverseDirection, m_Mins[primitive], m_Maxs[primitive], maxDistance);
+		});
+}
+
+float Bvh::IntersectAABB(const glm::vec3& origin, const glm::vec3& inverseDirection, const glm::vec3& min, const glm::vec3& max, float distance)
+{
+	// slab test on all three axes at once
+	const glm::vec3 t0{ (min - origin) * inverseDirection };
+	const glm::vec3 t1{ (max - origin) * inverseDirection };
+	const glm::vec3 tMin{ glm::min(t0, t1) };
+	const glm::vec3 tMax{ glm::max(t0, t1) };
+	const float entry{ std::max({ tMin.x, tMin.y, tMin.z, .0f }) };
+	const float exit{ std::min({ tMax.x, tMax.y, tMax.z, distance }) };
+	return (entry <= exit && entry < distance) ? entry : std::numeric_limits<float>::infinity();
+}
+
+float Bvh::CalculateCost() const
+{
+	if (m_Nodes.empty())
+		return .0f;
+
+	// chance of a random ray hitting a node is its area relative to the root, the empty padding adds nothing
+	const float inverseRootArea{ 1.f / std::max(SurfaceArea(m_Nodes[0].min, m_Nodes[0].max), FLT_MIN) };
+	float cost{};
+	for (const Node& node : m_Nodes)
+		cost += SurfaceArea(node.min, node.max) * inverseRootArea * ((node.count > 0) ? static_cast<float>(node.count) : TRAVERSAL_COST);
+	return cost;
+}
@@ -0,0 +1,97 @@
+#include "CameraPath.h"
+#include <glm/gtx/spline.hpp>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+void CameraPath::AddKey(float time, const glm::vec3& position, const glm::vec3& forward)
+{
+	if (!m_Keys.empty() && time < m_Keys.back().time)
+		throw std::runtime_error("failed to add camera path key, keys have to be added in order of time");
+
+	m_Keys.push_back(Key{ time, position, glm::normalize(forward) });
+}
+
+void CameraPath::Sample(float time, glm::vec3& position, glm::vec3& forward) const
+{
+	if (m_Keys.empty())
+		throw std::runtime_error("failed to sample camera path, it has no keys");
+
+	const float duration{ GetDuration() };
+	if (duration <= .0f)
+	{
+		position = m_Keys.front().position;
+		forward = m_Keys.front().forward;
+		return;
+	}
+
+	const float pathTime{ m_Keys.front().time + std::fmod(std::max(time, .0f), duration) };
+	// segment from key to key + 1, the neighbours outside the path repeat the end keys
+	const auto next{ std::upper_bound(m_Keys.begin(), m_Keys.end(), pathTime, [](float value, const Key& key) { return value < key.time; }) };
+	const size_t last{ m_Keys.size() - 1 };
+	const size_t key{ std::min(static_cast<size_t>(next - m_Keys.begin()) - 1, last) };
+	const Key& k0{ m_Keys[(key == 0) ? 0 : key - 1] };
+	const Key& k1{ m_Keys[key] };
+	const Key& k2{ m_Keys[std::min(key + 1, last)] };
+	const Key& k3{ m_Keys[std::min(key + 2, last)] };
+
+	const float length{ k2.time - k1.time };
+	const float weight{ (length > .0f) ? std::clamp((pathTime - k1.time) / length, .0f, 1.f) : .0f };
+	position = glm::catmullRom(k0.position, k1.position, k2.position, k3.position, weight);
+	// directions are splined like positions and renormalized, opposite keys would pass through zero
+	const glm::vec3 direction{ glm::catmullRom(k0.forward, k1.forward, k2.forward, k3.forward, weight) };
+	forward = (glm::dot(direction, direction) > 1e-6f) ? glm::normalize(direction) : k1.forward;
+}
+
+void CameraPath::Load(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file.is_open())
+		throw std::runtime_error("failed to open camera path " + path);
+
+	m_Keys.clear();
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		std::istringstream stream{ line };
+		Key key{};
+		if (!(stream >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.forward.x >> key.forward.y >> key.forward.z))
+			throw std::runtime_error("failed to read camera path " + path + ", bad key: " + line);
+		AddKey(key.time, key.position, key.forward);
+	}
+
+	if (m_Keys.empty())
+		throw std::runtime_error("failed to read camera path " + path + ", it has no keys");
+}
+
+void CameraPath::Save(const std::string& path) const
+{
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open())
+		throw std::runtime_error("failed to write camera path " + path);
+
+	file << "# time x y z forwardX forwardY forwardZ\n";
+	for (const Key& key : m_Keys)
+		file << key.time << ' ' << key.position.x << ' ' << key.position.y << ' ' << key.position.z << ' '
+			 << key.forward.x << ' ' << key.forward.y << ' ' << key.forward.z << '\n';
+}
+
+CameraPath CameraPath::CreateDefault()
+{
+	// world space of the rotated scene, z is up and the atrium runs along x
+	CameraPath path{};
+	path.AddKey(.0f,  glm::vec3{ -9.f,  .0f, 1.5f }, glm::vec3{ 1.f,  .0f,  .0f });
+	path.AddKey(4.f,  glm::vec3{ -3.f, -1.5f, 1.8f }, glm::vec3{ 1.f,  .3f,  .0f });
+	path.AddKey(8.f,  glm::vec3{ 4.f,  1.5f, 1.8f }, glm::vec3{ 1.f, -.3f, .05f });
+	path.AddKey(12.f, glm::vec3{ 9.f,  .0f, 2.5f }, glm::vec3{ -.2f, 1.f,  .3f });
+	path.AddKey(16.f, glm::vec3{ 6.f, -3.5f, 5.5f }, glm::vec3{ -1.f,  .2f, -.3f });
+	path.AddKey(20.f, glm::vec3{ -4.f, -3.5f, 5.5f }, glm::vec3{ -1.f,  .3f, -.2f });
+	path.AddKey(24.f, glm::vec3{ -9.f,  .0f, 3.f }, glm::vec3{ 1.f,  .0f, -.2f });
+	path.AddKey(28.f, glm::vec3{ -9.f,  .0f, 1.5f }, glm::vec3{ 1.f,  .0f,  .0f });
+	return path;
+}
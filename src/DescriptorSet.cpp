@@ -119,6 +119,50 @@ DescriptorSet& DescriptorSet::AddWriteDescriptorSet(Image* image, uint32_t bindi
 	return *this;
 }
 
+DescriptorSet& DescriptorSet::AddWriteDescriptorSet(Image* image, VkDescriptorType type, VkImageLayout layout, uint32_t binding, uint32_t arrayElement)
+{
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.imageLayout = layout;
+	imageInfo.imageView = *image->GetFirstViewPtr();
+	imageInfo.sampler = nullptr;
+
+	VkWriteDescriptorSet writeDescriptor{};
+	writeDescriptor.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writeDescriptor.dstSet = m_Set;
+	writeDescriptor.dstBinding = binding;
+	writeDescriptor.dstArrayElement = arrayElement;
+	writeDescriptor.descriptorType = type;
+	writeDescriptor.descriptorCount = 1;
+	writeDescriptor.pImageInfo = &imageInfo;
+	writeDescriptor.pBufferInfo = nullptr;
+	writeDescriptor.pTexelBufferView = nullptr;
+
+	m_WriteDescriptorSets.push_back(std::make_tuple(writeDescriptor, VkDescriptorBufferInfo(nullptr), std::vector<VkDescriptorImageInfo>{ imageInfo }));
+	return *this;
+}
+
+DescriptorSet& DescriptorSet::AddWriteDescriptorSet(VkImageView view, VkDescriptorType type, VkImageLayout layout, uint32_t binding, uint32_t arrayElement)
+{
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.imageLayout = layout;
+	imageInfo.imageView = view;
+	imageInfo.sampler = nullptr;
+
+	VkWriteDescriptorSet writeDescriptor{};
+	writeDescriptor.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writeDescriptor.dstSet = m_Set;
+	writeDescriptor.dstBinding = binding;
+	writeDescriptor.dstArrayElement = arrayElement;
+	writeDescriptor.descriptorType = type;
+	writeDescriptor.descriptorCount = 1;
+	writeDescriptor.pImageInfo = &imageInfo;
+	writeDescriptor.pBufferInfo = nullptr;
+	writeDescriptor.pTexelBufferView = nullptr;
+
+	m_WriteDescriptorSets.push_back(std::make_tuple(writeDescriptor, VkDescriptorBufferInfo(nullptr), std::vector<VkDescriptorImageInfo>{ imageInfo }));
+	return *this;
+}
+
 void DescriptorSet::Update(Device* device)
 {
 	std::vector<VkWriteDescriptorSet> sets;
@@ -10,6 +10,7 @@
 #include <set>
 #include <stdexcept>
 #include <map>
+#include <cstddef>
 
 VkFormat Device::FindSupportedFormats(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features)
 {
@@ -82,6 +83,9 @@ Device::QueueFamilyIndices Device::FindQueueFamilies(VkPhysicalDevice physDevice
 
 void Device::SetObjectName(VkObjectType type, uint64_t handle, const char* name)
 {
+	if (type == VK_OBJECT_TYPE_BUFFER || type == VK_OBJECT_TYPE_IMAGE)
+		m_MemoryTracker.SetName(handle, name);
+
 	VkDebugUtilsObjectNameInfoEXT info{};
 	info.sType			= VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
 	info.objectType		= type;
@@ -93,6 +97,34 @@ void Device::SetObjectName(VkObjectType type, uint64_t handle, const char* name)
 	#endif
 }
 
+bool Device::IsExtensionEnabled(const char* extension) const
+{
+	return std::find(m_EnabledExtensions.begin(), m_EnabledExtensions.end(), extension) != m_EnabledExtensions.end();
+}
+
+std::vector<Device::HeapBudget> Device::GetHeapBudgets()
+{
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+	budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+	const bool hasBudget{ IsExtensionEnabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) };
+	VkPhysicalDeviceMemoryProperties2 memProperties{};
+	memProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+	memProperties.pNext = hasBudget ? &budgetProperties : nullptr;
+	vkGetPhysicalDeviceMemoryProperties2(m_PhysicalDevice, &memProperties);
+
+	std::vector<HeapBudget> budgets(memProperties.memoryProperties.memoryHeapCount);
+	for (uint32_t index{}; index < budgets.size(); ++index)
+	{
+		const VkMemoryHeap& heap{ memProperties.memoryProperties.memoryHeaps[index] };
+		budgets[index].flags = heap.flags;
+		budgets[index].size = heap.size;
+		budgets[index].budget = hasBudget ? budgetProperties.heapBudget[index] : heap.size;
+		budgets[index].usage = hasBudget ? budgetProperties.heapUsage[index] : 0;
+	}
+	return budgets;
+}
+
 void Device::Destroy()
 {
 	vkDestroyDevice(m_Device, nullptr);
@@ -103,6 +135,38 @@ void DeviceBuilder::Build(std::unique_ptr<Device>& device, Instance* instance, V
 	device.reset(new Device());
 
 	PickPhysicalDevice(&device->m_PhysicalDevice, *instance->GetInstancePtr(), surface);
+	device->m_MemoryTracker.Initialize(device->m_PhysicalDevice);
+
+	uint32_t extensionCount{};
+	vkEnumerateDeviceExtensionProperties(device->m_PhysicalDevice, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device->m_PhysicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+	std::vector<const char*> extensions{ m_Extensions };
+	for (const char* extension : m_OptionalExtensions)
+	{
+		const bool isSupported{ std::any_of(availableExtensions.begin(), availableExtensions.end(),
+			[extension](const VkExtensionProperties& properties) { return std::string(properties.extensionName) == extension; }) };
+		if (isSupported)
+			extensions.push_back(extension);
+	}
+	device->m_EnabledExtensions.assign(extensions.begin(), extensions.end());
+
+	VkPhysicalDeviceVulkan12Features availableFeatures12{};
+	availableFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	VkPhysicalDeviceFeatures2 availableFeatures{};
+	availableFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	availableFeatures.pNext = &availableFeatures12;
+	vkGetPhysicalDeviceFeatures2(device->m_PhysicalDevice, &availableFeatures);
+
+	AddSupportedFeatures(&availableFeatures.features.robustBufferAccess, &m_OptionalFeatures.robustBufferAccess, &m_DeviceFeatures.features.robustBufferAccess,
+						 sizeof(VkPhysicalDeviceFeatures) / sizeof(VkBool32));
+	const size_t features12Offset{ offsetof(VkPhysicalDeviceVulkan12Features, samplerMirrorClampToEdge) };
+	AddSupportedFeatures(&availableFeatures12.samplerMirrorClampToEdge, &m_OptionalFeatures12.samplerMirrorClampToEdge, &m_DeviceFeatures12.samplerMirrorClampToEdge,
+						 (sizeof(VkPhysicalDeviceVulkan12Features) - features12Offset) / sizeof(VkBool32));
+	device->m_EnabledFeatures = m_DeviceFeatures.features;
+	device->m_EnabledFeatures12 = m_DeviceFeatures12;
+	device->m_EnabledFeatures12.pNext = nullptr;
 
 	Device::QueueFamilyIndices indices = device->FindQueueFamilies(surface);
 
@@ -142,8 +206,8 @@ void DeviceBuilder::Build(std::unique_ptr<Device>& device, Instance* instance, V
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	createInfo.pEnabledFeatures = nullptr;
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(m_Extensions.size());
-	createInfo.ppEnabledExtensionNames = m_Extensions.data();
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+	createInfo.ppEnabledExtensionNames = extensions.data();
 
 	if (ENABLE_VALIDATION_LAYERS)
 	{
@@ -201,6 +265,25 @@ DeviceBuilder& DeviceBuilder::SetEnabledFeatures(const VkPhysicalDeviceFeatures&
 	return *this;
 }
 
+DeviceBuilder& DeviceBuilder::SetOptionalFeatures(const VkPhysicalDeviceFeatures& features)
+{
+	m_OptionalFeatures = features;
+	return *this;
+}
+
+DeviceBuilder& DeviceBuilder::SetOptionalFeatures(const VkPhysicalDeviceVulkan12Features& features)
+{
+	m_OptionalFeatures12 = features;
+	return *this;
+}
+
+void DeviceBuilder::AddSupportedFeatures(const VkBool32* available, const VkBool32* optional, VkBool32* enabled, size_t count)
+{
+	for (size_t index{}; index < count; ++index)
+		if (optional[index] && available[index])
+			enabled[index] = VK_TRUE;
+}
+
 void DeviceBuilder::PickPhysicalDevice(VkPhysicalDevice* physDevice, VkInstance instance, VkSurfaceKHR surface)
 {
 	uint32_t deviceCount = 0;
@@ -225,7 +308,7 @@ void DeviceBuilder::PickPhysicalDevice(VkPhysicalDevice* physDevice, VkInstance
 	if (bestCandidate->first > 0)
 		*physDevice = bestCandidate->second;
 	else
-		throw std::runtime_error("failed to find a suitable GPU");
+		throw std::runtime_error("failed to find a suitable GPU, none supports every required extension and feature");
 }
 
 int DeviceBuilder::RateDeviceSuitability(VkPhysicalDevice device, VkSurfaceKHR surface)
@@ -304,7 +387,7 @@ bool DeviceBuilder::CheckFeatureSupport(VkPhysicalDevice device)
 		CompareFeatures<VkPhysicalDeviceVulkan13Features>(&deviceFeatures13, &m_DeviceFeatures13) &&
 		CompareFeatures<VkPhysicalDeviceVulkan12Features>(&deviceFeatures12, &m_DeviceFeatures12) &&
 		CompareFeatures<VkPhysicalDeviceVulkan11Features>(&deviceFeatures11, &m_DeviceFeatures11) &&
-		CompareFeatures<VkPhysicalDeviceFeatures2>(&deviceFeatures, &deviceFeatures);
+		CompareFeatures<VkPhysicalDeviceFeatures2>(&deviceFeatures, &m_DeviceFeatures);
 
 	//const VkBool32* enabledCBCFeatures{  };
 
@@ -0,0 +1,58 @@
+#include "DrawList.h"
+#include <array>
+#include <bit>
+#include <stdexcept>
+
+void DrawList::Add(uint32_t pipeline, uint32_t material, float depth, uint32_t meshIndex)
+{
+	if (pipeline >= MAX_PIPELINES || material >= MAX_MATERIALS || meshIndex >= MAX_MESHES)
+		throw std::runtime_error("failed to add draw, its pipeline, material or mesh does not fit the sort key");
+
+	// the bits of a non negative float sort like the float itself
+	const uint64_t depthBits{ std::bit_cast<uint32_t>(depth > .0f ? depth : .0f) };
+	m_Keys.push_back((static_cast<uint64_t>(pipeline) << PIPELINE_SHIFT) | (static_cast<uint64_t>(material) << MATERIAL_SHIFT) | (depthBits << DEPTH_SHIFT) | meshIndex);
+}
+
+void DrawList::Sort()
+{
+	const size_t count{ m_Keys.size() };
+	if (count < 2)
+		return;
+
+	// one pass over the keys counts every byte position at once
+	std::array<std::array<uint32_t, 256>, sizeof(uint64_t)> histograms{};
+	for (uint64_t key : m_Keys)
+	{
+		for (uint32_t digit{}; digit < sizeof(uint64_t); ++digit)
+			++histograms[digit][(key >> (digit * 8)) & 0xFF];
+	}
+
+	m_Scratch.resize(count);
+	for (uint32_t digit{}; digit < sizeof(uint64_t); ++digit)
+	{
+		std::array<uint32_t, 256>& histogram{ histograms[digit] };
+		// unused fields and the high bytes of small indices are the same in every key
+		if (histogram[(m_Keys[0] >> (digit * 8)) & 0xFF] == count)
+			continue;
+
+		uint32_t offset{};
+		for (uint32_t& bucket : histogram)
+		{
+			const uint32_t size{ bucket };
+			bucket = offset;
+			offset += size;
+		}
+
+		for (uint64_t key : m_Keys)
+			m_Scratch[histogram[(key >> (digit * 8)) & 0xFF]++] = key;
+		m_Keys.swap(m_Scratch);
+	}
+}
+
+uint32_t DrawList::CountMaterialChanges() const
+{
+	uint32_t changes{};
+	for (size_t draw{ 1 }; draw < m_Keys.size(); ++draw)
+		changes += (GetMaterial(draw) != GetMaterial(draw - 1)) ? 1 : 0;
+	return changes;
+}
@@ -18,12 +18,27 @@
 #include "Buffer.h"
 #include "DescriptorPool.h"
 #include "DescriptorSet.h"
+#include "GPUProfiler.h"
+#include "ShadowCascades.h"
+#include "TextureStreamer.h"
+#include "MeshSimplifier.h"
+#include "Benchmark.h"
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <bit>
+#include <cstring>
+#include <iomanip>
 
 #include <functional>
+#include <optional>
 #include "Sampler.h"
 
-DynamicRenderingApp::DynamicRenderingApp() = default;
+DynamicRenderingApp::DynamicRenderingApp(const Settings& settings)
+	: m_Settings{ settings }
+	, m_GBufferLayout{ GetGBufferLayout(settings.gbufferProfile) }
+{
+}
 
 DynamicRenderingApp::~DynamicRenderingApp() = default;
 
@@ -39,8 +54,29 @@ void DynamicRenderingApp::Run()
 
 void DynamicRenderingApp::KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
-	//DynamicRenderingApp* app = reinterpret_cast<DynamicRenderingApp*>(glfwGetWindowUserPointer(window));
-	//app->m_CameraPtr->KeyboardStateChanged(key, scancode, action, mods);
+	// camera movement is polled in Camera::Update
+	if (action != GLFW_PRESS)
+		return;
+
+	DynamicRenderingApp* app = reinterpret_cast<DynamicRenderingApp*>(glfwGetWindowUserPointer(window));
+	switch (key)
+	{
+	case GLFW_KEY_L:
+		app->ToggleLightingPath();
+		break;
+	case GLFW_KEY_P:
+		app->PrintStatistics();
+		break;
+	case GLFW_KEY_M:
+		app->m_DevicePtr->GetMemoryTracker().PrintReport(std::cout, app->m_DevicePtr.get());
+		break;
+	case GLFW_KEY_R:
+		app->TogglePathRecording();
+		break;
+	case GLFW_KEY_N:
+		app->ToggleNodeAnimation();
+		break;
+	}
 }
 
 void DynamicRenderingApp::MouseMovedCallback(GLFWwindow* window, double xpos, double ypos)
@@ -49,6 +85,25 @@ void DynamicRenderingApp::MouseMovedCallback(GLFWwindow* window, double xpos, do
 	//app->m_CameraPtr->MouseMoved(window, xpos, ypos);
 }
 
+DynamicRenderingApp::GBufferLayout DynamicRenderingApp::GetGBufferLayout(GBufferProfile profile)
+{
+	switch (profile)
+	{
+	case GBufferProfile::Balanced:
+		return GBufferLayout{ VK_FORMAT_R8G8B8A8_SRGB, VK_FORMAT_R16G16B16A16_UNORM, VK_FORMAT_UNDEFINED, VK_FORMAT_R16G16B16A16_SFLOAT };
+	case GBufferProfile::Compact:
+		// octahedral normal keeps 16 bit precision, roughness and metalness are fine with 8
+		return GBufferLayout{ VK_FORMAT_R8G8B8A8_SRGB, VK_FORMAT_R16G16_UNORM, VK_FORMAT_R8G8_UNORM, VK_FORMAT_B10G11R11_UFLOAT_PACK32 };
+	default:
+		return GBufferLayout{ VK_FORMAT_R8G8B8A8_SRGB, VK_FORMAT_R16G16B16A16_UNORM, VK_FORMAT_UNDEFINED, VK_FORMAT_R32G32B32A32_SFLOAT };
+	}
+}
+
+uint32_t DynamicRenderingApp::GBufferLayout::GetBytesPerPixel() const
+{
+	return HELP::GetFormatSize(albedo) + HELP::GetFormatSize(material) + HELP::GetFormatSize(roughnessMetalness) + HELP::GetFormatSize(hdr);
+}
+
 void DynamicRenderingApp::RenderToCubeMap(ShaderStage* vertexShader, ShaderStage* pixelShader, Image* inputImage, Sampler* sampler, Image* outputCubeMapImage)
 {
 	DeletionQueue localDeletionQueue{};
@@ -209,186 +264,1951 @@ void DynamicRenderingApp::RenderToCubeMap(ShaderStage* vertexShader, ShaderStage
 	outputCubeMapImage->DestroyExtraViews(m_DevicePtr.get());
 }
 
-void DynamicRenderingApp::GenerateShadowMap()
+void DynamicRenderingApp::ProjectToSphericalHarmonics(Image* cubeMap, Sampler* sampler, Buffer* outputCoefficients)
 {
+	DeletionQueue localDeletionQueue{};
+	DescriptorSetLayoutBuilder setLayoutBuilder{};
+	DescriptorSetLayout setLayout = setLayoutBuilder
+		.AddBinding(0, VK_DESCRIPTOR_TYPE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.AddBinding(1, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+		.AddBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // partial sums per workgroup
+		.AddBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // coefficients
+		.Build(*m_DevicePtr->GetDevicePtr());
+
+	localDeletionQueue.Push([&]() { vkDestroyDescriptorSetLayout(*m_DevicePtr->GetDevicePtr(), *setLayout.GetLayoutPtr(), nullptr); });
+
+	// face size, amount of partial sums
+	struct ProjectionConstants
 	{
-		ImageBuilder builder{};
-		builder
-			.SetAspect(m_DepthTexturePtr->GetAspect())
-			.SetFormat(m_DepthTexturePtr->GetFormat())
-			.SetDimensions(1024, 1024);
-		for (int index{}; index < m_DirectionalLights.size(); ++index)
+		uint32_t faceSize;
+		uint32_t partialCount;
+	};
+
+	PipelineLayoutBuilder pipelineLayoutBuilder{};
+	PipelineLayout pipelineLayout = pipelineLayoutBuilder
+		.AddDescriptorSetLayout(&setLayout)
+		.AddPushConstant(VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ProjectionConstants))
+		.Build(*m_DevicePtr->GetDevicePtr());
+
+	localDeletionQueue.Push([&]() { vkDestroyPipelineLayout(*m_DevicePtr->GetDevicePtr(), *pipelineLayout.GetPipelineLayoutPtr(), nullptr); });
+
+	auto projectionShaderCode{ HELP::ReadFile("shaders\\sh_projection_comp.spv") };
+	auto reductionShaderCode{ HELP::ReadFile("shaders\\sh_reduction_comp.spv") };
+
+	ShaderStage projectionShaderStage{ m_DevicePtr.get(), projectionShaderCode, VK_SHADER_STAGE_COMPUTE_BIT };
+	m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_SHADER_MODULE, (uint64_t)projectionShaderStage.GetModule(), "sh projection shader module");
+	ShaderStage reductionShaderStage{ m_DevicePtr.get(), reductionShaderCode, VK_SHADER_STAGE_COMPUTE_BIT };
+	m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_SHADER_MODULE, (uint64_t)reductionShaderStage.GetModule(), "sh reduction shader module");
+
+	localDeletionQueue.Push(
+		[&]()
+		{
+			reductionShaderStage.Destroy(m_DevicePtr.get());
+			projectionShaderStage.Destroy(m_DevicePtr.get());
+		});
+
+	ComputePipelineBuilder projectionBuilder{};
+	Pipeline projectionPipeline = projectionBuilder
+		.SetShaderStage(projectionShaderStage)
+		.Build(m_DevicePtr.get(), *pipelineLayout.GetPipelineLayoutPtr());
+
+	localDeletionQueue.Push([&]() { vkDestroyPipeline(*m_DevicePtr->GetDevicePtr(), *projectionPipeline.GetPipelinePtr(), nullptr); });
+
+	ComputePipelineBuilder reductionBuilder{};
+	Pipeline reductionPipeline = reductionBuilder
+		.SetShaderStage(reductionShaderStage)
+		.Build(m_DevicePtr.get(), *pipelineLayout.GetPipelineLayoutPtr());
+
+	localDeletionQueue.Push([&]() { vkDestroyPipeline(*m_DevicePtr->GetDevicePtr(), *reductionPipeline.GetPipelinePtr(), nullptr); });
+
+	const uint32_t faceSize{ cubeMap->GetExtent().width };
+	const uint32_t tilesPerAxis{ (faceSize + SH_PROJECTION_TILE_SIZE - 1) / SH_PROJECTION_TILE_SIZE };
+	const ProjectionConstants constants{ faceSize, tilesPerAxis * tilesPerAxis * 6 };
+
+	BufferBuilder bufferBuilder{};
+	Buffer partialSums = bufferBuilder
+		.Build(m_DevicePtr.get(), m_CommandPoolPtr.get(), constants.partialCount * SH_COEFFICIENT_COUNT * sizeof(glm::vec4), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)*partialSums.GetBufferPtr(), "sh partial sums");
+
+	localDeletionQueue.Push([&]() { partialSums.Destroy(m_DevicePtr.get()); });
+
+	DescriptorPoolBuilder poolBuilder{};
+	DescriptorPool pool = poolBuilder
+		.AddPoolSize(VK_DESCRIPTOR_TYPE_SAMPLER, 1)
+		.AddPoolSize(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1)
+		.AddPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2)
+		.Build(m_DevicePtr.get(), 1);
+
+	localDeletionQueue.Push([&]() { pool.Destroy(*m_DevicePtr->GetDevicePtr()); });
+
+	DescriptorSetBuilder setBuilder{};
+	DescriptorSet set = setBuilder.Build(m_DevicePtr.get(), 1, *pool.GetDescriptorPoolPtr(), setLayout.GetLayoutPtr());
+
+	set
+		.AddWriteDescriptorSet(*sampler->GetSamplerPtr(), 0, 0)
+		.AddWriteDescriptorSet(cubeMap, 1, 0)
+		.AddWriteDescriptorSet(&partialSums, 0, 2, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+		.AddWriteDescriptorSet(outputCoefficients, 0, 3, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+		.Update(m_DevicePtr.get());
+
+	SingleTimeCommand commandBuffer = m_CommandPoolPtr->AllocateSingleTimeCommand(*m_DevicePtr->GetDevicePtr());
+	commandBuffer.Start();
+
+	vkCmdBindDescriptorSets(*commandBuffer.GetBufferPtr(), VK_PIPELINE_BIND_POINT_COMPUTE, *pipelineLayout.GetPipelineLayoutPtr(), 0, 1, set.GetDescriptorSetPtr(), 0, nullptr);
+	vkCmdPushConstants(*commandBuffer.GetBufferPtr(), *pipelineLayout.GetPipelineLayoutPtr(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ProjectionConstants), &constants);
+
+	// every workgroup reduces its tile to one partial sum per coefficient
+	vkCmdBindPipeline(*commandBuffer.GetBufferPtr(), VK_PIPELINE_BIND_POINT_COMPUTE, *projectionPipeline.GetPipelinePtr());
+	vkCmdDispatch(*commandBuffer.GetBufferPtr(), tilesPerAxis, tilesPerAxis, 6);
+
+	{
+		Buffer::Barrier barrier{};
 		{
-			m_ShadowDepthMaps.emplace_back
-			(
-				builder.Build(m_DevicePtr.get(), m_CommandPoolPtr.get(), VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
-			);
-			m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)*m_ShadowDepthMaps[index].GetFirstViewPtr(), "Shadow depth image view");
-			m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE, (uint64_t)*m_ShadowDepthMaps[index].GetImagePtr(), "Shadow depth image");
-			m_DeletionQueue.Push([&, index]() { m_ShadowDepthMaps[index].Destroy(*m_DevicePtr->GetDevicePtr()); });
+			barrier.srcStage	= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			barrier.dstStage	= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			barrier.srcAccess	= VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.dstAccess	= VK_ACCESS_SHADER_READ_BIT;
 		}
+		partialSums.MakeBarrier(&commandBuffer, barrier);
 	}
 
-	// transition to attachment optimal
+	vkCmdBindPipeline(*commandBuffer.GetBufferPtr(), VK_PIPELINE_BIND_POINT_COMPUTE, *reductionPipeline.GetPipelinePtr());
+	vkCmdDispatch(*commandBuffer.GetBufferPtr(), 1, 1, 1);
+
 	{
-		SingleTimeCommand command = m_CommandPoolPtr->AllocateSingleTimeCommand(*m_DevicePtr->GetDevicePtr());
+		Buffer::Barrier barrier{};
+		{
+			barrier.srcStage	= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			barrier.dstStage	= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			barrier.srcAccess	= VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.dstAccess	= VK_ACCESS_SHADER_READ_BIT;
+		}
+		outputCoefficients->MakeBarrier(&commandBuffer, barrier);
+	}
 
-		command.Start();
+	commandBuffer.End(m_DevicePtr.get());
+}
+
+void DynamicRenderingApp::CreateSpecularImages()
+{
+	ImageBuilder builder{};
+	builder
+		.SetAspect(VK_IMAGE_ASPECT_COLOR_BIT)
+		.SetFormat(PREFILTERED_FORMAT)
+		.SetViewType(VK_IMAGE_VIEW_TYPE_CUBE)
+		.SetLayers(6)
+		.SetMipLevels(PREFILTERED_MIP_LEVELS)
+		.SetFlags(VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT)
+		.SetDimensions(PREFILTERED_FACE_SIZE, PREFILTERED_FACE_SIZE)
+		.Build(m_PrefilteredCubeMapPtr, m_DevicePtr.get(), m_CommandPoolPtr.get(), VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	for (VkImageView& imageView : m_PrefilteredCubeMapPtr->GetViews())
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)imageView, "prefiltered cubemap view");
+	m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE, (uint64_t)*m_PrefilteredCubeMapPtr->GetImagePtr(), "prefiltered cubemap");
+
+	// throws when the lut cannot be written from compute
+	m_DevicePtr->FindSupportedFormats({ BRDF_LUT_FORMAT }, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+
+	ImageBuilder lutBuilder{};
+	lutBuilder
+		.SetAspect(VK_IMAGE_ASPECT_COLOR_BIT)
+		.SetFormat(BRDF_LUT_FORMAT)
+		.SetDimensions(BRDF_LUT_SIZE, BRDF_LUT_SIZE)
+		.SetCategory(MemoryCategory::Environment)
+		.Build(m_BRDFLUTPtr, m_DevicePtr.get(), m_CommandPoolPtr.get(), VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)*m_BRDFLUTPtr->GetFirstViewPtr(), "brdf lut view");
+	m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE, (uint64_t)*m_BRDFLUTPtr->GetImagePtr(), "brdf lut");
+
+	m_DeletionQueue.Push(
+		[&]()
+		{
+			m_BRDFLUTPtr->Destroy(*m_DevicePtr->GetDevicePtr());
+			m_PrefilteredCubeMapPtr->Destroy(*m_DevicePtr->GetDevicePtr());
+		});
+}
+
+void DynamicRenderingApp::PrefilterEnvironment(Image* cubeMap, Sampler* sampler, Image* outputCubeMap)
+{
+	DeletionQueue localDeletionQueue{};
+	const uint32_t levelCount{ outputCubeMap->GetMipLevels() };
+
+	DescriptorSetLayoutBuilder setLayoutBuilder{};
+	DescriptorSetLayout setLayout = setLayoutBuilder
+		.AddBinding(0, VK_DESCRIPTOR_TYPE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.AddBinding(1, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+		.AddBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+		.Build(*m_DevicePtr->GetDevicePtr());
+
+	localDeletionQueue.Push([&]() { vkDestroyDescriptorSetLayout(*m_DevicePtr->GetDevicePtr(), *setLayout.GetLayoutPtr(), nullptr); });
+
+	// size of the level being written, roughness it is convolved with
+	struct PrefilterConstants
+	{
+		uint32_t levelSize;
+		float roughness;
+	};
+
+	PipelineLayoutBuilder pipelineLayoutBuilder{};
+	PipelineLayout pipelineLayout = pipelineLayoutBuilder
+		.AddDescriptorSetLayout(&setLayout)
+		.AddPushConstant(VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PrefilterConstants))
+		.Build(*m_DevicePtr->GetDevicePtr());
+
+	localDeletionQueue.Push([&]() { vkDestroyPipelineLayout(*m_DevicePtr->GetDevicePtr(), *pipelineLayout.GetPipelineLayoutPtr(), nullptr); });
+
+	auto prefilterShaderCode{ HELP::ReadFile("shaders\\prefilter_environment_comp.spv") };
+
+	uint32_t sampleCount{ PREFILTERED_SAMPLE_COUNT };
+	ShaderStage prefilterShaderStage{ m_DevicePtr.get(), prefilterShaderCode, VK_SHADER_STAGE_COMPUTE_BIT };
+	prefilterShaderStage.AddSpecialization(sizeof(uint32_t), 1, static_cast<void*>(&sampleCount));
+	m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_SHADER_MODULE, (uint64_t)prefilterShaderStage.GetModule(), "environment prefilter shader module");
+
+	localDeletionQueue.Push([&]() { prefilterShaderStage.Destroy(m_DevicePtr.get()); });
+
+	ComputePipelineBuilder pipelineBuilder{};
+	Pipeline pipeline = pipelineBuilder
+		.SetShaderStage(prefilterShaderStage)
+		.Build(m_DevicePtr.get(), *pipelineLayout.GetPipelineLayoutPtr());
+
+	localDeletionQueue.Push([&]() { vkDestroyPipeline(*m_DevicePtr->GetDevicePtr(), *pipeline.GetPipelinePtr(), nullptr); });
+
+	// every level is written through its own array view
+	std::vector<VkImageView> levelViews(levelCount);
+	{
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = *outputCubeMap->GetImagePtr();
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		viewInfo.format = outputCubeMap->GetFormat();
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.layerCount = outputCubeMap->GetLayers();
+		for (uint32_t level{}; level < levelCount; ++level)
+		{
+			viewInfo.subresourceRange.baseMipLevel = level;
+			if (vkCreateImageView(*m_DevicePtr->GetDevicePtr(), &viewInfo, nullptr, &levelViews[level]) != VK_SUCCESS)
+				throw std::runtime_error("failed to create prefiltered level view");
+		}
+	}
+
+	localDeletionQueue.Push(
+		[&]()
+		{
+			for (VkImageView view : levelViews)
+				vkDestroyImageView(*m_DevicePtr->GetDevicePtr(), view, nullptr);
+		});
+
+	DescriptorPoolBuilder poolBuilder{};
+	DescriptorPool pool = poolBuilder
+		.AddPoolSize(VK_DESCRIPTOR_TYPE_SAMPLER, levelCount)
+		.AddPoolSize(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, levelCount)
+		.AddPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, levelCount)
+		.Build(m_DevicePtr.get(), levelCount);
+
+	localDeletionQueue.Push([&]() { pool.Destroy(*m_DevicePtr->GetDevicePtr()); });
+
+	// one set per level since the storage view changes
+	std::vector<VkDescriptorSetLayout> layouts(levelCount, *setLayout.GetLayoutPtr());
+	std::vector<DescriptorSet> sets{};
+	DescriptorSetBuilder setBuilder{};
+	setBuilder.Build(sets, m_DevicePtr.get(), levelCount, *pool.GetDescriptorPoolPtr(), layouts.data());
+
+	for (uint32_t level{}; level < levelCount; ++level)
+	{
+		sets[level]
+			.AddWriteDescriptorSet(*sampler->GetSamplerPtr(), 0, 0)
+			.AddWriteDescriptorSet(cubeMap, 1, 0)
+			.AddWriteDescriptorSet(levelViews[level], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL, 2, 0)
+			.Update(m_DevicePtr.get());
+	}
+
+	SingleTimeCommand commandBuffer = m_CommandPoolPtr->AllocateSingleTimeCommand(*m_DevicePtr->GetDevicePtr());
+	commandBuffer.Start();
 
+	{
 		Image::Transition transition{};
-		transition.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		transition.newLayout = VK_IMAGE_LAYOUT_GENERAL;
 		transition.srcAccess = 0;
-		transition.dstAccess = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		transition.dstAccess = VK_ACCESS_SHADER_WRITE_BIT;
 		transition.srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-		transition.dstStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-		for (Image& image : m_ShadowDepthMaps)
-			image.MakeTransition(m_DevicePtr.get(), &command, transition);
+		transition.dstStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		transition.layerCount = outputCubeMap->GetLayers();
+		outputCubeMap->MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
+	}
 
-		command.End(m_DevicePtr.get());
+	vkCmdBindPipeline(*commandBuffer.GetBufferPtr(), VK_PIPELINE_BIND_POINT_COMPUTE, *pipeline.GetPipelinePtr());
+
+	for (uint32_t level{}; level < levelCount; ++level)
+	{
+		const PrefilterConstants constants{ std::max(outputCubeMap->GetExtent().width >> level, 1u), (levelCount > 1) ? static_cast<float>(level) / (levelCount - 1) : .0f };
+		vkCmdBindDescriptorSets(*commandBuffer.GetBufferPtr(), VK_PIPELINE_BIND_POINT_COMPUTE, *pipelineLayout.GetPipelineLayoutPtr(), 0, 1, sets[level].GetDescriptorSetPtr(), 0, nullptr);
+		vkCmdPushConstants(*commandBuffer.GetBufferPtr(), *pipelineLayout.GetPipelineLayoutPtr(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PrefilterConstants), &constants);
+		vkCmdDispatch(*commandBuffer.GetBufferPtr(), (constants.levelSize + 7) / 8, (constants.levelSize + 7) / 8, outputCubeMap->GetLayers());
+	}
+
+	{
+		Image::Transition transition{};
+		transition.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		transition.srcAccess = VK_ACCESS_SHADER_WRITE_BIT;
+		transition.dstAccess = VK_ACCESS_SHADER_READ_BIT;
+		transition.srcStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		transition.dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		transition.layerCount = outputCubeMap->GetLayers();
+		outputCubeMap->MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
 	}
 
+	commandBuffer.End(m_DevicePtr.get());
+}
+
+void DynamicRenderingApp::IntegrateBRDF(Image* outputLUT)
+{
 	DeletionQueue localDeletionQueue{};
 
+	DescriptorSetLayoutBuilder setLayoutBuilder{};
+	DescriptorSetLayout setLayout = setLayoutBuilder
+		.AddBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+		.Build(*m_DevicePtr->GetDevicePtr());
+
+	localDeletionQueue.Push([&]() { vkDestroyDescriptorSetLayout(*m_DevicePtr->GetDevicePtr(), *setLayout.GetLayoutPtr(), nullptr); });
+
 	PipelineLayoutBuilder pipelineLayoutBuilder{};
 	PipelineLayout pipelineLayout = pipelineLayoutBuilder
-		.AddPushConstant(VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4) + sizeof(uint32_t))
-		.AddPushConstant(VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(glm::mat4) + sizeof(uint32_t), sizeof(datatype::TextureIndices))
-		.AddDescriptorSetLayout(m_GlobalSetLayoutPtr.get())
+		.AddDescriptorSetLayout(&setLayout)
 		.Build(*m_DevicePtr->GetDevicePtr());
 
 	localDeletionQueue.Push([&]() { vkDestroyPipelineLayout(*m_DevicePtr->GetDevicePtr(), *pipelineLayout.GetPipelineLayoutPtr(), nullptr); });
 
-	uint32_t textureCount{ static_cast<uint32_t>(m_ScenePtr->GetTextures().size()) };
-	uint32_t lightCount{ static_cast<uint32_t>(m_DirectionalLights.size()) };
+	auto integrationShaderCode{ HELP::ReadFile("shaders\\brdf_integration_comp.spv") };
 
-	auto vertShaderCode{ HELP::ReadFile("shaders\\shadow_prepass_vert.spv") };
-	auto prepassShaderCode{ HELP::ReadFile("shaders\\shadow_prepass_frag.spv") };
+	uint32_t sampleCount{ BRDF_SAMPLE_COUNT };
+	ShaderStage integrationShaderStage{ m_DevicePtr.get(), integrationShaderCode, VK_SHADER_STAGE_COMPUTE_BIT };
+	integrationShaderStage.AddSpecialization(sizeof(uint32_t), 1, static_cast<void*>(&sampleCount));
+	m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_SHADER_MODULE, (uint64_t)integrationShaderStage.GetModule(), "brdf integration shader module");
 
-	ShaderStage vertShaderStage{ m_DevicePtr.get(), vertShaderCode, VK_SHADER_STAGE_VERTEX_BIT };
-	vertShaderStage.AddSpecialization(sizeof(uint32_t), 1, &lightCount);
-	m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_SHADER_MODULE, (uint64_t)vertShaderStage.GetModule(), "shadow vertex shader module");
+	localDeletionQueue.Push([&]() { integrationShaderStage.Destroy(m_DevicePtr.get()); });
 
-	ShaderStage prepassShaderStage{ m_DevicePtr.get(), prepassShaderCode, VK_SHADER_STAGE_FRAGMENT_BIT };
-	prepassShaderStage.AddSpecialization(sizeof(uint32_t), 1, &textureCount);
-	m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_SHADER_MODULE, (uint64_t)prepassShaderStage.GetModule(), "shadow prepass shader module");
+	ComputePipelineBuilder pipelineBuilder{};
+	Pipeline pipeline = pipelineBuilder
+		.SetShaderStage(integrationShaderStage)
+		.Build(m_DevicePtr.get(), *pipelineLayout.GetPipelineLayoutPtr());
 
-	std::vector<VkFormat> colorAttachmentFormats{  };
+	localDeletionQueue.Push([&]() { vkDestroyPipeline(*m_DevicePtr->GetDevicePtr(), *pipeline.GetPipelinePtr(), nullptr); });
 
-	auto attributeDesc{ datatype::Vertex::GetAttributeDescriptions() };
+	DescriptorPoolBuilder poolBuilder{};
+	DescriptorPool pool = poolBuilder
+		.AddPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1)
+		.Build(m_DevicePtr.get(), 1);
 
-	VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT
-		| VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-	colorBlendAttachment.blendEnable = VK_FALSE;
+	localDeletionQueue.Push([&]() { pool.Destroy(*m_DevicePtr->GetDevicePtr()); });
 
-	PipelineBuilder pipelineBuilder{};
-	Pipeline pipeline = pipelineBuilder
-		.AddShaderStage(vertShaderStage)
-		.AddShaderStage(prepassShaderStage)
-		.SetCullMode(VK_CULL_MODE_BACK_BIT)
-		.SetFrontFace(VK_FRONT_FACE_COUNTER_CLOCKWISE)
-		.SetPolygonMode(VK_POLYGON_MODE_FILL)
-		.EnableDepthTest(VK_COMPARE_OP_LESS)
-		.EnableDepthWrite()
-		.SetDepthBias(1.25f, .0f, 1.75f)
-		.SetVertexDescription(datatype::Vertex::GetBindingDescription(), attributeDesc.data(), attributeDesc.size())
-		.AddColorBlendAttachment(colorBlendAttachment)
-		.EnableDynamicRendering(colorAttachmentFormats, m_ShadowDepthMaps[0].GetFormat(), VK_FORMAT_UNDEFINED)
-		.Build(m_DevicePtr.get(), m_ShadowDepthMaps[0].GetExtent(), *pipelineLayout.GetPipelineLayoutPtr(), VK_NULL_HANDLE);
-	m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_PIPELINE, (uint64_t)*pipeline.GetPipelinePtr(), "Pipeline (shadow prepass)");
+	DescriptorSetBuilder setBuilder{};
+	DescriptorSet set = setBuilder.Build(m_DevicePtr.get(), 1, *pool.GetDescriptorPoolPtr(), setLayout.GetLayoutPtr());
 
-	vertShaderStage.Destroy(m_DevicePtr.get());
-	prepassShaderStage.Destroy(m_DevicePtr.get());
+	set
+		.AddWriteDescriptorSet(outputLUT, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL, 0, 0)
+		.Update(m_DevicePtr.get());
 
-	localDeletionQueue.Push([&]() { vkDestroyPipeline(*m_DevicePtr->GetDevicePtr(), *pipeline.GetPipelinePtr(), nullptr); });
 	SingleTimeCommand commandBuffer = m_CommandPoolPtr->AllocateSingleTimeCommand(*m_DevicePtr->GetDevicePtr());
 	commandBuffer.Start();
 
-	for (int index{}; index < m_ShadowDepthMaps.size(); ++index)
 	{
-		Image& shadowDepthMap = m_ShadowDepthMaps[index];
+		Image::Transition transition{};
+		transition.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		transition.srcAccess = 0;
+		transition.dstAccess = VK_ACCESS_SHADER_WRITE_BIT;
+		transition.srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		transition.dstStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		outputLUT->MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
+	}
+
+	const VkExtent2D extent{ outputLUT->GetExtent() };
+	vkCmdBindPipeline(*commandBuffer.GetBufferPtr(), VK_PIPELINE_BIND_POINT_COMPUTE, *pipeline.GetPipelinePtr());
+	vkCmdBindDescriptorSets(*commandBuffer.GetBufferPtr(), VK_PIPELINE_BIND_POINT_COMPUTE, *pipelineLayout.GetPipelineLayoutPtr(), 0, 1, set.GetDescriptorSetPtr(), 0, nullptr);
+	vkCmdDispatch(*commandBuffer.GetBufferPtr(), (extent.width + 7) / 8, (extent.height + 7) / 8, 1);
+
+	{
+		Image::Transition transition{};
+		transition.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		transition.srcAccess = VK_ACCESS_SHADER_WRITE_BIT;
+		transition.dstAccess = VK_ACCESS_SHADER_READ_BIT;
+		transition.srcStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		transition.dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		outputLUT->MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
+	}
+
+	commandBuffer.End(m_DevicePtr.get());
+}
+
+void DynamicRenderingApp::CreateEnvironmentCubeMap(uint32_t faceSize)
+{
+	const VkFormat format{ GetEnvironmentFormat(m_Settings.environmentFormat) };
+
+	// packed formats are written through an r32ui alias instead of being rendered to
+	VkImageUsageFlags usage{ VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT };
+	VkImageCreateFlags flags{ VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT };
+	if (!IsEnvironmentFormatPacked(format))
+		usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	else
+	{
+		usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+		flags |= VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT;
+	}
+
+	ImageBuilder builder{};
+	builder
+		.SetAspect(VK_IMAGE_ASPECT_COLOR_BIT)
+		.SetFormat(format)
+		.SetViewType(VK_IMAGE_VIEW_TYPE_CUBE)
+		.SetLayers(6)
+		.SetMipLevels(HELP::GetMipLevelCount(faceSize, faceSize))
+		.SetFlags(flags)
+		.SetDimensions(faceSize, faceSize)
+		.Build(m_CubeMapPtr, m_DevicePtr.get(), m_CommandPoolPtr.get(), usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	for (VkImageView& imageView : m_CubeMapPtr->GetViews())
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)imageView, "cubemap view");
+
+	m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE, (uint64_t)*m_CubeMapPtr->GetImagePtr(), "cubemap");
+
+	m_DeletionQueue.Push(
+		[&]()
+		{
+			m_CubeMapPtr->Destroy(*m_DevicePtr->GetDevicePtr());
+		});
+
+	PrintEnvironmentReport(faceSize, m_CubeMapPtr->GetMipLevels());
+}
+
+VkFormat DynamicRenderingApp::GetEnvironmentFormat(EnvironmentFormat format)
+{
+	switch (format)
+	{
+	case EnvironmentFormat::RGBA16F:
+		return VK_FORMAT_R16G16B16A16_SFLOAT;
+	case EnvironmentFormat::B10G11R11:
+		return VK_FORMAT_B10G11R11_UFLOAT_PACK32;
+	case EnvironmentFormat::E5B9G9R9:
+		return VK_FORMAT_E5B9G9R9_UFLOAT_PACK32;
+	case EnvironmentFormat::RGBA32F:
+	default:
+		return VK_FORMAT_R32G32B32A32_SFLOAT;
+	}
+}
+
+bool DynamicRenderingApp::IsEnvironmentFormatRenderable(VkFormat format)
+{
+	VkFormatProperties properties{};
+	vkGetPhysicalDeviceFormatProperties(*m_DevicePtr->GetPhysicalDevicePtr(), format, &properties);
+
+	const VkFormatFeatureFlags required{ VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT };
+	return (properties.optimalTilingFeatures & required) == required;
+}
+
+bool DynamicRenderingApp::IsEnvironmentFormatPacked(VkFormat format)
+{
+	// the pack shader only knows these encodings, anything else would be corrupted
+	const bool isPackable{ format == VK_FORMAT_E5B9G9R9_UFLOAT_PACK32 || format == VK_FORMAT_B10G11R11_UFLOAT_PACK32 };
+	return isPackable && !IsEnvironmentFormatRenderable(format);
+}
+
+void DynamicRenderingApp::ValidateEnvironmentFormat()
+{
+	const VkFormat format{ GetEnvironmentFormat(m_Settings.environmentFormat) };
+	if (IsEnvironmentFormatRenderable(format) || IsEnvironmentFormatPacked(format))
+		return;
+
+	if (!IsEnvironmentFormatRenderable(GetEnvironmentFormat(EnvironmentFormat::RGBA16F)))
+		throw std::runtime_error("failed to pick an environment format, rgba16f cannot be rendered, blitted and filtered on this device");
+
+	std::cout << "environment format cannot be rendered, blitted and filtered on this device, using rgba16f\n";
+	m_Settings.environmentFormat = EnvironmentFormat::RGBA16F;
+}
+
+void DynamicRenderingApp::PrintEnvironmentReport(uint32_t faceSize, uint32_t mipLevels)
+{
+	const EnvironmentFormat formats[]{ EnvironmentFormat::RGBA32F, EnvironmentFormat::RGBA16F, EnvironmentFormat::B10G11R11, EnvironmentFormat::E5B9G9R9 };
+	const char* names[]{ "rgba32f", "rgba16f", "b10g11r11", "e5b9g9r9" };
+	const VkDeviceSize referenceSize{ HELP::GetImageSize(VK_FORMAT_R32G32B32A32_SFLOAT, faceSize, faceSize, 6, mipLevels) };
+
+	// every sky pixel fetches one texel per bilinear tap, so bytes per texel scales the sampling bandwidth
+	std::cout << "environment " << faceSize << "x" << faceSize << " cube with " << mipLevels << " levels\n";
+	for (size_t index{}; index < std::size(formats); ++index)
+	{
+		const VkFormat format{ GetEnvironmentFormat(formats[index]) };
+		const VkDeviceSize size{ HELP::GetImageSize(format, faceSize, faceSize, 6, mipLevels) };
+		std::cout << ((formats[index] == m_Settings.environmentFormat) ? "* " : "  ") << std::left << std::setw(10) << names[index] << std::right
+				  << std::fixed << std::setprecision(1) << std::setw(8) << size / (1024.f * 1024.f) << " MB, "
+				  << HELP::GetFormatSize(format) << " bytes per texel, " << std::setprecision(2) << static_cast<float>(referenceSize) / size << "x smaller than rgba32f"
+				  << (IsEnvironmentFormatPacked(format) ? ", packed in compute" : IsEnvironmentFormatRenderable(format) ? "" : ", not supported") << '\n';
+	}
+}
+
+void DynamicRenderingApp::PackEnvironment(Image* source, Image* target)
+{
+	DeletionQueue localDeletionQueue{};
+	const uint32_t levelCount{ target->GetMipLevels() };
+
+	DescriptorSetLayoutBuilder setLayoutBuilder{};
+	DescriptorSetLayout setLayout = setLayoutBuilder
+		.AddBinding(0, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+		.AddBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+		.Build(*m_DevicePtr->GetDevicePtr());
+
+	localDeletionQueue.Push([&]() { vkDestroyDescriptorSetLayout(*m_DevicePtr->GetDevicePtr(), *setLayout.GetLayoutPtr(), nullptr); });
+
+	PipelineLayoutBuilder pipelineLayoutBuilder{};
+	PipelineLayout pipelineLayout = pipelineLayoutBuilder
+		.AddDescriptorSetLayout(&setLayout)
+		.AddPushConstant(VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t))
+		.Build(*m_DevicePtr->GetDevicePtr());
+
+	localDeletionQueue.Push([&]() { vkDestroyPipelineLayout(*m_DevicePtr->GetDevicePtr(), *pipelineLayout.GetPipelineLayoutPtr(), nullptr); });
+
+	auto packShaderCode{ HELP::ReadFile("shaders\\pack_environment_comp.spv") };
+
+	// encoding
+	uint32_t constants[]{ (target->GetFormat() == VK_FORMAT_E5B9G9R9_UFLOAT_PACK32) ? 0u : 1u };
+
+	ShaderStage packShaderStage{ m_DevicePtr.get(), packShaderCode, VK_SHADER_STAGE_COMPUTE_BIT };
+	packShaderStage.AddSpecialization(sizeof(uint32_t), std::size(constants), static_cast<void*>(constants));
+	m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_SHADER_MODULE, (uint64_t)packShaderStage.GetModule(), "environment pack shader module");
+
+	localDeletionQueue.Push([&]() { packShaderStage.Destroy(m_DevicePtr.get()); });
+
+	ComputePipelineBuilder pipelineBuilder{};
+	Pipeline pipeline = pipelineBuilder
+		.SetShaderStage(packShaderStage)
+		.Build(m_DevicePtr.get(), *pipelineLayout.GetPipelineLayoutPtr());
+
+	localDeletionQueue.Push([&]() { vkDestroyPipeline(*m_DevicePtr->GetDevicePtr(), *pipeline.GetPipelinePtr(), nullptr); });
+
+	// the cube is read as an array so texels can be fetched per face
+	std::vector<VkImageView> views(levelCount + 1);
+	{
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = *source->GetImagePtr();
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		viewInfo.format = source->GetFormat();
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.levelCount = source->GetMipLevels();
+		viewInfo.subresourceRange.layerCount = source->GetLayers();
+		if (vkCreateImageView(*m_DevicePtr->GetDevicePtr(), &viewInfo, nullptr, &views[0]) != VK_SUCCESS)
+			throw std::runtime_error("failed to create environment source view");
+
+		viewInfo.image = *target->GetImagePtr();
+		viewInfo.format = VK_FORMAT_R32_UINT;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.layerCount = target->GetLayers();
+		for (uint32_t level{}; level < levelCount; ++level)
+		{
+			viewInfo.subresourceRange.baseMipLevel = level;
+			if (vkCreateImageView(*m_DevicePtr->GetDevicePtr(), &viewInfo, nullptr, &views[level + 1]) != VK_SUCCESS)
+				throw std::runtime_error("failed to create environment storage view");
+		}
+	}
+
+	localDeletionQueue.Push(
+		[&]()
+		{
+			for (VkImageView view : views)
+				vkDestroyImageView(*m_DevicePtr->GetDevicePtr(), view, nullptr);
+		});
+
+	DescriptorPoolBuilder poolBuilder{};
+	DescriptorPool pool = poolBuilder
+		.AddPoolSize(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, levelCount)
+		.AddPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, levelCount)
+		.Build(m_DevicePtr.get(), levelCount);
+
+	localDeletionQueue.Push([&]() { pool.Destroy(*m_DevicePtr->GetDevicePtr()); });
+
+	// one set per level since the storage view changes
+	std::vector<VkDescriptorSetLayout> layouts(levelCount, *setLayout.GetLayoutPtr());
+	std::vector<DescriptorSet> sets{};
+	DescriptorSetBuilder setBuilder{};
+	setBuilder.Build(sets, m_DevicePtr.get(), levelCount, *pool.GetDescriptorPoolPtr(), layouts.data());
+
+	for (uint32_t level{}; level < levelCount; ++level)
+	{
+		sets[level]
+			.AddWriteDescriptorSet(views[0], VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, source->GetCurrentLayout(), 0, 0)
+			.AddWriteDescriptorSet(views[level + 1], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL, 1, 0)
+			.Update(m_DevicePtr.get());
+	}
+
+	SingleTimeCommand commandBuffer = m_CommandPoolPtr->AllocateSingleTimeCommand(*m_DevicePtr->GetDevicePtr());
+	commandBuffer.Start();
+
+	{
+		Image::Transition transition{};
+		transition.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		transition.srcAccess = 0;
+		transition.dstAccess = VK_ACCESS_SHADER_WRITE_BIT;
+		transition.srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		transition.dstStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		transition.layerCount = target->GetLayers();
+		target->MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
+	}
+
+	vkCmdBindPipeline(*commandBuffer.GetBufferPtr(), VK_PIPELINE_BIND_POINT_COMPUTE, *pipeline.GetPipelinePtr());
+
+	for (uint32_t level{}; level < levelCount; ++level)
+	{
+		const uint32_t levelSize{ std::max(target->GetExtent().width >> level, 1u) };
+		vkCmdBindDescriptorSets(*commandBuffer.GetBufferPtr(), VK_PIPELINE_BIND_POINT_COMPUTE, *pipelineLayout.GetPipelineLayoutPtr(), 0, 1, sets[level].GetDescriptorSetPtr(), 0, nullptr);
+		vkCmdPushConstants(*commandBuffer.GetBufferPtr(), *pipelineLayout.GetPipelineLayoutPtr(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &level);
+		vkCmdDispatch(*commandBuffer.GetBufferPtr(), (levelSize + 7) / 8, (levelSize + 7) / 8, target->GetLayers());
+	}
+
+	{
+		Image::Transition transition{};
+		transition.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		transition.srcAccess = VK_ACCESS_SHADER_WRITE_BIT;
+		transition.dstAccess = VK_ACCESS_SHADER_READ_BIT;
+		transition.srcStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		transition.dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		transition.layerCount = target->GetLayers();
+		target->MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
+	}
+
+	commandBuffer.End(m_DevicePtr.get());
+}
+
+bool DynamicRenderingApp::IsBakedEnvironmentValid(const IBLCache::BakedEnvironment& environment, VkFormat format)
+{
+	const IBLCache::CachedImage& cubeMap{ environment.cubeMap };
+	return IsCachedImageValid(cubeMap, format, cubeMap.width, cubeMap.width, 6, HELP::GetMipLevelCount(cubeMap.width, cubeMap.width))
+		&& IsCachedImageValid(environment.prefilteredCubeMap, PREFILTERED_FORMAT, PREFILTERED_FACE_SIZE, PREFILTERED_FACE_SIZE, 6, PREFILTERED_MIP_LEVELS)
+		&& IsCachedImageValid(environment.brdfLUT, BRDF_LUT_FORMAT, BRDF_LUT_SIZE, BRDF_LUT_SIZE, 1, 1)
+		&& environment.irradianceSH.size() == SH_COEFFICIENT_COUNT * 3;
+}
+
+bool DynamicRenderingApp::IsCachedImageValid(const IBLCache::CachedImage& image, VkFormat format, uint32_t width, uint32_t height, uint32_t layers, uint32_t mipLevels)
+{
+	const VkDeviceSize size{ HELP::GetImageSize(image.format, image.width, image.height, image.layers, image.mipLevels) };
+	return image.format == format && image.width == width && image.height == height && image.layers == layers && image.mipLevels == mipLevels
+		&& size > 0 && image.data.size() == size;
+}
+
+void DynamicRenderingApp::UploadCachedImage(const IBLCache::CachedImage& cachedImage, Image* image)
+{
+	BufferBuilder builder{};
+	Buffer stagingBuffer = builder
+		.MapMemory()
+		.Build(m_DevicePtr.get(), m_CommandPoolPtr.get(), cachedImage.data.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	stagingBuffer.UpdateMappedData(cachedImage.data.data(), cachedImage.data.size(), 0);
+
+	SingleTimeCommand command = m_CommandPoolPtr->AllocateSingleTimeCommand(*m_DevicePtr->GetDevicePtr());
+
+	command.Start();
+	{
+		Image::Transition transition{};
+		transition.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		transition.srcAccess = 0;
+		transition.dstAccess = VK_ACCESS_TRANSFER_WRITE_BIT;
+		transition.srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		transition.dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		transition.layerCount = image->GetLayers();
+		image->MakeTransition(m_DevicePtr.get(), &command, transition);
+	}
+	stagingBuffer.CopyTo(image, &command, m_DevicePtr.get(), m_CommandPoolPtr.get());
+	{
+		Image::Transition transition{};
+		transition.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		transition.srcAccess = VK_ACCESS_TRANSFER_WRITE_BIT;
+		transition.dstAccess = VK_ACCESS_SHADER_READ_BIT;
+		transition.srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		transition.dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		transition.layerCount = image->GetLayers();
+		image->MakeTransition(m_DevicePtr.get(), &command, transition);
+	}
+	command.End(m_DevicePtr.get());
+
+	stagingBuffer.Destroy(m_DevicePtr.get());
+}
+
+void DynamicRenderingApp::ReadBackImage(Image* image, IBLCache::CachedImage& cachedImage)
+{
+	const VkExtent2D extent{ image->GetExtent() };
+	const VkDeviceSize size{ HELP::GetImageSize(image->GetFormat(), extent.width, extent.height, image->GetLayers(), image->GetMipLevels()) };
+
+	BufferBuilder builder{};
+	Buffer readBackBuffer = builder
+		.MapMemory()
+		.Build(m_DevicePtr.get(), m_CommandPoolPtr.get(), size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	SingleTimeCommand command = m_CommandPoolPtr->AllocateSingleTimeCommand(*m_DevicePtr->GetDevicePtr());
+
+	command.Start();
+	{
+		Image::Transition transition{};
+		transition.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		transition.srcAccess = VK_ACCESS_SHADER_READ_BIT;
+		transition.dstAccess = VK_ACCESS_TRANSFER_READ_BIT;
+		transition.srcStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		transition.dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		transition.layerCount = image->GetLayers();
+		image->MakeTransition(m_DevicePtr.get(), &command, transition);
+	}
+	readBackBuffer.CopyFrom(image, &command);
+	{
+		Image::Transition transition{};
+		transition.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		transition.srcAccess = VK_ACCESS_TRANSFER_READ_BIT;
+		transition.dstAccess = VK_ACCESS_SHADER_READ_BIT;
+		transition.srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		transition.dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		transition.layerCount = image->GetLayers();
+		image->MakeTransition(m_DevicePtr.get(), &command, transition);
+	}
+	{
+		Buffer::Barrier barrier{};
+		{
+			barrier.srcStage	= VK_PIPELINE_STAGE_TRANSFER_BIT;
+			barrier.dstStage	= VK_PIPELINE_STAGE_HOST_BIT;
+			barrier.srcAccess	= VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccess	= VK_ACCESS_HOST_READ_BIT;
+		}
+		readBackBuffer.MakeBarrier(&command, barrier);
+	}
+	command.End(m_DevicePtr.get());
+
+	cachedImage.format = image->GetFormat();
+	cachedImage.width = extent.width;
+	cachedImage.height = extent.height;
+	cachedImage.layers = image->GetLayers();
+	cachedImage.mipLevels = image->GetMipLevels();
+	cachedImage.data.resize(size);
+	std::memcpy(cachedImage.data.data(), readBackBuffer.GetMappedData(), size);
+
+	readBackBuffer.Destroy(m_DevicePtr.get());
+}
+
+void DynamicRenderingApp::ReadBackEnvironment(IBLCache::BakedEnvironment& environment)
+{
+	ReadBackImage(m_CubeMapPtr.get(), environment.cubeMap);
+	ReadBackImage(m_PrefilteredCubeMapPtr.get(), environment.prefilteredCubeMap);
+	ReadBackImage(m_BRDFLUTPtr.get(), environment.brdfLUT);
+
+	BufferBuilder builder{};
+	Buffer shBuffer = builder
+		.MapMemory()
+		.Build(m_DevicePtr.get(), m_CommandPoolPtr.get(), m_IrradianceSHPtr->GetSize(), VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	SingleTimeCommand command = m_CommandPoolPtr->AllocateSingleTimeCommand(*m_DevicePtr->GetDevicePtr());
+
+	command.Start();
+	m_IrradianceSHPtr->CopyTo(&shBuffer, &command, m_DevicePtr.get(), m_CommandPoolPtr.get());
+	{
+		Buffer::Barrier barrier{};
+		{
+			barrier.srcStage	= VK_PIPELINE_STAGE_TRANSFER_BIT;
+			barrier.dstStage	= VK_PIPELINE_STAGE_HOST_BIT;
+			barrier.srcAccess	= VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccess	= VK_ACCESS_HOST_READ_BIT;
+		}
+		shBuffer.MakeBarrier(&command, barrier);
+	}
+	command.End(m_DevicePtr.get());
+
+	environment.irradianceSH.resize(SH_COEFFICIENT_COUNT * 3);
+	std::memcpy(environment.irradianceSH.data(), shBuffer.GetMappedData(), environment.irradianceSH.size() * sizeof(float));
+
+	shBuffer.Destroy(m_DevicePtr.get());
+}
+
+void DynamicRenderingApp::CreateShadowMaps()
+{
+	// layer per light and cascade, same order as the cascade buffer
+	{
+		ImageBuilder builder{};
+		builder
+			.SetAspect(m_DepthTexturePtr->GetAspect())
+			.SetFormat(m_DepthTexturePtr->GetFormat())
+			.SetDimensions(m_ShadowCascadesPtr->GetResolution(), m_ShadowCascadesPtr->GetResolution())
+			.SetLayers(static_cast<uint32_t>(m_ShadowCascadesPtr->GetCascades().size()))
+			.SetViewType(VK_IMAGE_VIEW_TYPE_2D_ARRAY)
+			.Build(m_ShadowMapArrayPtr, m_DevicePtr.get(), m_CommandPoolPtr.get(), VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)*m_ShadowMapArrayPtr->GetFirstViewPtr(), "Shadow depth array view");
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE, (uint64_t)*m_ShadowMapArrayPtr->GetImagePtr(), "Shadow depth array image");
+		m_DeletionQueue.Push([&]() { m_ShadowMapArrayPtr->Destroy(*m_DevicePtr->GetDevicePtr()); });
+	}
+
+	// the array rests in read only between frames, RecordShadows moves it to attachment layout while rendering
+	{
+		SingleTimeCommand command = m_CommandPoolPtr->AllocateSingleTimeCommand(*m_DevicePtr->GetDevicePtr());
+
+		command.Start();
+
+		Image::Transition transition{};
+		transition.newLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
+		transition.srcAccess = 0;
+		transition.dstAccess = VK_ACCESS_SHADER_READ_BIT;
+		transition.srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		transition.dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		transition.layerCount = m_ShadowMapArrayPtr->GetLayers();
+		m_ShadowMapArrayPtr->MakeTransition(m_DevicePtr.get(), &command, transition);
+
+		command.End(m_DevicePtr.get());
+	}
+
+	{
+		PipelineLayoutBuilder builder{};
+		builder
+			.AddPushConstant(VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(uint32_t))
+			.AddPushConstant(VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(uint32_t), sizeof(uint32_t))
+			.AddDescriptorSetLayout(m_GlobalSetLayoutPtr.get())
+			.Build(m_ShadowPipelineLayoutPtr, *m_DevicePtr->GetDevicePtr());
+
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_PIPELINE_LAYOUT, (uint64_t)*m_ShadowPipelineLayoutPtr->GetPipelineLayoutPtr(), "Pipeline layout (shadow prepass)");
+
+		m_DeletionQueue.Push([&]() { vkDestroyPipelineLayout(*m_DevicePtr->GetDevicePtr(), *m_ShadowPipelineLayoutPtr->GetPipelineLayoutPtr(), nullptr); });
+	}
+
+	uint32_t textureCount{ static_cast<uint32_t>(m_ScenePtr->GetTextures().size()) };
+
+	auto vertShaderCode{ HELP::ReadFile("shaders\\shadow_prepass_vert.spv") };
+	auto prepassShaderCode{ HELP::ReadFile("shaders\\shadow_prepass_frag.spv") };
+
+	ShaderStage vertShaderStage{ m_DevicePtr.get(), vertShaderCode, VK_SHADER_STAGE_VERTEX_BIT };
+	m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_SHADER_MODULE, (uint64_t)vertShaderStage.GetModule(), "shadow vertex shader module");
+
+	ShaderStage prepassShaderStage{ m_DevicePtr.get(), prepassShaderCode, VK_SHADER_STAGE_FRAGMENT_BIT };
+	prepassShaderStage.AddSpecialization(sizeof(uint32_t), 1, &textureCount);
+	m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_SHADER_MODULE, (uint64_t)prepassShaderStage.GetModule(), "shadow prepass shader module");
+
+	std::vector<VkFormat> colorAttachmentFormats{  };
+
+	auto attributeDesc{ datatype::Vertex::GetAttributeDescriptions() };
+
+	VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT
+		| VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	colorBlendAttachment.blendEnable = VK_FALSE;
+
+	PipelineBuilder pipelineBuilder{};
+	pipelineBuilder
+		.AddShaderStage(vertShaderStage)
+		.AddShaderStage(prepassShaderStage)
+		.SetCullMode(VK_CULL_MODE_BACK_BIT)
+		.SetFrontFace(VK_FRONT_FACE_COUNTER_CLOCKWISE)
+		.SetPolygonMode(VK_POLYGON_MODE_FILL)
+		.EnableDepthTest(VK_COMPARE_OP_LESS)
+		.EnableDepthWrite()
+		.SetDepthBias(1.25f, .0f, 1.75f)
+		.SetVertexDescription(datatype::Vertex::GetBindingDescription(), attributeDesc.data(), attributeDesc.size())
+		.AddColorBlendAttachment(colorBlendAttachment)
+		.EnableDynamicRendering(colorAttachmentFormats, m_ShadowMapArrayPtr->GetFormat(), VK_FORMAT_UNDEFINED)
+		.Build(m_ShadowPipelinePtr, m_DevicePtr.get(), m_ShadowMapArrayPtr->GetExtent(), *m_ShadowPipelineLayoutPtr->GetPipelineLayoutPtr(), VK_NULL_HANDLE);
+	m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_PIPELINE, (uint64_t)*m_ShadowPipelinePtr->GetPipelinePtr(), "Pipeline (shadow prepass)");
+
+	vertShaderStage.Destroy(m_DevicePtr.get());
+	prepassShaderStage.Destroy(m_DevicePtr.get());
+
+	m_DeletionQueue.Push([&]() { vkDestroyPipeline(*m_DevicePtr->GetDevicePtr(), *m_ShadowPipelinePtr->GetPipelinePtr(), nullptr); });
+}
+
+uint32_t DynamicRenderingApp::UpdateShadowCascades(bool hasSceneMoved)
+{
+	// near cascades cover the fewest texels per meter and show movement first, refresh them every frame
+	// far cascades take turns so their cost is spread over the update interval
+	const uint32_t cascadeCount{ m_ShadowCascadesPtr->GetCascadeCount() };
+	uint32_t updateMask{};
+	for (uint32_t cascade{}; cascade < cascadeCount; ++cascade)
+	{
+		if (m_ShadowFrame == 0 || hasSceneMoved || cascade < 2 || (m_ShadowFrame + cascade) % m_ShadowUpdateInterval == 0)
+			updateMask |= 1u << cascade;
+	}
+	++m_ShadowFrame;
+
+	m_ShadowCascadesPtr->Update(m_CameraPtr.get(), m_CameraPtr->CalculateView(), m_DirectionalLights, m_ScenePtr->GetAABBMin(), m_ScenePtr->GetAABBMax(), updateMask);
+	m_ShadowCascadesPtr->Cull(m_ScenePtr->GetMeshBvh(), static_cast<uint32_t>(m_ScenePtr->GetMeshes().size()), updateMask);
+
+	const std::vector<datatype::ShadowCascade>& cascades{ m_ShadowCascadesPtr->GetCascades() };
+	m_ShadowCascadeSSBO[m_CurrentFrame].UpdateMappedData(cascades.data(), cascades.size() * sizeof(datatype::ShadowCascade), 0);
+	return updateMask;
+}
+
+void DynamicRenderingApp::AdjustShadowUpdateInterval()
+{
+	// the profiler average lags behind, let it settle before the next step
+	const double shadowMs{ m_GPUProfilerPtr->GetAverageMs("shadows") };
+	if (shadowMs <= .0 || m_ShadowFrame % SHADOW_BUDGET_PERIOD != 0)
+		return;
+
+	if (shadowMs > m_Settings.shadowBudgetMs && m_ShadowUpdateInterval < MAX_SHADOW_UPDATE_INTERVAL)
+		m_ShadowUpdateInterval *= 2;
+	else if (shadowMs < m_Settings.shadowBudgetMs * .5 && m_ShadowUpdateInterval > 1)
+		m_ShadowUpdateInterval /= 2;
+}
+
+void DynamicRenderingApp::AdjustRenderScale()
+{
+	const double frameMs{ m_GPUProfilerPtr->GetLastFrameMs() };
+	// nan while no frame was resolved
+	if (!m_Settings.dynamicResolution || !(frameMs > .0))
+		return;
+
+	// close enough to the budget, keep the scale instead of chasing timing noise
+	const double ratio{ m_Settings.frameBudgetMs / frameMs };
+	if (std::abs(ratio - 1.) < RENDER_SCALE_TOLERANCE)
+		return;
+
+	// cost of the scaled passes follows the pixel count, so the side scales with the square root
+	// timings lag by the frames in flight, only move part of the way to avoid oscillating
+	const float target{ m_RenderScale * static_cast<float>(std::sqrt(ratio)) };
+	m_RenderScale = std::clamp(m_RenderScale + (target - m_RenderScale) * RENDER_SCALE_DAMPING, MIN_RENDER_SCALE, 1.f);
+}
+
+VkExtent2D DynamicRenderingApp::GetRenderExtent() const
+{
+	const VkExtent2D extent{ *m_SwapChainPtr->GetExtentPtr() };
+	return VkExtent2D{ std::max(static_cast<uint32_t>(extent.width * m_RenderScale), 1u), std::max(static_cast<uint32_t>(extent.height * m_RenderScale), 1u) };
+}
+
+void DynamicRenderingApp::SelectLods()
+{
+	std::vector<Mesh>& meshes{ m_ScenePtr->GetMeshes() };
+	m_MeshLods.resize(meshes.size());
+	m_MeshDistances.resize(meshes.size());
+	m_LodMeshCounts.assign(MeshSimplifier::MAX_LOD_COUNT, 0);
+	m_LodTriangleCount = 0;
+
+	// pixels covered by one unit at distance 1, the rendered height follows dynamic resolution
+	const float pixelsPerUnit{ GetRenderExtent().height / (2.f * std::tan(glm::radians(m_CameraPtr->GetFov()) * .5f)) };
+	const glm::vec3& cameraPosition{ m_CameraPtr->GetPosition() };
+	// written in place while the gpu reads the same buffer every frame
+	static_assert(HAS_SINGLE_FRAME_IN_FLIGHT);
+	datatype::MeshCullData* cullData{ m_Settings.occlusionCulling ? static_cast<datatype::MeshCullData*>(m_MeshCullDataPtr->GetMappedData()) : nullptr };
+
+	for (size_t index{}; index < meshes.size(); ++index)
+	{
+		const Mesh& mesh{ meshes[index] };
+		const std::vector<datatype::MeshLod>& lods{ mesh.GetLods() };
+
+		// nearest point of the bounds, the camera inside them always gets full detail
+		const glm::vec3 nearest{ glm::clamp(cameraPosition, mesh.GetAABBMin(), mesh.GetAABBMax()) };
+		m_MeshDistances[index] = glm::length(nearest - cameraPosition);
+		const float distance{ std::max(m_MeshDistances[index], m_CameraPtr->GetNear()) };
+
+		uint32_t level{};
+		// errors are measured on the vertices, instances may scale them
+		while (level + 1 < lods.size() && lods[level + 1].error * mesh.GetWorldScale() * pixelsPerUnit / distance <= m_Settings.lodErrorPixels)
+			++level;
+
+		m_MeshLods[index] = level;
+		++m_LodMeshCounts[level];
+		m_LodTriangleCount += lods[level].indexCount / 3 * mesh.GetInstanceCount();
+
+		if (cullData)
+		{
+			cullData[index].firstIndex = lods[level].firstIndex;
+			cullData[index].indexCount = lods[level].indexCount;
+			// bounds follow nodes moved in the scene graph
+			cullData[index].aabbMin = mesh.GetAABBMin();
+			cullData[index].aabbMax = mesh.GetAABBMax();
+		}
+	}
+}
+
+void DynamicRenderingApp::BuildDrawLists()
+{
+	std::vector<Mesh>& meshes{ m_ScenePtr->GetMeshes() };
+	m_PrepassDrawList.Clear();
+	m_GBufferDrawList.Clear();
+	m_ShadowDrawList.Clear();
+
+	// each pass binds one pipeline, the field stays 0 until a pass needs a second one
+	for (uint32_t index{}; index < meshes.size(); ++index)
+	{
+		// streamed out meshes have no buffers to draw from, every pass goes through these lists
+		if (!meshes[index].IsResident())
+			continue;
+
+		const uint32_t material{ meshes[index].GetMaterialIndex() };
+		// the prepass only alpha tests, the order that rejects the most fragments early wins
+		m_PrepassDrawList.Add(0, 0, m_MeshDistances[index], index);
+		// depth is complete after the prepass, every g-buffer fragment passes the equal test anyway
+		m_GBufferDrawList.Add(0, material, m_MeshDistances[index], index);
+		// distance to the camera says nothing about the light, shadows only group by material
+		m_ShadowDrawList.Add(0, material, .0f, index);
+	}
+
+	m_PrepassDrawList.Sort();
+	m_GBufferDrawList.Sort();
+	m_ShadowDrawList.Sort();
+}
+
+void DynamicRenderingApp::RecordShadows(CommandBuffer& commandBuffer, uint32_t updateMask)
+{
+	const uint32_t cascadeCount{ m_ShadowCascadesPtr->GetCascadeCount() };
+	const uint32_t layerCount{ m_ShadowMapArrayPtr->GetLayers() };
+	std::vector<Mesh>& meshes{ m_ScenePtr->GetMeshes() };
+
+	// layers of cascades skipped this frame keep their contents, only updated ones are cleared
+	std::vector<VkClearRect> clearRects;
+	for (uint32_t layer{}; layer < layerCount; ++layer)
+		if (updateMask & (1u << (layer % cascadeCount)))
+			clearRects.emplace_back(VkRect2D{ VkOffset2D{}, m_ShadowMapArrayPtr->GetExtent() }, layer, 1);
+
+	if (clearRects.empty())
+		return;
+
+	{
+		Image::Transition transition{};
+		{
+			transition.newLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
+			transition.srcStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			transition.dstStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+			transition.srcAccess = VK_ACCESS_SHADER_READ_BIT;
+			transition.dstAccess = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			transition.layerCount = layerCount;
+		}
+		m_ShadowMapArrayPtr->MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
+	}
+
+	VkRenderingAttachmentInfo depthAttachment{};
+	{
+		depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+		depthAttachment.imageView = *m_ShadowMapArrayPtr->GetFirstViewPtr();
+		depthAttachment.imageLayout = m_ShadowMapArrayPtr->GetCurrentLayout();
+		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	}
+
+	VkRenderingInfo prepassRenderingInfo{};
+	{
+		prepassRenderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+		prepassRenderingInfo.renderArea = VkRect2D{ VkOffset2D{}, m_ShadowMapArrayPtr->GetExtent() };
+		prepassRenderingInfo.layerCount = layerCount;
+		prepassRenderingInfo.colorAttachmentCount = 0;
+		prepassRenderingInfo.pColorAttachments = nullptr;
+		prepassRenderingInfo.pDepthAttachment = &depthAttachment;
+	}
+
+	vkCmdBeginRendering(*commandBuffer.GetBufferPtr(), &prepassRenderingInfo);
+
+	{
+		VkClearAttachment clearAttachment{};
+		clearAttachment.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		clearAttachment.clearValue.depthStencil = { 1.f, 0 };
+		vkCmdClearAttachments(*commandBuffer.GetBufferPtr(), 1, &clearAttachment, static_cast<uint32_t>(clearRects.size()), clearRects.data());
+
+		VkDescriptorSet descSets[]{ *m_GlobalDescriptorSets[m_CurrentFrame].GetDescriptorSetPtr() };
+		vkCmdBindPipeline(*commandBuffer.GetBufferPtr(), VK_PIPELINE_BIND_POINT_GRAPHICS, *m_ShadowPipelinePtr->GetPipelinePtr());
+		vkCmdBindDescriptorSets(*commandBuffer.GetBufferPtr(), VK_PIPELINE_BIND_POINT_GRAPHICS,
+								*m_ShadowPipelineLayoutPtr->GetPipelineLayoutPtr(), 0, std::size(descSets), descSets, 0, nullptr);
+
+		float colour[4]{ 1.f, .0f, .0f, 1.f };
+		commandBuffer.BeginLabel("Shadow cascades", colour);
+		uint32_t boundMaterial{ UINT32_MAX };
+		for (size_t draw{}; draw < m_ShadowDrawList.GetSize(); ++draw)
+		{
+			// each mesh is submitted once and instanced to every layer it was not culled from
+			const uint32_t meshIndex{ m_ShadowDrawList.GetMeshIndex(draw) };
+			const uint32_t layerMask{ m_ShadowCascadesPtr->GetLayerMask(meshIndex) };
+			if (layerMask == 0)
+				continue;
+
+			Mesh& mesh{ meshes[meshIndex] };
+			VkDeviceSize offsets[] = { 0 };
+
+			vkCmdPushConstants(*commandBuffer.GetBufferPtr(), *m_ShadowPipelineLayoutPtr->GetPipelineLayoutPtr(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(uint32_t), &layerMask);
+			const uint32_t material{ mesh.GetMaterialIndex() };
+			if (material != boundMaterial)
+			{
+				vkCmdPushConstants(*commandBuffer.GetBufferPtr(), *m_ShadowPipelineLayoutPtr->GetPipelineLayoutPtr(), VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(uint32_t), sizeof(uint32_t), &material);
+				boundMaterial = material;
+			}
+
+			vkCmdBindVertexBuffers(*commandBuffer.GetBufferPtr(), 0, 1, mesh.GetVertexBuffer()->GetBufferPtr(), offsets);
+			vkCmdBindIndexBuffer(*commandBuffer.GetBufferPtr(), *mesh.GetIndexBuffer()->GetBufferPtr(), 0, mesh.GetIndexType());
+
+			// instances are layer major, the shader divides the instance index by the layer count to find the mesh instance
+			const datatype::MeshLod& lod{ mesh.GetLods()[m_MeshLods[meshIndex]] };
+			const uint32_t layers{ static_cast<uint32_t>(std::popcount(layerMask)) };
+			vkCmdDrawIndexed(*commandBuffer.GetBufferPtr(), lod.indexCount, mesh.GetInstanceCount() * layers, lod.firstIndex, 0, mesh.GetFirstInstance() * layers);
+		}
+		commandBuffer.EndLabel();
+	}
+
+	vkCmdEndRendering(*commandBuffer.GetBufferPtr());
+
+	{
+		Image::Transition transition{};
+		{
+			transition.newLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
+			transition.srcStage = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+			transition.dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			transition.srcAccess = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			transition.dstAccess = VK_ACCESS_SHADER_READ_BIT;
+			transition.layerCount = layerCount;
+		}
+		m_ShadowMapArrayPtr->MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
+	}
+}
+
+void DynamicRenderingApp::CreateAutoExposure()
+{
+	{
+		std::vector<uint32_t> emptyBins(LUMINANCE_BIN_COUNT);
+		BufferBuilder builder{};
+		builder
+			.BindData(emptyBins.data(), m_CommandPoolPtr.get())
+			.Build(m_LuminanceHistogramPtr, m_DevicePtr.get(), m_CommandPoolPtr.get(), emptyBins.size() * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)*m_LuminanceHistogramPtr->GetBufferPtr(), "Luminance histogram");
+	}
+	{
+		// average luminance, exposure, an average of 0 makes the first frame start from its own measurement
+		float initialExposure[]{ .0f, 1.f };
+		BufferBuilder builder{};
+		builder
+			.BindData(initialExposure, m_CommandPoolPtr.get())
+			.Build(m_ExposurePtr, m_DevicePtr.get(), m_CommandPoolPtr.get(), sizeof(initialExposure), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)*m_ExposurePtr->GetBufferPtr(), "Exposure");
+	}
+
+	m_DeletionQueue.Push(
+		[&]()
+		{
+			m_ExposurePtr->Destroy(m_DevicePtr.get());
+			m_LuminanceHistogramPtr->Destroy(m_DevicePtr.get());
+		});
+
+	{
+		DescriptorSetLayoutBuilder builder{};
+		builder
+			.AddBinding(0, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT) // hdr target
+			.AddBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // histogram
+			.AddBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // exposure
+			.Build(m_AutoExposureSetLayoutPtr, *m_DevicePtr->GetDevicePtr());
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT, (uint64_t)*m_AutoExposureSetLayoutPtr->GetLayoutPtr(), "Auto exposure descriptor set layout");
+
+		m_DeletionQueue.Push([&]() { vkDestroyDescriptorSetLayout(*m_DevicePtr->GetDevicePtr(), *m_AutoExposureSetLayoutPtr->GetLayoutPtr(), nullptr); });
+	}
+
+	{
+		PipelineLayoutBuilder builder{};
+		builder
+			.AddPushConstant(VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(datatype::AutoExposureConstants))
+			.AddDescriptorSetLayout(m_AutoExposureSetLayoutPtr.get())
+			.Build(m_AutoExposurePipelineLayoutPtr, *m_DevicePtr->GetDevicePtr());
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_PIPELINE_LAYOUT, (uint64_t)*m_AutoExposurePipelineLayoutPtr->GetPipelineLayoutPtr(), "Pipeline layout (auto exposure)");
+
+		m_DeletionQueue.Push([&]() { vkDestroyPipelineLayout(*m_DevicePtr->GetDevicePtr(), *m_AutoExposurePipelineLayoutPtr->GetPipelineLayoutPtr(), nullptr); });
+	}
+
+	{
+		// subgroup merging needs ballot in compute, the fallback is one shared atomic per pixel
+		// the ballot variant is a separate module since its capabilities may not be declared without support
+		VkPhysicalDeviceSubgroupProperties subgroupProperties{};
+		subgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+		VkPhysicalDeviceProperties2 properties{};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties.pNext = &subgroupProperties;
+		vkGetPhysicalDeviceProperties2(*m_DevicePtr->GetPhysicalDevicePtr(), &properties);
+
+		const bool useSubgroups{ (subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) && (subgroupProperties.supportedOperations & VK_SUBGROUP_FEATURE_BALLOT_BIT) };
+
+		auto histogramShaderCode{ HELP::ReadFile(useSubgroups ? "shaders\\luminance_histogram_subgroup_comp.spv" : "shaders\\luminance_histogram_comp.spv") };
+		auto averageShaderCode{ HELP::ReadFile("shaders\\luminance_average_comp.spv") };
+
+		ShaderStage histogramShaderStage{ m_DevicePtr.get(), histogramShaderCode, VK_SHADER_STAGE_COMPUTE_BIT };
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_SHADER_MODULE, (uint64_t)histogramShaderStage.GetModule(), "luminance histogram shader module");
+		ShaderStage averageShaderStage{ m_DevicePtr.get(), averageShaderCode, VK_SHADER_STAGE_COMPUTE_BIT };
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_SHADER_MODULE, (uint64_t)averageShaderStage.GetModule(), "luminance average shader module");
+
+		ComputePipelineBuilder builder{};
+		builder
+			.SetShaderStage(histogramShaderStage)
+			.Build(m_LuminanceHistogramPipelinePtr, m_DevicePtr.get(), *m_AutoExposurePipelineLayoutPtr->GetPipelineLayoutPtr());
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_PIPELINE, (uint64_t)*m_LuminanceHistogramPipelinePtr->GetPipelinePtr(), "Pipeline (luminance histogram)");
+		builder
+			.SetShaderStage(averageShaderStage)
+			.Build(m_LuminanceAveragePipelinePtr, m_DevicePtr.get(), *m_AutoExposurePipelineLayoutPtr->GetPipelineLayoutPtr());
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_PIPELINE, (uint64_t)*m_LuminanceAveragePipelinePtr->GetPipelinePtr(), "Pipeline (luminance average)");
+
+		m_DeletionQueue.Push(
+			[&]()
+			{
+				vkDestroyPipeline(*m_DevicePtr->GetDevicePtr(), *m_LuminanceAveragePipelinePtr->GetPipelinePtr(), nullptr);
+				vkDestroyPipeline(*m_DevicePtr->GetDevicePtr(), *m_LuminanceHistogramPipelinePtr->GetPipelinePtr(), nullptr);
+			});
+
+		averageShaderStage.Destroy(m_DevicePtr.get());
+		histogramShaderStage.Destroy(m_DevicePtr.get());
+	}
+
+	// the hdr target is read after lighting moved it to read only
+	DescriptorSetBuilder builder{};
+	builder.Build(m_AutoExposureDescriptorSetPtr, m_DevicePtr.get(), 1, *m_DescriptorPoolPtr->GetDescriptorPoolPtr(), m_AutoExposureSetLayoutPtr->GetLayoutPtr());
+	(*m_AutoExposureDescriptorSetPtr)
+		.AddWriteDescriptorSet(m_HDRRenderTargetPtr.get(), VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, 0, 0)
+		.AddWriteDescriptorSet(m_LuminanceHistogramPtr.get(), 0, 1, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+		.AddWriteDescriptorSet(m_ExposurePtr.get(), 0, 2, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+		.Update(m_DevicePtr.get());
+	m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_DESCRIPTOR_SET, (uint64_t)*m_AutoExposureDescriptorSetPtr->GetDescriptorSetPtr(), "Auto exposure descriptor set");
+}
+
+void DynamicRenderingApp::RecordAutoExposure(CommandBuffer& commandBuffer)
+{
+	m_GPUProfilerPtr->BeginPass(&commandBuffer, "auto exposure");
+
+	const VkExtent2D extent{ GetRenderExtent() };
+	const datatype::AutoExposureConstants constants{ MIN_LOG_LUMINANCE, LOG_LUMINANCE_RANGE, 1.f - std::exp(-WorldTime::GetElapsedSec() * EXPOSURE_ADAPTATION_SPEED), extent.width * extent.height, glm::uvec2{ extent.width, extent.height } };
+
+	vkCmdBindDescriptorSets(*commandBuffer.GetBufferPtr(), VK_PIPELINE_BIND_POINT_COMPUTE, *m_AutoExposurePipelineLayoutPtr->GetPipelineLayoutPtr(), 0, 1, m_AutoExposureDescriptorSetPtr->GetDescriptorSetPtr(), 0, nullptr);
+	vkCmdPushConstants(*commandBuffer.GetBufferPtr(), *m_AutoExposurePipelineLayoutPtr->GetPipelineLayoutPtr(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+
+	// the reduction of the previous frame cleared the histogram
+	{
+		Buffer::Barrier barrier{};
+		{
+			barrier.srcStage	= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			barrier.dstStage	= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			barrier.srcAccess	= VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.dstAccess	= VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		}
+		m_LuminanceHistogramPtr->MakeBarrier(&commandBuffer, barrier);
+	}
+
+	vkCmdBindPipeline(*commandBuffer.GetBufferPtr(), VK_PIPELINE_BIND_POINT_COMPUTE, *m_LuminanceHistogramPipelinePtr->GetPipelinePtr());
+	vkCmdDispatch(*commandBuffer.GetBufferPtr(), (extent.width + 15) / 16, (extent.height + 15) / 16, 1);
+
+	{
+		Buffer::Barrier barrier{};
+		{
+			barrier.srcStage	= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			barrier.dstStage	= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			barrier.srcAccess	= VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.dstAccess	= VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		}
+		m_LuminanceHistogramPtr->MakeBarrier(&commandBuffer, barrier);
+	}
+	// tonemapping of the previous frame may still read the exposure
+	{
+		Buffer::Barrier barrier{};
+		{
+			barrier.srcStage	= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			barrier.dstStage	= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			barrier.srcAccess	= VK_ACCESS_SHADER_READ_BIT;
+			barrier.dstAccess	= VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		}
+		m_ExposurePtr->MakeBarrier(&commandBuffer, barrier);
+	}
+
+	vkCmdBindPipeline(*commandBuffer.GetBufferPtr(), VK_PIPELINE_BIND_POINT_COMPUTE, *m_LuminanceAveragePipelinePtr->GetPipelinePtr());
+	vkCmdDispatch(*commandBuffer.GetBufferPtr(), 1, 1, 1);
+
+	{
+		Buffer::Barrier barrier{};
+		{
+			barrier.srcStage	= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			barrier.dstStage	= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			barrier.srcAccess	= VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.dstAccess	= VK_ACCESS_SHADER_READ_BIT;
+		}
+		m_ExposurePtr->MakeBarrier(&commandBuffer, barrier);
+	}
+
+	m_GPUProfilerPtr->EndPass(&commandBuffer);
+}
+
+void DynamicRenderingApp::CreateLightingCache()
+{
+	// bound even without the cache so the frame set stays complete, lighting never touches them then
+	{
+		BufferBuilder builder{};
+		builder
+			.MapMemory()
+			.Build(m_LightingCacheStatisticsBuffers, m_DevicePtr.get(), m_CommandPoolPtr.get(), MAX_FRAMES_IN_FLIGHT, sizeof(datatype::LightingCacheStatistics), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+				   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+		for (Buffer& buffer : m_LightingCacheStatisticsBuffers)
+		{
+			const datatype::LightingCacheStatistics statistics{};
+			buffer.UpdateMappedData(&statistics, sizeof(statistics), 0);
+			m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)*buffer.GetBufferPtr(), "Lighting cache statistics");
+		}
+
+		m_DeletionQueue.Push(
+			[&]()
+			{
+				for (Buffer& buffer : m_LightingCacheStatisticsBuffers)
+					buffer.Destroy(m_DevicePtr.get());
+			});
+	}
+
+	if (!m_Settings.lightingCache)
+		return;
+
+	const VkExtent2D extent{ m_HDRRenderTargetPtr->GetExtent() };
+	{
+		ImageBuilder builder{};
+		builder
+			.SetAspect(VK_IMAGE_ASPECT_COLOR_BIT)
+			.SetFormat(m_HDRRenderTargetPtr->GetFormat())
+			.SetDimensions(extent.width, extent.height)
+			.Build(m_LightingHistoryPtr, m_DevicePtr.get(), m_CommandPoolPtr.get(), VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)*m_LightingHistoryPtr->GetFirstViewPtr(), "Lighting history view");
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE, (uint64_t)*m_LightingHistoryPtr->GetImagePtr(), "Lighting history");
+	}
+
+	{
+		const VkFormat depthFormat{ FindDepthFormat() };
+		const bool hasStencil{ HELP::HasStencilComponent(depthFormat) };
+
+		ImageBuilder builder{};
+		builder
+			.SetAspect(VK_IMAGE_ASPECT_DEPTH_BIT | (hasStencil * VK_IMAGE_ASPECT_STENCIL_BIT))
+			.SetFormat(depthFormat)
+			.SetDimensions(extent.width, extent.height)
+			.Build(m_DepthHistoryPtr, m_DevicePtr.get(), m_CommandPoolPtr.get(), VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)*m_DepthHistoryPtr->GetFirstViewPtr(), "Depth history view");
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE, (uint64_t)*m_DepthHistoryPtr->GetImagePtr(), "Depth history");
+	}
+
+	// contents stay undefined until the first copy, the previous render scale marks them invalid until then
+	{
+		SingleTimeCommand command = m_CommandPoolPtr->AllocateSingleTimeCommand(*m_DevicePtr->GetDevicePtr());
+
+		command.Start();
+
+		Image::Transition transition{};
+		transition.newLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
+		transition.srcAccess = VK_ACCESS_2_NONE;
+		transition.dstAccess = VK_ACCESS_SHADER_READ_BIT;
+		transition.srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		transition.dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		m_LightingHistoryPtr->MakeTransition(m_DevicePtr.get(), &command, transition);
+		m_DepthHistoryPtr->MakeTransition(m_DevicePtr.get(), &command, transition);
+
+		command.End(m_DevicePtr.get());
+	}
+
+	m_DeletionQueue.Push(
+		[&]()
+		{
+			m_DepthHistoryPtr->Destroy(*m_DevicePtr->GetDevicePtr());
+			m_LightingHistoryPtr->Destroy(*m_DevicePtr->GetDevicePtr());
+		});
+}
+
+void DynamicRenderingApp::RecordLightingHistory(CommandBuffer& commandBuffer, VkExtent2D renderExtent, bool computeLighting)
+{
+	m_GPUProfilerPtr->BeginPass(&commandBuffer, "lighting history");
+
+	{
+		Image::Transition transition{};
+		{
+			transition.newLayout	= VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			transition.srcStage		= computeLighting ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+			transition.dstStage		= VK_PIPELINE_STAGE_TRANSFER_BIT;
+			transition.srcAccess	= computeLighting ? VK_ACCESS_SHADER_WRITE_BIT : VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+			transition.dstAccess	= VK_ACCESS_TRANSFER_READ_BIT;
+		}
+		m_HDRRenderTargetPtr->MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
+
+		// depth was only read by lighting
+		transition.srcStage		= computeLighting ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT;
+		transition.srcAccess	= VK_ACCESS_2_NONE;
+		m_DepthTexturePtr->MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
+	}
+
+	{
+		Image::Transition transition{};
+		{
+			transition.newLayout	= VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			transition.srcStage		= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			transition.dstStage		= VK_PIPELINE_STAGE_TRANSFER_BIT;
+			transition.srcAccess	= VK_ACCESS_2_NONE;
+			transition.dstAccess	= VK_ACCESS_TRANSFER_WRITE_BIT;
+		}
+		m_LightingHistoryPtr->MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
+		m_DepthHistoryPtr->MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
+	}
+
+	// the history keeps the size the targets were created with
+	const VkExtent2D historyExtent{ m_LightingHistoryPtr->GetExtent() };
+	VkImageCopy region{};
+	region.srcSubresource	= VkImageSubresourceLayers{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.dstSubresource	= region.srcSubresource;
+	region.extent			= VkExtent3D{ std::min(renderExtent.width, historyExtent.width), std::min(renderExtent.height, historyExtent.height), 1 };
+	vkCmdCopyImage(*commandBuffer.GetBufferPtr(), *m_HDRRenderTargetPtr->GetImagePtr(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, *m_LightingHistoryPtr->GetImagePtr(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+	region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+	region.dstSubresource.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+	vkCmdCopyImage(*commandBuffer.GetBufferPtr(), *m_DepthTexturePtr->GetImagePtr(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, *m_DepthHistoryPtr->GetImagePtr(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+	{
+		Image::Transition transition{};
+		{
+			transition.newLayout	= VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
+			transition.srcStage		= VK_PIPELINE_STAGE_TRANSFER_BIT;
+			transition.dstStage		= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			transition.srcAccess	= VK_ACCESS_TRANSFER_WRITE_BIT;
+			transition.dstAccess	= VK_ACCESS_SHADER_READ_BIT;
+		}
+		m_LightingHistoryPtr->MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
+		m_DepthHistoryPtr->MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
+	}
+
+	if (m_Settings.cacheValidation)
+	{
+		Buffer::Barrier barrier{};
+		{
+			barrier.srcStage	= computeLighting ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			barrier.dstStage	= VK_PIPELINE_STAGE_HOST_BIT;
+			barrier.srcAccess	= VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.dstAccess	= VK_ACCESS_HOST_READ_BIT;
+		}
+		m_LightingCacheStatisticsBuffers[m_CurrentFrame].MakeBarrier(&commandBuffer, barrier);
+	}
+
+	m_GPUProfilerPtr->EndPass(&commandBuffer);
+}
+
+void DynamicRenderingApp::CreateOcclusionCulling()
+{
+	std::vector<Mesh>& meshes{ m_ScenePtr->GetMeshes() };
+	const uint32_t meshCount{ static_cast<uint32_t>(meshes.size()) };
+
+	{
+		std::vector<datatype::MeshCullData> cullData{};
+		cullData.reserve(meshCount);
+		for (Mesh& mesh : meshes)
+			cullData.push_back(datatype::MeshCullData{ mesh.GetAABBMin(), mesh.GetLods()[0].indexCount, mesh.GetAABBMax(), mesh.GetLods()[0].firstIndex, mesh.GetFirstInstance(), mesh.GetInstanceCount() });
+
+		// the index range is rewritten every frame with the selected level
+		BufferBuilder builder{};
+		builder
+			.MapMemory()
+			.Build(m_MeshCullDataPtr, m_DevicePtr.get(), m_CommandPoolPtr.get(), cullData.size() * sizeof(datatype::MeshCullData), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+				   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		m_MeshCullDataPtr->UpdateMappedData(cullData.data(), cullData.size() * sizeof(datatype::MeshCullData), 0);
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)*m_MeshCullDataPtr->GetBufferPtr(), "Mesh cull data");
+	}
+	{
+		// written by the cull before every use
+		BufferBuilder builder{};
+		builder.Build(m_DrawCommandsPtr, m_DevicePtr.get(), m_CommandPoolPtr.get(), static_cast<size_t>(DrawSection::Count) * meshCount * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)*m_DrawCommandsPtr->GetBufferPtr(), "Indirect draw commands");
+	}
+	{
+		// everything counts as visible before the first frame, so the first early prepass draws the whole frustum
+		std::vector<uint32_t> visibility(meshCount, 1);
+		BufferBuilder builder{};
+		builder
+			.BindData(visibility.data(), m_CommandPoolPtr.get())
+			.Build(m_MeshVisibilityPtr, m_DevicePtr.get(), m_CommandPoolPtr.get(), visibility.size() * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)*m_MeshVisibilityPtr->GetBufferPtr(), "Mesh visibility");
+	}
+	{
+		BufferBuilder builder{};
+		builder
+			.MapMemory()
+			.Build(m_OcclusionStatisticsPtr, m_DevicePtr.get(), m_CommandPoolPtr.get(), sizeof(datatype::OcclusionStatistics), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+				   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)*m_OcclusionStatisticsPtr->GetBufferPtr(), "Occlusion statistics");
+	}
+	// the cluster buffers complete the set even when only meshes are culled
+	{
+		std::vector<datatype::Meshlet> meshlets{};
+		m_FirstMeshlets.clear();
+		for (Mesh& mesh : meshes)
+		{
+			const uint32_t firstMeshMeshlet{ static_cast<uint32_t>(meshlets.size()) };
+			m_FirstMeshlets.push_back(firstMeshMeshlet);
+			for (datatype::Meshlet meshlet : mesh.GetMeshlets())
+			{
+				meshlet.firstMeshMeshlet = firstMeshMeshlet;
+				meshlets.push_back(meshlet);
+			}
+		}
+		m_MeshletCount = static_cast<uint32_t>(meshlets.size());
+		if (meshlets.empty())
+			meshlets.push_back(datatype::Meshlet{});
+
+		BufferBuilder builder{};
+		builder
+			.BindData(meshlets.data(), m_CommandPoolPtr.get())
+			.Build(m_MeshletsPtr, m_DevicePtr.get(), m_CommandPoolPtr.get(), meshlets.size() * sizeof(datatype::Meshlet), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)*m_MeshletsPtr->GetBufferPtr(), "Meshlets");
+	}
+	{
+		BufferBuilder builder{};
+		builder.Build(m_ClusterCommandsPtr, m_DevicePtr.get(), m_CommandPoolPtr.get(), std::max(m_MeshletCount, 1u) * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)*m_ClusterCommandsPtr->GetBufferPtr(), "Cluster draw commands");
+	}
+	{
+		// cleared before every cluster cull
+		BufferBuilder builder{};
+		builder.Build(m_ClusterCountsPtr, m_DevicePtr.get(), m_CommandPoolPtr.get(), meshCount * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)*m_ClusterCountsPtr->GetBufferPtr(), "Cluster draw counts");
+	}
+
+	m_DeletionQueue.Push(
+		[&]()
+		{
+			m_ClusterCountsPtr->Destroy(m_DevicePtr.get());
+			m_ClusterCommandsPtr->Destroy(m_DevicePtr.get());
+			m_MeshletsPtr->Destroy(m_DevicePtr.get());
+			m_OcclusionStatisticsPtr->Destroy(m_DevicePtr.get());
+			m_MeshVisibilityPtr->Destroy(m_DevicePtr.get());
+			m_DrawCommandsPtr->Destroy(m_DevicePtr.get());
+			m_MeshCullDataPtr->Destroy(m_DevicePtr.get());
+		});
+
+	// rounded down so every level halves exactly, level 0 reduces up to 3x3 depth texels instead
+	const VkExtent2D targetExtent{ m_HDRRenderTargetPtr->GetExtent() };
+	const uint32_t pyramidWidth{ std::bit_floor(targetExtent.width) };
+	const uint32_t pyramidHeight{ std::bit_floor(targetExtent.height) };
+	const uint32_t levelCount{ static_cast<uint32_t>(std::bit_width(std::max(pyramidWidth, pyramidHeight))) };
+	{
+		ImageBuilder builder{};
+		builder
+			.SetAspect(VK_IMAGE_ASPECT_COLOR_BIT)
+			.SetFormat(DEPTH_PYRAMID_FORMAT)
+			.SetDimensions(pyramidWidth, pyramidHeight)
+			.SetMipLevels(levelCount)
+			.Build(m_DepthPyramidPtr, m_DevicePtr.get(), m_CommandPoolPtr.get(), VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)*m_DepthPyramidPtr->GetFirstViewPtr(), "Depth pyramid view");
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE, (uint64_t)*m_DepthPyramidPtr->GetImagePtr(), "Depth pyramid");
+
+		m_DepthPyramidLevelViews.resize(levelCount);
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = *m_DepthPyramidPtr->GetImagePtr();
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = DEPTH_PYRAMID_FORMAT;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.layerCount = 1;
+		for (uint32_t level{}; level < levelCount; ++level)
+		{
+			viewInfo.subresourceRange.baseMipLevel = level;
+			if (vkCreateImageView(*m_DevicePtr->GetDevicePtr(), &viewInfo, nullptr, &m_DepthPyramidLevelViews[level]) != VK_SUCCESS)
+				throw std::runtime_error("failed to create depth pyramid level view");
+		}
+
+		// reduction and culling both run in compute, the pyramid never leaves the general layout
+		SingleTimeCommand command = m_CommandPoolPtr->AllocateSingleTimeCommand(*m_DevicePtr->GetDevicePtr());
+
+		command.Start();
+
+		Image::Transition transition{};
+		transition.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		transition.srcAccess = VK_ACCESS_2_NONE;
+		transition.dstAccess = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		transition.srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		transition.dstStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		m_DepthPyramidPtr->MakeTransition(m_DevicePtr.get(), &command, transition);
+
+		command.End(m_DevicePtr.get());
+	}
+
+	m_DeletionQueue.Push(
+		[&]()
+		{
+			for (VkImageView view : m_DepthPyramidLevelViews)
+				vkDestroyImageView(*m_DevicePtr->GetDevicePtr(), view, nullptr);
+			m_DepthPyramidPtr->Destroy(*m_DevicePtr->GetDevicePtr());
+		});
+
+	{
+		DescriptorSetLayoutBuilder builder{};
+		builder
+			.AddBinding(0, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT) // depth
+			.AddBinding(1, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT) // pyramid
+			.AddBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, levelCount) // pyramid levels
+			.AddBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // mesh cull data
+			.AddBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // draw commands
+			.AddBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // visibility
+			.AddBinding(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // statistics
+			.AddBinding(7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // meshlets
+			.AddBinding(8, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // cluster draw commands
+			.AddBinding(9, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // cluster draw counts
+			.AddBinding(11, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // instance transforms, same binding as the global set
+			.Build(m_OcclusionSetLayoutPtr, *m_DevicePtr->GetDevicePtr());
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT, (uint64_t)*m_OcclusionSetLayoutPtr->GetLayoutPtr(), "Occlusion culling descriptor set layout");
+
+		m_DeletionQueue.Push([&]() { vkDestroyDescriptorSetLayout(*m_DevicePtr->GetDevicePtr(), *m_OcclusionSetLayoutPtr->GetLayoutPtr(), nullptr); });
+	}
+
+	{
+		PipelineLayoutBuilder builder{};
+		builder
+			.AddPushConstant(VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(datatype::OcclusionCullingConstants))
+			.AddDescriptorSetLayout(m_OcclusionSetLayoutPtr.get())
+			.Build(m_OcclusionPipelineLayoutPtr, *m_DevicePtr->GetDevicePtr());
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_PIPELINE_LAYOUT, (uint64_t)*m_OcclusionPipelineLayoutPtr->GetPipelineLayoutPtr(), "Pipeline layout (occlusion culling)");
+
+		m_DeletionQueue.Push([&]() { vkDestroyPipelineLayout(*m_DevicePtr->GetDevicePtr(), *m_OcclusionPipelineLayoutPtr->GetPipelineLayoutPtr(), nullptr); });
+	}
+
+	{
+		auto pyramidShaderCode{ HELP::ReadFile("shaders\\depth_pyramid_comp.spv") };
+		auto cullShaderCode{ HELP::ReadFile("shaders\\occlusion_cull_comp.spv") };
+
+		// level count
+		uint32_t pyramidConstants[]{ levelCount };
+
+		ShaderStage pyramidShaderStage{ m_DevicePtr.get(), pyramidShaderCode, VK_SHADER_STAGE_COMPUTE_BIT };
+		pyramidShaderStage.AddSpecialization(sizeof(uint32_t), std::size(pyramidConstants), static_cast<void*>(pyramidConstants));
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_SHADER_MODULE, (uint64_t)pyramidShaderStage.GetModule(), "depth pyramid shader module");
+		ShaderStage cullShaderStage{ m_DevicePtr.get(), cullShaderCode, VK_SHADER_STAGE_COMPUTE_BIT };
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_SHADER_MODULE, (uint64_t)cullShaderStage.GetModule(), "occlusion cull shader module");
+
+		ComputePipelineBuilder builder{};
+		builder
+			.SetShaderStage(pyramidShaderStage)
+			.Build(m_DepthPyramidPipelinePtr, m_DevicePtr.get(), *m_OcclusionPipelineLayoutPtr->GetPipelineLayoutPtr());
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_PIPELINE, (uint64_t)*m_DepthPyramidPipelinePtr->GetPipelinePtr(), "Pipeline (depth pyramid)");
+
+		// phase
+		uint32_t phase{};
+		cullShaderStage.AddSpecialization(sizeof(uint32_t), 1, &phase);
+		builder
+			.SetShaderStage(cullShaderStage)
+			.Build(m_EarlyCullPipelinePtr, m_DevicePtr.get(), *m_OcclusionPipelineLayoutPtr->GetPipelineLayoutPtr());
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_PIPELINE, (uint64_t)*m_EarlyCullPipelinePtr->GetPipelinePtr(), "Pipeline (early occlusion cull)");
+
+		phase = 1;
+		cullShaderStage.AddSpecialization(sizeof(uint32_t), 1, &phase);
+		builder
+			.SetShaderStage(cullShaderStage)
+			.Build(m_LateCullPipelinePtr, m_DevicePtr.get(), *m_OcclusionPipelineLayoutPtr->GetPipelineLayoutPtr());
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_PIPELINE, (uint64_t)*m_LateCullPipelinePtr->GetPipelinePtr(), "Pipeline (late occlusion cull)");
+
+		m_DeletionQueue.Push(
+			[&]()
+			{
+				vkDestroyPipeline(*m_DevicePtr->GetDevicePtr(), *m_LateCullPipelinePtr->GetPipelinePtr(), nullptr);
+				vkDestroyPipeline(*m_DevicePtr->GetDevicePtr(), *m_EarlyCullPipelinePtr->GetPipelinePtr(), nullptr);
+				vkDestroyPipeline(*m_DevicePtr->GetDevicePtr(), *m_DepthPyramidPipelinePtr->GetPipelinePtr(), nullptr);
+			});
+
+		cullShaderStage.Destroy(m_DevicePtr.get());
+		pyramidShaderStage.Destroy(m_DevicePtr.get());
+	}
+
+	if (m_Settings.clusterCulling)
+	{
+		auto shaderCode{ HELP::ReadFile("shaders\\cluster_cull_comp.spv") };
+		ShaderStage shaderStage{ m_DevicePtr.get(), shaderCode, VK_SHADER_STAGE_COMPUTE_BIT };
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_SHADER_MODULE, (uint64_t)shaderStage.GetModule(), "cluster cull shader module");
+
+		ComputePipelineBuilder builder{};
+		builder
+			.SetShaderStage(shaderStage)
+			.Build(m_ClusterCullPipelinePtr, m_DevicePtr.get(), *m_OcclusionPipelineLayoutPtr->GetPipelineLayoutPtr());
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_PIPELINE, (uint64_t)*m_ClusterCullPipelinePtr->GetPipelinePtr(), "Pipeline (cluster cull)");
+
+		m_DeletionQueue.Push([&]() { vkDestroyPipeline(*m_DevicePtr->GetDevicePtr(), *m_ClusterCullPipelinePtr->GetPipelinePtr(), nullptr); });
+
+		shaderStage.Destroy(m_DevicePtr.get());
+	}
+
+	{
+		DescriptorPoolBuilder builder{};
+		builder
+			.AddPoolSize(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 2) // depth and pyramid
+			.AddPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, levelCount) // pyramid levels
+			.AddPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 8) // cull data, draws, visibility, statistics, the cluster buffers and instance transforms
+			.Build(m_OcclusionDescriptorPoolPtr, m_DevicePtr.get(), 1);
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_DESCRIPTOR_POOL, (uint64_t)*m_OcclusionDescriptorPoolPtr->GetDescriptorPoolPtr(), "Occlusion culling descriptor pool");
+
+		m_DeletionQueue.Push([&]() { m_OcclusionDescriptorPoolPtr->Destroy(*m_DevicePtr->GetDevicePtr()); });
+	}
+
+	// depth is read after the early prepass moved it to read only
+	DescriptorSetBuilder builder{};
+	builder.Build(m_OcclusionDescriptorSetPtr, m_DevicePtr.get(), 1, *m_OcclusionDescriptorPoolPtr->GetDescriptorPoolPtr(), m_OcclusionSetLayoutPtr->GetLayoutPtr());
+	(*m_OcclusionDescriptorSetPtr)
+		.AddWriteDescriptorSet(m_DepthTexturePtr.get(), VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, 0, 0)
+		.AddWriteDescriptorSet(m_DepthPyramidPtr.get(), VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_GENERAL, 1, 0);
+	for (uint32_t level{}; level < levelCount; ++level)
+		m_OcclusionDescriptorSetPtr->AddWriteDescriptorSet(m_DepthPyramidLevelViews[level], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL, 2, level);
+	(*m_OcclusionDescriptorSetPtr)
+		.AddWriteDescriptorSet(m_MeshCullDataPtr.get(), 0, 3, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+		.AddWriteDescriptorSet(m_DrawCommandsPtr.get(), 0, 4, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+		.AddWriteDescriptorSet(m_MeshVisibilityPtr.get(), 0, 5, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+		.AddWriteDescriptorSet(m_OcclusionStatisticsPtr.get(), 0, 6, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+		.AddWriteDescriptorSet(m_MeshletsPtr.get(), 0, 7, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+		.AddWriteDescriptorSet(m_ClusterCommandsPtr.get(), 0, 8, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+		.AddWriteDescriptorSet(m_ClusterCountsPtr.get(), 0, 9, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+		.AddWriteDescriptorSet(m_ScenePtr->GetInstanceBuffer(), 0, 11, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+		.Update(m_DevicePtr.get());
+	m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_DESCRIPTOR_SET, (uint64_t)*m_OcclusionDescriptorSetPtr->GetDescriptorSetPtr(), "Occlusion culling descriptor set");
+}
+
+void DynamicRenderingApp::RecordEarlyOcclusionCull(CommandBuffer& commandBuffer)
+{
+	const uint32_t meshCount{ static_cast<uint32_t>(m_ScenePtr->GetMeshes().size()) };
+	const datatype::OcclusionCullingConstants constants{ m_CameraPtr->GetProjection() * m_CameraPtr->CalculateView(), glm::uvec2{}, 0, meshCount, m_CameraPtr->GetPosition(), m_MeshletCount };
+
+	// the gbuffer of the previous frame still draws from the commands and its late cull wrote the visibility
+	{
+		Buffer::Barrier barrier{};
+		{
+			barrier.srcStage	= VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+			barrier.dstStage	= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			barrier.srcAccess	= VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+			barrier.dstAccess	= VK_ACCESS_SHADER_WRITE_BIT;
+		}
+		m_DrawCommandsPtr->MakeBarrier(&commandBuffer, barrier);
+	}
+	{
+		Buffer::Barrier barrier{};
+		{
+			barrier.srcStage	= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			barrier.dstStage	= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			barrier.srcAccess	= VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.dstAccess	= VK_ACCESS_SHADER_READ_BIT;
+		}
+		m_MeshVisibilityPtr->MakeBarrier(&commandBuffer, barrier);
+	}
+
+	vkCmdBindPipeline(*commandBuffer.GetBufferPtr(), VK_PIPELINE_BIND_POINT_COMPUTE, *m_EarlyCullPipelinePtr->GetPipelinePtr());
+	vkCmdBindDescriptorSets(*commandBuffer.GetBufferPtr(), VK_PIPELINE_BIND_POINT_COMPUTE, *m_OcclusionPipelineLayoutPtr->GetPipelineLayoutPtr(), 0, 1, m_OcclusionDescriptorSetPtr->GetDescriptorSetPtr(), 0, nullptr);
+	vkCmdPushConstants(*commandBuffer.GetBufferPtr(), *m_OcclusionPipelineLayoutPtr->GetPipelineLayoutPtr(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+	vkCmdDispatch(*commandBuffer.GetBufferPtr(), (meshCount + 63) / 64, 1, 1);
+
+	{
+		Buffer::Barrier barrier{};
+		{
+			barrier.srcStage	= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			barrier.dstStage	= VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+			barrier.srcAccess	= VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.dstAccess	= VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		}
+		m_DrawCommandsPtr->MakeBarrier(&commandBuffer, barrier);
+	}
+}
+
+void DynamicRenderingApp::RecordLateOcclusionCull(CommandBuffer& commandBuffer, VkExtent2D renderExtent)
+{
+	const uint32_t meshCount{ static_cast<uint32_t>(m_ScenePtr->GetMeshes().size()) };
+	datatype::OcclusionCullingConstants constants{ m_CameraPtr->GetProjection() * m_CameraPtr->CalculateView(), glm::uvec2{ renderExtent.width, renderExtent.height }, 0, meshCount, m_CameraPtr->GetPosition(), m_MeshletCount };
+
+	{
+		Image::Transition transition{};
+		{
+			transition.newLayout	= VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
+			transition.srcStage		= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+			transition.dstStage		= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			transition.srcAccess	= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			transition.dstAccess	= VK_ACCESS_SHADER_READ_BIT;
+		}
+		m_DepthTexturePtr->MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
+	}
+	// the late cull of the previous frame read every level
+	{
+		Image::Transition transition{};
+		{
+			transition.newLayout	= VK_IMAGE_LAYOUT_GENERAL;
+			transition.srcStage		= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			transition.dstStage		= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			transition.srcAccess	= VK_ACCESS_SHADER_READ_BIT;
+			transition.dstAccess	= VK_ACCESS_SHADER_WRITE_BIT;
+		}
+		m_DepthPyramidPtr->MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
+	}
+
+	vkCmdBindPipeline(*commandBuffer.GetBufferPtr(), VK_PIPELINE_BIND_POINT_COMPUTE, *m_DepthPyramidPipelinePtr->GetPipelinePtr());
+	vkCmdBindDescriptorSets(*commandBuffer.GetBufferPtr(), VK_PIPELINE_BIND_POINT_COMPUTE, *m_OcclusionPipelineLayoutPtr->GetPipelineLayoutPtr(), 0, 1, m_OcclusionDescriptorSetPtr->GetDescriptorSetPtr(), 0, nullptr);
+
+	// every level reads the one written before it
+	const VkExtent2D pyramidExtent{ m_DepthPyramidPtr->GetExtent() };
+	for (uint32_t level{}; level < m_DepthPyramidPtr->GetMipLevels(); ++level)
+	{
+		constants.level = level;
+		const uint32_t levelWidth{ std::max(pyramidExtent.width >> level, 1u) };
+		const uint32_t levelHeight{ std::max(pyramidExtent.height >> level, 1u) };
+		vkCmdPushConstants(*commandBuffer.GetBufferPtr(), *m_OcclusionPipelineLayoutPtr->GetPipelineLayoutPtr(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+		vkCmdDispatch(*commandBuffer.GetBufferPtr(), (levelWidth + 7) / 8, (levelHeight + 7) / 8, 1);
+
+		Image::Transition transition{};
+		{
+			transition.newLayout	= VK_IMAGE_LAYOUT_GENERAL;
+			transition.srcStage		= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			transition.dstStage		= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			transition.srcAccess	= VK_ACCESS_SHADER_WRITE_BIT;
+			transition.dstAccess	= VK_ACCESS_SHADER_READ_BIT;
+			transition.levelCount	= 1;
+			transition.baseMipLevel	= level;
+		}
+		m_DepthPyramidPtr->MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
+	}
+
+	vkCmdFillBuffer(*commandBuffer.GetBufferPtr(), *m_OcclusionStatisticsPtr->GetBufferPtr(), 0, VK_WHOLE_SIZE, 0);
+	{
+		Buffer::Barrier barrier{};
 		{
-			Image::Transition transition{};
+			barrier.srcStage	= VK_PIPELINE_STAGE_TRANSFER_BIT;
+			barrier.dstStage	= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			barrier.srcAccess	= VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccess	= VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		}
+		m_OcclusionStatisticsPtr->MakeBarrier(&commandBuffer, barrier);
+	}
+	if (m_Settings.clusterCulling)
+	{
+		// the g-buffer of the previous frame drew with the counts
+		{
+			Buffer::Barrier barrier{};
 			{
-				transition.newLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
-				transition.srcStage = VK_PIPELINE_STAGE_2_NONE;
-				transition.dstStage = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT;
-				transition.srcAccess = VK_ACCESS_2_NONE;
-				transition.dstAccess = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;;
+				barrier.srcStage	= VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+				barrier.dstStage	= VK_PIPELINE_STAGE_TRANSFER_BIT;
+				barrier.srcAccess	= VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+				barrier.dstAccess	= VK_ACCESS_TRANSFER_WRITE_BIT;
 			}
-			shadowDepthMap.MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
+			m_ClusterCountsPtr->MakeBarrier(&commandBuffer, barrier);
 		}
-
-		// shadow depth prepass
+		vkCmdFillBuffer(*commandBuffer.GetBufferPtr(), *m_ClusterCountsPtr->GetBufferPtr(), 0, VK_WHOLE_SIZE, 0);
 		{
-			VkRenderingAttachmentInfo depthAttachment{};
+			Buffer::Barrier barrier{};
 			{
-				VkClearValue depthClearValue{};
-				depthClearValue.depthStencil = { 1.f, 0 };
-
-				depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
-				depthAttachment.imageView = *shadowDepthMap.GetFirstViewPtr();
-				depthAttachment.imageLayout = shadowDepthMap.GetCurrentLayout();
-				depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-				depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-				depthAttachment.clearValue = depthClearValue;
+				barrier.srcStage	= VK_PIPELINE_STAGE_TRANSFER_BIT;
+				barrier.dstStage	= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+				barrier.srcAccess	= VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.dstAccess	= VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
 			}
-
-			VkRenderingInfo prepassRenderingInfo{};
+			m_ClusterCountsPtr->MakeBarrier(&commandBuffer, barrier);
+		}
+		{
+			Buffer::Barrier barrier{};
 			{
-				prepassRenderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
-				prepassRenderingInfo.renderArea = VkRect2D{ VkOffset2D{}, shadowDepthMap.GetExtent() };
-				prepassRenderingInfo.layerCount = 1;
-				prepassRenderingInfo.colorAttachmentCount = 0;
-				prepassRenderingInfo.pColorAttachments = nullptr;
-				prepassRenderingInfo.pDepthAttachment = &depthAttachment;
+				barrier.srcStage	= VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+				barrier.dstStage	= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+				barrier.srcAccess	= VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+				barrier.dstAccess	= VK_ACCESS_SHADER_WRITE_BIT;
 			}
+			m_ClusterCommandsPtr->MakeBarrier(&commandBuffer, barrier);
+		}
+	}
+	// the early prepass drew from its own section, the late cull only writes the other two
+	{
+		Buffer::Barrier barrier{};
+		{
+			barrier.srcStage	= VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+			barrier.dstStage	= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			barrier.srcAccess	= VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+			barrier.dstAccess	= VK_ACCESS_SHADER_WRITE_BIT;
+		}
+		m_DrawCommandsPtr->MakeBarrier(&commandBuffer, barrier);
+	}
 
-			vkCmdBeginRendering(*commandBuffer.GetBufferPtr(), &prepassRenderingInfo);
-			 
-			{
-				VkDescriptorSet descSets[]{ *m_GlobalDescriptorSets[m_CurrentFrame].GetDescriptorSetPtr() };
-				vkCmdBindPipeline(*commandBuffer.GetBufferPtr(), VK_PIPELINE_BIND_POINT_GRAPHICS, *pipeline.GetPipelinePtr());
-				vkCmdBindDescriptorSets(*commandBuffer.GetBufferPtr(), VK_PIPELINE_BIND_POINT_GRAPHICS,
-										*pipelineLayout.GetPipelineLayoutPtr(), 0, std::size(descSets), descSets, 0, nullptr);
-
-				std::vector<Mesh>& meshes{ m_ScenePtr->GetMeshes() };
-				glm::mat4 model{ m_ScenePtr->GetModelMatrix() };
-				float colour[4]{ 1.f, .0f, .0f, 1.f };
-				commandBuffer.BeginLabel("Shadow prepass", colour);
-				vkCmdPushConstants(*commandBuffer.GetBufferPtr(), *pipelineLayout.GetPipelineLayoutPtr(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &model);
-				vkCmdPushConstants(*commandBuffer.GetBufferPtr(), *pipelineLayout.GetPipelineLayoutPtr(), VK_SHADER_STAGE_VERTEX_BIT, sizeof(glm::mat4), sizeof(uint32_t), &index);
-				for (Mesh& mesh : meshes)
-				{
-					VkDeviceSize offsets[] = { 0 };
-
-					vkCmdPushConstants(*commandBuffer.GetBufferPtr(), *pipelineLayout.GetPipelineLayoutPtr(), VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(glm::mat4) + sizeof(uint32_t), sizeof(datatype::TextureIndices), mesh.GetTextureIndices());
+	vkCmdBindPipeline(*commandBuffer.GetBufferPtr(), VK_PIPELINE_BIND_POINT_COMPUTE, *m_LateCullPipelinePtr->GetPipelinePtr());
+	vkCmdDispatch(*commandBuffer.GetBufferPtr(), (meshCount + 63) / 64, 1, 1);
 
-					vkCmdBindVertexBuffers(*commandBuffer.GetBufferPtr(), 0, 1, mesh.GetVertexBuffer()->GetBufferPtr(), offsets);
-					vkCmdBindIndexBuffer(*commandBuffer.GetBufferPtr(), *mesh.GetIndexBuffer()->GetBufferPtr(), 0, VK_INDEX_TYPE_UINT32);
+	{
+		Buffer::Barrier barrier{};
+		{
+			barrier.srcStage	= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			barrier.dstStage	= VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+			barrier.srcAccess	= VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.dstAccess	= VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		}
+		m_DrawCommandsPtr->MakeBarrier(&commandBuffer, barrier);
+	}
 
-					vkCmdDrawIndexed(*commandBuffer.GetBufferPtr(), static_cast<uint32_t>(mesh.GetIndexBuffer()->GetSize() / sizeof(uint32_t)), 1, 0, 0, 0);
-				}
-				commandBuffer.EndLabel();
+	// clusters of the meshes the late cull kept, against the same pyramid
+	if (m_Settings.clusterCulling)
+	{
+		{
+			Buffer::Barrier barrier{};
+			{
+				barrier.srcStage	= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+				barrier.dstStage	= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+				barrier.srcAccess	= VK_ACCESS_SHADER_WRITE_BIT;
+				barrier.dstAccess	= VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
 			}
+			m_MeshVisibilityPtr->MakeBarrier(&commandBuffer, barrier);
+			m_OcclusionStatisticsPtr->MakeBarrier(&commandBuffer, barrier);
+		}
 
-			vkCmdEndRendering(*commandBuffer.GetBufferPtr());
+		vkCmdBindPipeline(*commandBuffer.GetBufferPtr(), VK_PIPELINE_BIND_POINT_COMPUTE, *m_ClusterCullPipelinePtr->GetPipelinePtr());
+		vkCmdDispatch(*commandBuffer.GetBufferPtr(), (m_MeshletCount + 63) / 64, 1, 1);
+
+		Buffer::Barrier barrier{};
+		{
+			barrier.srcStage	= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			barrier.dstStage	= VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+			barrier.srcAccess	= VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.dstAccess	= VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		}
+		m_ClusterCommandsPtr->MakeBarrier(&commandBuffer, barrier);
+		m_ClusterCountsPtr->MakeBarrier(&commandBuffer, barrier);
+	}
+	{
+		Buffer::Barrier barrier{};
+		{
+			barrier.srcStage	= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			barrier.dstStage	= VK_PIPELINE_STAGE_HOST_BIT;
+			barrier.srcAccess	= VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.dstAccess	= VK_ACCESS_HOST_READ_BIT;
 		}
+		m_OcclusionStatisticsPtr->MakeBarrier(&commandBuffer, barrier);
+	}
 
+	// the late prepass adds the meshes that became visible
+	{
+		Image::Transition transition{};
 		{
-			Image::Transition transition{};
-			{
-				transition.newLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
-				transition.srcStage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
-				transition.dstStage = VK_PIPELINE_STAGE_2_NONE;
-				transition.srcAccess = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
-				transition.dstAccess = VK_ACCESS_2_NONE;;
-			}
-			shadowDepthMap.MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
+			transition.newLayout	= VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
+			transition.srcStage		= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			transition.dstStage		= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+			transition.srcAccess	= VK_ACCESS_2_NONE;
+			transition.dstAccess	= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 		}
+		m_DepthTexturePtr->MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
 	}
+}
 
-	commandBuffer.End(m_DevicePtr.get());
+void DynamicRenderingApp::DrawMeshes(CommandBuffer& commandBuffer, VkPipelineLayout pipelineLayout, DrawSection section)
+{
+	std::vector<Mesh>& meshes{ m_ScenePtr->GetMeshes() };
+	const DrawList& drawList{ (section == DrawSection::GBuffer) ? m_GBufferDrawList : m_PrepassDrawList };
+	uint32_t boundMaterial{ UINT32_MAX };
+	for (size_t draw{}; draw < drawList.GetSize(); ++draw)
+	{
+		const uint32_t index{ drawList.GetMeshIndex(draw) };
+		Mesh& mesh{ meshes[index] };
+		VkDeviceSize offsets[] = { 0 };
+
+		// sorted lists keep runs of one material together, the push is skipped within a run
+		const uint32_t material{ mesh.GetMaterialIndex() };
+		if (material != boundMaterial)
+		{
+			vkCmdPushConstants(*commandBuffer.GetBufferPtr(), pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(uint32_t), &material);
+			boundMaterial = material;
+		}
+
+		vkCmdBindVertexBuffers(*commandBuffer.GetBufferPtr(), 0, 1, mesh.GetVertexBuffer()->GetBufferPtr(), offsets);
+		vkCmdBindIndexBuffer(*commandBuffer.GetBufferPtr(), *mesh.GetIndexBuffer()->GetBufferPtr(), 0, mesh.GetIndexType());
+
+		// culled meshes have an instance count of 0
+		if (m_Settings.clusterCulling && section == DrawSection::GBuffer && m_MeshLods[index] == 0 && !mesh.GetMeshlets().empty())
+		{
+			// the count of a culled mesh stays 0
+			const VkDeviceSize commandOffset{ static_cast<VkDeviceSize>(m_FirstMeshlets[index]) * sizeof(VkDrawIndexedIndirectCommand) };
+			const uint32_t meshletCount{ static_cast<uint32_t>(mesh.GetMeshlets().size()) };
+			vkCmdDrawIndexedIndirectCount(*commandBuffer.GetBufferPtr(), *m_ClusterCommandsPtr->GetBufferPtr(), commandOffset, *m_ClusterCountsPtr->GetBufferPtr(), index * sizeof(uint32_t), meshletCount, sizeof(VkDrawIndexedIndirectCommand));
+		}
+		else if (m_Settings.occlusionCulling)
+		{
+			const VkDeviceSize commandOffset{ (static_cast<size_t>(section) * meshes.size() + index) * sizeof(VkDrawIndexedIndirectCommand) };
+			vkCmdDrawIndexedIndirect(*commandBuffer.GetBufferPtr(), *m_DrawCommandsPtr->GetBufferPtr(), commandOffset, 1, sizeof(VkDrawIndexedIndirectCommand));
+		}
+		else
+		{
+			const datatype::MeshLod& lod{ mesh.GetLods()[m_MeshLods[index]] };
+			vkCmdDrawIndexed(*commandBuffer.GetBufferPtr(), lod.indexCount, mesh.GetInstanceCount(), lod.firstIndex, 0, mesh.GetFirstInstance());
+		}
+	}
 }
 
 void DynamicRenderingApp::InitWindow()
@@ -400,12 +2220,15 @@ void DynamicRenderingApp::InitWindow()
 
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE); 
+	// the swapchain still needs a surface, headless only hides it
+	if (m_Settings.headless)
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 	 
 	m_WindowPtr = glfwCreateWindow(WIDTH, HEIGHT, m_AppName.c_str(), nullptr, nullptr);
 	glfwSetWindowUserPointer(m_WindowPtr, this);
 	glfwSetFramebufferSizeCallback(m_WindowPtr, FramebufferResizeCallback);
 
-	//glfwSetKeyCallback(m_WindowPtr, &DynamicRenderingApp::KeyCallback);
+	glfwSetKeyCallback(m_WindowPtr, &DynamicRenderingApp::KeyCallback);
 	//glfwSetCursorPosCallback(m_WindowPtr, &DynamicRenderingApp::MouseMovedCallback);
 
 	m_DeletionQueue.Push([&]() { glfwDestroyWindow(m_WindowPtr); });
@@ -421,7 +2244,7 @@ void DynamicRenderingApp::CreateDepthResources()
 		.SetAspect(VK_IMAGE_ASPECT_DEPTH_BIT | (hasStencil * VK_IMAGE_ASPECT_STENCIL_BIT))
 		.SetFormat(depthFormat)
 		.SetDimensions(m_SwapChainPtr->GetExtentPtr()->width, m_SwapChainPtr->GetExtentPtr()->height)
-		.Build(m_DepthTexturePtr, m_DevicePtr.get(), m_CommandPoolPtr.get(), VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		.Build(m_DepthTexturePtr, m_DevicePtr.get(), m_CommandPoolPtr.get(), VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 	m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)*m_DepthTexturePtr->GetFirstViewPtr(), "Depth image view");
 	m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE, (uint64_t)*m_DepthTexturePtr->GetImagePtr(), "Depth image");
 
@@ -496,11 +2319,26 @@ void DynamicRenderingApp::InitVulkan()
 		VkPhysicalDeviceFeatures deviceFeatures{};
 		deviceFeatures.samplerAnisotropy = VK_TRUE;
 		deviceFeatures.depthBiasClamp = VK_TRUE;
+		// compute lighting writes the hdr target without declaring its format in the shader
+		deviceFeatures.shaderStorageImageWriteWithoutFormat = VK_TRUE;
+		// fragment lighting accumulates lighting cache statistics while validating and the g-buffer writes texture feedback
+		// both shaders always contain the stores, so the device has to support them
+		deviceFeatures.fragmentStoresAndAtomics = VK_TRUE;
+		// cluster culling draws every cluster slot of a mesh in one indirect call
+		VkPhysicalDeviceFeatures optionalFeatures{};
+		optionalFeatures.multiDrawIndirect = VK_TRUE;
+		// the depth pyramid writes the level picked by a push constant out of an array of storage views
+		optionalFeatures.shaderStorageImageArrayDynamicIndexing = VK_TRUE;
 		VkPhysicalDeviceVulkan13Features deviceFeatures13{};
 		deviceFeatures13.dynamicRendering = VK_TRUE;
 		deviceFeatures13.synchronization2 = VK_TRUE;
 		VkPhysicalDeviceVulkan12Features deviceFeatures12{};
 		deviceFeatures12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		// gl_Layer from the vertex stage, renders every shadow layer in one pass
+		deviceFeatures12.shaderOutputLayer = VK_TRUE;
+		// the number of surviving clusters is only known on the gpu
+		VkPhysicalDeviceVulkan12Features optionalFeatures12{};
+		optionalFeatures12.drawIndirectCount = VK_TRUE;
 
 		DeviceBuilder builder{};
 		builder
@@ -508,7 +2346,11 @@ void DynamicRenderingApp::InitVulkan()
 			.SetEnabledFeatures(deviceFeatures13)
 			.SetEnabledFeatures(deviceFeatures12)
 			.SetEnabledFeatures(borderFeatures)
+			.SetOptionalFeatures(optionalFeatures)
+			.SetOptionalFeatures(optionalFeatures12)
 			.AddMultipleExtensions(m_DeviceExtensions)
+			// heap budgets left by other processes, texture streaming stays below them
+			.AddOptionalExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)
 			.PreferDedicatedGPU()
 			.Build(m_DevicePtr, m_InstancePtr.get(), m_Surface);
 
@@ -518,6 +2360,19 @@ void DynamicRenderingApp::InitVulkan()
 		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_QUEUE, (uint64_t)*m_DevicePtr->GetPresentQueuePtr(), "Present queue");
 
 		m_DeletionQueue.Push([&]() { m_DevicePtr->Destroy(); });
+
+		if (m_Settings.occlusionCulling && !m_DevicePtr->GetEnabledFeatures().shaderStorageImageArrayDynamicIndexing)
+		{
+			std::cout << "occlusion culling needs dynamic indexing of storage image arrays, drawing every mesh in the frustum instead\n";
+			m_Settings.occlusionCulling = false;
+			m_Settings.clusterCulling = false;
+		}
+		if (m_Settings.clusterCulling && !(m_DevicePtr->GetEnabledFeatures().multiDrawIndirect && m_DevicePtr->GetEnabledFeatures12().drawIndirectCount))
+		{
+			std::cout << "cluster culling needs multi draw indirect and draw indirect count, culling whole meshes instead\n";
+			m_Settings.clusterCulling = false;
+		}
+		ValidateEnvironmentFormat();
 	}
 
 	// create swapchain
@@ -537,28 +2392,54 @@ void DynamicRenderingApp::InitVulkan()
 		m_DeletionQueue.Push([&]() { m_CommandPoolPtr->Destroy(*m_DevicePtr->GetDevicePtr()); });
 	}
 
+	// create gpu profiler
+	{
+		Device::QueueFamilyIndices queueFamilyIndices = m_DevicePtr->FindQueueFamilies(m_Surface);
+
+		// room for every pass with all optional features enabled
+		m_GPUProfilerPtr = std::make_unique<GPUProfiler>(m_DevicePtr.get(), queueFamilyIndices.graphicsFamily.value(), MAX_PROFILED_PASSES, MAX_FRAMES_IN_FLIGHT);
+		if (!m_GPUProfilerPtr->IsSupported())
+			std::cerr << "gpu timestamps are not supported, pass timings will not be available\n";
+
+		m_DeletionQueue.Push([&]() { m_GPUProfilerPtr->Destroy(m_DevicePtr.get()); });
+	}
+
 	//HELP::LoadScene();
+	if (m_Settings.textureBudgetMB > .0f)
+		m_ScenePtr->DeferTextures();
 	m_ScenePtr->Load(m_DevicePtr.get(), m_CommandPoolPtr.get(), "resources\\Sponza.gltf");
+	m_TextureStreamerPtr = std::make_unique<TextureStreamer>(m_DevicePtr.get(), m_CommandPoolPtr.get(), m_ScenePtr.get(), static_cast<uint64_t>(m_Settings.textureBudgetMB * 1024.f * 1024.f));
+	if (m_Settings.triangleBvh)
+		m_ScenePtr->BuildTriangleBvhs();
+	if (m_Settings.streamingBudgetMB > .0f)
+		m_ScenePtr->EnableStreaming(m_Settings.streamingCellSize);
 	m_DeletionQueue.Push([&]() { m_ScenePtr->Flush(); });
+	m_DeletionQueue.Push([&]() { m_TextureStreamerPtr->Destroy(m_DevicePtr.get()); });
 
 	m_PointLights.emplace_back(glm::vec3{ 6.f, .0f, 1.f }, glm::vec3{ .577f, .0f, .0f }, 1521.f);
 	m_PointLights.emplace_back(glm::vec3{ 2.f, .0f, 1.f }, glm::vec3{ .34f, .34f, .1f }, 1521.f);
 	m_DirectionalLights.emplace_back(glm::normalize(glm::vec3{ .5f, .0f, -.5f }), glm::vec3{ .877f, .877f, .577f }, 100.0f);
 	m_DirectionalLights.emplace_back(glm::normalize(glm::vec3{ .999f, .0f, -.577f }), glm::vec3{ .877f, .877f, .577f }, 75.0f);
 
-	for (datatype::DirectionalLight& light : m_DirectionalLights)
-		m_ScenePtr->CalculateLightViewProj(light);
+	m_ShadowCascadesPtr = std::make_unique<ShadowCascades>(static_cast<uint32_t>(m_DirectionalLights.size()), m_Settings.shadowCascadeCount, m_Settings.shadowResolution, SHADOW_SPLIT_LAMBDA);
 
 	// create descriptor set layout for global values that are mostly unchanged
 	{
 		DescriptorSetLayoutBuilder builder{};
 		builder
-			.AddBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT) // point lights
-			.AddBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_VERTEX_BIT) // directional lights
-			.AddBinding(2, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT) // environment
-			.AddBinding(3, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT) // ibl
-			.AddBinding(4, VK_DESCRIPTOR_TYPE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT) // sampler
+			.AddBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT) // point lights
+			.AddBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT) // directional lights
+			.AddBinding(2, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT) // environment
+			.AddBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT) // irradiance sh
+			.AddBinding(4, VK_DESCRIPTOR_TYPE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT) // sampler
 			.AddBinding(5, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT, m_ScenePtr->GetTextures().size()) // textures
+			.AddBinding(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT) // shadow cascades
+			.AddBinding(7, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT) // prefiltered environment
+			.AddBinding(8, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT) // brdf lut
+			.AddBinding(9, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT) // exposure
+			.AddBinding(10, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT) // material table
+			.AddBinding(11, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT) // instance transforms
+			.AddBinding(12, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT) // texture feedback
 			.Build(m_GlobalSetLayoutPtr, *m_DevicePtr->GetDevicePtr());
 		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT, (uint64_t)*m_GlobalSetLayoutPtr->GetLayoutPtr(), "Global descriptor set layout");
 		
@@ -569,8 +2450,8 @@ void DynamicRenderingApp::InitVulkan()
 	{
 		DescriptorSetLayoutBuilder builder{};
 		builder
-			.AddBinding(0, VK_DESCRIPTOR_TYPE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT) // shadow sampler
-			.AddBinding(1, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT, m_DirectionalLights.size()) // shadow map
+			.AddBinding(0, VK_DESCRIPTOR_TYPE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT) // shadow sampler
+			.AddBinding(1, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT) // shadow map array, layer per light and cascade
 			.Build(m_LocalSetLayoutPtr, *m_DevicePtr->GetDevicePtr());
 		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT, (uint64_t)*m_LocalSetLayoutPtr->GetLayoutPtr(), "Local descriptor set layout");
 
@@ -581,11 +2462,15 @@ void DynamicRenderingApp::InitVulkan()
 	{
 		DescriptorSetLayoutBuilder builder{};
 		builder
-			.AddBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT) // UBO
-			.AddBinding(1, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT) // albedo
-			.AddBinding(2, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT) // material
-			.AddBinding(3, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT) // depth
+			.AddBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT) // UBO
+			.AddBinding(1, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT) // albedo
+			.AddBinding(2, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT) // material
+			.AddBinding(3, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT) // depth
 			.AddBinding(4, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT) // hdr render
+			.AddBinding(5, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT) // roughness and metalness
+			.AddBinding(6, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT) // lighting history
+			.AddBinding(7, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT) // depth history
+			.AddBinding(8, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT) // lighting cache statistics
 			.Build(m_FrameDescriptorSetLayoutPtr, *m_DevicePtr->GetDevicePtr());
 		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT, (uint64_t)*m_FrameDescriptorSetLayoutPtr->GetLayoutPtr(), "Frame descriptor set layout");
 
@@ -596,7 +2481,7 @@ void DynamicRenderingApp::InitVulkan()
 	{
 		PipelineLayoutBuilder builder{};
 		builder
-			.AddPushConstant(VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(datatype::TextureIndices))
+			.AddPushConstant(VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(uint32_t)) // material index
 			.AddDescriptorSetLayout(m_GlobalSetLayoutPtr.get())
 			.AddDescriptorSetLayout(m_FrameDescriptorSetLayoutPtr.get())
 			.Build(m_PrepassPipelineLayoutPtr, *m_DevicePtr->GetDevicePtr());
@@ -610,7 +2495,7 @@ void DynamicRenderingApp::InitVulkan()
 	{
 		PipelineLayoutBuilder builder{};
 		builder
-			.AddPushConstant(VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(datatype::TextureIndices))
+			.AddPushConstant(VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(uint32_t)) // material index
 			.AddDescriptorSetLayout(m_GlobalSetLayoutPtr.get())
 			.AddDescriptorSetLayout(m_FrameDescriptorSetLayoutPtr.get())
 			.Build(m_GBufferPipelineLayoutPtr, *m_DevicePtr->GetDevicePtr());
@@ -634,6 +2519,35 @@ void DynamicRenderingApp::InitVulkan()
 		m_DeletionQueue.Push([&]() { vkDestroyPipelineLayout(*m_DevicePtr->GetDevicePtr(), *m_LightingPipelineLayoutPtr->GetPipelineLayoutPtr(), nullptr); });
 	}
 
+	// create descriptor set layout for tiled compute lighting
+	{
+		DescriptorSetLayoutBuilder builder{};
+		builder
+			.AddBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT) // hdr output
+			.AddBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // tile lists
+			.AddBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // indirect dispatch per tile class
+			.Build(m_TiledLightingSetLayoutPtr, *m_DevicePtr->GetDevicePtr());
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT, (uint64_t)*m_TiledLightingSetLayoutPtr->GetLayoutPtr(), "Tiled lighting descriptor set layout");
+
+		m_DeletionQueue.Push([&]() { vkDestroyDescriptorSetLayout(*m_DevicePtr->GetDevicePtr(), *m_TiledLightingSetLayoutPtr->GetLayoutPtr(), nullptr); });
+	}
+
+	// create pipeline layout for tiled compute lighting
+	{
+		PipelineLayoutBuilder builder{};
+		builder
+			.AddPushConstant(VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(datatype::TiledLightingConstants))
+			.AddDescriptorSetLayout(m_GlobalSetLayoutPtr.get())
+			.AddDescriptorSetLayout(m_LocalSetLayoutPtr.get())
+			.AddDescriptorSetLayout(m_FrameDescriptorSetLayoutPtr.get())
+			.AddDescriptorSetLayout(m_TiledLightingSetLayoutPtr.get())
+			.Build(m_TiledLightingPipelineLayoutPtr, *m_DevicePtr->GetDevicePtr());
+
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_PIPELINE_LAYOUT, (uint64_t)*m_TiledLightingPipelineLayoutPtr->GetPipelineLayoutPtr(), "Pipeline layout (tiled lighting)");
+
+		m_DeletionQueue.Push([&]() { vkDestroyPipelineLayout(*m_DevicePtr->GetDevicePtr(), *m_TiledLightingPipelineLayoutPtr->GetPipelineLayoutPtr(), nullptr); });
+	}
+
 	// create depth resources
 	{
 		VkFormat depthFormat = FindDepthFormat();
@@ -644,7 +2558,7 @@ void DynamicRenderingApp::InitVulkan()
 			.SetAspect(VK_IMAGE_ASPECT_DEPTH_BIT | (hasStencil * VK_IMAGE_ASPECT_STENCIL_BIT))
 			.SetFormat(depthFormat)
 			.SetDimensions(m_SwapChainPtr->GetExtentPtr()->width, m_SwapChainPtr->GetExtentPtr()->height)
-			.Build(m_DepthTexturePtr, m_DevicePtr.get(), m_CommandPoolPtr.get(), VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			.Build(m_DepthTexturePtr, m_DevicePtr.get(), m_CommandPoolPtr.get(), VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)*m_DepthTexturePtr->GetFirstViewPtr(), "Depth image view");
 		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE, (uint64_t)*m_DepthTexturePtr->GetImagePtr(), "Depth image");
 
@@ -673,7 +2587,7 @@ void DynamicRenderingApp::InitVulkan()
 			ImageBuilder builder{};
 			builder
 				.SetAspect(VK_IMAGE_ASPECT_COLOR_BIT) 
-				.SetFormat(VK_FORMAT_R8G8B8A8_SRGB)
+				.SetFormat(m_GBufferLayout.albedo)
 				.SetDimensions(m_SwapChainPtr->GetExtentPtr()->width, m_SwapChainPtr->GetExtentPtr()->height)
 				.Build(m_AlbedoTexturePtr, m_DevicePtr.get(), m_CommandPoolPtr.get(), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 			m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)*m_AlbedoTexturePtr->GetFirstViewPtr(), "Albedo image view");
@@ -684,20 +2598,47 @@ void DynamicRenderingApp::InitVulkan()
 			ImageBuilder builder{};
 			builder
 				.SetAspect(VK_IMAGE_ASPECT_COLOR_BIT)
-				.SetFormat(VK_FORMAT_R16G16B16A16_UNORM)
+				.SetFormat(m_GBufferLayout.material)
 				.SetDimensions(m_SwapChainPtr->GetExtentPtr()->width, m_SwapChainPtr->GetExtentPtr()->height)
 				.Build(m_MaterialPropsTexturePtr, m_DevicePtr.get(), m_CommandPoolPtr.get(), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 			m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)*m_MaterialPropsTexturePtr->GetFirstViewPtr(), "Material properties image view");
 			m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE, (uint64_t)*m_MaterialPropsTexturePtr->GetImagePtr(), "Material properties image");
 		}
 
+		if (m_GBufferLayout.IsMaterialSplit())
+		{
+			ImageBuilder builder{};
+			builder
+				.SetAspect(VK_IMAGE_ASPECT_COLOR_BIT)
+				.SetFormat(m_GBufferLayout.roughnessMetalness)
+				.SetDimensions(m_SwapChainPtr->GetExtentPtr()->width, m_SwapChainPtr->GetExtentPtr()->height)
+				.Build(m_RoughnessMetalnessTexturePtr, m_DevicePtr.get(), m_CommandPoolPtr.get(), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)*m_RoughnessMetalnessTexturePtr->GetFirstViewPtr(), "Roughness metalness image view");
+			m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE, (uint64_t)*m_RoughnessMetalnessTexturePtr->GetImagePtr(), "Roughness metalness image");
+		}
+
 		{
+			const VkFormat hdrFormat{ m_GBufferLayout.hdr };
+
+			VkFormatProperties formatProperties{};
+			vkGetPhysicalDeviceFormatProperties(*m_DevicePtr->GetPhysicalDevicePtr(), hdrFormat, &formatProperties);
+			m_IsComputeLightingSupported = formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT;
+			if (m_Settings.computeLighting && !m_IsComputeLightingSupported)
+				std::cerr << "hdr format does not support storage writes, falling back to fragment lighting\n";
+
+			VkImageUsageFlags hdrUsage{ VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT };
+			if (m_IsComputeLightingSupported)
+				hdrUsage |= VK_IMAGE_USAGE_STORAGE_BIT;
+			// copied into the history of the lighting cache
+			if (m_Settings.lightingCache)
+				hdrUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
 			ImageBuilder builder{};
 			builder
 				.SetAspect(VK_IMAGE_ASPECT_COLOR_BIT)
-				.SetFormat(VK_FORMAT_R32G32B32A32_SFLOAT)
+				.SetFormat(hdrFormat)
 				.SetDimensions(m_SwapChainPtr->GetExtentPtr()->width, m_SwapChainPtr->GetExtentPtr()->height)
-				.Build(m_HDRRenderTargetPtr, m_DevicePtr.get(), m_CommandPoolPtr.get(), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+				.Build(m_HDRRenderTargetPtr, m_DevicePtr.get(), m_CommandPoolPtr.get(), hdrUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 			m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)*m_HDRRenderTargetPtr->GetFirstViewPtr(), "HDR Render target view");
 			m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE, (uint64_t)*m_HDRRenderTargetPtr->GetImagePtr(), "HDR Render target");
 		}
@@ -716,6 +2657,8 @@ void DynamicRenderingApp::InitVulkan()
 			transition.dstStage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
 			m_AlbedoTexturePtr->MakeTransition(m_DevicePtr.get(), &command, transition);
 			m_MaterialPropsTexturePtr->MakeTransition(m_DevicePtr.get(), &command, transition);
+			if (m_RoughnessMetalnessTexturePtr)
+				m_RoughnessMetalnessTexturePtr->MakeTransition(m_DevicePtr.get(), &command, transition);
 			m_HDRRenderTargetPtr->MakeTransition(m_DevicePtr.get(), &command, transition);
 
 			command.End(m_DevicePtr.get());
@@ -725,13 +2668,45 @@ void DynamicRenderingApp::InitVulkan()
 			{
 				m_AlbedoTexturePtr->Destroy(*m_DevicePtr->GetDevicePtr());
 				m_MaterialPropsTexturePtr->Destroy(*m_DevicePtr->GetDevicePtr()); 
+				if (m_RoughnessMetalnessTexturePtr)
+					m_RoughnessMetalnessTexturePtr->Destroy(*m_DevicePtr->GetDevicePtr());
 				m_HDRRenderTargetPtr->Destroy(*m_DevicePtr->GetDevicePtr());
 			});
+
+		const VkExtent2D extent{ *m_SwapChainPtr->GetExtentPtr() };
+		const uint32_t bytesPerPixel{ m_GBufferLayout.GetBytesPerPixel() };
+		std::cout << "g-buffer " << bytesPerPixel << " bytes per pixel, "
+				  << bytesPerPixel * extent.width * extent.height / (1024.f * 1024.f) << " MB at " << extent.width << "x" << extent.height << '\n';
 	}
 
+	CreateLightingCache();
+
+	if (m_Settings.occlusionCulling)
+		CreateOcclusionCulling();
+
 	CreateTextureSampler(); 
 
+	// environment and irradiance only depend on the source image and bake parameters
+	const VkFormat environmentFormat{ GetEnvironmentFormat(m_Settings.environmentFormat) };
+	const IBLCache::BakeParameters bakeParameters{ environmentFormat, ENVIRONMENT_FACE_DIVISOR, SH_COEFFICIENT_COUNT,
+												   PREFILTERED_FACE_SIZE, PREFILTERED_MIP_LEVELS, PREFILTERED_SAMPLE_COUNT, BRDF_LUT_SIZE, BRDF_SAMPLE_COUNT };
+	// the key hashes the whole source image, so the cache is only made when it is used
+	std::optional<IBLCache> iblCache{};
+	if (m_Settings.iblCache)
+		iblCache.emplace(ENVIRONMENT_PATH, bakeParameters);
+	IBLCache::BakedEnvironment bakedEnvironment{};
+	const bool isEnvironmentCached{ iblCache && iblCache->Load(bakedEnvironment) && IsBakedEnvironmentValid(bakedEnvironment, environmentFormat) };
+	if (isEnvironmentCached)
+		std::cout << "loaded baked environment from " << iblCache->GetPath() << '\n';
+
+	// upload cached cube map
+	if (isEnvironmentCached)
+	{
+		CreateEnvironmentCubeMap(bakedEnvironment.cubeMap.width);
+		UploadCachedImage(bakedEnvironment.cubeMap, m_CubeMapPtr.get());
+	}
 	// render to cube map
+	else
 	{
 		auto vertexShaderCode{ HELP::ReadFile("shaders\\cubemap_vert.spv")};
 		auto fragShaderCode{ HELP::ReadFile("shaders\\environment_frag.spv") };
@@ -742,29 +2717,35 @@ void DynamicRenderingApp::InitVulkan()
 
 		ImageBuilder builder{};
 		Image inputImage = builder
-			.SetFilePath("resources\\golden_gate_hills_4k.hdr")
+			.SetFilePath(ENVIRONMENT_PATH)
 			.SetFormat(VK_FORMAT_R32G32B32A32_SFLOAT)
+			.SetCategory(MemoryCategory::Environment)
 			.Build(m_DevicePtr.get(), m_CommandPoolPtr.get(), VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
 		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE, (uint64_t)*inputImage.GetImagePtr(), "ibl source");
 		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)*inputImage.GetFirstViewPtr(), "ibl source view");
 
+		const uint32_t faceSize{ inputImage.GetExtent().width / ENVIRONMENT_FACE_DIVISOR };
+		CreateEnvironmentCubeMap(faceSize);
+
+		// formats that cannot be rendered to are baked in half float and packed afterwards
+		const bool isPacked{ IsEnvironmentFormatPacked(environmentFormat) };
+		uptr<Image> bakeTargetPtr{};
+		if (isPacked)
 		{
 			ImageBuilder builder{};
 			builder
 				.SetAspect(VK_IMAGE_ASPECT_COLOR_BIT)
-				.SetFormat(VK_FORMAT_R32G32B32A32_SFLOAT)
+				.SetFormat(VK_FORMAT_R16G16B16A16_SFLOAT)
 				.SetViewType(VK_IMAGE_VIEW_TYPE_CUBE)
 				.SetLayers(6)
+				.SetMipLevels(m_CubeMapPtr->GetMipLevels())
 				.SetFlags(VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT)
-				.SetDimensions(inputImage.GetExtent().width / 3, inputImage.GetExtent().width / 3)
-				.Build(m_CubeMapPtr, m_DevicePtr.get(), m_CommandPoolPtr.get(), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-			for (VkImageView& imageView : m_CubeMapPtr->GetViews())
-				m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)imageView, "cubemap view");
-
-			m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE, (uint64_t)*m_CubeMapPtr->GetImagePtr(), "cubemap");
+				.SetDimensions(faceSize, faceSize)
+				.Build(bakeTargetPtr, m_DevicePtr.get(), m_CommandPoolPtr.get(), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE, (uint64_t)*bakeTargetPtr->GetImagePtr(), "cubemap bake target");
 		}
+		Image* bakeTarget{ isPacked ? bakeTargetPtr.get() : m_CubeMapPtr.get() };
 
 		// transition to attachment optimal
 		{
@@ -779,88 +2760,70 @@ void DynamicRenderingApp::InitVulkan()
 			transition.srcStage = VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT;
 			transition.dstStage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
 			transition.layerCount = 6;
-			m_CubeMapPtr->MakeTransition(m_DevicePtr.get(), &command, transition);
+			bakeTarget->MakeTransition(m_DevicePtr.get(), &command, transition);
 
 			command.End(m_DevicePtr.get());
 		}
 
-		m_DeletionQueue.Push(
-			[&]()
-			{
-				m_CubeMapPtr->Destroy(*m_DevicePtr->GetDevicePtr());
-			});
-
-		RenderToCubeMap(&vertShaderStage, &fragShaderStage, &inputImage, m_TextureSamplerPtr.get(), m_CubeMapPtr.get());
-
-		inputImage.Destroy(*m_DevicePtr->GetDevicePtr());
-		fragShaderStage.Destroy(m_DevicePtr.get());
-		vertShaderStage.Destroy(m_DevicePtr.get());
-	}
-
-	// render to irradiance map
-	{
-		auto vertexShaderCode{ HELP::ReadFile("shaders\\cubemap_vert.spv") };
-		auto fragShaderCode{ HELP::ReadFile("shaders\\diffuse_irradiance_frag.spv") };
-		ShaderStage vertShaderStage{ m_DevicePtr.get(), vertexShaderCode, VK_SHADER_STAGE_VERTEX_BIT };
-		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_SHADER_MODULE, (uint64_t)vertShaderStage.GetModule(), "vertex shader module");
-		ShaderStage fragShaderStage{ m_DevicePtr.get(), fragShaderCode, VK_SHADER_STAGE_FRAGMENT_BIT };
-		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_SHADER_MODULE, (uint64_t)fragShaderStage.GetModule(), "irradiance shader module");
+		RenderToCubeMap(&vertShaderStage, &fragShaderStage, &inputImage, m_TextureSamplerPtr.get(), bakeTarget);
 
 		{
-			ImageBuilder builder{};
-			builder
-				.SetAspect(VK_IMAGE_ASPECT_COLOR_BIT)
-				.SetFormat(VK_FORMAT_R32G32B32A32_SFLOAT)
-				.SetViewType(VK_IMAGE_VIEW_TYPE_CUBE)
-				.SetLayers(6)
-				.SetFlags(VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT)
-				.SetDimensions(64, 64)
-				.Build(m_DiffuseIrradiancePtr, m_DevicePtr.get(), m_CommandPoolPtr.get(), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-			for (VkImageView& imageView : m_DiffuseIrradiancePtr->GetViews())
-				m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)imageView, "irradiance view");
+			SingleTimeCommand command = m_CommandPoolPtr->AllocateSingleTimeCommand(*m_DevicePtr->GetDevicePtr());
 
-			m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_IMAGE, (uint64_t)*m_DiffuseIrradiancePtr->GetImagePtr(), "irradiance");
+			command.Start();
+			bakeTarget->GenerateMipmaps(&command);
+			command.End(m_DevicePtr.get());
 		}
 
+		if (isPacked)
 		{
-			SingleTimeCommand command = m_CommandPoolPtr->AllocateSingleTimeCommand(*m_DevicePtr->GetDevicePtr());
-
-			command.Start();
+			PackEnvironment(bakeTarget, m_CubeMapPtr.get());
+			bakeTarget->Destroy(*m_DevicePtr->GetDevicePtr());
+		}
 
-			{
-				Image::Transition transition{};
-				transition.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-				transition.srcAccess = 0;
-				transition.dstAccess = VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT;
-				transition.srcStage = VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT;
-				transition.dstStage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
-				transition.layerCount = 6;
-				m_DiffuseIrradiancePtr->MakeTransition(m_DevicePtr.get(), &command, transition);
-			}
-			{
-				Image::Transition transition{};
-				transition.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-				transition.srcAccess = 0;
-				transition.dstAccess = VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT;
-				transition.srcStage = VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT;
-				transition.dstStage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
-				m_CubeMapPtr->MakeTransition(m_DevicePtr.get(), &command, transition);
-			}
+		inputImage.Destroy(*m_DevicePtr->GetDevicePtr());
+		fragShaderStage.Destroy(m_DevicePtr.get());
+		vertShaderStage.Destroy(m_DevicePtr.get());
+	}
 
-			command.End(m_DevicePtr.get());
-		}
+	// project environment into irradiance spherical harmonics, every path leaves the cube map shader readable
+	{
+		BufferBuilder builder{};
+		if (isEnvironmentCached)
+			builder.BindData(bakedEnvironment.irradianceSH.data(), m_CommandPoolPtr.get());
+		builder
+			.SetCategory(MemoryCategory::Environment)
+			.Build(m_IrradianceSHPtr, m_DevicePtr.get(), m_CommandPoolPtr.get(), SH_COEFFICIENT_COUNT * 3 * sizeof(float), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)*m_IrradianceSHPtr->GetBufferPtr(), "Irradiance SH");
 
 		m_DeletionQueue.Push(
 			[&]()
 			{
-				m_DiffuseIrradiancePtr->Destroy(*m_DevicePtr->GetDevicePtr());
+				m_IrradianceSHPtr->Destroy(m_DevicePtr.get());
 			});
 
-		RenderToCubeMap(&vertShaderStage, &fragShaderStage, m_CubeMapPtr.get(), m_TextureSamplerPtr.get(), m_DiffuseIrradiancePtr.get());
+		if (!isEnvironmentCached)
+			ProjectToSphericalHarmonics(m_CubeMapPtr.get(), m_TextureSamplerPtr.get(), m_IrradianceSHPtr.get());
+	}
 
-		fragShaderStage.Destroy(m_DevicePtr.get());
-		vertShaderStage.Destroy(m_DevicePtr.get());
+	// prefilter the environment for specular and integrate the brdf lut
+	CreateSpecularImages();
+	if (isEnvironmentCached)
+	{
+		UploadCachedImage(bakedEnvironment.prefilteredCubeMap, m_PrefilteredCubeMapPtr.get());
+		UploadCachedImage(bakedEnvironment.brdfLUT, m_BRDFLUTPtr.get());
+	}
+	else
+	{
+		PrefilterEnvironment(m_CubeMapPtr.get(), m_TextureSamplerPtr.get(), m_PrefilteredCubeMapPtr.get());
+		IntegrateBRDF(m_BRDFLUTPtr.get());
+	}
+
+	// keep every bake for the next launch
+	if (!isEnvironmentCached && iblCache)
+	{
+		ReadBackEnvironment(bakedEnvironment);
+		iblCache->Save(bakedEnvironment);
 	}
 
 	// create pipelines
@@ -892,7 +2855,9 @@ void DynamicRenderingApp::InitVulkan()
 		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_SHADER_MODULE, (uint64_t)vertShaderStage.GetModule(), "gbuffer vertex shader module");
 
 		ShaderStage gbufferGenShaderStage{ m_DevicePtr.get(), gbufferGenShaderCode, VK_SHADER_STAGE_FRAGMENT_BIT };
-		gbufferGenShaderStage.AddSpecialization(sizeof(uint32_t), 1, &textureCount);
+		// texture count, split material, texture feedback
+		uint32_t gbufferConstants[]{ textureCount, m_GBufferLayout.IsMaterialSplit(), m_TextureStreamerPtr->IsEnabled() };
+		gbufferGenShaderStage.AddSpecialization(sizeof(uint32_t), std::size(gbufferConstants), static_cast<void*>(gbufferConstants));
 		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_SHADER_MODULE, (uint64_t)gbufferGenShaderStage.GetModule(), "gbuffer gen shader module");
 
 		ShaderStage quadShaderStage{ m_DevicePtr.get(), quadShaderCode, VK_SHADER_STAGE_VERTEX_BIT };
@@ -902,10 +2867,16 @@ void DynamicRenderingApp::InitVulkan()
 		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_SHADER_MODULE, (uint64_t)fragShaderStage.GetModule(), "fragment shader module");
 
 		ShaderStage blitShaderStage{ m_DevicePtr.get(), blitShaderCode, VK_SHADER_STAGE_FRAGMENT_BIT };
+		uint32_t exposureMode{ static_cast<uint32_t>(m_Settings.exposureMode) };
+		// exposure mode, upscale sharpness
+		uint32_t blitConstants[]{ exposureMode, std::bit_cast<uint32_t>(UPSCALE_SHARPNESS) };
+		blitShaderStage.AddSpecialization(sizeof(uint32_t), std::size(blitConstants), static_cast<void*>(blitConstants));
 		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_SHADER_MODULE, (uint64_t)blitShaderStage.GetModule(), "blit shader module");
 
 		ShaderStage lightingShaderStage{ m_DevicePtr.get(), lightingShaderCode, VK_SHADER_STAGE_FRAGMENT_BIT };
-		uint32_t lightCounts[]{ static_cast<uint32_t>(m_PointLights.size()), static_cast<uint32_t>(m_DirectionalLights.size()) };
+		// point lights, directional lights, split material, fused tonemap, shadow cascades, exposure mode, lighting cache, cache refresh ratio, cache validation
+		uint32_t lightCounts[]{ static_cast<uint32_t>(m_PointLights.size()), static_cast<uint32_t>(m_DirectionalLights.size()), m_GBufferLayout.IsMaterialSplit(), 0, m_ShadowCascadesPtr->GetCascadeCount(), exposureMode,
+								m_Settings.lightingCache, m_Settings.cacheRefreshRatio, m_Settings.cacheValidation };
 		lightingShaderStage.AddSpecialization(sizeof(uint32_t), std::size(lightCounts), static_cast<void*>(lightCounts));
 		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_SHADER_MODULE, (uint64_t)lightingShaderStage.GetModule(), "lighting shader module");
 
@@ -938,10 +2909,14 @@ void DynamicRenderingApp::InitVulkan()
 		// create graphics pipeline for gbuffer generation
 		{
 			std::vector<VkFormat> colorAttachmentFormats{ m_AlbedoTexturePtr->GetFormat(), m_MaterialPropsTexturePtr->GetFormat() };
+			if (m_GBufferLayout.IsMaterialSplit())
+				colorAttachmentFormats.emplace_back(m_RoughnessMetalnessTexturePtr->GetFormat());
 
 			auto attributeDesc{ datatype::Vertex::GetAttributeDescriptions() };
 
 			PipelineBuilder builder{};
+			if (m_GBufferLayout.IsMaterialSplit())
+				builder.AddColorBlendAttachment(colorBlendAttachment);
 			builder
 				.AddShaderStage(gbufferVertShaderStage)
 				.AddShaderStage(gbufferGenShaderStage)
@@ -982,6 +2957,31 @@ void DynamicRenderingApp::InitVulkan()
 			m_DeletionQueue.Push([&]() { vkDestroyPipeline(*m_DevicePtr->GetDevicePtr(), *m_LightingPipelinePtr->GetPipelinePtr(), nullptr); });
 		}
 
+		// create graphics pipeline for lighting with tonemapping into the swapchain
+		if (m_Settings.fusedTonemap)
+		{
+			lightCounts[3] = VK_TRUE;
+			lightingShaderStage.AddSpecialization(sizeof(uint32_t), std::size(lightCounts), static_cast<void*>(lightCounts));
+
+			std::vector<VkFormat> colorAttachmentFormats{ *m_SwapChainPtr->GetFormatPtr() };
+
+			PipelineBuilder builder{};
+			builder
+				.AddShaderStage(quadShaderStage)
+				.AddShaderStage(lightingShaderStage)
+				.AddDynamicState(VK_DYNAMIC_STATE_VIEWPORT)
+				.AddDynamicState(VK_DYNAMIC_STATE_SCISSOR)
+				.SetCullMode(VK_CULL_MODE_FRONT_BIT)
+				.SetFrontFace(VK_FRONT_FACE_COUNTER_CLOCKWISE)
+				.SetPolygonMode(VK_POLYGON_MODE_FILL)
+				.AddColorBlendAttachment(colorBlendAttachment)
+				.EnableDynamicRendering(colorAttachmentFormats, m_DepthTexturePtr->GetFormat(), VK_FORMAT_UNDEFINED)
+				.Build(m_FusedLightingPipelinePtr, m_DevicePtr.get(), *m_SwapChainPtr->GetExtentPtr(), *m_LightingPipelineLayoutPtr->GetPipelineLayoutPtr(), VK_NULL_HANDLE);
+			m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_PIPELINE, (uint64_t)*m_FusedLightingPipelinePtr->GetPipelinePtr(), "Pipeline (fused lighting)");
+
+			m_DeletionQueue.Push([&]() { vkDestroyPipeline(*m_DevicePtr->GetDevicePtr(), *m_FusedLightingPipelinePtr->GetPipelinePtr(), nullptr); });
+		}
+
 		// create graphics pipeline for blit
 		{
 			std::vector<VkFormat> colorAttachmentFormats{ *m_SwapChainPtr->GetFormatPtr() };
@@ -1003,6 +3003,54 @@ void DynamicRenderingApp::InitVulkan()
 			m_DeletionQueue.Push([&]() { vkDestroyPipeline(*m_DevicePtr->GetDevicePtr(), *m_BlitPipelinePtr->GetPipelinePtr(), nullptr); });
 		}
 
+		// create compute pipelines for tiled lighting
+		if (m_IsComputeLightingSupported)
+		{
+			auto classificationShaderCode{ HELP::ReadFile("shaders\\tile_classification_comp.spv") };
+			auto tiledLightingShaderCode{ HELP::ReadFile("shaders\\lighting_comp.spv") };
+
+			// local size x, local size y, point lights, directional lights, tile class, split material, shadow cascades, lighting cache, cache refresh ratio, cache validation
+			uint32_t constants[]{ m_Settings.tileSize, m_Settings.tileSize, lightCounts[0], lightCounts[1], 0, m_GBufferLayout.IsMaterialSplit(), lightCounts[4], lightCounts[6], lightCounts[7], lightCounts[8] };
+
+			ShaderStage classificationShaderStage{ m_DevicePtr.get(), classificationShaderCode, VK_SHADER_STAGE_COMPUTE_BIT };
+			classificationShaderStage.AddSpecialization(sizeof(uint32_t), std::size(constants), static_cast<void*>(constants));
+			m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_SHADER_MODULE, (uint64_t)classificationShaderStage.GetModule(), "tile classification shader module");
+
+			ComputePipelineBuilder builder{};
+			builder
+				.SetShaderStage(classificationShaderStage)
+				.Build(m_TileClassificationPipelinePtr, m_DevicePtr.get(), *m_TiledLightingPipelineLayoutPtr->GetPipelineLayoutPtr());
+			m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_PIPELINE, (uint64_t)*m_TileClassificationPipelinePtr->GetPipelinePtr(), "Pipeline (tile classification)");
+
+			m_DeletionQueue.Push([&]() { vkDestroyPipeline(*m_DevicePtr->GetDevicePtr(), *m_TileClassificationPipelinePtr->GetPipelinePtr(), nullptr); });
+
+			ShaderStage tiledLightingShaderStage{ m_DevicePtr.get(), tiledLightingShaderCode, VK_SHADER_STAGE_COMPUTE_BIT };
+			m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_SHADER_MODULE, (uint64_t)tiledLightingShaderStage.GetModule(), "tiled lighting shader module");
+
+			const char* pipelineNames[]{ "Pipeline (tiled lighting sky)", "Pipeline (tiled lighting unlit)", "Pipeline (tiled lighting shadowed)", "Pipeline (tiled lighting full)" };
+			for (uint32_t tileClass{}; tileClass < static_cast<uint32_t>(TileClass::Count); ++tileClass)
+			{
+				constants[4] = tileClass;
+				tiledLightingShaderStage.AddSpecialization(sizeof(uint32_t), std::size(constants), static_cast<void*>(constants));
+
+				m_TiledLightingPipelines.emplace_back(
+					builder
+						.SetShaderStage(tiledLightingShaderStage)
+						.Build(m_DevicePtr.get(), *m_TiledLightingPipelineLayoutPtr->GetPipelineLayoutPtr()));
+				m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_PIPELINE, (uint64_t)*m_TiledLightingPipelines.back().GetPipelinePtr(), pipelineNames[tileClass]);
+			}
+
+			m_DeletionQueue.Push(
+				[&]()
+				{
+					for (Pipeline& pipeline : m_TiledLightingPipelines)
+						vkDestroyPipeline(*m_DevicePtr->GetDevicePtr(), *pipeline.GetPipelinePtr(), nullptr);
+				});
+
+			classificationShaderStage.Destroy(m_DevicePtr.get());
+			tiledLightingShaderStage.Destroy(m_DevicePtr.get());
+		}
+
 		prepassShaderStage.Destroy(m_DevicePtr.get());
 		vertShaderStage.Destroy(m_DevicePtr.get());
 		fragShaderStage.Destroy(m_DevicePtr.get());
@@ -1033,57 +3081,115 @@ void DynamicRenderingApp::InitVulkan()
 		m_DeletionQueue.Push(
 			[&]()
 			{
-				for (Buffer& buffer : m_MVPUBuffers)  
+				for (Buffer& buffer : m_MVPUBuffers)  
+					buffer.Destroy(m_DevicePtr.get());
+			});
+	}
+
+	// create point light buffers
+	{
+		VkDeviceSize bufferSize	{ m_PointLights.size() * sizeof(datatype::PointLight) };
+
+		BufferBuilder builder{};
+		builder
+			.MapMemory()
+			.Build(m_PointLightsSSBO, m_DevicePtr.get(), m_CommandPoolPtr.get(), MAX_FRAMES_IN_FLIGHT, bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+				   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+		for (Buffer& buffer : m_PointLightsSSBO)
+		{
+			const size_t pointLightsSize{ m_PointLights.size() * sizeof(datatype::PointLight) };
+			buffer.UpdateMappedData(m_PointLights.data(), pointLightsSize, 0);
+			m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)*buffer.GetBufferPtr(), "Lights");
+		}
+
+		m_DeletionQueue.Push(
+			[&]()
+			{
+				for (Buffer& buffer : m_PointLightsSSBO)
+					buffer.Destroy(m_DevicePtr.get());
+			});
+	}
+
+	// create point directional buffers
+	{
+		VkDeviceSize bufferSize{ m_DirectionalLights.size() * sizeof(datatype::DirectionalLight) };
+
+		BufferBuilder builder{};
+		builder
+			.MapMemory()
+			.Build(m_DirectionalLightsSSBO, m_DevicePtr.get(), m_CommandPoolPtr.get(), MAX_FRAMES_IN_FLIGHT, bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+				   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+		for (Buffer& buffer : m_DirectionalLightsSSBO)
+		{
+			const size_t dirLightsSize{ m_DirectionalLights.size() * sizeof(datatype::DirectionalLight) };
+			buffer.UpdateMappedData(m_DirectionalLights.data(), dirLightsSize, 0);
+			m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)*buffer.GetBufferPtr(), "Lights");
+		}
+
+		m_DeletionQueue.Push(
+			[&]()
+			{
+				for (Buffer& buffer : m_DirectionalLightsSSBO)
 					buffer.Destroy(m_DevicePtr.get());
 			});
 	}
 
-	// create point light buffers
+	// create shadow cascade buffers, rewritten every frame before recording
 	{
-		VkDeviceSize bufferSize	{ m_PointLights.size() * sizeof(datatype::PointLight) };
+		VkDeviceSize bufferSize{ m_ShadowCascadesPtr->GetCascades().size() * sizeof(datatype::ShadowCascade) };
 
 		BufferBuilder builder{};
 		builder
 			.MapMemory()
-			.Build(m_PointLightsSSBO, m_DevicePtr.get(), m_CommandPoolPtr.get(), MAX_FRAMES_IN_FLIGHT, bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+			.Build(m_ShadowCascadeSSBO, m_DevicePtr.get(), m_CommandPoolPtr.get(), MAX_FRAMES_IN_FLIGHT, bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
 				   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-		for (Buffer& buffer : m_PointLightsSSBO)
-		{
-			const size_t pointLightsSize{ m_PointLights.size() * sizeof(datatype::PointLight) };
-			buffer.UpdateMappedData(m_PointLights.data(), pointLightsSize, 0);
-			m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)*buffer.GetBufferPtr(), "Lights");
-		}
+		for (Buffer& buffer : m_ShadowCascadeSSBO)
+			m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)*buffer.GetBufferPtr(), "Shadow cascades");
 
 		m_DeletionQueue.Push(
 			[&]()
 			{
-				for (Buffer& buffer : m_PointLightsSSBO)
+				for (Buffer& buffer : m_ShadowCascadeSSBO)
 					buffer.Destroy(m_DevicePtr.get());
 			});
 	}
 
-	// create point directional buffers
+	// create tile classification buffers
 	{
-		VkDeviceSize bufferSize{ m_DirectionalLights.size() * sizeof(datatype::DirectionalLight) };
+		VkDeviceSize tileListSize{ static_cast<uint32_t>(TileClass::Count) * GetTileCapacity() * sizeof(uint32_t) };
 
 		BufferBuilder builder{};
 		builder
+			.Build(m_TileListSSBO, m_DevicePtr.get(), m_CommandPoolPtr.get(), MAX_FRAMES_IN_FLIGHT, tileListSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		for (Buffer& buffer : m_TileListSSBO)
+			m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)*buffer.GetBufferPtr(), "Tile lists");
+
+		// host visible to read back tile counts for statistics
+		VkDeviceSize dispatchSize{ static_cast<uint32_t>(TileClass::Count) * sizeof(VkDispatchIndirectCommand) };
+
+		BufferBuilder dispatchBuilder{};
+		dispatchBuilder
 			.MapMemory()
-			.Build(m_DirectionalLightsSSBO, m_DevicePtr.get(), m_CommandPoolPtr.get(), MAX_FRAMES_IN_FLIGHT, bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+			.Build(m_TileDispatchBuffers, m_DevicePtr.get(), m_CommandPoolPtr.get(), MAX_FRAMES_IN_FLIGHT, dispatchSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
 				   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-		for (Buffer& buffer : m_DirectionalLightsSSBO)
+		for (Buffer& buffer : m_TileDispatchBuffers)
 		{
-			const size_t dirLightsSize{ m_DirectionalLights.size() * sizeof(datatype::DirectionalLight) };
-			buffer.UpdateMappedData(m_DirectionalLights.data(), dirLightsSize, 0);
-			m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)*buffer.GetBufferPtr(), "Lights");
+			std::vector<VkDispatchIndirectCommand> emptyDispatches(static_cast<size_t>(TileClass::Count), VkDispatchIndirectCommand{ 0, 1, 1 });
+			buffer.UpdateMappedData(emptyDispatches.data(), dispatchSize, 0);
+			m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)*buffer.GetBufferPtr(), "Tile dispatches");
 		}
 
 		m_DeletionQueue.Push(
 			[&]()
 			{
-				for (Buffer& buffer : m_DirectionalLightsSSBO)
+				for (Buffer& buffer : m_TileListSSBO)
+					buffer.Destroy(m_DevicePtr.get());
+				for (Buffer& buffer : m_TileDispatchBuffers)
 					buffer.Destroy(m_DevicePtr.get());
 			});
 	}
@@ -1095,17 +3201,31 @@ void DynamicRenderingApp::InitVulkan()
 			.AddPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, MAX_FRAMES_IN_FLIGHT) // mvp
 			.AddPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_FRAMES_IN_FLIGHT) // light data
 			.AddPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_FRAMES_IN_FLIGHT) // light data
+			.AddPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_FRAMES_IN_FLIGHT) // shadow cascades
+			.AddPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_FRAMES_IN_FLIGHT) // irradiance sh
 			.AddPoolSize(VK_DESCRIPTOR_TYPE_SAMPLER, MAX_FRAMES_IN_FLIGHT) // sampler
 			.AddPoolSize(VK_DESCRIPTOR_TYPE_SAMPLER, MAX_FRAMES_IN_FLIGHT) // sampler
 			.AddPoolSize(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, MAX_FRAMES_IN_FLIGHT) // textures
 			.AddPoolSize(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, MAX_FRAMES_IN_FLIGHT) // depth
 			.AddPoolSize(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, MAX_FRAMES_IN_FLIGHT) // albedo
 			.AddPoolSize(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, MAX_FRAMES_IN_FLIGHT) // material props
+			.AddPoolSize(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, MAX_FRAMES_IN_FLIGHT) // roughness metalness
 			.AddPoolSize(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, MAX_FRAMES_IN_FLIGHT) // hdr render
 			.AddPoolSize(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, MAX_FRAMES_IN_FLIGHT) // environment
-			.AddPoolSize(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, MAX_FRAMES_IN_FLIGHT) // ibl
-			.AddPoolSize(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, MAX_FRAMES_IN_FLIGHT) // shadow depth maps
-			.Build(m_DescriptorPoolPtr, m_DevicePtr.get(), 3 * MAX_FRAMES_IN_FLIGHT);
+			.AddPoolSize(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, MAX_FRAMES_IN_FLIGHT) // prefiltered environment
+			.AddPoolSize(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, MAX_FRAMES_IN_FLIGHT) // brdf lut
+			.AddPoolSize(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, MAX_FRAMES_IN_FLIGHT) // shadow depth map array
+			.AddPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, MAX_FRAMES_IN_FLIGHT) // hdr output
+			.AddPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 * MAX_FRAMES_IN_FLIGHT) // tile lists and dispatches
+			.AddPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_FRAMES_IN_FLIGHT) // exposure
+			.AddPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_FRAMES_IN_FLIGHT) // material table
+			.AddPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_FRAMES_IN_FLIGHT) // instance transforms
+			.AddPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_FRAMES_IN_FLIGHT) // texture feedback
+			.AddPoolSize(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 2 * MAX_FRAMES_IN_FLIGHT) // lighting and depth history
+			.AddPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_FRAMES_IN_FLIGHT) // lighting cache statistics
+			.AddPoolSize(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1) // auto exposure hdr input
+			.AddPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2) // auto exposure histogram and exposure
+			.Build(m_DescriptorPoolPtr, m_DevicePtr.get(), 4 * MAX_FRAMES_IN_FLIGHT + 1);
 		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_DESCRIPTOR_POOL, (uint64_t)*m_DescriptorPoolPtr->GetDescriptorPoolPtr(), "Descriptor pool");
 
 		m_DeletionQueue.Push([&]() { m_DescriptorPoolPtr->Destroy(*m_DevicePtr->GetDevicePtr()); });
@@ -1133,21 +3253,30 @@ void DynamicRenderingApp::InitVulkan()
 			transition.dstAccess = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
 			transition.srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
 			transition.dstStage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+			transition.layerCount = 6;
 			m_CubeMapPtr->MakeTransition(m_DevicePtr.get(), &command, transition);
-			m_DiffuseIrradiancePtr->MakeTransition(m_DevicePtr.get(), &command, transition);
 
 			command.End(m_DevicePtr.get());
 		}
 
+		CreateAutoExposure();
+
 		for (size_t index{}; index < m_GlobalDescriptorSets.size(); ++index)
 		{
 			m_GlobalDescriptorSets[index]
 				.AddWriteDescriptorSet(&m_PointLightsSSBO[index], 0, 0, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
 				.AddWriteDescriptorSet(&m_DirectionalLightsSSBO[index], 0, 1, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
 				.AddWriteDescriptorSet(m_CubeMapPtr.get(), 2, 0)
-				.AddWriteDescriptorSet(m_DiffuseIrradiancePtr.get(), 3, 0)
+				.AddWriteDescriptorSet(m_IrradianceSHPtr.get(), 0, 3, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
 				.AddWriteDescriptorSet(*m_TextureSamplerPtr->GetSamplerPtr(), 4, 0)
 				.AddWriteDescriptorSet(textures, 5, 0)
+				.AddWriteDescriptorSet(&m_ShadowCascadeSSBO[index], 0, 6, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+				.AddWriteDescriptorSet(m_PrefilteredCubeMapPtr.get(), 7, 0)
+				.AddWriteDescriptorSet(m_BRDFLUTPtr.get(), 8, 0)
+				.AddWriteDescriptorSet(m_ExposurePtr.get(), 0, 9, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+				.AddWriteDescriptorSet(m_ScenePtr->GetMaterialBuffer(), 0, 10, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+				.AddWriteDescriptorSet(m_ScenePtr->GetInstanceBuffer(), 0, 11, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+				.AddWriteDescriptorSet(m_TextureStreamerPtr->GetFeedbackBuffer(), 0, 12, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
 				.Update(m_DevicePtr.get());
 			m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_DESCRIPTOR_SET, (uint64_t)*m_GlobalDescriptorSets[index].GetDescriptorSetPtr(), "Global descriptor set");
 		}
@@ -1159,13 +3288,13 @@ void DynamicRenderingApp::InitVulkan()
 				.Build(m_LocalDescriptorSets, m_DevicePtr.get(), MAX_FRAMES_IN_FLIGHT, *m_DescriptorPoolPtr->GetDescriptorPoolPtr(), layouts.data());
 		}
 
-		GenerateShadowMap();
+		CreateShadowMaps();
 
 		for (size_t index{}; index < m_LocalDescriptorSets.size(); ++index)
 		{
 			m_LocalDescriptorSets[index]
 				.AddWriteDescriptorSet(*m_ShadowSamplerPtr->GetSamplerPtr(), 0, 0)
-				.AddWriteDescriptorSet(m_ShadowDepthMaps, 1, 0)
+				.AddWriteDescriptorSet(m_ShadowMapArrayPtr.get(), 1, 0)
 				.Update(m_DevicePtr.get());
 				m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_DESCRIPTOR_SET, (uint64_t)*m_LocalDescriptorSets[index].GetDescriptorSetPtr(), "Local descriptor set");
 		}
@@ -1201,9 +3330,37 @@ void DynamicRenderingApp::InitVulkan()
 				.AddWriteDescriptorSet(m_MaterialPropsTexturePtr.get(), 2, 0)
 				.AddWriteDescriptorSet(m_DepthTexturePtr.get(), 3, 0)
 				.AddWriteDescriptorSet(m_HDRRenderTargetPtr.get(), 4, 0)
+				.AddWriteDescriptorSet(m_GBufferLayout.IsMaterialSplit() ? m_RoughnessMetalnessTexturePtr.get() : m_MaterialPropsTexturePtr.get(), 5, 0)
+				.AddWriteDescriptorSet(&m_LightingCacheStatisticsBuffers[index], 0, 8, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+			// any read only image keeps the set complete when the cache is off
+			Image* lightingHistory{ m_LightingHistoryPtr ? m_LightingHistoryPtr.get() : m_AlbedoTexturePtr.get() };
+			Image* depthHistory{ m_DepthHistoryPtr ? m_DepthHistoryPtr.get() : m_AlbedoTexturePtr.get() };
+			m_FrameDescriptorSets[index]
+				.AddWriteDescriptorSet(lightingHistory, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, 6, 0)
+				.AddWriteDescriptorSet(depthHistory, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, 7, 0)
 				.Update(m_DevicePtr.get());
 				m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_DESCRIPTOR_SET, (uint64_t)*m_FrameDescriptorSets[index].GetDescriptorSetPtr(), "Frame descriptor set");
 		}
+
+		if (m_IsComputeLightingSupported)
+		{
+			{
+				std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, *m_TiledLightingSetLayoutPtr->GetLayoutPtr());
+				DescriptorSetBuilder builder{};
+				builder
+					.Build(m_TiledLightingDescriptorSets, m_DevicePtr.get(), MAX_FRAMES_IN_FLIGHT, *m_DescriptorPoolPtr->GetDescriptorPoolPtr(), layouts.data());
+			}
+
+			for (size_t index{}; index < m_TiledLightingDescriptorSets.size(); ++index)
+			{
+				m_TiledLightingDescriptorSets[index]
+					.AddWriteDescriptorSet(m_HDRRenderTargetPtr.get(), VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL, 0, 0)
+					.AddWriteDescriptorSet(&m_TileListSSBO[index], 0, 1, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+					.AddWriteDescriptorSet(&m_TileDispatchBuffers[index], 0, 2, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+					.Update(m_DevicePtr.get());
+				m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_DESCRIPTOR_SET, (uint64_t)*m_TiledLightingDescriptorSets[index].GetDescriptorSetPtr(), "Tiled lighting descriptor set");
+			}
+		}
 	}
 
 	m_CommandPoolPtr->AllocateCommandBuffers(m_CommandBuffers, *m_DevicePtr->GetDevicePtr(), MAX_FRAMES_IN_FLIGHT, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
@@ -1237,6 +3394,7 @@ void DynamicRenderingApp::CreateTextureSampler()
 			.SetAddressMode(VK_SAMPLER_ADDRESS_MODE_REPEAT)
 			.SetFilter(VK_FILTER_LINEAR)
 			.SetMaxAnisotropy(properties.limits.maxSamplerAnisotropy)
+			.SetMaxLod(VK_LOD_CLAMP_NONE)
 			.Build(m_TextureSamplerPtr, m_DevicePtr.get());
 		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_SAMPLER, (uint64_t)*m_TextureSamplerPtr->GetSamplerPtr(), "Sampler");
 
@@ -1326,6 +3484,9 @@ void DynamicRenderingApp::RecreateSwapChain()
 
 	CreateDepthResources();
 
+	// depth of the history no longer matches the new depth buffer
+	m_PreviousRenderScale = glm::vec2{};
+
 	for (size_t index{}; index < m_FrameDescriptorSets.size(); ++index)
 	{
 		m_FrameDescriptorSets[index]
@@ -1333,12 +3494,25 @@ void DynamicRenderingApp::RecreateSwapChain()
 			.Update(m_DevicePtr.get());
 		m_DevicePtr->SetObjectName(VK_OBJECT_TYPE_DESCRIPTOR_SET, (uint64_t)*m_FrameDescriptorSets[index].GetDescriptorSetPtr(), "Frame descriptor set");
 	}
+
+	if (m_OcclusionDescriptorSetPtr)
+	{
+		m_OcclusionDescriptorSetPtr->AddWriteDescriptorSet(m_DepthTexturePtr.get(), VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, 0, 0)
+			.Update(m_DevicePtr.get());
+	}
 }
 
-void DynamicRenderingApp::RecordCommandBufferWithPrepass(CommandBuffer& commandBuffer, uint32_t imageIndex)
+void DynamicRenderingApp::RecordCommandBufferWithPrepass(CommandBuffer& commandBuffer, uint32_t imageIndex, uint32_t shadowUpdateMask)
 {
 	commandBuffer.Start();
 	Image& swapchainImage = m_SwapChainPtr->GetImages()[imageIndex];
+	m_GPUProfilerPtr->BeginFrame(&commandBuffer, m_CurrentFrame);
+	m_TextureStreamerPtr->RecordUploads(m_DevicePtr.get(), &commandBuffer, m_ScenePtr.get());
+
+	const bool computeLighting{ IsComputeLightingActive() };
+	const bool hdrRoundTrip{ NeedsHDRRoundTrip() };
+	// targets keep their native size, only this part of them is rendered and read
+	const VkExtent2D renderExtent{ GetRenderExtent() };
 
 	{
 		Image::Transition transition{};
@@ -1352,7 +3526,13 @@ void DynamicRenderingApp::RecordCommandBufferWithPrepass(CommandBuffer& commandB
 		m_DepthTexturePtr->MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
 	}
 
-	// depth prepass
+	m_GPUProfilerPtr->BeginPass(&commandBuffer, "shadows");
+	RecordShadows(commandBuffer, shadowUpdateMask);
+	m_GPUProfilerPtr->EndPass(&commandBuffer);
+
+	// depth prepass, with occlusion culling the early pass draws what was visible last frame and the late pass what became visible
+	const bool occlusionCulling{ m_Settings.occlusionCulling };
+	const auto recordPrepass = [&](VkAttachmentLoadOp loadOp, DrawSection section, const char* label)
 	{
 		VkRenderingAttachmentInfo depthAttachment{};
 		{
@@ -1362,7 +3542,7 @@ void DynamicRenderingApp::RecordCommandBufferWithPrepass(CommandBuffer& commandB
 			depthAttachment.sType		= VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
 			depthAttachment.imageView	= *m_DepthTexturePtr->GetFirstViewPtr();
 			depthAttachment.imageLayout = m_DepthTexturePtr->GetCurrentLayout();
-			depthAttachment.loadOp		= VK_ATTACHMENT_LOAD_OP_CLEAR;
+			depthAttachment.loadOp		= loadOp;
 			depthAttachment.storeOp		= VK_ATTACHMENT_STORE_OP_STORE;
 			depthAttachment.clearValue	= depthClearValue;
 		}
@@ -1370,7 +3550,7 @@ void DynamicRenderingApp::RecordCommandBufferWithPrepass(CommandBuffer& commandB
 		VkRenderingInfo prepassRenderingInfo{};
 		{
 			prepassRenderingInfo.sType					= VK_STRUCTURE_TYPE_RENDERING_INFO;
-			prepassRenderingInfo.renderArea				= VkRect2D{ VkOffset2D{}, swapchainImage.GetExtent() };
+			prepassRenderingInfo.renderArea				= VkRect2D{ VkOffset2D{}, renderExtent };
 			prepassRenderingInfo.layerCount				= 1;
 			prepassRenderingInfo.colorAttachmentCount	= 0;
 			prepassRenderingInfo.pColorAttachments		= nullptr;
@@ -1388,36 +3568,38 @@ void DynamicRenderingApp::RecordCommandBufferWithPrepass(CommandBuffer& commandB
 			VkViewport viewport{};
 			viewport.x = .0f;
 			viewport.y = .0f;
-			viewport.width = static_cast<float>(m_SwapChainPtr->GetExtentPtr()->width);
-			viewport.height = static_cast<float>(m_SwapChainPtr->GetExtentPtr()->height);
+			viewport.width = static_cast<float>(renderExtent.width);
+			viewport.height = static_cast<float>(renderExtent.height);
 			viewport.minDepth = .0f;
 			viewport.maxDepth = 1.f;
 			vkCmdSetViewport(*commandBuffer.GetBufferPtr(), 0, 1, &viewport);
 
 			VkRect2D scissor{};
 			scissor.offset = { 0, 0 };
-			scissor.extent = *m_SwapChainPtr->GetExtentPtr();
+			scissor.extent = renderExtent;
 			vkCmdSetScissor(*commandBuffer.GetBufferPtr(), 0, 1, &scissor);
 
-			std::vector<Mesh>& meshes{ m_ScenePtr->GetMeshes() };
-
 			float colour[4]{ 1.f, .0f, .0f, 1.f };
-			commandBuffer.BeginLabel("Meshes prepass", colour);
-			for (Mesh& mesh : meshes)
-			{
-				VkDeviceSize offsets[] = { 0 };
-
-				vkCmdPushConstants(*commandBuffer.GetBufferPtr(), *m_PrepassPipelineLayoutPtr->GetPipelineLayoutPtr(), VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(datatype::TextureIndices), mesh.GetTextureIndices());
-
-				vkCmdBindVertexBuffers(*commandBuffer.GetBufferPtr(), 0, 1, mesh.GetVertexBuffer()->GetBufferPtr(), offsets);
-				vkCmdBindIndexBuffer(*commandBuffer.GetBufferPtr(), *mesh.GetIndexBuffer()->GetBufferPtr(), 0, VK_INDEX_TYPE_UINT32);
-
-				vkCmdDrawIndexed(*commandBuffer.GetBufferPtr(), static_cast<uint32_t>(mesh.GetIndexBuffer()->GetSize() / sizeof(uint32_t)), 1, 0, 0, 0);
-			}
+			commandBuffer.BeginLabel(label, colour);
+			DrawMeshes(commandBuffer, *m_PrepassPipelineLayoutPtr->GetPipelineLayoutPtr(), section);
 			commandBuffer.EndLabel();
 		}
 
 		vkCmdEndRendering(*commandBuffer.GetBufferPtr());
+	};
+
+	m_GPUProfilerPtr->BeginPass(&commandBuffer, "depth prepass");
+	if (occlusionCulling)
+		RecordEarlyOcclusionCull(commandBuffer);
+	recordPrepass(VK_ATTACHMENT_LOAD_OP_CLEAR, DrawSection::EarlyPrepass, "Meshes prepass");
+	m_GPUProfilerPtr->EndPass(&commandBuffer);
+
+	if (occlusionCulling)
+	{
+		m_GPUProfilerPtr->BeginPass(&commandBuffer, "occlusion culling");
+		RecordLateOcclusionCull(commandBuffer, renderExtent);
+		recordPrepass(VK_ATTACHMENT_LOAD_OP_LOAD, DrawSection::LatePrepass, "Meshes late prepass");
+		m_GPUProfilerPtr->EndPass(&commandBuffer);
 	}
 
 	{
@@ -1431,6 +3613,8 @@ void DynamicRenderingApp::RecordCommandBufferWithPrepass(CommandBuffer& commandB
 		}
 		m_AlbedoTexturePtr->MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
 		m_MaterialPropsTexturePtr->MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
+		if (m_RoughnessMetalnessTexturePtr)
+			m_RoughnessMetalnessTexturePtr->MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
 	}
 
 	{
@@ -1446,6 +3630,7 @@ void DynamicRenderingApp::RecordCommandBufferWithPrepass(CommandBuffer& commandB
 	}
 
 	// gbuffer generation
+	m_GPUProfilerPtr->BeginPass(&commandBuffer, "gbuffer");
 	{
 		VkRenderingAttachmentInfo depthAttachment{};
 		{
@@ -1484,15 +3669,23 @@ void DynamicRenderingApp::RecordCommandBufferWithPrepass(CommandBuffer& commandB
 			materialPropsAttachment.clearValue = clearValue;
 		}
 
-		VkRenderingAttachmentInfo attachments[]{ albedoAttachment, materialPropsAttachment };
+		std::vector<VkRenderingAttachmentInfo> attachments{ albedoAttachment, materialPropsAttachment };
+
+		if (m_RoughnessMetalnessTexturePtr)
+		{
+			VkRenderingAttachmentInfo roughnessMetalnessAttachment{ materialPropsAttachment };
+			roughnessMetalnessAttachment.imageView = *m_RoughnessMetalnessTexturePtr->GetFirstViewPtr();
+			roughnessMetalnessAttachment.imageLayout = m_RoughnessMetalnessTexturePtr->GetCurrentLayout();
+			attachments.emplace_back(roughnessMetalnessAttachment);
+		}
 
 		VkRenderingInfo prepassRenderingInfo{};
 		{
 			prepassRenderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
-			prepassRenderingInfo.renderArea = VkRect2D{ VkOffset2D{}, swapchainImage.GetExtent() };
+			prepassRenderingInfo.renderArea = VkRect2D{ VkOffset2D{}, renderExtent };
 			prepassRenderingInfo.layerCount = 1;
-			prepassRenderingInfo.colorAttachmentCount = std::size(attachments);
-			prepassRenderingInfo.pColorAttachments = attachments;
+			prepassRenderingInfo.colorAttachmentCount = static_cast<uint32_t>(attachments.size());
+			prepassRenderingInfo.pColorAttachments = attachments.data();
 			prepassRenderingInfo.pDepthAttachment = &depthAttachment;
 		}
 
@@ -1507,46 +3700,51 @@ void DynamicRenderingApp::RecordCommandBufferWithPrepass(CommandBuffer& commandB
 			VkViewport viewport{};
 			viewport.x = .0f;
 			viewport.y = .0f;
-			viewport.width = static_cast<float>(m_SwapChainPtr->GetExtentPtr()->width);
-			viewport.height = static_cast<float>(m_SwapChainPtr->GetExtentPtr()->height);
+			viewport.width = static_cast<float>(renderExtent.width);
+			viewport.height = static_cast<float>(renderExtent.height);
 			viewport.minDepth = .0f;
 			viewport.maxDepth = 1.f;
 			vkCmdSetViewport(*commandBuffer.GetBufferPtr(), 0, 1, &viewport);
 
 			VkRect2D scissor{};
 			scissor.offset = { 0, 0 };
-			scissor.extent = *m_SwapChainPtr->GetExtentPtr();
+			scissor.extent = renderExtent;
 			vkCmdSetScissor(*commandBuffer.GetBufferPtr(), 0, 1, &scissor);
 
-			std::vector<Mesh>& meshes{ m_ScenePtr->GetMeshes() };
-
 			float colour[4]{ 1.f, .0f, .0f, 1.f };
 			commandBuffer.BeginLabel("Meshes gbuffer generation", colour);
-			for (Mesh& mesh : meshes)
-			{
-				VkDeviceSize offsets[] = { 0 };
-
-				vkCmdPushConstants(*commandBuffer.GetBufferPtr(), *m_GBufferPipelineLayoutPtr->GetPipelineLayoutPtr(), VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(datatype::TextureIndices), mesh.GetTextureIndices());
-
-				vkCmdBindVertexBuffers(*commandBuffer.GetBufferPtr(), 0, 1, mesh.GetVertexBuffer()->GetBufferPtr(), offsets);
-				vkCmdBindIndexBuffer(*commandBuffer.GetBufferPtr(), *mesh.GetIndexBuffer()->GetBufferPtr(), 0, VK_INDEX_TYPE_UINT32);
-
-				vkCmdDrawIndexed(*commandBuffer.GetBufferPtr(), static_cast<uint32_t>(mesh.GetIndexBuffer()->GetSize() / sizeof(uint32_t)), 1, 0, 0, 0);
-			}
+			// occluded meshes are dropped here, lighting and everything after it only reads the g-buffer
+			DrawMeshes(commandBuffer, *m_GBufferPipelineLayoutPtr->GetPipelineLayoutPtr(), DrawSection::GBuffer);
 			commandBuffer.EndLabel();
 		}
 
 		vkCmdEndRendering(*commandBuffer.GetBufferPtr());
 	}
+	m_GPUProfilerPtr->EndPass(&commandBuffer);
+
+	if (m_TextureStreamerPtr->IsEnabled())
+	{
+		// the streamer reads the sampled levels once the fence is signaled
+		Buffer::Barrier barrier{};
+		{
+			barrier.srcStage	= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			barrier.dstStage	= VK_PIPELINE_STAGE_HOST_BIT;
+			barrier.srcAccess	= VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.dstAccess	= VK_ACCESS_HOST_READ_BIT;
+		}
+		m_TextureStreamerPtr->GetFeedbackBuffer()->MakeBarrier(&commandBuffer, barrier);
+	}
 
+	if (hdrRoundTrip)
 	{
+		// compute lighting writes the hdr target as a storage image
 		Image::Transition transition{};
 		{
-			transition.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			transition.newLayout = computeLighting ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 			transition.srcStage = VK_PIPELINE_STAGE_2_NONE;
-			transition.dstStage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+			transition.dstStage = computeLighting ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
 			transition.srcAccess = VK_ACCESS_2_NONE;
-			transition.dstAccess = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+			transition.dstAccess = computeLighting ? VK_ACCESS_SHADER_WRITE_BIT : VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
 		}
 		m_HDRRenderTargetPtr->MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
 	}
@@ -1556,12 +3754,14 @@ void DynamicRenderingApp::RecordCommandBufferWithPrepass(CommandBuffer& commandB
 		{
 			transition.newLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
 			transition.srcStage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
-			transition.dstStage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+			transition.dstStage = computeLighting ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
 			transition.srcAccess = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
-			transition.dstAccess = VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT;
+			transition.dstAccess = computeLighting ? VK_ACCESS_SHADER_READ_BIT : VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT;
 		}
 		m_AlbedoTexturePtr->MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
 		m_MaterialPropsTexturePtr->MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
+		if (m_RoughnessMetalnessTexturePtr)
+			m_RoughnessMetalnessTexturePtr->MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
 		transition.layerCount = 6;
 		m_CubeMapPtr->MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
 	} 
@@ -1571,21 +3771,57 @@ void DynamicRenderingApp::RecordCommandBufferWithPrepass(CommandBuffer& commandB
 		{
 			transition.newLayout	= VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
 			transition.srcStage		= VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
-			transition.dstStage		= VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT;
+			transition.dstStage		= computeLighting ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT;
 			transition.srcAccess	= VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
-			transition.dstAccess	= VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT;;
+			transition.dstAccess	= computeLighting ? VK_ACCESS_SHADER_READ_BIT : VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
 		}
 		m_DepthTexturePtr->MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
 	}
 
+	if (m_Settings.lightingCache && m_Settings.cacheValidation)
+	{
+		Buffer& statisticsBuffer{ m_LightingCacheStatisticsBuffers[m_CurrentFrame] };
+		vkCmdFillBuffer(*commandBuffer.GetBufferPtr(), *statisticsBuffer.GetBufferPtr(), 0, VK_WHOLE_SIZE, 0);
+
+		Buffer::Barrier barrier{};
+		{
+			barrier.srcStage	= VK_PIPELINE_STAGE_TRANSFER_BIT;
+			barrier.dstStage	= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			barrier.srcAccess	= VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccess	= VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		}
+		statisticsBuffer.MakeBarrier(&commandBuffer, barrier);
+	}
+
+	// before lighting so the fused path can render into the swapchain
+	{
+		Image::Transition transition{};
+		{
+			transition.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			transition.srcStage = VK_PIPELINE_STAGE_2_NONE;
+			transition.dstStage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+			transition.srcAccess = VK_ACCESS_2_NONE;
+			transition.dstAccess = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+		}
+		swapchainImage.MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
+	}
+
+	if (computeLighting)
+	{
+		RecordComputeLighting(commandBuffer);
+	}
 	// lighting render pass
+	else
 	{
+		m_GPUProfilerPtr->BeginPass(&commandBuffer, "lighting (fragment)");
+
 		VkRenderingAttachmentInfo colorAttachment{};
 		{
 			VkClearValue clearColor = { { .0f, .0f, .0f, 1.f } };
 			colorAttachment.sType		= VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
-			colorAttachment.imageView	= *m_HDRRenderTargetPtr->GetFirstViewPtr();
-			colorAttachment.imageLayout = m_HDRRenderTargetPtr->GetCurrentLayout();
+			Image& target{ hdrRoundTrip ? *m_HDRRenderTargetPtr : swapchainImage };
+			colorAttachment.imageView	= *target.GetFirstViewPtr();
+			colorAttachment.imageLayout = target.GetCurrentLayout();
 			colorAttachment.loadOp		= VK_ATTACHMENT_LOAD_OP_CLEAR;
 			colorAttachment.storeOp		= VK_ATTACHMENT_STORE_OP_STORE;
 			colorAttachment.clearValue	= clearColor;
@@ -1609,7 +3845,7 @@ void DynamicRenderingApp::RecordCommandBufferWithPrepass(CommandBuffer& commandB
 		VkRenderingInfo renderingInfo{};
 		{
 			renderingInfo.sType					= VK_STRUCTURE_TYPE_RENDERING_INFO;
-			renderingInfo.renderArea			= VkRect2D{ VkOffset2D{}, swapchainImage.GetExtent() };
+			renderingInfo.renderArea			= VkRect2D{ VkOffset2D{}, renderExtent };
 			renderingInfo.layerCount			= 1;
 			renderingInfo.colorAttachmentCount	= std::size(attachments);
 			renderingInfo.pColorAttachments		= attachments;
@@ -1620,22 +3856,23 @@ void DynamicRenderingApp::RecordCommandBufferWithPrepass(CommandBuffer& commandB
 
 		{
 			VkDescriptorSet descSets[]{ *m_GlobalDescriptorSets[m_CurrentFrame].GetDescriptorSetPtr(), *m_LocalDescriptorSets[m_CurrentFrame].GetDescriptorSetPtr(), *m_FrameDescriptorSets[m_CurrentFrame].GetDescriptorSetPtr()};
-			vkCmdBindPipeline(*commandBuffer.GetBufferPtr(), VK_PIPELINE_BIND_POINT_GRAPHICS, *m_LightingPipelinePtr->GetPipelinePtr());
+			Pipeline& pipeline{ hdrRoundTrip ? *m_LightingPipelinePtr : *m_FusedLightingPipelinePtr };
+			vkCmdBindPipeline(*commandBuffer.GetBufferPtr(), VK_PIPELINE_BIND_POINT_GRAPHICS, *pipeline.GetPipelinePtr());
 			vkCmdBindDescriptorSets(*commandBuffer.GetBufferPtr(), VK_PIPELINE_BIND_POINT_GRAPHICS, 
 									*m_LightingPipelineLayoutPtr->GetPipelineLayoutPtr(), 0, std::size(descSets), descSets, 0, nullptr);
 									 
 			VkViewport viewport{};
 			viewport.x = .0f;
 			viewport.y = .0f;
-			viewport.width = static_cast<float>(m_SwapChainPtr->GetExtentPtr()->width);
-			viewport.height = static_cast<float>(m_SwapChainPtr->GetExtentPtr()->height);
+			viewport.width = static_cast<float>(renderExtent.width);
+			viewport.height = static_cast<float>(renderExtent.height);
 			viewport.minDepth = .0f;
 			viewport.maxDepth = 1.f;
 			vkCmdSetViewport(*commandBuffer.GetBufferPtr(), 0, 1, &viewport);
 
 			VkRect2D scissor{};
 			scissor.offset = { 0, 0 };
-			scissor.extent = *m_SwapChainPtr->GetExtentPtr();
+			scissor.extent = renderExtent;
 			vkCmdSetScissor(*commandBuffer.GetBufferPtr(), 0, 1, &scissor);
 
 			std::vector<Mesh>& meshes{ m_ScenePtr->GetMeshes() };
@@ -1647,46 +3884,48 @@ void DynamicRenderingApp::RecordCommandBufferWithPrepass(CommandBuffer& commandB
 		}
 
 		vkCmdEndRendering(*commandBuffer.GetBufferPtr());
+		m_GPUProfilerPtr->EndPass(&commandBuffer);
 	}
 
+	// the cache copies depth and the hdr target as soon as lighting finished, the transitions below wait on the copy instead
+	const bool copiesHistory{ m_Settings.lightingCache };
+	if (copiesHistory)
+		RecordLightingHistory(commandBuffer, renderExtent, computeLighting);
+
 	{
 		Image::Transition transition{};
 		{
 			transition.newLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
-			transition.srcStage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+			transition.srcStage = copiesHistory ? VK_PIPELINE_STAGE_TRANSFER_BIT : computeLighting ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
 			transition.dstStage = VK_PIPELINE_STAGE_2_NONE;
-			transition.srcAccess = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+			transition.srcAccess = copiesHistory ? VK_ACCESS_TRANSFER_READ_BIT : computeLighting ? VK_ACCESS_SHADER_READ_BIT : VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
 			transition.dstAccess = VK_ACCESS_2_NONE;
 		}
 		m_DepthTexturePtr->MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
 	}
 
+	if (hdrRoundTrip)
 	{
 		Image::Transition transition{};
 		{
 			transition.newLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
-			transition.srcStage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
-			transition.dstStage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
-			transition.srcAccess = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
-			transition.dstAccess = VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT;;
+			transition.srcStage = copiesHistory ? VK_PIPELINE_STAGE_TRANSFER_BIT : computeLighting ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+			transition.dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			transition.srcAccess = copiesHistory ? VK_ACCESS_TRANSFER_READ_BIT : computeLighting ? VK_ACCESS_SHADER_WRITE_BIT : VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+			transition.dstAccess = VK_ACCESS_SHADER_READ_BIT;
 		}
 		m_HDRRenderTargetPtr->MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
 	}
 
-	{
-		Image::Transition transition{};
-		{
-			transition.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-			transition.srcStage = VK_PIPELINE_STAGE_2_NONE;
-			transition.dstStage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
-			transition.srcAccess = VK_ACCESS_2_NONE;
-			transition.dstAccess = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
-		}
-		swapchainImage.MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
-	}
+	// round trip is forced while auto exposure is on
+	if (m_Settings.exposureMode == ExposureMode::Auto)
+		RecordAutoExposure(commandBuffer);
 
 	// blit pass
+	if (hdrRoundTrip)
 	{
+		m_GPUProfilerPtr->BeginPass(&commandBuffer, "blit");
+
 		VkRenderingAttachmentInfo colorAttachment{};
 		{
 			VkClearValue clearColor = { { .0f, .0f, .0f, 1.f } };
@@ -1741,6 +3980,7 @@ void DynamicRenderingApp::RecordCommandBufferWithPrepass(CommandBuffer& commandB
 		}
 
 		vkCmdEndRendering(*commandBuffer.GetBufferPtr());
+		m_GPUProfilerPtr->EndPass(&commandBuffer);
 	}
 
 	{
@@ -1753,13 +3993,313 @@ void DynamicRenderingApp::RecordCommandBufferWithPrepass(CommandBuffer& commandB
 		swapchainImage.MakeTransition(m_DevicePtr.get(), &commandBuffer, transition);
 	}
 
+	m_GPUProfilerPtr->EndFrame(&commandBuffer);
 	commandBuffer.End(m_DevicePtr.get());
 }
 
+void DynamicRenderingApp::RecordComputeLighting(CommandBuffer& commandBuffer)
+{
+	const VkExtent2D extent{ GetRenderExtent() };
+	const uint32_t tilesX{ (extent.width + m_Settings.tileSize - 1) / m_Settings.tileSize };
+	const uint32_t tilesY{ (extent.height + m_Settings.tileSize - 1) / m_Settings.tileSize };
+
+	Buffer& dispatchBuffer{ m_TileDispatchBuffers[m_CurrentFrame] };
+	Buffer& tileListBuffer{ m_TileListSSBO[m_CurrentFrame] };
+
+	// every class starts with an empty dispatch, classification only increments x
+	{
+		VkDispatchIndirectCommand emptyDispatches[static_cast<size_t>(TileClass::Count)]{};
+		for (VkDispatchIndirectCommand& dispatch : emptyDispatches)
+			dispatch = VkDispatchIndirectCommand{ 0, 1, 1 };
+		vkCmdUpdateBuffer(*commandBuffer.GetBufferPtr(), *dispatchBuffer.GetBufferPtr(), 0, sizeof(emptyDispatches), emptyDispatches);
+
+		Buffer::Barrier barrier{};
+		{
+			barrier.srcStage	= VK_PIPELINE_STAGE_TRANSFER_BIT;
+			barrier.dstStage	= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			barrier.srcAccess	= VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccess	= VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		}
+		dispatchBuffer.MakeBarrier(&commandBuffer, barrier);
+	}
+
+	VkDescriptorSet descSets[]{ *m_GlobalDescriptorSets[m_CurrentFrame].GetDescriptorSetPtr(), *m_LocalDescriptorSets[m_CurrentFrame].GetDescriptorSetPtr(),
+								*m_FrameDescriptorSets[m_CurrentFrame].GetDescriptorSetPtr(), *m_TiledLightingDescriptorSets[m_CurrentFrame].GetDescriptorSetPtr() };
+	vkCmdBindDescriptorSets(*commandBuffer.GetBufferPtr(), VK_PIPELINE_BIND_POINT_COMPUTE,
+							*m_TiledLightingPipelineLayoutPtr->GetPipelineLayoutPtr(), 0, std::size(descSets), descSets, 0, nullptr);
+
+	datatype::TiledLightingConstants constants{};
+	constants.extent = glm::ivec2{ extent.width, extent.height };
+	constants.tileCapacity = GetTileCapacity();
+	vkCmdPushConstants(*commandBuffer.GetBufferPtr(), *m_TiledLightingPipelineLayoutPtr->GetPipelineLayoutPtr(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+
+	float colour[4]{ .0f, 1.f, .0f, 1.f };
+
+	m_GPUProfilerPtr->BeginPass(&commandBuffer, "tile classification");
+	commandBuffer.BeginLabel("tile classification", colour);
+	vkCmdBindPipeline(*commandBuffer.GetBufferPtr(), VK_PIPELINE_BIND_POINT_COMPUTE, *m_TileClassificationPipelinePtr->GetPipelinePtr());
+	vkCmdDispatch(*commandBuffer.GetBufferPtr(), tilesX, tilesY, 1);
+	commandBuffer.EndLabel();
+	m_GPUProfilerPtr->EndPass(&commandBuffer);
+
+	{
+		Buffer::Barrier barrier{};
+		{
+			barrier.srcStage	= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			barrier.dstStage	= VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT;
+			barrier.srcAccess	= VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.dstAccess	= VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_HOST_READ_BIT; // host reads tile counts for statistics
+		}
+		dispatchBuffer.MakeBarrier(&commandBuffer, barrier);
+		tileListBuffer.MakeBarrier(&commandBuffer, barrier);
+	}
+
+	// one specialized pipeline per class, empty classes dispatch zero groups
+	m_GPUProfilerPtr->BeginPass(&commandBuffer, "lighting (compute)");
+	commandBuffer.BeginLabel("tiled lighting", colour);
+	for (uint32_t tileClass{}; tileClass < static_cast<uint32_t>(TileClass::Count); ++tileClass)
+	{
+		vkCmdBindPipeline(*commandBuffer.GetBufferPtr(), VK_PIPELINE_BIND_POINT_COMPUTE, *m_TiledLightingPipelines[tileClass].GetPipelinePtr());
+		vkCmdDispatchIndirect(*commandBuffer.GetBufferPtr(), *dispatchBuffer.GetBufferPtr(), tileClass * sizeof(VkDispatchIndirectCommand));
+	}
+	commandBuffer.EndLabel();
+	m_GPUProfilerPtr->EndPass(&commandBuffer);
+}
+
+uint32_t DynamicRenderingApp::GetTileCapacity()
+{
+	const VkExtent2D extent{ *m_SwapChainPtr->GetExtentPtr() };
+	return ((extent.width + m_Settings.tileSize - 1) / m_Settings.tileSize) * ((extent.height + m_Settings.tileSize - 1) / m_Settings.tileSize);
+}
+
+void DynamicRenderingApp::ToggleLightingPath()
+{
+	if (!m_IsComputeLightingSupported)
+	{
+		std::cout << "compute lighting is not supported on this device\n";
+		return;
+	}
+
+	m_Settings.computeLighting = !m_Settings.computeLighting;
+	std::cout << "lighting path: " << (m_Settings.computeLighting ? "compute" : "fragment") << '\n';
+}
+
+void DynamicRenderingApp::TogglePathRecording()
+{
+	m_IsRecordingPath = !m_IsRecordingPath;
+	if (m_IsRecordingPath)
+	{
+		m_RecordedPath.Clear();
+		m_RecordingTime = .0f;
+		std::cout << "recording camera path, press R again to save it\n";
+		return;
+	}
+
+	// called from a glfw callback, nothing may be thrown through it
+	try
+	{
+		m_RecordedPath.Save(RECORDED_PATH_FILE);
+		std::cout << "saved camera path of " << m_RecordedPath.GetDuration() << " s to " << RECORDED_PATH_FILE << '\n';
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << '\n';
+	}
+}
+
+void DynamicRenderingApp::ToggleNodeAnimation()
+{
+	if (m_AnimatedNode != SceneGraph::NO_PARENT)
+	{
+		m_ScenePtr->SetNodeTransform(m_AnimatedNode, m_AnimatedNodeTransform);
+		m_AnimatedNode = SceneGraph::NO_PARENT;
+		return;
+	}
+
+	float distance{ FLT_MAX };
+	const uint32_t meshIndex{ m_ScenePtr->Raycast(m_CameraPtr->GetPosition(), m_CameraPtr->GetForward(), distance) };
+	if (meshIndex == Bvh::NO_HIT)
+	{
+		std::cout << "no mesh in the center of the view to animate\n";
+		return;
+	}
+
+	// instanced meshes share the geometry but every placement has its own node, the first is spun
+	m_AnimatedNode = m_ScenePtr->GetMeshes()[meshIndex].m_Instances[0].node;
+	m_AnimatedNodeTransform = m_ScenePtr->GetGraph().GetLocalTransform(m_AnimatedNode);
+	m_AnimationAngle = .0f;
+	std::cout << "spinning scene node " << m_AnimatedNode << " of mesh " << meshIndex << ", press N again to stop\n";
+}
+
+void DynamicRenderingApp::AnimateNode()
+{
+	if (m_AnimatedNode == SceneGraph::NO_PARENT)
+		return;
+
+	// around the local up axis so the node stays in place whatever the scale of its parents
+	m_AnimationAngle += WorldTime::GetElapsedSec() * NODE_SPIN_SPEED;
+	m_ScenePtr->SetNodeTransform(m_AnimatedNode, m_AnimatedNodeTransform * glm::rotate(glm::mat4{ 1.f }, m_AnimationAngle, glm::vec3{ .0f, 1.f, .0f }));
+}
+
+void DynamicRenderingApp::PrintStatistics()
+{
+	const char* profileNames[]{ "reference", "balanced", "compact" };
+	const VkExtent2D extent{ *m_SwapChainPtr->GetExtentPtr() };
+	const uint32_t bytesPerPixel{ m_GBufferLayout.GetBytesPerPixel() };
+	std::cout << "g-buffer profile " << profileNames[static_cast<uint32_t>(m_Settings.gbufferProfile)] << ": " << bytesPerPixel << " bytes per pixel, "
+			  << bytesPerPixel * extent.width * extent.height / (1024.f * 1024.f) << " MB\n";
+
+	m_GPUProfilerPtr->PrintReport(std::cout);
+
+	const double fragmentMs{ m_GPUProfilerPtr->GetAverageMs("lighting (fragment)") };
+	const double computeMs{ m_GPUProfilerPtr->GetAverageMs("tile classification") + m_GPUProfilerPtr->GetAverageMs("lighting (compute)") };
+	if (m_Settings.lightingCache)
+	{
+		std::cout << "lighting cache: 1 in " << m_Settings.cacheRefreshRatio << " pixels refreshed per frame";
+		const datatype::LightingCacheStatistics& statistics{ m_LightingCacheStatistics };
+		const uint32_t litCount{ statistics.evaluatedCount + statistics.cachedCount };
+		if (m_Settings.cacheValidation && litCount > 0)
+		{
+			std::cout << ", " << 100.f * statistics.cachedCount / litCount << "% of lit pixels cached, relative error mean "
+					  << ((statistics.cachedCount > 0) ? statistics.errorSum / LIGHTING_CACHE_ERROR_SCALE / statistics.cachedCount : .0f) << " max " << statistics.maxError / LIGHTING_CACHE_ERROR_SCALE;
+		}
+		std::cout << '\n';
+	}
+
+	if (m_Settings.occlusionCulling)
+	{
+		const datatype::OcclusionStatistics& statistics{ m_OcclusionStatistics };
+		std::cout << "occlusion culling: " << statistics.visibleCount << " of " << m_ScenePtr->GetMeshes().size() << " meshes visible, "
+				  << statistics.frustumCulledCount << " outside the frustum, " << statistics.occlusionCulledCount << " occluded, pyramid "
+				  << m_DepthPyramidPtr->GetExtent().width << "x" << m_DepthPyramidPtr->GetExtent().height << " with " << m_DepthPyramidPtr->GetMipLevels() << " levels\n";
+		if (m_Settings.clusterCulling)
+		{
+			std::cout << "cluster culling: " << statistics.visibleClusterCount << " of " << m_MeshletCount << " clusters drawn, " << statistics.frustumCulledClusterCount
+					  << " outside the frustum, " << statistics.backfaceCulledClusterCount << " backfacing, " << statistics.occlusionCulledClusterCount << " occluded\n";
+		}
+	}
+
+	// in mesh order every neighbour with another material costs a push
+	uint32_t unsortedMaterialChanges{};
+	const std::vector<Mesh>& meshes{ m_ScenePtr->GetMeshes() };
+	for (size_t index{ 1 }; index < meshes.size(); ++index)
+		unsortedMaterialChanges += (meshes[index].GetMaterialIndex() != meshes[index - 1].GetMaterialIndex()) ? 1 : 0;
+	std::cout << "draw lists: " << m_ScenePtr->GetMaterials().size() << " materials, g-buffer material changes " << m_GBufferDrawList.CountMaterialChanges()
+			  << " sorted instead of " << unsortedMaterialChanges << ", shadows " << m_ShadowDrawList.CountMaterialChanges() << '\n';
+
+	std::cout << "levels of detail: " << m_LodTriangleCount << " triangles submitted, meshes per level";
+	for (uint32_t count : m_LodMeshCounts)
+		std::cout << ' ' << count;
+	std::cout << '\n';
+
+	if (m_Settings.dynamicResolution)
+	{
+		const VkExtent2D renderExtent{ GetRenderExtent() };
+		std::cout << "dynamic resolution: " << renderExtent.width << "x" << renderExtent.height << " (scale " << m_RenderScale << "), gpu frame "
+				  << m_GPUProfilerPtr->GetLastFrameMs() << " ms, budget " << m_Settings.frameBudgetMs << " ms\n";
+	}
+
+	std::cout << "lighting fragment " << fragmentMs << " ms, compute (classification + lighting) " << computeMs << " ms\n";
+
+	const char* classNames[]{ "sky", "unlit", "shadowed", "full" };
+	std::cout << "tiles of " << m_Settings.tileSize << "x" << m_Settings.tileSize << ":";
+	for (size_t index{}; index < m_TileCounts.size(); ++index)
+		std::cout << ' ' << classNames[index] << ' ' << m_TileCounts[index];
+	std::cout << '\n';
+
+	const uint32_t cascadeCount{ m_ShadowCascadesPtr->GetCascadeCount() };
+	const std::vector<datatype::ShadowCascade>& cascades{ m_ShadowCascadesPtr->GetCascades() };
+	std::cout << "shadows: " << cascadeCount << " cascades of " << m_Settings.shadowResolution << "x" << m_Settings.shadowResolution
+			  << ", far cascades every " << m_ShadowUpdateInterval << " frames, budget " << m_Settings.shadowBudgetMs << " ms\n";
+	for (uint32_t light{}; light < m_DirectionalLights.size(); ++light)
+	{
+		std::cout << "  light " << light << " casters per cascade:";
+		for (uint32_t cascade{}; cascade < cascadeCount; ++cascade)
+			std::cout << ' ' << m_ShadowCascadesPtr->GetCasterCount(light * cascadeCount + cascade) << " (to " << cascades[cascade].SplitDepth << ')';
+		std::cout << '\n';
+	}
+
+	if (m_ScenePtr->IsStreaming())
+	{
+		const StreamingGrid& grid{ m_ScenePtr->GetStreamingGrid() };
+		const Scene::StreamingStatistics& statistics{ m_ScenePtr->GetStreamingStatistics() };
+		const size_t residentCells{ static_cast<size_t>(std::count_if(grid.GetCells().begin(), grid.GetCells().end(), [](const StreamingGrid::Cell& cell) { return cell.isResident; })) };
+		std::cout << "streaming: " << residentCells << " of " << grid.GetCells().size() << " cells resident, " << grid.GetResidentSize() / (1024 * 1024) << " of "
+				  << m_Settings.streamingBudgetMB << " MB, " << statistics.loadedCells << " cells loaded (" << statistics.loadedBytes / (1024 * 1024) << " MB) and "
+				  << statistics.evictedCells << " evicted so far\n";
+	}
+
+	if (m_TextureStreamerPtr->IsEnabled())
+	{
+		const size_t textureCount{ m_ScenePtr->GetTextures().size() };
+		size_t fullCount{};
+		for (uint32_t texture{}; texture < textureCount; ++texture)
+			fullCount += m_TextureStreamerPtr->GetResidentLevel(texture) == 0;
+		const TextureStreamer::Statistics& statistics{ m_TextureStreamerPtr->GetStatistics() };
+		std::cout << "texture streaming: " << m_TextureStreamerPtr->GetResidentSize() / (1024 * 1024) << " of " << m_TextureStreamerPtr->GetBudget() / (1024 * 1024) << " MB, "
+				  << fullCount << " of " << textureCount << " textures at full resolution, " << statistics.uploads << " uploads (" << statistics.uploadedBytes / (1024 * 1024)
+				  << " MB) so far" << (m_DevicePtr->IsExtensionEnabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) ? "" : ", heap budget unknown") << '\n';
+	}
+
+	BenchmarkBvh();
+}
+
+void DynamicRenderingApp::BenchmarkBvh()
+{
+	const Bvh& bvh{ m_ScenePtr->GetMeshBvh() };
+	const glm::mat4 viewProjection{ m_CameraPtr->GetProjection() * m_CameraPtr->CalculateView() };
+
+	std::vector<uint32_t> visible{};
+	const auto frustumStart{ std::chrono::steady_clock::now() };
+	for (uint32_t repeat{}; repeat < BVH_BENCHMARK_QUERIES; ++repeat)
+	{
+		visible.clear();
+		bvh.QueryFrustum(viewProjection, visible);
+	}
+	const double frustumUs{ std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - frustumStart).count() / BVH_BENCHMARK_QUERIES };
+
+	// a grid of rays through the view, like picking every few pixels
+	const glm::mat4 inverseViewProjection{ glm::inverse(viewProjection) };
+	const glm::vec3& origin{ m_CameraPtr->GetPosition() };
+	uint32_t hitCount{};
+	const auto rayStart{ std::chrono::steady_clock::now() };
+	for (uint32_t y{}; y < BVH_BENCHMARK_GRID; ++y)
+	{
+		for (uint32_t x{}; x < BVH_BENCHMARK_GRID; ++x)
+		{
+			const glm::vec2 ndc{ (x + .5f) / BVH_BENCHMARK_GRID * 2.f - 1.f, (y + .5f) / BVH_BENCHMARK_GRID * 2.f - 1.f };
+			const glm::vec4 target{ inverseViewProjection * glm::vec4{ ndc, 1.f, 1.f } };
+			float distance{ FLT_MAX };
+			hitCount += (m_ScenePtr->Raycast(origin, glm::normalize(glm::vec3{ target } / target.w - origin), distance) != Bvh::NO_HIT) ? 1 : 0;
+		}
+	}
+	const double raySeconds{ std::chrono::duration<double>(std::chrono::steady_clock::now() - rayStart).count() };
+	const uint32_t rayCount{ BVH_BENCHMARK_GRID * BVH_BENCHMARK_GRID };
+
+	std::cout << "mesh bvh: " << bvh.GetNodes().size() << " nodes, sah cost " << bvh.CalculateCost() << ", frustum query " << frustumUs << " us for "
+			  << visible.size() << " of " << bvh.GetPrimitiveCount() << " meshes, " << rayCount / raySeconds / 1e6 << " million rays per second against "
+			  << (m_Settings.triangleBvh ? "triangles" : "mesh bounds") << ", " << hitCount << " of " << rayCount << " hit\n";
+}
+
 void DynamicRenderingApp::DrawFrame()
 {
 	vkWaitForFences(*m_DevicePtr->GetDevicePtr(), 1, &m_InFlightFences[m_CurrentFrame], VK_TRUE, UINT64_MAX);
 
+	// the fence guarantees the previous use of this frame finished on the gpu
+	m_GPUProfilerPtr->Resolve(m_DevicePtr.get(), m_CurrentFrame);
+	AdjustShadowUpdateInterval();
+	AdjustRenderScale();
+	if (IsComputeLightingActive())
+	{
+		const uint32_t* dispatches{ static_cast<const uint32_t*>(m_TileDispatchBuffers[m_CurrentFrame].GetMappedData()) };
+		for (size_t index{}; index < m_TileCounts.size(); ++index)
+			m_TileCounts[index] = dispatches[index * 3];
+	}
+	if (m_Settings.lightingCache && m_Settings.cacheValidation)
+		std::memcpy(&m_LightingCacheStatistics, m_LightingCacheStatisticsBuffers[m_CurrentFrame].GetMappedData(), sizeof(m_LightingCacheStatistics));
+	if (m_Settings.occlusionCulling)
+		std::memcpy(&m_OcclusionStatistics, m_OcclusionStatisticsPtr->GetMappedData(), sizeof(m_OcclusionStatistics));
+
 	uint32_t imageIndex;
 	VkResult result = vkAcquireNextImageKHR(*m_DevicePtr->GetDevicePtr(), *m_SwapChainPtr->GetSwapchainPtr(), UINT64_MAX, m_ImageAvailableSemaphores[m_CurrentFrame], VK_NULL_HANDLE, &imageIndex);
 	if (result == VK_ERROR_OUT_OF_DATE_KHR)
@@ -1775,7 +4315,14 @@ void DynamicRenderingApp::DrawFrame()
 	//std::cout << "flight fence reset\n";
 	vkResetFences(*m_DevicePtr->GetDevicePtr(), 1, &m_InFlightFences[m_CurrentFrame]);
 
-	RecordCommandBufferWithPrepass(m_CommandBuffers[m_CurrentFrame], imageIndex);
+	AnimateNode();
+	const bool hasSceneMoved{ m_ScenePtr->UpdateTransforms() };
+	m_ScenePtr->UpdateStreaming(m_DevicePtr.get(), m_CommandPoolPtr.get(), m_CameraPtr->GetPosition(), static_cast<uint64_t>(m_Settings.streamingBudgetMB * 1024.f * 1024.f));
+	m_TextureStreamerPtr->Update(m_DevicePtr.get(), m_CommandPoolPtr.get(), m_ScenePtr.get(), m_GlobalDescriptorSets, 5);
+	SelectLods();
+	BuildDrawLists();
+	const uint32_t shadowUpdateMask{ UpdateShadowCascades(hasSceneMoved) };
+	RecordCommandBufferWithPrepass(m_CommandBuffers[m_CurrentFrame], imageIndex, shadowUpdateMask);
 	//RecordCommandBufferNoPrepass(m_CommandBuffers[m_CurrentFrame], imageIndex);
 
 	UpdateUniformBuffer(m_CurrentFrame);
@@ -1796,9 +4343,23 @@ void DynamicRenderingApp::UpdateUniformBuffer(uint32_t currentImage)
 	float deltaTime = std::chrono::duration<float>(currentTime - startTime).count();
 
 	datatype::ModelViewProjection mvp{};
-	mvp.model = m_ScenePtr->GetModelMatrix();
+	// the model matrix is the root of the scene graph, the instance transforms already contain it
+	mvp.model = glm::mat4{ 1.f };
 	mvp.view = m_CameraPtr->CalculateView();
 	mvp.projection = m_CameraPtr->GetProjection();
+	mvp.inverseView = glm::inverse(mvp.view);
+	mvp.inverseProjection = glm::inverse(mvp.projection);
+	const VkExtent2D renderExtent{ GetRenderExtent() };
+	mvp.renderScale = glm::vec2{ static_cast<float>(renderExtent.width) / m_SwapChainPtr->GetExtentPtr()->width, static_cast<float>(renderExtent.height) / m_SwapChainPtr->GetExtentPtr()->height };
+	mvp.previousViewProjection = m_PreviousViewProjection;
+	mvp.previousRenderScale = m_PreviousRenderScale;
+	mvp.frameIndex = m_LightingCacheFrame++;
+	// the history copied this frame is reprojected by the next one
+	if (m_Settings.lightingCache)
+	{
+		m_PreviousViewProjection = mvp.projection * mvp.view;
+		m_PreviousRenderScale = mvp.renderScale;
+	}
 	m_MVPUBuffers[currentImage].UpdateMappedData(&mvp, sizeof(mvp), 0);
 }
 
@@ -1853,20 +4414,85 @@ void DynamicRenderingApp::Present(uint32_t imageIndex)
 
 void DynamicRenderingApp::MainLoop()
 {
-	while (!glfwWindowShouldClose(m_WindowPtr))
+	if (m_Settings.benchmarkFrames > 0)
+	{
+		RunBenchmark();
+		return;
+	}
+
 	while (!glfwWindowShouldClose(m_WindowPtr))
 	{
 		WorldTime::Tick();
 		glfwPollEvents();
 		m_CameraPtr->Update(m_WindowPtr);
+		if (m_IsRecordingPath)
+		{
+			m_RecordedPath.AddKey(m_RecordingTime, m_CameraPtr->GetPosition(), m_CameraPtr->GetForward());
+			m_RecordingTime += WorldTime::GetElapsedSec();
+		}
 		DrawFrame();
 	}
 
 	vkDeviceWaitIdle(*m_DevicePtr->GetDevicePtr());
 }
 
+void DynamicRenderingApp::RunBenchmark()
+{
+	CameraPath path{ CameraPath::CreateDefault() };
+	if (!m_Settings.benchmarkPath.empty())
+		path.Load(m_Settings.benchmarkPath);
+
+	// the camera and the exposure adaptation see the same time every run, however long frames take
+	const float step{ m_Settings.benchmarkStepMs / 1000.f };
+	WorldTime::SetFixedStep(step);
+	if (!m_GPUProfilerPtr->IsSupported())
+		std::cout << "gpu timestamps are not supported, gpu times are written as nan\n";
+
+	Benchmark benchmark{ m_Settings.benchmarkFrames, m_Settings.benchmarkStepMs, m_Settings.benchmarkPath };
+	const size_t framesInFlight{ static_cast<size_t>(MAX_FRAMES_IN_FLIGHT) };
+	const uint32_t frameCount{ BENCHMARK_WARMUP_FRAMES + m_Settings.benchmarkFrames };
+	for (uint32_t frame{}; frame < frameCount && !glfwWindowShouldClose(m_WindowPtr); ++frame)
+	{
+		const auto frameStart{ std::chrono::steady_clock::now() };
+		WorldTime::Tick();
+		glfwPollEvents();
+
+		// warm up frames stay at the start of the path
+		const uint32_t measuredFrame{ frame - std::min(frame, BENCHMARK_WARMUP_FRAMES) };
+		glm::vec3 position{};
+		glm::vec3 forward{};
+		path.Sample(measuredFrame * step, position, forward);
+		m_CameraPtr->SetPose(position, forward);
+		DrawFrame();
+
+		// drawing resolved the gpu time of the last frame that used the same frame in flight
+		if (benchmark.GetFrameCount() >= framesInFlight)
+			benchmark.SetGpuMs(benchmark.GetFrameCount() - framesInFlight, m_GPUProfilerPtr->GetLastFrameMs());
+		if (frame >= BENCHMARK_WARMUP_FRAMES)
+			benchmark.AddFrame(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+	}
+
+	vkDeviceWaitIdle(*m_DevicePtr->GetDevicePtr());
+	WorldTime::SetFixedStep(.0f);
+
+	// the frames still in flight when the loop ended, oldest first
+	const size_t pendingCount{ std::min(benchmark.GetFrameCount(), framesInFlight) };
+	for (size_t pending{}; pending < pendingCount; ++pending)
+	{
+		const uint32_t frameInFlight{ static_cast<uint32_t>((m_CurrentFrame + framesInFlight - pendingCount + pending) % framesInFlight) };
+		m_GPUProfilerPtr->Resolve(m_DevicePtr.get(), frameInFlight);
+		benchmark.SetGpuMs(benchmark.GetFrameCount() - pendingCount + pending, m_GPUProfilerPtr->GetLastFrameMs());
+	}
+
+	benchmark.PrintSummary(std::cout);
+	benchmark.Write(m_Settings.benchmarkOutput);
+	std::cout << "benchmark results written to " << m_Settings.benchmarkOutput << '\n';
+}
+
 void DynamicRenderingApp::End()
 {
+	// peaks are only known at the end, live sizes are everything still loaded
+	m_DevicePtr->GetMemoryTracker().PrintReport(std::cout, m_DevicePtr.get());
 	m_DeletionQueue.Flush();
 
 	glfwTerminate();
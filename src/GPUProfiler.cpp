@@ -0,0 +1,169 @@
+#include "GPUProfiler.h"
+#include "Device.h"
+#include "CommandPool.h"
+#include <stdexcept>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+
+GPUProfiler::GPUProfiler(Device* device, uint32_t queueFamilyIndex, uint32_t maxPassesPerFrame, uint32_t framesInFlight)
+	: m_MaxPasses{ maxPassesPerFrame }
+	, m_FramePasses(framesInFlight)
+	, m_IsFrameRecorded(framesInFlight)
+{
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(*device->GetPhysicalDevicePtr(), &properties);
+
+	uint32_t familyCount{};
+	vkGetPhysicalDeviceQueueFamilyProperties(*device->GetPhysicalDevicePtr(), &familyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> families(familyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(*device->GetPhysicalDevicePtr(), &familyCount, families.data());
+
+	const uint32_t validBits{ families[queueFamilyIndex].timestampValidBits };
+	m_IsSupported = validBits > 0 && properties.limits.timestampPeriod > .0f;
+	if (!m_IsSupported)
+		return;
+
+	m_TimestampPeriod = properties.limits.timestampPeriod;
+	m_TimestampMask = (validBits >= 64) ? ~0ull : ((1ull << validBits) - 1);
+
+	VkQueryPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	poolInfo.queryCount = GetFirstQuery(framesInFlight);
+
+	if (vkCreateQueryPool(*device->GetDevicePtr(), &poolInfo, nullptr, &m_QueryPool) != VK_SUCCESS)
+		throw std::runtime_error("failed to create timestamp query pool");
+
+	device->SetObjectName(VK_OBJECT_TYPE_QUERY_POOL, (uint64_t)m_QueryPool, "GPU profiler query pool");
+}
+
+void GPUProfiler::Resolve(Device* device, uint32_t frame)
+{
+	// a stale time would pass for a measurement of this frame
+	m_LastFrameMs = std::numeric_limits<double>::quiet_NaN();
+	std::vector<std::string>& passes{ m_FramePasses[frame] };
+	const bool isFrameRecorded{ m_IsFrameRecorded[frame] != 0 };
+	m_IsFrameRecorded[frame] = 0;
+	if (!m_IsSupported || !isFrameRecorded)
+	{
+		passes.clear();
+		return;
+	}
+
+	const auto getMs{ [this](uint64_t begin, uint64_t end)
+		{
+			return static_cast<double>(((end & m_TimestampMask) - (begin & m_TimestampMask)) & m_TimestampMask) * m_TimestampPeriod / 1e6;
+		} };
+	// the frame pair sits behind the slots of every pass, the unused slots in between are not read
+	std::vector<uint64_t> timestamps((m_MaxPasses + 1) * 2);
+	const VkResult result = vkGetQueryPoolResults(*device->GetDevicePtr(), m_QueryPool, GetFirstQuery(frame) + m_MaxPasses * 2, 2,
+												  2 * sizeof(uint64_t), &timestamps[m_MaxPasses * 2], sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+	const VkResult passResult = passes.empty() ? VK_SUCCESS : vkGetQueryPoolResults(*device->GetDevicePtr(), m_QueryPool, GetFirstQuery(frame), static_cast<uint32_t>(passes.size() * 2),
+												  passes.size() * 2 * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+	// not ready means the frame was never submitted, skip it instead of stalling
+	if (result != VK_SUCCESS || passResult != VK_SUCCESS)
+	{
+		passes.clear();
+		return;
+	}
+
+	m_LastFrameMs = getMs(timestamps[m_MaxPasses * 2], timestamps[m_MaxPasses * 2 + 1]);
+	for (size_t index{}; index < passes.size(); ++index)
+	{
+		const double ms{ getMs(timestamps[index * 2], timestamps[index * 2 + 1]) };
+		PassTiming& timing{ m_Timings[passes[index]] };
+		timing.lastMs = ms;
+		timing.averageMs = (timing.samples == 0) ? ms : timing.averageMs + (ms - timing.averageMs) * SMOOTHING;
+		++timing.samples;
+	}
+	passes.clear();
+}
+
+void GPUProfiler::BeginFrame(CommandBuffer* command, uint32_t frame)
+{
+	m_CurrentFrame = frame;
+	m_FramePasses[frame].clear();
+	m_SkippedPasses = 0;
+	if (!m_IsSupported)
+		return;
+
+	vkCmdResetQueryPool(*command->GetBufferPtr(), m_QueryPool, GetFirstQuery(frame), (m_MaxPasses + 1) * 2);
+	vkCmdWriteTimestamp(*command->GetBufferPtr(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_QueryPool, GetFirstQuery(frame) + m_MaxPasses * 2);
+}
+
+void GPUProfiler::EndFrame(CommandBuffer* command)
+{
+	if (!m_IsSupported)
+		return;
+
+	vkCmdWriteTimestamp(*command->GetBufferPtr(), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_QueryPool, GetFirstQuery(m_CurrentFrame) + m_MaxPasses * 2 + 1);
+	m_IsFrameRecorded[m_CurrentFrame] = 1;
+}
+
+void GPUProfiler::BeginPass(CommandBuffer* command, const std::string& name)
+{
+	std::vector<std::string>& passes{ m_FramePasses[m_CurrentFrame] };
+	if (!m_IsSupported)
+		return;
+	// over the cap the pass is not timed, its end has to be skipped too
+	if (passes.size() >= m_MaxPasses)
+	{
+		if (!m_HasWarnedOverflow)
+			std::cerr << "gpu profiler is out of queries, " << name << " and later passes are not timed\n";
+		m_HasWarnedOverflow = true;
+		++m_SkippedPasses;
+		return;
+	}
+
+	const uint32_t query{ GetFirstQuery(m_CurrentFrame) + static_cast<uint32_t>(passes.size()) * 2 };
+	vkCmdWriteTimestamp(*command->GetBufferPtr(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_QueryPool, query);
+	passes.emplace_back(name);
+}
+
+void GPUProfiler::EndPass(CommandBuffer* command)
+{
+	std::vector<std::string>& passes{ m_FramePasses[m_CurrentFrame] };
+	if (!m_IsSupported || passes.empty())
+		return;
+	if (m_SkippedPasses > 0)
+	{
+		--m_SkippedPasses;
+		return;
+	}
+
+	const uint32_t query{ GetFirstQuery(m_CurrentFrame) + static_cast<uint32_t>(passes.size() - 1) * 2 + 1 };
+	vkCmdWriteTimestamp(*command->GetBufferPtr(), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_QueryPool, query);
+}
+
+double GPUProfiler::GetAverageMs(const std::string& name) const
+{
+	auto it = m_Timings.find(name);
+	return (it == m_Timings.end()) ? .0 : it->second.averageMs;
+}
+
+double GPUProfiler::GetLastMs(const std::string& name) const
+{
+	auto it = m_Timings.find(name);
+	return (it == m_Timings.end()) ? .0 : it->second.lastMs;
+}
+
+void GPUProfiler::PrintReport(std::ostream& stream) const
+{
+	if (!m_IsSupported)
+	{
+		stream << "gpu timestamps are not supported by the graphics queue\n";
+		return;
+	}
+
+	stream << "pass timings (average / last) ms\n";
+	for (const auto& [name, timing] : m_Timings)
+		stream << "  " << std::left << std::setw(32) << name << std::right << std::fixed << std::setprecision(3)
+			   << std::setw(8) << timing.averageMs << " / " << std::setw(8) << timing.lastMs << '\n';
+}
+
+void GPUProfiler::Destroy(Device* device)
+{
+	if (m_QueryPool != VK_NULL_HANDLE)
+		vkDestroyQueryPool(*device->GetDevicePtr(), m_QueryPool, nullptr);
+}
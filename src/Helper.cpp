@@ -1,6 +1,8 @@
 #include "Helper.h"
 #include <fstream>
 #include <iostream>
+#include <algorithm>
+#include <bit>
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
@@ -37,3 +39,44 @@ bool HELP::HasStencilComponent(VkFormat format)
 	return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
 }
 
+uint32_t HELP::GetFormatSize(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_R8G8_UNORM:
+		return 2;
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+	case VK_FORMAT_B8G8R8A8_UNORM:
+	case VK_FORMAT_B8G8R8A8_SRGB:
+	case VK_FORMAT_R16G16_UNORM:
+	case VK_FORMAT_R16G16_SFLOAT:
+	case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+	case VK_FORMAT_E5B9G9R9_UFLOAT_PACK32:
+	case VK_FORMAT_D32_SFLOAT:
+	case VK_FORMAT_D24_UNORM_S8_UINT:
+		return 4;
+	case VK_FORMAT_D32_SFLOAT_S8_UINT:
+		return 5;
+	case VK_FORMAT_R16G16B16A16_UNORM:
+	case VK_FORMAT_R16G16B16A16_SFLOAT:
+		return 8;
+	case VK_FORMAT_R32G32B32A32_SFLOAT:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+uint32_t HELP::GetMipLevelCount(uint32_t width, uint32_t height)
+{
+	return static_cast<uint32_t>(std::bit_width(std::max(std::max(width, height), 1u)));
+}
+
+VkDeviceSize HELP::GetImageSize(VkFormat format, uint32_t width, uint32_t height, uint32_t layers, uint32_t mipLevels)
+{
+	VkDeviceSize size{};
+	for (uint32_t level{}; level < mipLevels; ++level)
+		size += static_cast<VkDeviceSize>(std::max(width >> level, 1u)) * std::max(height >> level, 1u) * layers * GetFormatSize(format);
+	return size;
+}
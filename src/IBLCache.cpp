@@ -0,0 +1,138 @@
+#include "IBLCache.h"
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <stdexcept>
+
+namespace
+{
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t key;
+	};
+
+	template<typename T>
+	void Write(std::ofstream& file, const T& value)
+	{
+		file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	bool Read(std::ifstream& file, T& value)
+	{
+		return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+
+	void WriteImage(std::ofstream& file, const IBLCache::CachedImage& image)
+	{
+		Write(file, image.format);
+		Write(file, image.width);
+		Write(file, image.height);
+		Write(file, image.layers);
+		Write(file, image.mipLevels);
+		Write(file, static_cast<uint64_t>(image.data.size()));
+		file.write(image.data.data(), image.data.size());
+	}
+
+	bool ReadImage(std::ifstream& file, IBLCache::CachedImage& image)
+	{
+		uint64_t size{};
+		if (!Read(file, image.format) || !Read(file, image.width) || !Read(file, image.height) ||
+			!Read(file, image.layers) || !Read(file, image.mipLevels) || !Read(file, size))
+			return false;
+
+		image.data.resize(size);
+		return static_cast<bool>(file.read(image.data.data(), size));
+	}
+}
+
+IBLCache::IBLCache(const std::string& sourcePath, const BakeParameters& parameters)
+	: m_Path{ std::filesystem::path(sourcePath).replace_extension(".iblcache").string() }
+	, m_Key{ Hash(HashFile(sourcePath), &parameters, sizeof(BakeParameters)) }
+{
+}
+
+bool IBLCache::Load(BakedEnvironment& environment) const
+{
+	std::ifstream file(m_Path, std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	FileHeader header{};
+	if (!Read(file, header) || header.magic != MAGIC || header.version != VERSION || header.key != m_Key)
+		return false;
+
+	if (!ReadImage(file, environment.cubeMap))
+		return false;
+
+	uint32_t coefficientCount{};
+	if (!Read(file, coefficientCount))
+		return false;
+	environment.irradianceSH.resize(coefficientCount);
+	if (!file.read(reinterpret_cast<char*>(environment.irradianceSH.data()), coefficientCount * sizeof(float)))
+		return false;
+
+	return ReadImage(file, environment.prefilteredCubeMap) && ReadImage(file, environment.brdfLUT);
+}
+
+void IBLCache::Save(const BakedEnvironment& environment) const
+{
+	// written next to the final file first so an interrupted write never leaves a valid looking cache
+	const std::string temporaryPath{ m_Path + ".tmp" };
+	{
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			std::cerr << "failed to write ibl cache " << m_Path << '\n';
+			return;
+		}
+
+		Write(file, FileHeader{ MAGIC, VERSION, m_Key });
+		WriteImage(file, environment.cubeMap);
+		Write(file, static_cast<uint32_t>(environment.irradianceSH.size()));
+		file.write(reinterpret_cast<const char*>(environment.irradianceSH.data()), environment.irradianceSH.size() * sizeof(float));
+		WriteImage(file, environment.prefilteredCubeMap);
+		WriteImage(file, environment.brdfLUT);
+
+		if (!file)
+		{
+			std::cerr << "failed to write ibl cache " << m_Path << '\n';
+			return;
+		}
+	}
+
+	std::error_code error{};
+	std::filesystem::rename(temporaryPath, m_Path, error);
+	if (error)
+		std::cerr << "failed to write ibl cache " << m_Path << ": " << error.message() << '\n';
+}
+
+// fnv-1a, streamed so the source is never held in memory twice
+uint64_t IBLCache::HashFile(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+		throw std::runtime_error("failed to open file " + path);
+
+	uint64_t hash{ FNV_OFFSET_BASIS };
+	std::vector<char> chunk(1 << 16);
+	while (file)
+	{
+		file.read(chunk.data(), chunk.size());
+		hash = Hash(hash, chunk.data(), static_cast<size_t>(file.gcount()));
+	}
+	return hash;
+}
+
+uint64_t IBLCache::Hash(uint64_t hash, const void* data, size_t size)
+{
+	const unsigned char* bytes{ static_cast<const unsigned char*>(data) };
+	for (size_t index{}; index < size; ++index)
+	{
+		hash ^= bytes[index];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
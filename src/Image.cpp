@@ -5,6 +5,7 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 #include <variant>
+#include <algorithm>
 #include "CommandPool.h"
 #include "Buffer.h"
 
@@ -29,7 +30,8 @@ void Image::MakeTransition(Device* device, CommandBuffer* command, const Transit
 	
 	barrier.image = m_Image;
 	barrier.subresourceRange.aspectMask = m_Aspect;
-	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseMipLevel = transition.baseMipLevel;
+	barrier.subresourceRange.levelCount = transition.levelCount;
 	barrier.subresourceRange.layerCount = transition.layerCount;
 	barrier.subresourceRange.baseArrayLayer = transition.baseLayerLevel;
 
@@ -48,8 +50,81 @@ void Image::MakeTransition(Device* device, CommandBuffer* command, const Transit
 	m_CurrentLayout = transition.newLayout;
 }
 
+void Image::GenerateMipmaps(CommandBuffer* command)
+{
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = m_Image;
+	barrier.subresourceRange.aspectMask = m_Aspect;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = m_Layers;
+
+	// first level is read by the first blit, the remaining ones are overwritten
+	{
+		barrier.oldLayout = m_CurrentLayout;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = 1;
+		vkCmdPipelineBarrier(*command->GetBufferPtr(), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+	if (m_MipLevels > 1)
+	{
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.subresourceRange.baseMipLevel = 1;
+		barrier.subresourceRange.levelCount = m_MipLevels - 1;
+		vkCmdPipelineBarrier(*command->GetBufferPtr(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	int32_t width{ static_cast<int32_t>(m_Extent.width) };
+	int32_t height{ static_cast<int32_t>(m_Extent.height) };
+	for (uint32_t level{ 1 }; level < m_MipLevels; ++level)
+	{
+		VkImageBlit blit{};
+		blit.srcOffsets[1] = { width, height, 1 };
+		blit.srcSubresource.aspectMask = m_Aspect;
+		blit.srcSubresource.mipLevel = level - 1;
+		blit.srcSubresource.layerCount = m_Layers;
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
+		blit.dstOffsets[1] = { width, height, 1 };
+		blit.dstSubresource.aspectMask = m_Aspect;
+		blit.dstSubresource.mipLevel = level;
+		blit.dstSubresource.layerCount = m_Layers;
+
+		vkCmdBlitImage(*command->GetBufferPtr(), m_Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+		// written level becomes the source of the next blit
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.subresourceRange.baseMipLevel = level;
+		barrier.subresourceRange.levelCount = 1;
+		vkCmdPipelineBarrier(*command->GetBufferPtr(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = m_MipLevels;
+	vkCmdPipelineBarrier(*command->GetBufferPtr(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	m_CurrentLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+}
+
 void Image::Destroy(VkDevice device)
 {
+	if (m_MemoryTrackerPtr)
+		m_MemoryTrackerPtr->Remove(m_Memory);
 	vkDestroyImage(device, m_Image, nullptr);
 	for (VkImageView& imageView : m_Views)
 		vkDestroyImageView(device, imageView, nullptr);
@@ -87,6 +162,12 @@ ImageBuilder& ImageBuilder::SetLayers(uint32_t layers)
 	return *this;
 }
 
+ImageBuilder& ImageBuilder::SetMipLevels(uint32_t mipLevels)
+{
+	m_MipLevels = mipLevels;
+	return *this;
+}
+
 ImageBuilder& ImageBuilder::SetViewType(VkImageViewType type)
 {
 	m_ViewType = type;
@@ -117,6 +198,19 @@ ImageBuilder& ImageBuilder::SetFilePath(const std::string& path)
 	return *this;
 }
 
+ImageBuilder& ImageBuilder::SetCategory(MemoryCategory category)
+{
+	m_Category = category;
+	return *this;
+}
+
+ImageBuilder& ImageBuilder::SetPixels(const void* data, VkDeviceSize size)
+{
+	m_Pixels = data;
+	m_PixelsSize = size;
+	return *this;
+}
+
 void ImageBuilder::Build(std::unique_ptr<Image>& image, Device* device, CommandPool* commandPool, VkImageUsageFlags usage, VkMemoryPropertyFlags properties)
 {
 	image.reset(new Image());
@@ -160,6 +254,14 @@ void ImageBuilder::Build(Image& image, Device* device, CommandPool* commandPool,
 
 		stbi_image_free(((m_Format == VK_FORMAT_R32G32B32A32_SFLOAT) ? (void*)std::get<float*>(pixels) : (void*)std::get<stbi_uc*>(pixels)));
 	}
+	else if (m_Pixels)
+	{
+		BufferBuilder builder{};
+		stagingBuffer = builder
+			.MapMemory()
+			.Build(device, commandPool, m_PixelsSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		stagingBuffer->UpdateMappedData(m_Pixels, m_PixelsSize, 0);
+	}
 
 	image.m_Extent.width = m_Width;
 	image.m_Extent.height = m_Height;
@@ -173,17 +275,19 @@ void ImageBuilder::Build(Image& image, Device* device, CommandPool* commandPool,
 	imageInfo.extent.width = m_Width;
 	imageInfo.extent.height = m_Height;
 	imageInfo.extent.depth = 1;
-	imageInfo.mipLevels = 1;
+	imageInfo.mipLevels = m_MipLevels;
 	imageInfo.arrayLayers = m_Layers;
 	imageInfo.format = m_Format;
 	imageInfo.tiling = m_Tiling;
 	imageInfo.initialLayout = m_InitialLayout;
-	imageInfo.usage = usage | (!m_FilePath.empty() * VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+	imageInfo.usage = usage | (stagingBuffer.has_value() * VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+	m_Usage = imageInfo.usage;
 	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 	imageInfo.flags = m_Flags;
 
 	image.m_Layers = m_Layers;
+	image.m_MipLevels = m_MipLevels;
 
 	if (vkCreateImage(*device->GetDevicePtr(), &imageInfo, nullptr, &image.m_Image) != VK_SUCCESS)
 		throw std::runtime_error("failed to create image");
@@ -201,8 +305,16 @@ void ImageBuilder::Build(Image& image, Device* device, CommandPool* commandPool,
 
 	vkBindImageMemory(*device->GetDevicePtr(), image.m_Image, image.m_Memory, 0);
 
+	MemoryCategory category{ MemoryCategory::Texture };
+	if (m_Flags & VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT)
+		category = MemoryCategory::Environment;
+	else if (imageInfo.usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT))
+		category = MemoryCategory::RenderTarget;
+	image.m_MemoryTrackerPtr = &device->GetMemoryTracker();
+	image.m_MemoryTrackerPtr->Add(image.m_Memory, (uint64_t)image.m_Image, m_Category.value_or(category), allocInfo.memoryTypeIndex, allocInfo.allocationSize);
+
 	// after VkImage is created copy loaded image to VkImage
-	if (!m_FilePath.empty())
+	if (stagingBuffer)
 	{
 		// transition to dst
 		SingleTimeCommand command = commandPool->AllocateSingleTimeCommand(*device->GetDevicePtr());
@@ -247,18 +359,28 @@ Image ImageBuilder::Build(Device* device, CommandPool* commandPool, VkImageUsage
 
 void ImageBuilder::CreateView(Image& image, VkDevice device)
 {
+	// cube and array images get a view of every layer first, followed by a 2d view per layer
+	const bool hasLayeredView{ m_ViewType == VK_IMAGE_VIEW_TYPE_CUBE || m_ViewType == VK_IMAGE_VIEW_TYPE_2D_ARRAY };
 	image.m_Views.resize(m_Layers);
-	if (m_ViewType == VK_IMAGE_VIEW_TYPE_CUBE)
+
+	// with extended usage the image may carry usages only an aliased format supports, views in its own format drop them
+	VkImageViewUsageCreateInfo usageInfo{};
+	usageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO;
+	usageInfo.usage = m_Usage & ~VK_IMAGE_USAGE_STORAGE_BIT;
+	const void* viewNext{ (m_Flags & VK_IMAGE_CREATE_EXTENDED_USAGE_BIT) ? &usageInfo : nullptr };
+
+	if (hasLayeredView)
 	{
 		image.m_Views.emplace_back();
 		VkImageViewCreateInfo viewInfo{};
 		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.pNext = viewNext;
 		viewInfo.image = image.m_Image;
 		viewInfo.format = m_Format;
 		viewInfo.viewType = m_ViewType;
 		viewInfo.subresourceRange.aspectMask = m_Aspect;
-		viewInfo.subresourceRange.levelCount = 1;
-		viewInfo.subresourceRange.layerCount = 6;
+		viewInfo.subresourceRange.levelCount = m_MipLevels;
+		viewInfo.subresourceRange.layerCount = (m_ViewType == VK_IMAGE_VIEW_TYPE_CUBE) ? 6 : m_Layers;
 		viewInfo.subresourceRange.baseArrayLayer = 0;
 		if (vkCreateImageView(device, &viewInfo, nullptr, &image.m_Views[0]) != VK_SUCCESS)
 			throw std::runtime_error("failed to create texture image view");
@@ -266,17 +388,18 @@ void ImageBuilder::CreateView(Image& image, VkDevice device)
 
 	VkImageViewCreateInfo viewInfo{};
 	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.pNext = viewNext;
 	viewInfo.image = image.m_Image;
 	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
 	viewInfo.format = m_Format;
 	viewInfo.subresourceRange.aspectMask = m_Aspect;
-	viewInfo.subresourceRange.levelCount = 1;
+	viewInfo.subresourceRange.levelCount = hasLayeredView ? 1 : m_MipLevels;
 	viewInfo.subresourceRange.layerCount = 1;
 	for (int index{}; index < m_Layers; ++index)
 	{
 		viewInfo.subresourceRange.baseArrayLayer = index;
-		if (vkCreateImageView(device, &viewInfo, nullptr, &image.m_Views[index + 1 * (m_ViewType == VK_IMAGE_VIEW_TYPE_CUBE)]) != VK_SUCCESS)
+		if (vkCreateImageView(device, &viewInfo, nullptr, &image.m_Views[index + 1 * hasLayeredView]) != VK_SUCCESS)
 			throw std::runtime_error("failed to create texture image view");
 	}
 
-}
+}
\ No newline at end of file
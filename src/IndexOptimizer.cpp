@@ -0,0 +1,381 @@
+#include "IndexOptimizer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+
+namespace
+{
+	float CachePositionScore(int position, uint32_t cacheSize)
+	{
+		if (position < 0)
+			return .0f;
+		// the triangle just emitted is in the cache anyway, it should not attract its neighbours more than the rest
+		if (position < 3)
+			return .75f;
+		return std::pow(1.f - static_cast<float>(position - 3) / (cacheSize - 3), 1.5f);
+	}
+
+	// vertices with few triangles left are finished first so they leave the cache for good
+	float ValenceScore(uint32_t remainingTriangles)
+	{
+		return (remainingTriangles > 0) ? 2.f / std::sqrt(static_cast<float>(remainingTriangles)) : .0f;
+	}
+}
+
+std::vector<uint32_t> IndexOptimizer::OptimizeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount)
+{
+	const uint32_t triangleCount{ static_cast<uint32_t>(indices.size() / 3) };
+	std::vector<uint32_t> result{};
+	result.reserve(triangleCount * 3);
+	if (triangleCount == 0)
+		return result;
+
+	// live triangles of every vertex, emitted ones are swapped past the remaining count
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (uint32_t index : indices)
+		++remaining[index];
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (uint32_t vertex{}; vertex < vertexCount; ++vertex)
+		offsets[vertex + 1] = offsets[vertex] + remaining[vertex];
+	std::vector<uint32_t> adjacency(indices.size());
+	{
+		std::vector<uint32_t> fill{ offsets.begin(), offsets.end() - 1 };
+		for (uint32_t triangle{}; triangle < triangleCount; ++triangle)
+		{
+			for (uint32_t corner{}; corner < 3; ++corner)
+				adjacency[fill[indices[triangle * 3 + corner]]++] = triangle;
+		}
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (uint32_t vertex{}; vertex < vertexCount; ++vertex)
+		vertexScore[vertex] = ValenceScore(remaining[vertex]);
+
+	std::vector<float> triangleScore(triangleCount);
+	for (uint32_t triangle{}; triangle < triangleCount; ++triangle)
+		triangleScore[triangle] = vertexScore[indices[triangle * 3]] + vertexScore[indices[triangle * 3 + 1]] + vertexScore[indices[triangle * 3 + 2]];
+
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> cache{};
+	std::vector<uint32_t> newCache{};
+	uint32_t cursor{};
+
+	uint32_t best{ static_cast<uint32_t>(std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin()) };
+	while (true)
+	{
+		emitted[best] = true;
+		const uint32_t* triangle{ &indices[best * 3] };
+		for (uint32_t corner{}; corner < 3; ++corner)
+		{
+			const uint32_t vertex{ triangle[corner] };
+			result.push_back(vertex);
+
+			uint32_t* begin{ &adjacency[offsets[vertex]] };
+			uint32_t* end{ begin + remaining[vertex] };
+			uint32_t* found{ std::find(begin, end, best) };
+			if (found != end)
+			{
+				std::swap(*found, *(end - 1));
+				--remaining[vertex];
+			}
+		}
+
+		// the emitted triangle moves to the front, everything pushed past the cache size is evicted
+		newCache.assign(triangle, triangle + 3);
+		for (uint32_t vertex : cache)
+		{
+			if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+				newCache.push_back(vertex);
+		}
+		for (size_t position{}; position < newCache.size(); ++position)
+			cachePosition[newCache[position]] = (position < OPTIMIZER_CACHE_SIZE) ? static_cast<int>(position) : -1;
+
+		for (uint32_t vertex : newCache)
+		{
+			vertexScore[vertex] = CachePositionScore(cachePosition[vertex], OPTIMIZER_CACHE_SIZE) + ValenceScore(remaining[vertex]);
+			for (uint32_t offset{ offsets[vertex] }; offset < offsets[vertex] + remaining[vertex]; ++offset)
+			{
+				const uint32_t neighbour{ adjacency[offset] };
+				triangleScore[neighbour] = vertexScore[indices[neighbour * 3]] + vertexScore[indices[neighbour * 3 + 1]] + vertexScore[indices[neighbour * 3 + 2]];
+			}
+		}
+		if (newCache.size() > OPTIMIZER_CACHE_SIZE)
+			newCache.resize(OPTIMIZER_CACHE_SIZE);
+		std::swap(cache, newCache);
+
+		// best live triangle touching the cache, the neighbourhood is small so this stays linear overall
+		float bestScore{ -1.f };
+		for (uint32_t vertex : cache)
+		{
+			for (uint32_t offset{ offsets[vertex] }; offset < offsets[vertex] + remaining[vertex]; ++offset)
+			{
+				const uint32_t neighbour{ adjacency[offset] };
+				if (triangleScore[neighbour] > bestScore)
+				{
+					bestScore = triangleScore[neighbour];
+					best = neighbour;
+				}
+			}
+		}
+
+		// nothing connected is left, continue with the next triangle in input order
+		if (bestScore < .0f)
+		{
+			while (cursor < triangleCount && emitted[cursor])
+				++cursor;
+			if (cursor == triangleCount)
+				break;
+			best = cursor;
+		}
+	}
+
+	return result;
+}
+
+std::vector<uint32_t> IndexOptimizer::SimulateCacheMisses(const uint32_t* indices, size_t indexCount, uint32_t vertexCount)
+{
+	// fifo through timestamps, a vertex is a hit while it was inserted less than the cache size misses ago
+	std::vector<uint32_t> insertedAt(vertexCount, 0);
+	uint32_t time{ ANALYSIS_CACHE_SIZE + 1 };
+
+	std::vector<uint32_t> misses(indexCount / 3, 0);
+	for (size_t index{}; index + 2 < indexCount; index += 3)
+	{
+		for (uint32_t corner{}; corner < 3; ++corner)
+		{
+			const uint32_t vertex{ indices[index + corner] };
+			if (time - insertedAt[vertex] > ANALYSIS_CACHE_SIZE)
+			{
+				insertedAt[vertex] = time++;
+				++misses[index / 3];
+			}
+		}
+	}
+	return misses;
+}
+
+std::vector<uint32_t> IndexOptimizer::OptimizeOverdraw(const std::vector<datatype::Vertex>& vertices, const std::vector<uint32_t>& indices, float threshold)
+{
+	const uint32_t vertexCount{ static_cast<uint32_t>(vertices.size()) };
+	const size_t triangleCount{ indices.size() / 3 };
+	if (triangleCount == 0)
+		return indices;
+
+	// a triangle missing all three vertices starts over with an empty cache, cutting there costs nothing
+	const std::vector<uint32_t> misses{ SimulateCacheMisses(indices.data(), indices.size(), vertexCount) };
+	std::vector<size_t> hardBoundaries{ 0 };
+	for (size_t triangle{ 1 }; triangle < triangleCount; ++triangle)
+	{
+		if (misses[triangle] == 3)
+			hardBoundaries.push_back(triangle);
+	}
+	hardBoundaries.push_back(triangleCount);
+
+	// inside a run, cut again wherever the piece so far has no worse an acmr than the threshold allows
+	// every piece starts with a cold cache of its own, moving the clock past the cache size empties it
+	std::vector<uint32_t> insertedAt(vertexCount, 0);
+	uint32_t time{ ANALYSIS_CACHE_SIZE + 1 };
+	std::vector<size_t> boundaries{};
+	for (size_t run{}; run + 1 < hardBoundaries.size(); ++run)
+	{
+		const size_t runStart{ hardBoundaries[run] };
+		const size_t runEnd{ hardBoundaries[run + 1] };
+		uint32_t runMisses{};
+		for (size_t triangle{ runStart }; triangle < runEnd; ++triangle)
+			runMisses += misses[triangle];
+		const float runAcmr{ static_cast<float>(runMisses) / (runEnd - runStart) };
+
+		boundaries.push_back(runStart);
+		size_t pieceStart{ runStart };
+		uint32_t pieceMisses{};
+		time += ANALYSIS_CACHE_SIZE + 1;
+		for (size_t triangle{ runStart }; triangle < runEnd; ++triangle)
+		{
+			for (uint32_t corner{}; corner < 3; ++corner)
+			{
+				const uint32_t vertex{ indices[triangle * 3 + corner] };
+				if (time - insertedAt[vertex] > ANALYSIS_CACHE_SIZE)
+				{
+					insertedAt[vertex] = time++;
+					++pieceMisses;
+				}
+			}
+
+			const size_t pieceTriangles{ triangle + 1 - pieceStart };
+			if (triangle + 1 < runEnd && static_cast<float>(pieceMisses) <= pieceTriangles * runAcmr * threshold)
+			{
+				boundaries.push_back(triangle + 1);
+				pieceStart = triangle + 1;
+				pieceMisses = 0;
+				time += ANALYSIS_CACHE_SIZE + 1;
+			}
+		}
+	}
+	boundaries.push_back(triangleCount);
+
+	// pieces facing away from the center of the mesh are likely in front of the rest of it
+	glm::vec3 meshCenter{};
+	float meshArea{};
+	std::vector<float> sortKeys(boundaries.size() - 1);
+	std::vector<glm::vec3> pieceCenters(sortKeys.size());
+	std::vector<glm::vec3> pieceNormals(sortKeys.size());
+	for (size_t piece{}; piece < sortKeys.size(); ++piece)
+	{
+		glm::vec3 center{};
+		glm::vec3 normal{};
+		float area{};
+		for (size_t triangle{ boundaries[piece] }; triangle < boundaries[piece + 1]; ++triangle)
+		{
+			const glm::vec3& a{ vertices[indices[triangle * 3]].position };
+			const glm::vec3& b{ vertices[indices[triangle * 3 + 1]].position };
+			const glm::vec3& c{ vertices[indices[triangle * 3 + 2]].position };
+			const glm::vec3 cross{ glm::cross(b - a, c - a) };
+			const float triangleArea{ glm::length(cross) };
+			center += (a + b + c) * (triangleArea / 3.f);
+			normal += cross;
+			area += triangleArea;
+		}
+		pieceCenters[piece] = (area > .0f) ? center / area : vertices[indices[boundaries[piece] * 3]].position;
+		const float normalLength{ glm::length(normal) };
+		pieceNormals[piece] = (normalLength > .0f) ? normal / normalLength : glm::vec3{};
+		meshCenter += center;
+		meshArea += area;
+	}
+	if (meshArea > .0f)
+		meshCenter /= meshArea;
+	for (size_t piece{}; piece < sortKeys.size(); ++piece)
+		sortKeys[piece] = glm::dot(pieceCenters[piece] - meshCenter, pieceNormals[piece]);
+
+	std::vector<size_t> order(sortKeys.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) { return sortKeys[lhs] > sortKeys[rhs]; });
+
+	std::vector<uint32_t> result{};
+	result.reserve(indices.size());
+	for (size_t piece : order)
+		result.insert(result.end(), indices.begin() + boundaries[piece] * 3, indices.begin() + boundaries[piece + 1] * 3);
+	return result;
+}
+
+void IndexOptimizer::OptimizeVertexFetch(std::vector<datatype::Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	constexpr uint32_t unused{ UINT32_MAX };
+	std::vector<uint32_t> remap(vertices.size(), unused);
+	std::vector<datatype::Vertex> reordered{};
+	reordered.reserve(vertices.size());
+	for (uint32_t& index : indices)
+	{
+		if (remap[index] == unused)
+		{
+			remap[index] = static_cast<uint32_t>(reordered.size());
+			reordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	vertices = std::move(reordered);
+}
+
+void IndexOptimizer::RasterizeOverdraw(const std::vector<datatype::Vertex>& vertices, const uint32_t* indices, size_t indexCount, uint64_t& shaded, uint64_t& covered)
+{
+	glm::vec3 min{ FLT_MAX };
+	glm::vec3 max{ -FLT_MAX };
+	for (size_t index{}; index < indexCount; ++index)
+	{
+		min = glm::min(min, vertices[indices[index]].position);
+		max = glm::max(max, vertices[indices[index]].position);
+	}
+	const glm::vec3 extent{ glm::max(max - min, glm::vec3{ FLT_EPSILON }) };
+
+	std::vector<float> depthBuffer(OVERDRAW_GRID_SIZE * OVERDRAW_GRID_SIZE);
+	// looks along every axis in both directions, mirroring one screen axis keeps the winding of the front faces
+	for (uint32_t view{}; view < 6; ++view)
+	{
+		const int axis{ static_cast<int>(view / 2) };
+		const bool negative{ (view & 1) != 0 };
+		std::fill(depthBuffer.begin(), depthBuffer.end(), FLT_MAX);
+
+		const auto project = [&](const glm::vec3& position)
+		{
+			const glm::vec3 normalized{ (position - min) / extent };
+			const float u{ normalized[(axis + 1) % 3] };
+			const float v{ normalized[(axis + 2) % 3] };
+			const float depth{ normalized[axis] };
+			return glm::vec3{ (negative ? 1.f - u : u) * OVERDRAW_GRID_SIZE, v * OVERDRAW_GRID_SIZE, negative ? depth : 1.f - depth };
+		};
+
+		for (size_t index{}; index + 2 < indexCount; index += 3)
+		{
+			const glm::vec3 a{ project(vertices[indices[index]].position) };
+			const glm::vec3 b{ project(vertices[indices[index + 1]].position) };
+			const glm::vec3 c{ project(vertices[indices[index + 2]].position) };
+
+			// back faces are culled like in the renderer
+			const float area{ (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x) };
+			if (area <= .0f)
+				continue;
+
+			const int minX{ std::max(static_cast<int>(std::floor(std::min({ a.x, b.x, c.x }))), 0) };
+			const int maxX{ std::min(static_cast<int>(std::ceil(std::max({ a.x, b.x, c.x }))), OVERDRAW_GRID_SIZE - 1) };
+			const int minY{ std::max(static_cast<int>(std::floor(std::min({ a.y, b.y, c.y }))), 0) };
+			const int maxY{ std::min(static_cast<int>(std::ceil(std::max({ a.y, b.y, c.y }))), OVERDRAW_GRID_SIZE - 1) };
+			for (int y{ minY }; y <= maxY; ++y)
+			{
+				for (int x{ minX }; x <= maxX; ++x)
+				{
+					const float px{ x + .5f };
+					const float py{ y + .5f };
+					const float wa{ (b.x - px) * (c.y - py) - (b.y - py) * (c.x - px) };
+					const float wb{ (c.x - px) * (a.y - py) - (c.y - py) * (a.x - px) };
+					const float wc{ (a.x - px) * (b.y - py) - (a.y - py) * (b.x - px) };
+					if (wa < .0f || wb < .0f || wc < .0f)
+						continue;
+
+					const float depth{ (wa * a.z + wb * b.z + wc * c.z) / area };
+					float& stored{ depthBuffer[y * OVERDRAW_GRID_SIZE + x] };
+					// an early depth test shades everything that is nearer than what was drawn before
+					if (depth < stored)
+					{
+						stored = depth;
+						++shaded;
+					}
+				}
+			}
+		}
+
+		for (float depth : depthBuffer)
+			covered += (depth < FLT_MAX) ? 1 : 0;
+	}
+}
+
+IndexOptimizer::Statistics IndexOptimizer::Analyze(const std::vector<datatype::Vertex>& vertices, const uint32_t* indices, size_t indexCount)
+{
+	Statistics statistics{};
+	const size_t triangleCount{ indexCount / 3 };
+	if (triangleCount == 0)
+		return statistics;
+
+	const std::vector<uint32_t> misses{ SimulateCacheMisses(indices, indexCount, static_cast<uint32_t>(vertices.size())) };
+	const uint64_t transformed{ std::accumulate(misses.begin(), misses.end(), uint64_t{}) };
+
+	std::vector<bool> referenced(vertices.size(), false);
+	uint64_t uniqueVertices{};
+	for (size_t index{}; index < indexCount; ++index)
+	{
+		if (!referenced[indices[index]])
+		{
+			referenced[indices[index]] = true;
+			++uniqueVertices;
+		}
+	}
+
+	uint64_t shaded{};
+	uint64_t covered{};
+	RasterizeOverdraw(vertices, indices, indexCount, shaded, covered);
+
+	statistics.acmr = static_cast<float>(transformed) / triangleCount;
+	statistics.atvr = static_cast<float>(transformed) / uniqueVertices;
+	statistics.overdraw = (covered > 0) ? static_cast<float>(shaded) / covered : 1.f;
+	return statistics;
+}
@@ -0,0 +1,136 @@
+#include "MemoryTracker.h"
+#include "Device.h"
+#include <algorithm>
+#include <iomanip>
+
+namespace
+{
+	double ToMB(VkDeviceSize size)
+	{
+		return static_cast<double>(size) / (1024.0 * 1024.0);
+	}
+}
+
+void MemoryTracker::Initialize(VkPhysicalDevice physicalDevice)
+{
+	VkPhysicalDeviceMemoryProperties memProperties{};
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+	m_TypeHeaps.resize(memProperties.memoryTypeCount);
+	for (uint32_t index{}; index < memProperties.memoryTypeCount; ++index)
+		m_TypeHeaps[index] = memProperties.memoryTypes[index].heapIndex;
+	m_Heaps.assign(memProperties.memoryHeapCount, Usage{});
+}
+
+void MemoryTracker::Add(VkDeviceMemory memory, uint64_t object, MemoryCategory category, uint32_t memoryType, VkDeviceSize size)
+{
+	const uint32_t heap{ m_TypeHeaps[memoryType] };
+	m_Allocations[memory] = Allocation{ object, category, heap, size, {} };
+	m_Objects[object] = memory;
+	Grow(m_Heaps[heap], size);
+	Grow(m_Categories[static_cast<size_t>(category)], size);
+}
+
+void MemoryTracker::Remove(VkDeviceMemory memory)
+{
+	const auto allocation{ m_Allocations.find(memory) };
+	if (allocation == m_Allocations.end())
+		return;
+
+	Shrink(m_Heaps[allocation->second.heap], allocation->second.size);
+	Shrink(m_Categories[static_cast<size_t>(allocation->second.category)], allocation->second.size);
+	m_Objects.erase(allocation->second.object);
+	m_Allocations.erase(allocation);
+}
+
+void MemoryTracker::SetName(uint64_t object, const char* name)
+{
+	const auto memory{ m_Objects.find(object) };
+	if (memory != m_Objects.end())
+		m_Allocations[memory->second].name = name;
+}
+
+void MemoryTracker::Grow(Usage& usage, VkDeviceSize size)
+{
+	usage.live += size;
+	usage.peak = std::max(usage.peak, usage.live);
+	++usage.count;
+}
+
+void MemoryTracker::Shrink(Usage& usage, VkDeviceSize size)
+{
+	usage.live -= size;
+	--usage.count;
+}
+
+void MemoryTracker::PrintReport(std::ostream& stream, Device* device) const
+{
+	const std::vector<Device::HeapBudget> budgets{ device->GetHeapBudgets() };
+	const bool hasBudget{ device->IsExtensionEnabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) };
+	const std::ios::fmtflags flags{ stream.flags() };
+	const std::streamsize precision{ stream.precision() };
+	stream << std::fixed << std::setprecision(1) << "device memory:\n";
+
+	std::vector<uint32_t> heaps(m_Heaps.size());
+	for (uint32_t heap{}; heap < heaps.size(); ++heap)
+		heaps[heap] = heap;
+	std::sort(heaps.begin(), heaps.end(), [this](uint32_t lhs, uint32_t rhs) { return m_Heaps[lhs].live > m_Heaps[rhs].live; });
+	for (uint32_t heap : heaps)
+	{
+		const Usage& usage{ m_Heaps[heap] };
+		stream << "  heap " << heap << ((budgets[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " (device local)" : " (host)") << ": "
+			   << ToMB(usage.live) << " MB in " << usage.count << " allocations, peak " << ToMB(usage.peak) << " MB";
+		// the process usage includes memory not allocated through buffers and images, like the swapchain
+		if (hasBudget)
+			stream << ", process uses " << ToMB(budgets[heap].usage) << " of " << ToMB(budgets[heap].budget) << " MB budget";
+		stream << ", " << ToMB(budgets[heap].size) << " MB heap\n";
+	}
+
+	std::vector<MemoryCategory> categories;
+	for (size_t category{}; category < m_Categories.size(); ++category)
+		categories.push_back(static_cast<MemoryCategory>(category));
+	std::sort(categories.begin(), categories.end(), [this](MemoryCategory lhs, MemoryCategory rhs) { return GetCategoryUsage(lhs).live > GetCategoryUsage(rhs).live; });
+	for (MemoryCategory category : categories)
+	{
+		const Usage& usage{ GetCategoryUsage(category) };
+		stream << "  " << std::left << std::setw(14) << GetCategoryName(category) << std::right << std::setw(9) << ToMB(usage.live) << " MB in "
+			   << usage.count << " allocations, peak " << ToMB(usage.peak) << " MB\n";
+	}
+
+	std::vector<const Allocation*> allocations;
+	for (const auto& [memory, allocation] : m_Allocations)
+		allocations.push_back(&allocation);
+	const size_t listedCount{ std::min(allocations.size(), REPORT_ALLOCATION_COUNT) };
+	std::partial_sort(allocations.begin(), allocations.begin() + listedCount, allocations.end(), [](const Allocation* lhs, const Allocation* rhs) { return lhs->size > rhs->size; });
+
+	stream << "  largest allocations:\n";
+	for (size_t index{}; index < listedCount; ++index)
+	{
+		const Allocation& allocation{ *allocations[index] };
+		stream << "    " << std::setw(9) << ToMB(allocation.size) << " MB  " << std::left << std::setw(14) << GetCategoryName(allocation.category) << std::right
+			   << (allocation.name.empty() ? "unnamed" : allocation.name) << '\n';
+	}
+	if (allocations.size() > listedCount)
+	{
+		VkDeviceSize restSize{};
+		for (size_t index{ listedCount }; index < allocations.size(); ++index)
+			restSize += allocations[index]->size;
+		stream << "    " << std::setw(9) << ToMB(restSize) << " MB  in " << allocations.size() - listedCount << " smaller allocations\n";
+	}
+	stream.flags(flags);
+	stream.precision(precision);
+}
+
+const char* MemoryTracker::GetCategoryName(MemoryCategory category)
+{
+	switch (category)
+	{
+	case MemoryCategory::RenderTarget:	return "render targets";
+	case MemoryCategory::Texture:		return "textures";
+	case MemoryCategory::Environment:	return "environment";
+	case MemoryCategory::Geometry:		return "geometry";
+	case MemoryCategory::Staging:		return "staging";
+	case MemoryCategory::Buffer:		return "buffers";
+	default:							return "unknown";
+	}
+}
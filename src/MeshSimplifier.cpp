@@ -0,0 +1,281 @@
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <unordered_map>
+
+void MeshSimplifier::Quadric::AddPlane(const glm::dvec3& normal, double distance, double area)
+{
+	a00 += area * normal.x * normal.x;
+	a01 += area * normal.x * normal.y;
+	a02 += area * normal.x * normal.z;
+	a11 += area * normal.y * normal.y;
+	a12 += area * normal.y * normal.z;
+	a22 += area * normal.z * normal.z;
+	b0 += area * normal.x * distance;
+	b1 += area * normal.y * distance;
+	b2 += area * normal.z * distance;
+	c += area * distance * distance;
+	weight += area;
+}
+
+void MeshSimplifier::Quadric::Add(const Quadric& other)
+{
+	a00 += other.a00;
+	a01 += other.a01;
+	a02 += other.a02;
+	a11 += other.a11;
+	a12 += other.a12;
+	a22 += other.a22;
+	b0 += other.b0;
+	b1 += other.b1;
+	b2 += other.b2;
+	c += other.c;
+	weight += other.weight;
+}
+
+double MeshSimplifier::Quadric::Evaluate(const glm::dvec3& position) const
+{
+	const double x{ position.x };
+	const double y{ position.y };
+	const double z{ position.z };
+	const double error{ a00 * x * x + a11 * y * y + a22 * z * z + 2. * (a01 * x * y + a02 * x * z + a12 * y * z) + 2. * (b0 * x + b1 * y + b2 * z) + c };
+	return (weight > .0) ? std::max(error, .0) / weight : .0;
+}
+
+std::vector<uint32_t> MeshSimplifier::Simplify(const std::vector<datatype::Vertex>& vertices, const std::vector<uint32_t>& indices, size_t targetIndexCount, float targetError, float& resultError)
+{
+	const uint32_t vertexCount{ static_cast<uint32_t>(vertices.size()) };
+	resultError = .0f;
+
+	// vertices split only by their attributes share a position, moving one of them would tear the surface
+	std::unordered_map<glm::vec3, uint32_t> positionIds{};
+	std::vector<uint32_t> positionId(vertexCount);
+	std::vector<uint32_t> positionUsers{};
+	for (uint32_t vertex{}; vertex < vertexCount; ++vertex)
+	{
+		const auto [it, inserted] { positionIds.try_emplace(vertices[vertex].position, static_cast<uint32_t>(positionUsers.size())) };
+		if (inserted)
+			positionUsers.push_back(0);
+		positionId[vertex] = it->second;
+		++positionUsers[it->second];
+	}
+
+	// an edge without a twin in the opposite direction is on an open border
+	std::unordered_map<uint64_t, uint32_t> directedEdges{};
+	const auto edgeKey = [&](uint32_t from, uint32_t to) { return (static_cast<uint64_t>(positionId[from]) << 32) | positionId[to]; };
+	for (size_t index{}; index + 2 < indices.size(); index += 3)
+	{
+		for (uint32_t corner{}; corner < 3; ++corner)
+			++directedEdges[edgeKey(indices[index + corner], indices[index + (corner + 1) % 3])];
+	}
+	std::vector<bool> borderPosition(positionUsers.size(), false);
+	for (size_t index{}; index + 2 < indices.size(); index += 3)
+	{
+		for (uint32_t corner{}; corner < 3; ++corner)
+		{
+			const uint32_t from{ indices[index + corner] };
+			const uint32_t to{ indices[index + (corner + 1) % 3] };
+			if (directedEdges.find(edgeKey(to, from)) == directedEdges.end())
+			{
+				borderPosition[positionId[from]] = true;
+				borderPosition[positionId[to]] = true;
+			}
+		}
+	}
+
+	std::vector<bool> locked(vertexCount);
+	for (uint32_t vertex{}; vertex < vertexCount; ++vertex)
+		locked[vertex] = positionUsers[positionId[vertex]] > 1 || borderPosition[positionId[vertex]];
+
+	std::vector<Quadric> quadrics(vertexCount, Quadric{});
+	for (size_t index{}; index + 2 < indices.size(); index += 3)
+	{
+		const glm::dvec3 a{ vertices[indices[index]].position };
+		const glm::dvec3 b{ vertices[indices[index + 1]].position };
+		const glm::dvec3 c{ vertices[indices[index + 2]].position };
+		const glm::dvec3 cross{ glm::cross(b - a, c - a) };
+		const double length{ glm::length(cross) };
+		if (length <= .0)
+			continue;
+
+		const glm::dvec3 normal{ cross / length };
+		const double distance{ -glm::dot(normal, a) };
+		for (uint32_t corner{}; corner < 3; ++corner)
+			quadrics[indices[index + corner]].AddPlane(normal, distance, length * .5);
+	}
+
+	struct Collapse
+	{
+		double cost;
+		uint32_t from;
+		uint32_t to;
+	};
+
+	std::vector<uint32_t> result{ indices };
+	const double maxCost{ static_cast<double>(targetError) * targetError };
+	double maxAppliedCost{};
+
+	std::vector<uint32_t> triangleOffsets(vertexCount + 1);
+	std::vector<uint32_t> vertexTriangles{};
+	std::vector<Collapse> collapses{};
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<bool> touched(vertexCount);
+
+	// every pass applies the cheapest collapses that do not share a neighbourhood, then rebuilds the adjacency
+	while (result.size() > targetIndexCount)
+	{
+		const uint32_t triangleCount{ static_cast<uint32_t>(result.size() / 3) };
+
+		std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+		for (uint32_t index : result)
+			++triangleOffsets[index + 1];
+		for (uint32_t vertex{}; vertex < vertexCount; ++vertex)
+			triangleOffsets[vertex + 1] += triangleOffsets[vertex];
+		vertexTriangles.resize(result.size());
+		{
+			std::vector<uint32_t> fill{ triangleOffsets.begin(), triangleOffsets.end() - 1 };
+			for (uint32_t triangle{}; triangle < triangleCount; ++triangle)
+			{
+				for (uint32_t corner{}; corner < 3; ++corner)
+					vertexTriangles[fill[result[triangle * 3 + corner]]++] = triangle;
+			}
+		}
+
+		collapses.clear();
+		for (uint32_t triangle{}; triangle < triangleCount; ++triangle)
+		{
+			for (uint32_t corner{}; corner < 3; ++corner)
+			{
+				const uint32_t from{ result[triangle * 3 + corner] };
+				if (locked[from])
+					continue;
+
+				for (uint32_t other{ 1 }; other < 3; ++other)
+				{
+					const uint32_t to{ result[triangle * 3 + (corner + other) % 3] };
+					Quadric merged{ quadrics[from] };
+					merged.Add(quadrics[to]);
+					const double cost{ merged.Evaluate(glm::dvec3{ vertices[to].position }) };
+					if (cost <= maxCost)
+						collapses.push_back(Collapse{ cost, from, to });
+				}
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& lhs, const Collapse& rhs) { return lhs.cost < rhs.cost; });
+
+		for (uint32_t vertex{}; vertex < vertexCount; ++vertex)
+			remap[vertex] = vertex;
+		std::fill(touched.begin(), touched.end(), false);
+
+		const size_t trianglesToRemove{ (result.size() - targetIndexCount) / 3 };
+		size_t removedTriangles{};
+		size_t appliedCollapses{};
+		for (const Collapse& collapse : collapses)
+		{
+			if (touched[collapse.from] || touched[collapse.to])
+				continue;
+
+			// the triangles that survive the collapse must keep facing the same way
+			bool flips{};
+			uint32_t sharedTriangles{};
+			for (uint32_t offset{ triangleOffsets[collapse.from] }; offset < triangleOffsets[collapse.from + 1] && !flips; ++offset)
+			{
+				const uint32_t* triangle{ &result[vertexTriangles[offset] * 3] };
+				if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+				{
+					++sharedTriangles;
+					continue;
+				}
+
+				glm::vec3 before[3]{};
+				glm::vec3 after[3]{};
+				for (uint32_t corner{}; corner < 3; ++corner)
+				{
+					before[corner] = vertices[triangle[corner]].position;
+					after[corner] = vertices[(triangle[corner] == collapse.from) ? collapse.to : triangle[corner]].position;
+				}
+				const glm::vec3 normalBefore{ glm::cross(before[1] - before[0], before[2] - before[0]) };
+				const glm::vec3 normalAfter{ glm::cross(after[1] - after[0], after[2] - after[0]) };
+				flips = glm::dot(normalBefore, normalAfter) <= .0f;
+			}
+			if (flips)
+				continue;
+
+			// neighbours of the moved vertex wait for the next pass, their flip checks assumed the old positions
+			for (uint32_t offset{ triangleOffsets[collapse.from] }; offset < triangleOffsets[collapse.from + 1]; ++offset)
+			{
+				for (uint32_t corner{}; corner < 3; ++corner)
+					touched[result[vertexTriangles[offset] * 3 + corner]] = true;
+			}
+
+			remap[collapse.from] = collapse.to;
+			quadrics[collapse.to].Add(quadrics[collapse.from]);
+			maxAppliedCost = std::max(maxAppliedCost, collapse.cost);
+			++appliedCollapses;
+
+			removedTriangles += sharedTriangles;
+			if (removedTriangles >= trianglesToRemove)
+				break;
+		}
+
+		if (appliedCollapses == 0)
+			break;
+
+		size_t writeIndex{};
+		for (size_t index{}; index + 2 < result.size(); index += 3)
+		{
+			const uint32_t a{ remap[result[index]] };
+			const uint32_t b{ remap[result[index + 1]] };
+			const uint32_t c{ remap[result[index + 2]] };
+			if (a == b || b == c || c == a)
+				continue;
+
+			result[writeIndex++] = a;
+			result[writeIndex++] = b;
+			result[writeIndex++] = c;
+		}
+		result.resize(writeIndex);
+	}
+
+	resultError = static_cast<float>(std::sqrt(maxAppliedCost));
+	return result;
+}
+
+MeshSimplifier::Result MeshSimplifier::BuildLodChain(const std::vector<datatype::Vertex>& vertices, const std::vector<uint32_t>& indices)
+{
+	Result result{};
+	result.indices = indices;
+	result.lods.push_back(datatype::MeshLod{ 0, static_cast<uint32_t>(indices.size()), .0f });
+
+	glm::vec3 min{ FLT_MAX };
+	glm::vec3 max{ -FLT_MAX };
+	for (uint32_t index : indices)
+	{
+		min = glm::min(min, vertices[index].position);
+		max = glm::max(max, vertices[index].position);
+	}
+	const float maxError{ indices.empty() ? .0f : MAX_RELATIVE_ERROR * glm::length(max - min) };
+
+	size_t previousIndexCount{ indices.size() };
+	float previousError{};
+	while (result.lods.size() < MAX_LOD_COUNT)
+	{
+		const size_t targetIndexCount{ static_cast<size_t>(previousIndexCount * LOD_REDUCTION) / 3 * 3 };
+		if (targetIndexCount < MIN_LOD_TRIANGLES * 3)
+			break;
+
+		float error{};
+		const std::vector<uint32_t> lod{ Simplify(vertices, indices, targetIndexCount, maxError, error) };
+		if (lod.size() > previousIndexCount * MIN_LOD_GAIN)
+			break;
+
+		// selection walks the levels in order and expects the error to grow
+		previousError = std::max(previousError, error);
+		result.lods.push_back(datatype::MeshLod{ static_cast<uint32_t>(result.indices.size()), static_cast<uint32_t>(lod.size()), previousError });
+		result.indices.insert(result.indices.end(), lod.begin(), lod.end());
+		previousIndexCount = lod.size();
+	}
+
+	return result;
+}
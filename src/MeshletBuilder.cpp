@@ -0,0 +1,104 @@
+#include "MeshletBuilder.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+MeshletBuilder::Result MeshletBuilder::Build(const std::vector<datatype::Vertex>& vertices, const std::vector<uint32_t>& indices)
+{
+	Result result{};
+	result.indices.reserve(indices.size());
+
+	// slot of a vertex in the current cluster, reset through the cluster vertex list
+	constexpr uint32_t unused{ UINT32_MAX };
+	std::vector<uint32_t> localIndices(vertices.size(), unused);
+	std::vector<uint32_t> clusterVertices{};
+	clusterVertices.reserve(MAX_VERTICES);
+
+	uint32_t firstIndex{};
+	const auto flush = [&]()
+	{
+		const uint32_t indexCount{ static_cast<uint32_t>(result.indices.size()) - firstIndex };
+		if (indexCount == 0)
+			return;
+
+		datatype::Meshlet meshlet{};
+		meshlet.firstIndex = firstIndex;
+		meshlet.indexCount = indexCount;
+		ComputeBounds(vertices, result.indices.data() + firstIndex, indexCount, meshlet);
+		result.meshlets.push_back(meshlet);
+
+		for (uint32_t vertex : clusterVertices)
+			localIndices[vertex] = unused;
+		clusterVertices.clear();
+		firstIndex = static_cast<uint32_t>(result.indices.size());
+	};
+
+	// greedy in index order, the input is already ordered for vertex cache locality so neighbours stay together
+	for (size_t triangle{}; triangle + 2 < indices.size(); triangle += 3)
+	{
+		const uint32_t* corners{ &indices[triangle] };
+		const uint32_t newVertices{ static_cast<uint32_t>((localIndices[corners[0]] == unused) + (localIndices[corners[1]] == unused) + (localIndices[corners[2]] == unused)) };
+		const uint32_t triangleCount{ (static_cast<uint32_t>(result.indices.size()) - firstIndex) / 3 };
+		if (clusterVertices.size() + newVertices > MAX_VERTICES || triangleCount + 1 > MAX_TRIANGLES)
+			flush();
+
+		for (uint32_t corner{}; corner < 3; ++corner)
+		{
+			if (localIndices[corners[corner]] == unused)
+			{
+				localIndices[corners[corner]] = static_cast<uint32_t>(clusterVertices.size());
+				clusterVertices.push_back(corners[corner]);
+			}
+			result.indices.push_back(corners[corner]);
+		}
+	}
+	flush();
+
+	return result;
+}
+
+void MeshletBuilder::ComputeBounds(const std::vector<datatype::Vertex>& vertices, const uint32_t* indices, uint32_t indexCount, datatype::Meshlet& meshlet)
+{
+	// sphere around the center of the box, slightly larger than the minimal one but never misses a vertex
+	glm::vec3 min{ FLT_MAX };
+	glm::vec3 max{ -FLT_MAX };
+	for (uint32_t index{}; index < indexCount; ++index)
+	{
+		min = glm::min(min, vertices[indices[index]].position);
+		max = glm::max(max, vertices[indices[index]].position);
+	}
+	meshlet.center = (min + max) * .5f;
+
+	float radius{};
+	for (uint32_t index{}; index < indexCount; ++index)
+		radius = std::max(radius, glm::length(vertices[indices[index]].position - meshlet.center));
+	meshlet.radius = radius;
+
+	// area weighted through the unnormalized cross product, degenerate triangles do not count
+	std::vector<glm::vec3> normals{};
+	normals.reserve(indexCount / 3);
+	glm::vec3 axis{};
+	for (uint32_t index{}; index + 2 < indexCount; index += 3)
+	{
+		const glm::vec3& a{ vertices[indices[index]].position };
+		const glm::vec3& b{ vertices[indices[index + 1]].position };
+		const glm::vec3& c{ vertices[indices[index + 2]].position };
+		const glm::vec3 normal{ glm::cross(b - a, c - a) };
+		const float length{ glm::length(normal) };
+		if (length <= .0f)
+			continue;
+
+		axis += normal;
+		normals.push_back(normal / length);
+	}
+
+	const float axisLength{ glm::length(axis) };
+	meshlet.coneAxis = (axisLength > .0f) ? axis / axisLength : glm::vec3{ .0f, .0f, 1.f };
+
+	float minDot{ 1.f };
+	for (const glm::vec3& normal : normals)
+		minDot = std::min(minDot, glm::dot(normal, meshlet.coneAxis));
+
+	// sine of the widest angle to the axis, compared against the view direction in cluster_cull.comp
+	meshlet.coneCutoff = (normals.empty() || minDot <= MIN_CONE_DOT) ? 1.f : std::sqrt(1.f - minDot * minDot);
+}
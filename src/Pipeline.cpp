@@ -237,3 +237,28 @@ Pipeline PipelineBuilder::Build(Device* device, const VkExtent2D& viewportExtent
 	return pipeline;
 }
 
+ComputePipelineBuilder& ComputePipelineBuilder::SetShaderStage(ShaderStage& shaderStage)
+{
+	m_StageInfo = shaderStage.GetInfo();
+	return *this;
+}
+
+void ComputePipelineBuilder::Build(std::unique_ptr<Pipeline>& pipeline, Device* device, VkPipelineLayout layout)
+{
+	pipeline.reset(new Pipeline(std::move(Build(device, layout))));
+}
+
+Pipeline ComputePipelineBuilder::Build(Device* device, VkPipelineLayout layout)
+{
+	Pipeline pipeline;
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage = m_StageInfo;
+	pipelineInfo.layout = layout;
+
+	if (vkCreateComputePipelines(*device->GetDevicePtr(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline.m_Pipeline) != VK_SUCCESS)
+		throw std::runtime_error("failed to create compute pipeline");
+
+	return pipeline;
+}
@@ -8,13 +8,19 @@
 #include <iostream>
 #include "../inc/Device.h"
 #include <limits>
+#include <algorithm>
+#include "MeshletBuilder.h"
+#include "MeshSimplifier.h"
+#include "IndexOptimizer.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <chrono>
 
 void Scene::Load(Device* device, CommandPool* commandPool, const char* filepath)
 {
 	Assimp::Importer importer;
 	const aiScene* scene = importer.ReadFile(filepath, aiProcess_Triangulate |
 											 aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices |
-											 aiProcess_ImproveCacheLocality | aiProcess_GenUVCoords | 
+											 aiProcess_GenUVCoords | 
 											 aiProcess_GenNormals | aiProcess_CalcTangentSpace);
 
 	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
@@ -22,60 +28,132 @@ void Scene::Load(Device* device, CommandPool* commandPool, const char* filepath)
 		throw std::runtime_error("failed to load model " + std::string(importer.GetErrorString()));
 	}
 
-	ProcessNode(device, commandPool, scene->mRootNode, scene);
-	glm::mat4 model{ GetModelMatrix() };
-	m_AABBMin = model * glm::vec4(m_AABBMin, 1.f);
-	m_AABBMax = model * glm::vec4(m_AABBMax, 1.f);
-} 
+	// the model matrix is a root above the hierarchy of the file, the queue adds the nodes level by level
+	const uint32_t root{ m_Graph.AddNode(SceneGraph::NO_PARENT, GetModelMatrix()) };
+	std::vector<std::pair<const aiNode*, uint32_t>> nodes{ { scene->mRootNode, root } };
+	for (size_t index{}; index < nodes.size(); ++index)
+	{
+		const aiNode* node{ nodes[index].first };
+		// assimp matrices are row major
+		const uint32_t graphNode{ m_Graph.AddNode(nodes[index].second, glm::transpose(glm::make_mat4(&node->mTransformation.a1))) };
+		ProcessNode(device, commandPool, node, graphNode, scene);
+		for (uint32_t child{}; child < node->mNumChildren; ++child)
+			nodes.emplace_back(node->mChildren[child], graphNode);
+	}
+	m_Graph.Update();
 
-void Scene::CalculateLightViewProj(datatype::DirectionalLight& light)
-{
-	const glm::vec3 sceneCenter = (m_AABBMin + m_AABBMax) * .5f;
-	const glm::vec3 lightDirection = glm::normalize(light.Direction);
+	// only needed to find copies while importing
+	m_GeometryHashes.clear();
+	m_ImportedGeometry = std::vector<ImportedGeometry>{};
 
-	const std::vector<glm::vec3> corners
+	uint32_t instancedMeshCount{};
+	m_NodeInstances.resize(m_Graph.GetNodeCount());
+	for (uint32_t meshIndex{}; meshIndex < m_Meshes.size(); ++meshIndex)
 	{
-		{ m_AABBMin.x, m_AABBMin.y, m_AABBMin.z },
-		{ m_AABBMax.x, m_AABBMin.y, m_AABBMin.z },
-		{ m_AABBMin.x, m_AABBMax.y, m_AABBMin.z },
-		{ m_AABBMax.x, m_AABBMax.y, m_AABBMin.z },
-		{ m_AABBMin.x, m_AABBMin.y, m_AABBMax.z },
-		{ m_AABBMax.x, m_AABBMin.y, m_AABBMax.z },
-		{ m_AABBMin.x, m_AABBMax.y, m_AABBMax.z },
-		{ m_AABBMax.x, m_AABBMax.y, m_AABBMax.z }
-	};
+		Mesh& mesh{ m_Meshes[meshIndex] };
+		mesh.m_FirstInstance = static_cast<uint32_t>(m_InstanceTransforms.size());
+		for (const Mesh::Instance& instance : mesh.m_Instances)
+		{
+			m_NodeInstances[instance.node].push_back(static_cast<uint32_t>(m_InstanceTransforms.size()));
+			m_InstanceMeshes.push_back(meshIndex);
+			m_InstanceTransforms.push_back(m_Graph.GetWorldTransform(instance.node) * instance.offset);
+		}
+		// cluster bounds describe a single placement, instanced meshes are culled as a whole
+		if (mesh.m_Instances.size() > 1)
+		{
+			mesh.m_Meshlets.clear();
+			++instancedMeshCount;
+		}
+		UpdateBounds(mesh);
+	}
+	UpdateSceneBounds();
+	{
+		const auto start{ std::chrono::steady_clock::now() };
+		BuildMeshBvh();
+		const float buildMs{ std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count() };
+		std::cout << "mesh bvh of " << m_MeshBvh.GetNodes().size() << " nodes built in " << buildMs << " ms, sah cost " << m_MeshBvh.CalculateCost() << '\n';
+	}
+	{
+		// rewritten in place when nodes move
+		BufferBuilder builder{};
+		builder
+			.MapMemory()
+			.Build(m_InstanceBufferPtr, device, commandPool, sizeof(glm::mat4) * m_InstanceTransforms.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+				   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		m_InstanceBufferPtr->UpdateMappedData(m_InstanceTransforms.data(), sizeof(glm::mat4) * m_InstanceTransforms.size(), 0);
+		device->SetObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)*m_InstanceBufferPtr->GetBufferPtr(), "Instance transforms");
+		m_DeletionQueue.Push([&, device]() { m_InstanceBufferPtr->Destroy(device); });
+	}
+	std::cout << m_Graph.GetNodeCount() << " scene nodes place " << m_InstanceTransforms.size() << " instances\n";
+	std::cout << m_InstanceTransforms.size() - m_Meshes.size() << " duplicate meshes drawn as instances of " << instancedMeshCount << " meshes, "
+			  << m_DuplicateBytes / 1024 << " KiB of geometry not uploaded\n";
 
-	float minProj = FLT_MAX;
-	float maxProj = FLT_MIN;
-	for (const glm::vec3& corner : corners)
 	{
-		const float proj = glm::dot(corner, lightDirection);
-		minProj = std::min(minProj, proj);
-		maxProj = std::max(maxProj, proj);
-	} 
+		BufferBuilder builder{};
+		builder
+			.BindData((void*)m_Materials.data(), commandPool)
+			.Build(m_MaterialBufferPtr, device, commandPool, sizeof(datatype::TextureIndices) * m_Materials.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		device->SetObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)*m_MaterialBufferPtr->GetBufferPtr(), "Material table");
+		m_DeletionQueue.Push([&, device]() { m_MaterialBufferPtr->Destroy(device); });
+	}
+	std::cout << m_Materials.size() << " materials shared by " << m_Meshes.size() << " meshes\n";
 
-	const float distance = maxProj - glm::dot(sceneCenter, lightDirection);
-	const glm::vec3 lightPos = sceneCenter - lightDirection * distance;
+	// cluster bounds stay in the space of the vertices, the cluster cull moves them with the instance
+	uint32_t meshletCount{};
+	for (Mesh& mesh : m_Meshes)
+	{
+		meshletCount += static_cast<uint32_t>(mesh.m_Meshlets.size());
+	}
+	std::cout << "split " << m_Meshes.size() << " meshes into " << meshletCount << " meshlets of up to " << MeshletBuilder::MAX_VERTICES
+			  << " vertices and " << MeshletBuilder::MAX_TRIANGLES << " triangles\n";
+
+	// triangles of every mesh at its n-th level, meshes with fewer levels count their coarsest one
+	std::vector<uint64_t> lodTriangles(MeshSimplifier::MAX_LOD_COUNT);
+	for (const Mesh& mesh : m_Meshes)
+	{
+		for (size_t level{}; level < lodTriangles.size(); ++level)
+			lodTriangles[level] += mesh.m_Lods[std::min(level, mesh.m_Lods.size() - 1)].indexCount / 3;
+	}
+	uint32_t shortIndexMeshCount{};
+	uint64_t indexBytes{};
+	uint64_t wideIndexBytes{};
+	for (Mesh& mesh : m_Meshes)
+	{
+		shortIndexMeshCount += (mesh.m_IndexType == VK_INDEX_TYPE_UINT16) ? 1 : 0;
+		indexBytes += mesh.m_IndexBuffer.GetSize();
+		wideIndexBytes += mesh.m_Indices.size() * sizeof(uint32_t);
+	}
+	std::cout << shortIndexMeshCount << " of " << m_Meshes.size() << " meshes use 16 bit indices, " << indexBytes / 1024 << " KiB of index buffers instead of "
+			  << wideIndexBytes / 1024 << " KiB\n";
+
+	std::cout << "level of detail triangles:";
+	for (uint64_t triangles : lodTriangles)
+		std::cout << ' ' << triangles;
+	std::cout << '\n';
+} 
 
-	const glm::vec3 up = glm::abs(glm::dot(lightDirection, glm::vec3(.0f, .0f, 1.f))) > .99f
-		? glm::vec3(.0f, 1.f, .0f) 
-		: glm::vec3(.0f, .0f, 1.f);
-	 
-	light.View = glm::lookAt(lightPos, sceneCenter, up);
+void Scene::TransformAABB(const glm::mat4& transform, glm::vec3& min, glm::vec3& max)
+{
+	const glm::vec3 corners[]
+	{
+		{ min.x, min.y, min.z },
+		{ max.x, min.y, min.z },
+		{ min.x, max.y, min.z },
+		{ max.x, max.y, min.z },
+		{ min.x, min.y, max.z },
+		{ max.x, min.y, max.z },
+		{ min.x, max.y, max.z },
+		{ max.x, max.y, max.z }
+	};
 
-	glm::vec3 minLightSpace{ FLT_MAX };
-	glm::vec3 maxLightSpace{ FLT_MIN }; 
+	min = glm::vec3{ FLT_MAX };
+	max = glm::vec3{ -FLT_MAX };
 	for (const glm::vec3& corner : corners)
 	{
-		const glm::vec3 transformedCorner = glm::vec3{ light.View * glm::vec4(corner, 1.f) };
-		minLightSpace = glm::min(minLightSpace, transformedCorner);
-		maxLightSpace = glm::max(maxLightSpace, transformedCorner);
+		const glm::vec3 transformedCorner{ transform * glm::vec4(corner, 1.f) };
+		min = glm::min(min, transformedCorner);
+		max = glm::max(max, transformedCorner);
 	}
-
-	const float near = .0f;
-	const float far = maxLightSpace.z - minLightSpace.z;
-	light.Projection = glm::ortho(minLightSpace.x, maxLightSpace.x, minLightSpace.y, maxLightSpace.y, near, far);
-	light.Projection[1][1] *= -1;
 }
 
 std::vector<Mesh>& Scene::GetMeshes()
@@ -88,51 +166,304 @@ std::vector<Image>& Scene::GetTextures()
 	return m_Textures;
 }
 
-void Scene::ProcessNode(Device* device, CommandPool* commandPool, aiNode* node, const aiScene* scene)
+bool Scene::UpdateTransforms()
+{
+	const std::vector<uint32_t>& changedNodes{ m_Graph.Update() };
+	if (changedNodes.empty())
+		return false;
+
+	static_assert(HAS_SINGLE_FRAME_IN_FLIGHT);
+	std::vector<uint32_t> changedMeshes{};
+	for (uint32_t node : changedNodes)
+	{
+		for (uint32_t instance : m_NodeInstances[node])
+		{
+			const uint32_t meshIndex{ m_InstanceMeshes[instance] };
+			const Mesh& mesh{ m_Meshes[meshIndex] };
+			m_InstanceTransforms[instance] = m_Graph.GetWorldTransform(node) * mesh.m_Instances[instance - mesh.m_FirstInstance].offset;
+			m_InstanceBufferPtr->UpdateMappedData(&m_InstanceTransforms[instance], sizeof(glm::mat4), instance * sizeof(glm::mat4));
+			changedMeshes.push_back(meshIndex);
+		}
+	}
+
+	std::sort(changedMeshes.begin(), changedMeshes.end());
+	changedMeshes.erase(std::unique(changedMeshes.begin(), changedMeshes.end()), changedMeshes.end());
+	for (uint32_t meshIndex : changedMeshes)
+		UpdateBounds(m_Meshes[meshIndex]);
+	UpdateSceneBounds();
+
+	// a refit keeps the queries correct, the tree is rebuilt once it got much worse than a fresh one
+	std::vector<glm::vec3> mins{};
+	std::vector<glm::vec3> maxs{};
+	GetMeshBounds(mins, maxs);
+	m_MeshBvh.Refit(mins, maxs);
+	if (m_MeshBvh.CalculateCost() > m_MeshBvhCost * BVH_REBUILD_RATIO)
+		BuildMeshBvh();
+	if (m_IsStreaming)
+		m_StreamingGrid.UpdateBounds(mins, maxs);
+	return true;
+}
+
+void Scene::GetMeshBounds(std::vector<glm::vec3>& mins, std::vector<glm::vec3>& maxs) const
+{
+	mins.resize(m_Meshes.size());
+	maxs.resize(m_Meshes.size());
+	for (size_t index{}; index < m_Meshes.size(); ++index)
+	{
+		mins[index] = m_Meshes[index].m_AABBMin;
+		maxs[index] = m_Meshes[index].m_AABBMax;
+	}
+}
+
+void Scene::BuildMeshBvh()
+{
+	std::vector<glm::vec3> mins{};
+	std::vector<glm::vec3> maxs{};
+	GetMeshBounds(mins, maxs);
+	m_MeshBvh.Build(mins, maxs);
+	m_MeshBvhCost = m_MeshBvh.CalculateCost();
+}
+
+void Scene::EnableStreaming(float cellSize)
+{
+	std::vector<glm::vec3> mins{};
+	std::vector<glm::vec3> maxs{};
+	GetMeshBounds(mins, maxs);
+	std::vector<uint64_t> sizes(m_Meshes.size());
+	for (size_t index{}; index < m_Meshes.size(); ++index)
+		sizes[index] = m_Meshes[index].GetGpuSize();
+
+	m_StreamingGrid.Build(mins, maxs, sizes, cellSize);
+	m_IsStreaming = true;
+	std::cout << "streaming " << m_Meshes.size() << " meshes in " << m_StreamingGrid.GetCells().size() << " cells of " << cellSize << " units, "
+			  << m_StreamingGrid.GetResidentSize() / (1024 * 1024) << " MiB of geometry\n";
+}
+
+void Scene::UpdateStreaming(Device* device, CommandPool* commandPool, const glm::vec3& position, uint64_t budget)
+{
+	if (!m_IsStreaming)
+		return;
+
+	static_assert(HAS_SINGLE_FRAME_IN_FLIGHT);
+	m_StreamingGrid.Update(position, budget, STREAMING_LOAD_LIMIT, m_StreamingEvictions, m_StreamingLoads);
+	for (uint32_t cell : m_StreamingEvictions)
+	{
+		for (uint32_t meshIndex : m_StreamingGrid.GetCells()[cell].items)
+			m_Meshes[meshIndex].Destroy(device);
+		m_StreamingGrid.SetResident(cell, false);
+		++m_StreamingStatistics.evictedCells;
+	}
+	for (uint32_t cell : m_StreamingLoads)
+	{
+		for (uint32_t meshIndex : m_StreamingGrid.GetCells()[cell].items)
+			m_Meshes[meshIndex].CreateBuffers(device, commandPool);
+		m_StreamingGrid.SetResident(cell, true);
+		++m_StreamingStatistics.loadedCells;
+		m_StreamingStatistics.loadedBytes += m_StreamingGrid.GetCells()[cell].size;
+	}
+}
+
+void Scene::BuildTriangleBvhs()
+{
+	const auto start{ std::chrono::steady_clock::now() };
+	size_t triangleCount{};
+	size_t memorySize{};
+	for (Mesh& mesh : m_Meshes)
+	{
+		const datatype::MeshLod& lod{ mesh.m_Lods[0] };
+		std::vector<glm::vec3> mins(lod.indexCount / 3);
+		std::vector<glm::vec3> maxs(lod.indexCount / 3);
+		for (uint32_t triangle{}; triangle < mins.size(); ++triangle)
+		{
+			const uint32_t* indices{ &mesh.m_Indices[lod.firstIndex + triangle * 3] };
+			const glm::vec3& a{ mesh.m_Vertices[indices[0]].position };
+			const glm::vec3& b{ mesh.m_Vertices[indices[1]].position };
+			const glm::vec3& c{ mesh.m_Vertices[indices[2]].position };
+			mins[triangle] = glm::min(a, glm::min(b, c));
+			maxs[triangle] = glm::max(a, glm::max(b, c));
+		}
+		mesh.m_TriangleBvh.Build(mins, maxs);
+		triangleCount += mins.size();
+		memorySize += mesh.m_TriangleBvh.GetMemorySize();
+	}
+	const float buildMs{ std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count() };
+	std::cout << "triangle bvhs over " << triangleCount << " triangles built in " << buildMs << " ms, " << memorySize / 1024 << " KiB\n";
+}
+
+uint32_t Scene::Raycast(const glm::vec3& origin, const glm::vec3& direction, float& distance) const
+{
+	const glm::vec3 inverseDirection{ 1.f / direction };
+	return m_MeshBvh.Raycast(origin, direction, distance, [&](uint32_t meshIndex, float maxDistance)
+		{
+			const Mesh& mesh{ m_Meshes[meshIndex] };
+			if (mesh.m_TriangleBvh.GetNodes().empty())
+				return Bvh::IntersectAABB(origin, inverseDirection, mesh.m_AABBMin, mesh.m_AABBMax, maxDistance);
+
+			// the ray moves into mesh space, an affine transform keeps the distances along it
+			const datatype::MeshLod& lod{ mesh.m_Lods[0] };
+			float closest{ maxDistance };
+			for (uint32_t instance{}; instance < mesh.m_Instances.size(); ++instance)
+			{
+				const glm::mat4 inverse{ glm::inverse(m_InstanceTransforms[mesh.m_FirstInstance + instance]) };
+				const glm::vec3 localOrigin{ inverse * glm::vec4{ origin, 1.f } };
+				const glm::vec3 localDirection{ inverse * glm::vec4{ direction, .0f } };
+				mesh.m_TriangleBvh.Raycast(localOrigin, localDirection, closest, [&](uint32_t triangle, float triangleDistance)
+					{
+						// moller trumbore, both sides count
+						const uint32_t* indices{ &mesh.m_Indices[lod.firstIndex + triangle * 3] };
+						const glm::vec3& a{ mesh.m_Vertices[indices[0]].position };
+						const glm::vec3 ab{ mesh.m_Vertices[indices[1]].position - a };
+						const glm::vec3 ac{ mesh.m_Vertices[indices[2]].position - a };
+						const glm::vec3 p{ glm::cross(localDirection, ac) };
+						const float determinant{ glm::dot(ab, p) };
+						if (std::abs(determinant) < FLT_EPSILON)
+							return triangleDistance;
+						const float inverseDeterminant{ 1.f / determinant };
+						const glm::vec3 toOrigin{ localOrigin - a };
+						const float u{ glm::dot(toOrigin, p) * inverseDeterminant };
+						const glm::vec3 q{ glm::cross(toOrigin, ab) };
+						const float v{ glm::dot(localDirection, q) * inverseDeterminant };
+						const float t{ glm::dot(ac, q) * inverseDeterminant };
+						return (u >= .0f && v >= .0f && u + v <= 1.f && t >= .0f) ? t : triangleDistance;
+					});
+			}
+			return closest;
+		});
+}
+
+void Scene::UpdateBounds(Mesh& mesh)
+{
+	mesh.m_AABBMin = glm::vec3{ FLT_MAX };
+	mesh.m_AABBMax = glm::vec3{ -FLT_MAX };
+	mesh.m_WorldScale = .0f;
+	for (uint32_t instance{}; instance < mesh.m_Instances.size(); ++instance)
+	{
+		const glm::mat4& transform{ m_InstanceTransforms[mesh.m_FirstInstance + instance] };
+		glm::vec3 min{ mesh.m_LocalMin };
+		glm::vec3 max{ mesh.m_LocalMax };
+		TransformAABB(transform, min, max);
+		mesh.m_AABBMin = glm::min(mesh.m_AABBMin, min);
+		mesh.m_AABBMax = glm::max(mesh.m_AABBMax, max);
+		mesh.m_WorldScale = std::max({ mesh.m_WorldScale, glm::length(glm::vec3{ transform[0] }), glm::length(glm::vec3{ transform[1] }), glm::length(glm::vec3{ transform[2] }) });
+	}
+}
+
+void Scene::UpdateSceneBounds()
+{
+	m_AABBMin = glm::vec3{ FLT_MAX };
+	m_AABBMax = glm::vec3{ -FLT_MAX };
+	for (const Mesh& mesh : m_Meshes)
+	{
+		m_AABBMin = glm::min(m_AABBMin, mesh.m_AABBMin);
+		m_AABBMax = glm::max(m_AABBMax, mesh.m_AABBMax);
+	}
+}
+
+uint64_t Scene::HashGeometry(const ImportedGeometry& geometry)
+{
+	// fnv-1a over positions on a grid relative to the bounds, copies off by less than a cell usually land in the same one
+	uint64_t hash{ 14695981039346656037ull };
+	const auto combine = [&hash](uint32_t value)
+		{
+			hash ^= value;
+			hash *= 1099511628211ull;
+		};
+
+	combine(geometry.materialIndex);
+	combine(static_cast<uint32_t>(geometry.vertices.size()));
+	for (const datatype::Vertex& vertex : geometry.vertices)
+	{
+		const glm::ivec3 cell{ glm::round((vertex.position - geometry.min) / INSTANCE_TOLERANCE) };
+		combine(static_cast<uint32_t>(cell.x));
+		combine(static_cast<uint32_t>(cell.y));
+		combine(static_cast<uint32_t>(cell.z));
+	}
+	for (uint32_t index : geometry.indices)
+		combine(index);
+	return hash;
+}
+
+uint32_t Scene::FindDuplicate(uint64_t hash, const ImportedGeometry& geometry) const
+{
+	const auto isClose = [](const auto& lhs, const auto& rhs) { return glm::all(glm::lessThanEqual(glm::abs(lhs - rhs), decltype(lhs - rhs){ INSTANCE_TOLERANCE })); };
+
+	const auto [first, last] { m_GeometryHashes.equal_range(hash) };
+	for (auto it{ first }; it != last; ++it)
+	{
+		const ImportedGeometry& candidate{ m_ImportedGeometry[it->second] };
+		if (candidate.materialIndex != geometry.materialIndex || candidate.indices != geometry.indices || candidate.vertices.size() != geometry.vertices.size())
+			continue;
+
+		bool isCopy{ true };
+		for (size_t vertex{}; vertex < geometry.vertices.size() && isCopy; ++vertex)
+		{
+			const datatype::Vertex& lhs{ candidate.vertices[vertex] };
+			const datatype::Vertex& rhs{ geometry.vertices[vertex] };
+			isCopy = isClose(lhs.position - candidate.min, rhs.position - geometry.min) && isClose(lhs.uv, rhs.uv) && isClose(lhs.normal, rhs.normal)
+				  && isClose(lhs.tangent, rhs.tangent);
+		}
+		if (isCopy)
+			return it->second;
+	}
+	return UINT32_MAX;
+}
+
+uint32_t Scene::LoadTexture(Device* device, CommandPool* commandPool, const std::string& name, VkFormat format)
+{
+	const auto loaded{ m_LoadedTextures.find(name) };
+	if (loaded != m_LoadedTextures.end())
+		return loaded->second;
+
+	const uint32_t index{ static_cast<uint32_t>(m_TextureSources.size()) };
+	m_LoadedTextures.emplace(name, index);
+	m_TextureSources.push_back(TextureSource{ "resources/" + name, format });
+	// deferred textures are created by the texture streamer before anything is drawn
+	if (!m_AreTexturesDeferred)
+	{
+		ImageBuilder builder{};
+		m_Textures.push_back(builder
+			.SetFilePath(m_TextureSources.back().path)
+			.SetFormat(format)
+			.Build(device, commandPool, VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+	}
+	m_DeletionQueue.Push([&, device, index]() { m_Textures[index].Destroy(*device->GetDevicePtr()); });
+	return index;
+}
+
+void Scene::ProcessNode(Device* device, CommandPool* commandPool, const aiNode* node, uint32_t graphNode, const aiScene* scene)
 {
 	for (uint32_t meshIndex{}; meshIndex < node->mNumMeshes; ++meshIndex)
 	{
 		aiMesh* mesh = scene->mMeshes[node->mMeshes[meshIndex]];
 		std::vector<datatype::Vertex> tempVertices;
 		std::vector<uint32_t> tempIndices;
-		std::optional<Image> tempTexture;
+		glm::vec3 meshMin{ FLT_MAX };
+		glm::vec3 meshMax{ -FLT_MAX };
 
 		for (uint32_t vertexIndex{}; vertexIndex < mesh->mNumVertices; ++vertexIndex)
 		{
-			aiMatrix4x4 transform = scene->mRootNode->mTransformation;
-			aiVector3D aiVertex{ transform * mesh->mVertices[vertexIndex] };
-
-			aiVector3D translation{};
-			aiQuaternion rotationQuat{};
-
-			transform.DecomposeNoScaling(rotationQuat, translation);
-			
-			const aiMatrix3x3 rotation{ rotationQuat.GetMatrix() };
+			// vertices stay in the space of the mesh, the scene graph places every instance
+			const aiVector3D& aiVertex{ mesh->mVertices[vertexIndex] };
 
 			datatype::Vertex vertex{};
 			vertex.position.x = aiVertex.x;
 			vertex.position.y = aiVertex.y;
 			vertex.position.z = aiVertex.z;
 
-			m_AABBMin.x = std::min(m_AABBMin.x, vertex.position.x);
-			m_AABBMin.y = std::min(m_AABBMin.y, vertex.position.y);
-			m_AABBMin.z = std::min(m_AABBMin.z, vertex.position.z);
-
-			m_AABBMax.x = std::max(m_AABBMax.x, vertex.position.x);
-			m_AABBMax.y = std::max(m_AABBMax.y, vertex.position.y);
-			m_AABBMax.z = std::max(m_AABBMax.z, vertex.position.z);
+			meshMin = glm::min(meshMin, vertex.position);
+			meshMax = glm::max(meshMax, vertex.position);
 
-			aiVector3D normal{ rotation * mesh->mNormals[vertexIndex] };
+			const aiVector3D& normal{ mesh->mNormals[vertexIndex] };
 			vertex.normal.x = normal.x;
 			vertex.normal.y = normal.y;
 			vertex.normal.z = normal.z;
 
-			aiVector3D tangent{ rotation * mesh->mTangents[vertexIndex] };
+			const aiVector3D& tangent{ mesh->mTangents[vertexIndex] };
 			vertex.tangent.x = tangent.x;
 			vertex.tangent.y = tangent.y;
 			vertex.tangent.z = tangent.z;
 
-			aiVector3D bitangent{ rotation * mesh->mBitangents[vertexIndex] };
+			const aiVector3D& bitangent{ mesh->mBitangents[vertexIndex] };
 			vertex.bitangent.x = bitangent.x;
 			vertex.bitangent.y = bitangent.y;
 			vertex.bitangent.z = bitangent.z;
@@ -163,93 +494,74 @@ void Scene::ProcessNode(Device* device, CommandPool* commandPool, aiNode* node,
 
 		if (mesh->mMaterialIndex >= 0) 
 		{
-			aiString str;
-			aiMaterial* material{};
-			material = scene->mMaterials[mesh->mMaterialIndex];
-			if (material->GetTextureCount(aiTextureType_BASE_COLOR))
-				material->GetTexture(aiTextureType_BASE_COLOR, 0, &str);
-			else
-				str = aiString{ "textures/200px-Debugempty.png" };
-
-			if (!m_LoadedTextures.contains(std::string(str.C_Str())))
-			{
-				ImageBuilder builder{};
-				tempTexture = builder
-					.SetFilePath("resources/" + std::string(str.C_Str()))
-					.Build(device, commandPool, VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-				textureIndices.albedo = m_LoadedTextures[std::string(str.C_Str())] = m_Textures.size();
-				m_Textures.push_back(tempTexture.value());
-				m_DeletionQueue.Push([&, device, textureIndices]() { m_Textures[textureIndices.albedo].Destroy(*device->GetDevicePtr()); });
-			}
-			else
-				textureIndices.albedo = m_LoadedTextures[std::string(str.C_Str())];
-
-			if (material->GetTextureCount(aiTextureType_DIFFUSE_ROUGHNESS))
-				material->GetTexture(aiTextureType_DIFFUSE_ROUGHNESS, 0, &str);
-			else
-				str = aiString{ "textures/200px-Debugempty.png" };
-
-			if (!m_LoadedTextures.contains(std::string(str.C_Str())))
-			{
-				ImageBuilder builder{};
-				tempTexture = builder
-					.SetFilePath("resources/" + std::string(str.C_Str()))
-					.Build(device, commandPool, VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-				textureIndices.roughness = m_LoadedTextures[std::string(str.C_Str())] = m_Textures.size();
-				m_Textures.push_back(tempTexture.value());
-				m_DeletionQueue.Push([&, device, textureIndices]() { m_Textures[textureIndices.roughness].Destroy(*device->GetDevicePtr()); });
-			}
-			else
-				textureIndices.roughness = m_LoadedTextures[std::string(str.C_Str())];
-
-			if (material->GetTextureCount(aiTextureType_METALNESS))
-				material->GetTexture(aiTextureType_METALNESS, 0, &str);
-			else
-				str = aiString{ "textures/200px-Debugempty.png" };
-
-			if (!m_LoadedTextures.contains(std::string(str.C_Str())))
-			{
-				ImageBuilder builder{};
-				tempTexture = builder
-					.SetFilePath("resources/" + std::string(str.C_Str()))
-					.Build(device, commandPool, VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-				textureIndices.metalness = m_LoadedTextures[std::string(str.C_Str())] = m_Textures.size();
-				m_Textures.push_back(tempTexture.value());
-				m_DeletionQueue.Push([&, device, textureIndices]() { m_Textures[textureIndices.metalness].Destroy(*device->GetDevicePtr()); });
-			}
-			else
-				textureIndices.metalness = m_LoadedTextures[std::string(str.C_Str())];
-
-			if (material->GetTextureCount(aiTextureType_NORMALS))
-				material->GetTexture(aiTextureType_NORMALS, 0, &str);
-			else
-				str = aiString{ "textures/200px-Debugempty.png" };
+			const aiMaterial* material{ scene->mMaterials[mesh->mMaterialIndex] };
+			// the first texture of the type, a placeholder without one
+			const auto getName = [material](aiTextureType type)
+				{
+					aiString str{ "textures/200px-Debugempty.png" };
+					if (material->GetTextureCount(type))
+						material->GetTexture(type, 0, &str);
+					return std::string(str.C_Str());
+				};
+
+			textureIndices.albedo = LoadTexture(device, commandPool, getName(aiTextureType_BASE_COLOR), VK_FORMAT_R8G8B8A8_SRGB);
+			textureIndices.roughness = LoadTexture(device, commandPool, getName(aiTextureType_DIFFUSE_ROUGHNESS), VK_FORMAT_R8G8B8A8_SRGB);
+			textureIndices.metalness = LoadTexture(device, commandPool, getName(aiTextureType_METALNESS), VK_FORMAT_R8G8B8A8_SRGB);
+			textureIndices.normal = LoadTexture(device, commandPool, getName(aiTextureType_NORMALS), VK_FORMAT_R8G8B8A8_UNORM);
+		}
 
-			if (!m_LoadedTextures.contains(std::string(str.C_Str())))
-			{
-				ImageBuilder builder{};
-				tempTexture = builder
-					.SetFilePath("resources/" + std::string(str.C_Str()))
-					.SetFormat(VK_FORMAT_R8G8B8A8_UNORM)
-					.Build(device, commandPool, VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-				textureIndices.normal = m_LoadedTextures[std::string(str.C_Str())] = m_Textures.size();
-				m_Textures.push_back(tempTexture.value());
-				m_DeletionQueue.Push([&, device, textureIndices]() { m_Textures[textureIndices.normal].Destroy(*device->GetDevicePtr()); });
-			}
-			else
-				textureIndices.normal = m_LoadedTextures[std::string(str.C_Str())];
+		// materials are found by their textures, assimp materials differing only in unused properties merge
+		const auto material{ std::find(m_Materials.begin(), m_Materials.end(), textureIndices) };
+		const uint32_t materialIndex{ static_cast<uint32_t>(material - m_Materials.begin()) };
+		if (material == m_Materials.end())
+			m_Materials.push_back(textureIndices);
+
+		// a copy of an earlier mesh moved somewhere else becomes another instance of it
+		ImportedGeometry geometry{ tempVertices, tempIndices, materialIndex, meshMin };
+		const uint64_t hash{ HashGeometry(geometry) };
+		const uint32_t original{ FindDuplicate(hash, geometry) };
+		if (original != UINT32_MAX)
+		{
+			// nodes sharing a mesh of the file land here as well, with no offset
+			m_Meshes[original].m_Instances.push_back(Mesh::Instance{ graphNode, glm::translate(glm::mat4{ 1.f }, meshMin - m_ImportedGeometry[original].min) });
+			m_DuplicateBytes += tempVertices.size() * sizeof(datatype::Vertex) + tempIndices.size() * sizeof(uint32_t);
+			continue;
 		}
 
 		uint32_t index{ static_cast<uint32_t>(m_Meshes.size()) };
-		m_Meshes.push_back(Mesh(device, commandPool, tempVertices, tempIndices, textureIndices));
+		m_GeometryHashes.emplace(hash, index);
+		m_ImportedGeometry.push_back(std::move(geometry));
+		const uint32_t vertexCount{ static_cast<uint32_t>(tempVertices.size()) };
+		const IndexOptimizer::Statistics before{ IndexOptimizer::Analyze(tempVertices, tempIndices.data(), tempIndices.size()) };
+		tempIndices = IndexOptimizer::OptimizeVertexCache(tempIndices, vertexCount);
+		tempIndices = IndexOptimizer::OptimizeOverdraw(tempVertices, tempIndices, OVERDRAW_THRESHOLD);
+
+		// clusters own contiguous ranges of the reordered index buffer
+		MeshletBuilder::Result meshlets{ MeshletBuilder::Build(tempVertices, tempIndices) };
+		for (datatype::Meshlet& meshlet : meshlets.meshlets)
+			meshlet.meshIndex = index;
+		// the coarser levels follow the clustered full detail one in the same index buffer
+		MeshSimplifier::Result lods{ MeshSimplifier::BuildLodChain(tempVertices, meshlets.indices) };
+		// collapses scatter the cache order, coarse levels are small enough on screen to skip the overdraw pass
+		for (size_t level{ 1 }; level < lods.lods.size(); ++level)
+		{
+			const auto first{ lods.indices.begin() + lods.lods[level].firstIndex };
+			const std::vector<uint32_t> optimized{ IndexOptimizer::OptimizeVertexCache(std::vector<uint32_t>{ first, first + lods.lods[level].indexCount }, vertexCount) };
+			std::copy(optimized.begin(), optimized.end(), first);
+		}
+		// last, it renumbers the vertices of every level at once
+		IndexOptimizer::OptimizeVertexFetch(tempVertices, lods.indices);
+
+		const IndexOptimizer::Statistics after{ IndexOptimizer::Analyze(tempVertices, lods.indices.data(), lods.lods[0].indexCount) };
+		std::cout << "mesh " << index << " (" << lods.lods[0].indexCount / 3 << " triangles): acmr " << before.acmr << " -> " << after.acmr
+				  << ", atvr " << before.atvr << " -> " << after.atvr << ", overdraw " << before.overdraw << " -> " << after.overdraw << '\n';
+
+		m_Meshes.push_back(Mesh(device, commandPool, tempVertices, lods.indices, materialIndex));
+		m_Meshes.back().m_LocalMin = meshMin;
+		m_Meshes.back().m_LocalMax = meshMax;
+		m_Meshes.back().m_Instances.push_back(Mesh::Instance{ graphNode, glm::mat4{ 1.f } });
+		m_Meshes.back().m_Meshlets = std::move(meshlets.meshlets);
+		m_Meshes.back().m_Lods = std::move(lods.lods);
 		m_DeletionQueue.Push([&, device, index]() { m_Meshes[index].Destroy(device); });
 	}
-	for (uint32_t i = 0; i < node->mNumChildren; i++)
-	{
-		ProcessNode(device, commandPool, node->mChildren[i], scene);
-	}
 }
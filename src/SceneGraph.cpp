@@ -0,0 +1,69 @@
+#include "SceneGraph.h"
+#include <algorithm>
+#include <execution>
+#include <stdexcept>
+
+uint32_t SceneGraph::AddNode(uint32_t parent, const glm::mat4& localTransform)
+{
+	const uint32_t node{ static_cast<uint32_t>(m_Parents.size()) };
+	if (parent != NO_PARENT && parent >= node)
+		throw std::runtime_error("failed to add scene node, its parent was not added before");
+
+	const uint32_t depth{ (parent == NO_PARENT) ? 0 : m_Depths[parent] + 1 };
+	if (!m_Depths.empty() && depth < m_Depths.back())
+		throw std::runtime_error("failed to add scene node, nodes have to be added breadth first");
+	if (m_Depths.empty() || depth > m_Depths.back())
+		m_LevelOffsets.push_back(node);
+
+	m_Parents.push_back(parent);
+	m_Depths.push_back(depth);
+	m_LocalTransforms.push_back(localTransform);
+	m_WorldTransforms.push_back(localTransform);
+	m_Dirty.push_back(1);
+	m_HasChanges = true;
+	return node;
+}
+
+void SceneGraph::SetLocalTransform(uint32_t node, const glm::mat4& localTransform)
+{
+	m_LocalTransforms[node] = localTransform;
+	m_Dirty[node] = 1;
+	m_HasChanges = true;
+}
+
+const std::vector<uint32_t>& SceneGraph::Update()
+{
+	m_Changed.clear();
+	if (!m_HasChanges)
+		return m_Changed;
+
+	// a node only reads its parent, which is finished with the level before
+	const auto updateNode = [this](uint8_t& dirty)
+		{
+			const size_t node{ static_cast<size_t>(&dirty - m_Dirty.data()) };
+			const uint32_t parent{ m_Parents[node] };
+			if (parent != NO_PARENT && m_Dirty[parent])
+				dirty = 1;
+			if (dirty)
+				m_WorldTransforms[node] = (parent != NO_PARENT) ? m_WorldTransforms[parent] * m_LocalTransforms[node] : m_LocalTransforms[node];
+		};
+
+	for (size_t level{}; level < m_LevelOffsets.size(); ++level)
+	{
+		const auto first{ m_Dirty.begin() + m_LevelOffsets[level] };
+		const auto last{ (level + 1 < m_LevelOffsets.size()) ? m_Dirty.begin() + m_LevelOffsets[level + 1] : m_Dirty.end() };
+		if (last - first >= PARALLEL_LEVEL_SIZE)
+			std::for_each(std::execution::par, first, last, updateNode);
+		else
+			std::for_each(first, last, updateNode);
+	}
+
+	for (uint32_t node{}; node < m_Dirty.size(); ++node)
+	{
+		if (m_Dirty[node])
+			m_Changed.push_back(node);
+		m_Dirty[node] = 0;
+	}
+	m_HasChanges = false;
+	return m_Changed;
+}
@@ -0,0 +1,107 @@
+#include "Settings.h"
+#include <iostream>
+#include <string>
+
+Settings Settings::FromCommandLine(int argc, char* argv[])
+{
+	Settings settings{};
+
+	for (int index{ 1 }; index < argc; ++index)
+	{
+		const std::string argument{ argv[index] };
+		const size_t separator{ argument.find('=') };
+		const std::string key{ argument.substr(0, separator) };
+		const std::string value{ (separator == std::string::npos) ? "" : argument.substr(separator + 1) };
+
+		if (key == "--lighting" && (value == "fragment" || value == "compute"))
+			settings.computeLighting = value == "compute";
+		else if (key == "--tile-size" && (value == "8" || value == "16"))
+			settings.tileSize = static_cast<uint32_t>(std::stoul(value));
+		else if (key == "--gbuffer" && value == "reference")
+			settings.gbufferProfile = GBufferProfile::Reference;
+		else if (key == "--gbuffer" && value == "balanced")
+			settings.gbufferProfile = GBufferProfile::Balanced;
+		else if (key == "--gbuffer" && value == "compact")
+			settings.gbufferProfile = GBufferProfile::Compact;
+		else if (key == "--tonemap" && (value == "separate" || value == "fused"))
+			settings.fusedTonemap = value == "fused";
+		else if (key == "--cascades" && (value == "1" || value == "2" || value == "3" || value == "4"))
+			settings.shadowCascadeCount = static_cast<uint32_t>(std::stoul(value));
+		else if (key == "--shadow-resolution" && (value == "512" || value == "1024" || value == "2048" || value == "4096"))
+			settings.shadowResolution = static_cast<uint32_t>(std::stoul(value));
+		else if (key == "--shadow-budget" && value.find_first_of("0123456789") != std::string::npos && value.find_first_not_of("0123456789.") == std::string::npos)
+			settings.shadowBudgetMs = std::stof(value);
+		else if (key == "--environment" && value == "rgba32f")
+			settings.environmentFormat = EnvironmentFormat::RGBA32F;
+		else if (key == "--environment" && value == "rgba16f")
+			settings.environmentFormat = EnvironmentFormat::RGBA16F;
+		else if (key == "--environment" && value == "b10g11r11")
+			settings.environmentFormat = EnvironmentFormat::B10G11R11;
+		else if (key == "--environment" && value == "e5b9g9r9")
+			settings.environmentFormat = EnvironmentFormat::E5B9G9R9;
+		else if (key == "--ibl-cache" && (value == "on" || value == "off"))
+			settings.iblCache = value == "on";
+		else if (key == "--exposure" && value == "auto")
+			settings.exposureMode = ExposureMode::Auto;
+		else if (key == "--exposure" && value == "indoor")
+			settings.exposureMode = ExposureMode::Indoor;
+		else if (key == "--exposure" && value == "sunny16")
+			settings.exposureMode = ExposureMode::Sunny16;
+		else if (key == "--dynamic-resolution" && (value == "on" || value == "off"))
+			settings.dynamicResolution = value == "on";
+		else if (key == "--frame-budget" && value.find_first_of("0123456789") != std::string::npos && value.find_first_not_of("0123456789.") == std::string::npos)
+			settings.frameBudgetMs = std::stof(value);
+		else if (key == "--lighting-cache" && (value == "on" || value == "off" || value == "validate"))
+		{
+			settings.lightingCache = value != "off";
+			settings.cacheValidation = value == "validate";
+		}
+		else if (key == "--cache-refresh" && (value == "2" || value == "4" || value == "8" || value == "16"))
+			settings.cacheRefreshRatio = static_cast<uint32_t>(std::stoul(value));
+		else if (key == "--occlusion-culling" && (value == "on" || value == "off"))
+			settings.occlusionCulling = value == "on";
+		else if (key == "--cluster-culling" && (value == "on" || value == "off"))
+			settings.clusterCulling = value == "on";
+		else if (key == "--lod-error" && value.find_first_of("0123456789") != std::string::npos && value.find_first_not_of("0123456789.") == std::string::npos)
+			settings.lodErrorPixels = std::stof(value);
+		else if (key == "--triangle-bvh" && (value == "on" || value == "off"))
+			settings.triangleBvh = value == "on";
+		else if (key == "--streaming-budget" && value.find_first_of("0123456789") != std::string::npos && value.find_first_not_of("0123456789.") == std::string::npos)
+			settings.streamingBudgetMB = std::stof(value);
+		else if (key == "--streaming-cell" && value.find_first_of("123456789") != std::string::npos && value.find_first_not_of("0123456789.") == std::string::npos)
+			settings.streamingCellSize = std::stof(value);
+		else if (key == "--texture-budget" && value.find_first_of("0123456789") != std::string::npos && value.find_first_not_of("0123456789.") == std::string::npos)
+			settings.textureBudgetMB = std::stof(value);
+		else if (key == "--benchmark" && !value.empty() && value.find_first_not_of("0123456789") == std::string::npos)
+			settings.benchmarkFrames = static_cast<uint32_t>(std::stoul(value));
+		else if (key == "--benchmark-path" && !value.empty())
+			settings.benchmarkPath = value;
+		else if (key == "--benchmark-output" && !value.empty())
+			settings.benchmarkOutput = value;
+		else if (key == "--benchmark-step" && value.find_first_of("123456789") != std::string::npos && value.find_first_not_of("0123456789.") == std::string::npos)
+			settings.benchmarkStepMs = std::stof(value);
+		else if (key == "--headless" && (value == "on" || value == "off"))
+			settings.headless = value == "on";
+		else
+			std::cerr << "ignoring unknown argument " << argument << '\n';
+	}
+
+	// clusters are only culled for meshes the occlusion cull kept
+	if (settings.clusterCulling)
+		settings.occlusionCulling = true;
+
+	// auto exposure measures the hdr target, so lighting cannot tonemap straight into the swapchain
+	if (settings.fusedTonemap && settings.exposureMode == ExposureMode::Auto)
+	{
+		std::cerr << "ignoring --tonemap=fused with auto exposure, pick --exposure=indoor or sunny16 to fuse\n";
+		settings.fusedTonemap = false;
+	}
+
+	if (settings.headless && settings.benchmarkFrames == 0)
+	{
+		std::cerr << "ignoring --headless without --benchmark\n";
+		settings.headless = false;
+	}
+
+	return settings;
+}
@@ -23,6 +23,8 @@ ShaderStage::~ShaderStage() = default;
 
 void ShaderStage::AddSpecialization(uint32_t size, uint32_t count, void* data)
 {
+	// replaces previous specialization so one module can be built into several pipeline permutations
+	m_MapEntries.clear();
 	for (int index{}; index < count; ++index)
 	{
 		m_MapEntries.emplace_back(index, index * size, size);
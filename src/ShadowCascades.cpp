@@ -0,0 +1,141 @@
+#include "ShadowCascades.h"
+#include "Camera.h"
+#include "Bvh.h"
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <stdexcept>
+
+ShadowCascades::ShadowCascades(uint32_t lightCount, uint32_t cascadeCount, uint32_t resolution, float splitLambda)
+	: m_CascadeCount{ std::clamp(cascadeCount, 1u, MAX_CASCADES) }
+	, m_Resolution{ resolution }
+	, m_SplitLambda{ splitLambda }
+	, m_SplitDepths(m_CascadeCount + 1)
+	, m_Cascades(lightCount * m_CascadeCount)
+	, m_CasterCounts(lightCount * m_CascadeCount)
+{
+	if (m_Cascades.size() > MAX_LAYERS)
+		throw std::runtime_error("failed to create shadow cascades, too many layers for the light count");
+}
+
+void ShadowCascades::CalculateSplits(float near, float far)
+{
+	// practical split scheme, logarithmic splits keep texel density even but crowd the near plane
+	m_SplitDepths[0] = near;
+	for (uint32_t index{ 1 }; index <= m_CascadeCount; ++index)
+	{
+		const float ratio{ static_cast<float>(index) / m_CascadeCount };
+		const float logarithmic{ near * std::pow(far / near, ratio) };
+		const float uniform{ near + (far - near) * ratio };
+		m_SplitDepths[index] = m_SplitLambda * logarithmic + (1.f - m_SplitLambda) * uniform;
+	}
+}
+
+void ShadowCascades::Update(const Camera* camera, const glm::mat4& view, const std::vector<datatype::DirectionalLight>& lights
+							, const glm::vec3& sceneMin, const glm::vec3& sceneMax, uint32_t updateMask)
+{
+	CalculateSplits(camera->GetNear(), camera->GetFar());
+
+	const glm::vec3 sceneCorners[]
+	{
+		{ sceneMin.x, sceneMin.y, sceneMin.z },
+		{ sceneMax.x, sceneMin.y, sceneMin.z },
+		{ sceneMin.x, sceneMax.y, sceneMin.z },
+		{ sceneMax.x, sceneMax.y, sceneMin.z },
+		{ sceneMin.x, sceneMin.y, sceneMax.z },
+		{ sceneMax.x, sceneMin.y, sceneMax.z },
+		{ sceneMin.x, sceneMax.y, sceneMax.z },
+		{ sceneMax.x, sceneMax.y, sceneMax.z }
+	};
+
+	for (uint32_t cascade{}; cascade < m_CascadeCount; ++cascade)
+	{
+		if ((updateMask & (1u << cascade)) == 0)
+			continue;
+
+		// corners of the frustum slice in world space, depth is zero to one
+		const glm::mat4 inverseSlice{ glm::inverse(glm::perspective(glm::radians(camera->GetFov()), camera->GetAspectRatio()
+																	 , m_SplitDepths[cascade], m_SplitDepths[cascade + 1]) * view) };
+		glm::vec3 corners[8]{};
+		glm::vec3 center{};
+		for (uint32_t index{}; index < 8; ++index)
+		{
+			const glm::vec4 ndc{ (index & 1) ? 1.f : -1.f, (index & 2) ? 1.f : -1.f, (index & 4) ? 1.f : .0f, 1.f };
+			const glm::vec4 corner{ inverseSlice * ndc };
+			corners[index] = glm::vec3{ corner } / corner.w;
+			center += corners[index] / 8.f;
+		}
+
+		// a bounding sphere keeps the projection size constant while the camera rotates
+		float radius{};
+		for (const glm::vec3& corner : corners)
+			radius = std::max(radius, glm::length(corner - center));
+		radius = std::ceil(radius * 16.f) / 16.f;
+
+		for (size_t light{}; light < lights.size(); ++light)
+		{
+			const glm::vec3 direction{ glm::normalize(lights[light].Direction) };
+			const glm::vec3 up = glm::abs(glm::dot(direction, glm::vec3(.0f, .0f, 1.f))) > .99f
+				? glm::vec3(.0f, 1.f, .0f)
+				: glm::vec3(.0f, .0f, 1.f);
+			const glm::mat4 lightView{ glm::lookAt(center - direction * radius, center, up) };
+
+			// pull the near plane back so casters outside of the slice still land in the map
+			float near{};
+			for (const glm::vec3& corner : sceneCorners)
+				near = std::min(near, -(lightView * glm::vec4(corner, 1.f)).z);
+
+			glm::mat4 projection{ glm::ortho(-radius, radius, -radius, radius, near, 2.f * radius) };
+			projection[1][1] *= -1;
+
+			// snap the origin to whole texels so edges do not shimmer when the camera moves
+			const glm::vec4 origin{ projection * lightView * glm::vec4(.0f, .0f, .0f, 1.f) };
+			const glm::vec2 texelOrigin{ glm::vec2{ origin } * (m_Resolution * .5f) };
+			const glm::vec2 offset{ (glm::round(texelOrigin) - texelOrigin) * (2.f / m_Resolution) };
+			projection[3][0] += offset.x;
+			projection[3][1] += offset.y;
+
+			datatype::ShadowCascade& shadowCascade{ m_Cascades[light * m_CascadeCount + cascade] };
+			shadowCascade.ViewProjection = projection * lightView;
+			shadowCascade.SplitDepth = m_SplitDepths[cascade + 1];
+		}
+	}
+}
+
+void ShadowCascades::Cull(const Bvh& meshBvh, uint32_t meshCount, uint32_t updateMask)
+{
+	m_MeshLayerMasks.assign(meshCount, 0);
+	for (uint32_t index{}; index < m_Cascades.size(); ++index)
+	{
+		if ((updateMask & (1u << (index % m_CascadeCount))) == 0)
+			continue;
+
+		const glm::mat4& viewProjection{ m_Cascades[index].ViewProjection };
+		m_CasterCounts[index] = 0;
+
+		meshBvh.Traverse([&viewProjection](const glm::vec3& min, const glm::vec3& max)
+			{
+				// orthographic, so clip space bounds of the corners are exact
+				glm::vec3 clipMin{ FLT_MAX };
+				glm::vec3 clipMax{ -FLT_MAX };
+				for (uint32_t corner{}; corner < 8; ++corner)
+				{
+					const glm::vec4 position{ (corner & 1) ? max.x : min.x, (corner & 2) ? max.y : min.y, (corner & 4) ? max.z : min.z, 1.f };
+					const glm::vec3 clip{ viewProjection * position };
+					clipMin = glm::min(clipMin, clip);
+					clipMax = glm::max(clipMax, clip);
+				}
+
+				// anything in front of the far plane can cast into the cascade
+				if (clipMax.x < -1.f || clipMin.x > 1.f || clipMax.y < -1.f || clipMin.y > 1.f || clipMin.z > 1.f)
+					return Bvh::Overlap::Outside;
+				if (clipMin.x >= -1.f && clipMax.x <= 1.f && clipMin.y >= -1.f && clipMax.y <= 1.f && clipMax.z <= 1.f)
+					return Bvh::Overlap::Inside;
+				return Bvh::Overlap::Partial;
+			}, [&](uint32_t meshIndex)
+			{
+				m_MeshLayerMasks[meshIndex] |= 1u << index;
+				++m_CasterCounts[index];
+			});
+	}
+}
@@ -0,0 +1,112 @@
+#include "StreamingGrid.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+
+void StreamingGrid::Build(const std::vector<glm::vec3>& mins, const std::vector<glm::vec3>& maxs, const std::vector<uint64_t>& sizes, float cellSize)
+{
+	if (cellSize <= .0f)
+		throw std::runtime_error("failed to build streaming grid, the cell size has to be positive");
+	if (mins.size() != maxs.size() || mins.size() != sizes.size())
+		throw std::runtime_error("failed to build streaming grid, every item needs bounds and a size");
+
+	m_CellSize = cellSize;
+	m_Cells.clear();
+	m_ResidentSize = 0;
+
+	// only occupied cells are created, ordered so the cell indices do not depend on the item order
+	std::map<std::tuple<int, int, int>, std::vector<uint32_t>> occupied{};
+	for (uint32_t item{}; item < mins.size(); ++item)
+	{
+		const glm::ivec3 coordinates{ glm::floor((mins[item] + maxs[item]) * .5f / cellSize) };
+		occupied[{ coordinates.x, coordinates.y, coordinates.z }].push_back(item);
+	}
+
+	for (auto& [coordinates, items] : occupied)
+	{
+		Cell cell{ glm::vec3{ FLT_MAX }, glm::vec3{ -FLT_MAX }, std::move(items), 0, true };
+		for (uint32_t item : cell.items)
+			cell.size += sizes[item];
+		m_ResidentSize += cell.size;
+		m_Cells.push_back(std::move(cell));
+	}
+	UpdateBounds(mins, maxs);
+}
+
+void StreamingGrid::UpdateBounds(const std::vector<glm::vec3>& mins, const std::vector<glm::vec3>& maxs)
+{
+	// the bounds of the items, not the grid square, large items are near as soon as any part of them is
+	for (Cell& cell : m_Cells)
+	{
+		cell.min = glm::vec3{ FLT_MAX };
+		cell.max = glm::vec3{ -FLT_MAX };
+		for (uint32_t item : cell.items)
+		{
+			cell.min = glm::min(cell.min, mins[item]);
+			cell.max = glm::max(cell.max, maxs[item]);
+		}
+	}
+}
+
+void StreamingGrid::Update(const glm::vec3& position, uint64_t budget, uint64_t loadLimit, std::vector<uint32_t>& evictions, std::vector<uint32_t>& loads)
+{
+	evictions.clear();
+	loads.clear();
+	if (m_Cells.empty())
+		return;
+
+	// resident cells count as a bit nearer, so a camera between two cells does not swap them every frame
+	m_Order.clear();
+	for (uint32_t index{}; index < m_Cells.size(); ++index)
+	{
+		const Cell& cell{ m_Cells[index] };
+		const float distance{ glm::length(glm::clamp(position, cell.min, cell.max) - position) };
+		m_Order.emplace_back(cell.isResident ? std::max(distance - m_CellSize * HYSTERESIS, .0f) : distance, index);
+	}
+	std::sort(m_Order.begin(), m_Order.end());
+
+	uint64_t wantedSize{};
+	size_t wantedCount{};
+	for (; wantedCount < m_Order.size(); ++wantedCount)
+	{
+		const uint64_t size{ m_Cells[m_Order[wantedCount].second].size };
+		if (wantedCount > 0 && wantedSize + size > budget)
+			break;
+		wantedSize += size;
+	}
+
+	// farthest first, so memory is freed before anything near is uploaded
+	for (size_t rank{ m_Order.size() }; rank > wantedCount; --rank)
+	{
+		const uint32_t index{ m_Order[rank - 1].second };
+		if (m_Cells[index].isResident)
+			evictions.push_back(index);
+	}
+
+	uint64_t loadSize{};
+	for (size_t rank{}; rank < wantedCount; ++rank)
+	{
+		const uint32_t index{ m_Order[rank].second };
+		if (m_Cells[index].isResident)
+			continue;
+		if (!loads.empty() && loadSize + m_Cells[index].size > loadLimit)
+			break;
+		loads.push_back(index);
+		loadSize += m_Cells[index].size;
+	}
+}
+
+void StreamingGrid::SetResident(uint32_t cell, bool isResident)
+{
+	if (m_Cells[cell].isResident == isResident)
+		return;
+
+	m_Cells[cell].isResident = isResident;
+	if (isResident)
+		m_ResidentSize += m_Cells[cell].size;
+	else
+		m_ResidentSize -= m_Cells[cell].size;
+}
@@ -0,0 +1,372 @@
+#include "TextureStreamer.h"
+#include "Buffer.h"
+#include "Image.h"
+#include "Device.h"
+#include "DescriptorSet.h"
+#include "DataTypes.h"
+#include "Helper.h"
+#include <stb_image.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+	// levels of a full chain down to 1x1
+	uint32_t GetLevelCount(uint32_t width, uint32_t height)
+	{
+		uint32_t levelCount{ 1 };
+		while (std::max(width, height) >> levelCount > 0)
+			++levelCount;
+		return levelCount;
+	}
+
+	float DecodeSrgb(uint8_t value)
+	{
+		static const std::array<float, 256> table{ []()
+			{
+				std::array<float, 256> values{};
+				for (size_t index{}; index < values.size(); ++index)
+				{
+					const float color{ index / 255.f };
+					values[index] = (color <= .04045f) ? color / 12.92f : std::pow((color + .055f) / 1.055f, 2.4f);
+				}
+				return values;
+			}() };
+		return table[value];
+	}
+
+	uint8_t EncodeSrgb(float value)
+	{
+		const float color{ (value <= .0031308f) ? value * 12.92f : 1.055f * std::pow(value, 1.f / 2.4f) - .055f };
+		return static_cast<uint8_t>(std::clamp(color, .0f, 1.f) * 255.f + .5f);
+	}
+}
+
+TextureStreamer::TextureStreamer(Device* device, CommandPool* commandPool, Scene* scene, uint64_t budget)
+	: m_RequestedBudget{ budget }
+	, m_Budget{ budget }
+	, m_IsEnabled{ budget > 0 }
+{
+	const std::vector<Scene::TextureSource>& sources{ scene->GetTextureSources() };
+	std::vector<Image>& textures{ scene->GetTextures() };
+	if (m_IsEnabled && !textures.empty())
+		throw std::runtime_error("failed to create texture streamer, the scene has to defer its textures");
+
+	m_Textures.resize(sources.size());
+	for (uint32_t index{}; index < sources.size(); ++index)
+	{
+		Texture& texture{ m_Textures[index] };
+		if (m_IsEnabled)
+		{
+			int width{};
+			int height{};
+			int channels{};
+			if (!stbi_info(sources[index].path.c_str(), &width, &height, &channels))
+				throw std::runtime_error("failed to load texture " + sources[index].path);
+			texture.width = static_cast<uint32_t>(width);
+			texture.height = static_cast<uint32_t>(height);
+		}
+		else
+		{
+			texture.width = textures[index].GetExtent().width;
+			texture.height = textures[index].GetExtent().height;
+		}
+		texture.levelCount = GetLevelCount(texture.width, texture.height);
+		while (texture.tailLevel + 1 < texture.levelCount && std::max(texture.width, texture.height) >> texture.tailLevel > TAIL_SIZE)
+			++texture.tailLevel;
+		texture.residentLevel = texture.wantedLevel = m_IsEnabled ? texture.tailLevel : 0;
+	}
+
+	// tails are decoded a batch of threads at a time, every decode holds its whole file
+	if (m_IsEnabled)
+	{
+		const size_t batchSize{ std::max<size_t>(std::thread::hardware_concurrency(), 1) };
+		for (size_t first{}; first < sources.size(); first += batchSize)
+		{
+			std::vector<std::future<DecodedTexture>> decodes;
+			for (size_t index{ first }; index < std::min(first + batchSize, sources.size()); ++index)
+				decodes.push_back(std::async(std::launch::async, &TextureStreamer::Decode, sources[index], m_Textures[index].tailLevel));
+			for (std::future<DecodedTexture>& decode : decodes)
+			{
+				const size_t index{ textures.size() };
+				textures.push_back(CreateImage(device, commandPool, sources[index], decode.get()));
+				m_ResidentSize += GetSize(m_Textures[index], m_Textures[index].tailLevel);
+			}
+		}
+	}
+
+	// level 0 sizes so the shader can tell the level it needs from derivatives alone
+	std::vector<datatype::TextureFeedback> feedback(std::max<size_t>(m_Textures.size(), 1), datatype::TextureFeedback{ 1, 1, UINT32_MAX, 0 });
+	for (size_t index{}; index < m_Textures.size(); ++index)
+	{
+		feedback[index].width = m_Textures[index].width;
+		feedback[index].height = m_Textures[index].height;
+	}
+
+	const VkDeviceSize size{ sizeof(datatype::TextureFeedback) * feedback.size() };
+	BufferBuilder builder{};
+	builder
+		.MapMemory()
+		.Build(m_FeedbackBufferPtr, device, commandPool, size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	m_FeedbackBufferPtr->UpdateMappedData(feedback.data(), size, 0);
+	device->SetObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)*m_FeedbackBufferPtr->GetBufferPtr(), "Texture feedback");
+}
+
+void TextureStreamer::Update(Device* device, CommandPool* commandPool, Scene* scene, std::vector<DescriptorSet>& descriptorSets, uint32_t binding)
+{
+	if (!m_IsEnabled)
+		return;
+
+	// the copies were recorded into the frame whose fence was just waited on
+	static_assert(HAS_SINGLE_FRAME_IN_FLIGHT);
+	for (Upload& upload : m_Uploads)
+		upload.stagingBufferPtr->Destroy(device);
+	m_Uploads.clear();
+
+	// the frame that wrote the feedback finished, it is reset for the one about to be recorded
+	datatype::TextureFeedback* feedback{ static_cast<datatype::TextureFeedback*>(m_FeedbackBufferPtr->GetMappedData()) };
+	for (size_t index{}; index < m_Textures.size(); ++index)
+	{
+		Texture& texture{ m_Textures[index] };
+		const uint32_t sampledLevel{ feedback[index].level };
+		feedback[index].level = UINT32_MAX;
+
+		if (sampledLevel == UINT32_MAX)
+		{
+			if (++texture.unseenFrames >= UNSEEN_FRAMES)
+				texture.wantedLevel = texture.tailLevel;
+			continue;
+		}
+
+		// finer levels are taken at once, a single level coarser is kept so a texture on the edge of two levels does not flip
+		texture.unseenFrames = 0;
+		const uint32_t level{ std::min(sampledLevel, texture.tailLevel) };
+		texture.wantedLevel = (level == texture.residentLevel + 1) ? texture.residentLevel : level;
+	}
+	FitBudget(device);
+
+	// coarser levels first, they free memory the finer ones may need
+	uint32_t pendingCount{ static_cast<uint32_t>(std::count_if(m_Textures.begin(), m_Textures.end(), [](const Texture& texture) { return texture.pending.valid(); })) };
+	const std::vector<Scene::TextureSource>& sources{ scene->GetTextureSources() };
+	for (bool isCoarsening : { true, false })
+	{
+		for (size_t index{}; index < m_Textures.size() && pendingCount < MAX_PENDING; ++index)
+		{
+			Texture& texture{ m_Textures[index] };
+			if (texture.hasFailed || texture.pending.valid() || texture.wantedLevel == texture.residentLevel || (texture.wantedLevel > texture.residentLevel) != isCoarsening)
+				continue;
+			texture.pending = std::async(std::launch::async, &TextureStreamer::Decode, sources[index], texture.wantedLevel);
+			++pendingCount;
+		}
+	}
+
+	// the gpu is done with the old images, they are replaced without waiting on anything else
+	std::vector<Image>& textures{ scene->GetTextures() };
+	for (uint32_t index{}; index < m_Textures.size(); ++index)
+	{
+		Texture& texture{ m_Textures[index] };
+		if (!texture.pending.valid() || texture.pending.wait_for(std::chrono::seconds{ 0 }) != std::future_status::ready)
+			continue;
+
+		// the file may have changed or broken since the tail was read, the texture stays as it is
+		DecodedTexture decoded{};
+		try
+		{
+			decoded = texture.pending.get();
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << e.what() << ", keeping it at level " << texture.residentLevel << '\n';
+			texture.hasFailed = true;
+			continue;
+		}
+
+		Upload upload{ index };
+		textures[index].Destroy(*device->GetDevicePtr());
+		textures[index] = CreateImage(device, commandPool, sources[index], decoded, upload.stagingBufferPtr);
+		m_Uploads.push_back(std::move(upload));
+		// nothing samples the image before RecordUploads leaves it in this layout
+		for (DescriptorSet& descriptorSet : descriptorSets)
+			descriptorSet.AddWriteDescriptorSet(&textures[index], VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, binding, index).Update(device);
+
+		m_ResidentSize = m_ResidentSize - GetSize(texture, texture.residentLevel) + GetSize(texture, decoded.firstLevel);
+		texture.residentLevel = decoded.firstLevel;
+		++m_Statistics.uploads;
+		m_Statistics.uploadedBytes += decoded.pixels.size();
+	}
+}
+
+void TextureStreamer::RecordUploads(Device* device, CommandBuffer* commandBuffer, Scene* scene)
+{
+	std::vector<Image>& textures{ scene->GetTextures() };
+	for (Upload& upload : m_Uploads)
+	{
+		Image& image{ textures[upload.texture] };
+		{
+			Image::Transition transition{};
+			transition.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			transition.srcAccess = 0;
+			transition.dstAccess = VK_ACCESS_TRANSFER_WRITE_BIT;
+			transition.srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+			transition.dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			image.MakeTransition(device, commandBuffer, transition);
+		}
+		upload.stagingBufferPtr->CopyTo(&image, commandBuffer, device, nullptr);
+		{
+			Image::Transition transition{};
+			transition.newLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
+			transition.srcAccess = VK_ACCESS_TRANSFER_WRITE_BIT;
+			transition.dstAccess = VK_ACCESS_SHADER_READ_BIT;
+			transition.srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			transition.dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			image.MakeTransition(device, commandBuffer, transition);
+		}
+	}
+}
+
+void TextureStreamer::FitBudget(Device* device)
+{
+	// the largest device local heap holds the textures, other processes may leave less of it than requested
+	std::vector<Device::HeapBudget> heaps{ device->GetHeapBudgets() };
+	const auto heap{ std::max_element(heaps.begin(), heaps.end(), [](const Device::HeapBudget& lhs, const Device::HeapBudget& rhs)
+		{
+			return (lhs.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) == (rhs.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+				? lhs.size < rhs.size : !(lhs.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT);
+		}) };
+	m_Budget = m_RequestedBudget;
+	if (heap != heaps.end())
+		m_Budget = std::min(m_Budget, m_ResidentSize + ((heap->budget > heap->usage) ? heap->budget - heap->usage : 0));
+
+	uint64_t wantedSize{};
+	for (const Texture& texture : m_Textures)
+		wantedSize += GetSize(texture, texture.wantedLevel);
+
+	while (wantedSize > m_Budget)
+	{
+		Texture* largest{};
+		for (Texture& texture : m_Textures)
+		{
+			if (texture.wantedLevel < texture.tailLevel && (!largest || GetSize(texture, texture.wantedLevel) > GetSize(*largest, largest->wantedLevel)))
+				largest = &texture;
+		}
+		// every texture is at its tail, those always stay
+		if (!largest)
+			break;
+
+		wantedSize -= GetSize(*largest, largest->wantedLevel) - GetSize(*largest, largest->wantedLevel + 1);
+		++largest->wantedLevel;
+	}
+}
+
+TextureStreamer::DecodedTexture TextureStreamer::Decode(const Scene::TextureSource& source, uint32_t firstLevel)
+{
+	int width{};
+	int height{};
+	int channels{};
+	stbi_uc* pixels{ stbi_load(source.path.c_str(), &width, &height, &channels, STBI_rgb_alpha) };
+	if (!pixels)
+		throw std::runtime_error("failed to load texture " + source.path);
+
+	DecodedTexture decoded{ std::max(static_cast<uint32_t>(width) >> firstLevel, 1u), std::max(static_cast<uint32_t>(height) >> firstLevel, 1u), firstLevel, {} };
+	std::vector<uint8_t> level(pixels, pixels + static_cast<size_t>(width) * height * 4);
+	stbi_image_free(pixels);
+
+	// every level is filtered from the one above it, like blits would do on the gpu
+	const bool isSrgb{ source.format == VK_FORMAT_R8G8B8A8_SRGB };
+	uint32_t levelWidth{ static_cast<uint32_t>(width) };
+	uint32_t levelHeight{ static_cast<uint32_t>(height) };
+	const uint32_t levelCount{ GetLevelCount(levelWidth, levelHeight) };
+	for (uint32_t levelIndex{}; levelIndex < levelCount; ++levelIndex)
+	{
+		if (levelIndex >= firstLevel)
+			decoded.pixels.insert(decoded.pixels.end(), level.begin(), level.end());
+		if (levelIndex + 1 == levelCount)
+			break;
+
+		const uint32_t nextWidth{ std::max(levelWidth / 2, 1u) };
+		const uint32_t nextHeight{ std::max(levelHeight / 2, 1u) };
+		std::vector<uint8_t> next(static_cast<size_t>(nextWidth) * nextHeight * 4);
+		for (uint32_t y{}; y < nextHeight; ++y)
+		{
+			for (uint32_t x{}; x < nextWidth; ++x)
+			{
+				// edges of one texel are not halved, the same texel is read twice
+				const uint32_t x0{ std::min(x * 2, levelWidth - 1) };
+				const uint32_t x1{ std::min(x * 2 + 1, levelWidth - 1) };
+				const uint32_t y0{ std::min(y * 2, levelHeight - 1) };
+				const uint32_t y1{ std::min(y * 2 + 1, levelHeight - 1) };
+				const size_t texels[]{ (static_cast<size_t>(y0) * levelWidth + x0) * 4, (static_cast<size_t>(y0) * levelWidth + x1) * 4,
+										(static_cast<size_t>(y1) * levelWidth + x0) * 4, (static_cast<size_t>(y1) * levelWidth + x1) * 4 };
+				const size_t target{ (static_cast<size_t>(y) * nextWidth + x) * 4 };
+				for (uint32_t channel{}; channel < 4; ++channel)
+				{
+					// alpha is linear in srgb formats as well
+					const bool isLinear{ !isSrgb || channel == 3 };
+					float sum{};
+					for (size_t texel : texels)
+						sum += isLinear ? level[texel + channel] / 255.f : DecodeSrgb(level[texel + channel]);
+					next[target + channel] = isLinear ? static_cast<uint8_t>(sum * .25f * 255.f + .5f) : EncodeSrgb(sum * .25f);
+				}
+			}
+		}
+		level = std::move(next);
+		levelWidth = nextWidth;
+		levelHeight = nextHeight;
+	}
+	return decoded;
+}
+
+Image TextureStreamer::CreateImage(Device* device, CommandPool* commandPool, const Scene::TextureSource& source, const DecodedTexture& decoded)
+{
+	ImageBuilder builder{};
+	Image image{ builder
+		.SetFormat(source.format)
+		.SetDimensions(decoded.width, decoded.height)
+		.SetMipLevels(GetLevelCount(decoded.width, decoded.height))
+		.SetPixels(decoded.pixels.data(), decoded.pixels.size())
+		.Build(device, commandPool, VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) };
+	device->SetObjectName(VK_OBJECT_TYPE_IMAGE, (uint64_t)*image.GetImagePtr(), source.path.c_str());
+	return image;
+}
+
+Image TextureStreamer::CreateImage(Device* device, CommandPool* commandPool, const Scene::TextureSource& source, const DecodedTexture& decoded, std::unique_ptr<Buffer>& stagingBufferPtr)
+{
+	BufferBuilder bufferBuilder{};
+	bufferBuilder
+		.MapMemory()
+		.Build(stagingBufferPtr, device, commandPool, decoded.pixels.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	stagingBufferPtr->UpdateMappedData(decoded.pixels.data(), decoded.pixels.size(), 0);
+
+	ImageBuilder builder{};
+	Image image{ builder
+		.SetFormat(source.format)
+		.SetDimensions(decoded.width, decoded.height)
+		.SetMipLevels(GetLevelCount(decoded.width, decoded.height))
+		.Build(device, commandPool, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) };
+	device->SetObjectName(VK_OBJECT_TYPE_IMAGE, (uint64_t)*image.GetImagePtr(), source.path.c_str());
+	return image;
+}
+
+uint64_t TextureStreamer::GetSize(const Texture& texture, uint32_t level) const
+{
+	return HELP::GetImageSize(VK_FORMAT_R8G8B8A8_UNORM, std::max(texture.width >> level, 1u), std::max(texture.height >> level, 1u), 1, texture.levelCount - level);
+}
+
+void TextureStreamer::Destroy(Device* device)
+{
+	// decodes still running only touch their own memory, waiting for them is enough
+	for (Texture& texture : m_Textures)
+	{
+		if (texture.pending.valid())
+			texture.pending.wait();
+	}
+	for (Upload& upload : m_Uploads)
+		upload.stagingBufferPtr->Destroy(device);
+	m_Uploads.clear();
+	m_FeedbackBufferPtr->Destroy(device);
+}
@@ -5,6 +5,7 @@ namespace
 {
 	static auto lastUpdateTime{ std::chrono::steady_clock::now() };
 	static float elapsedSec{ .0f };
+	static float fixedStep{ .0f };
 }
 
 namespace WorldTime
@@ -17,8 +18,13 @@ namespace WorldTime
 	void Tick()
 	{
 		const auto currentTime{ std::chrono::steady_clock::now() };
-		elapsedSec = std::chrono::duration<float>(currentTime - lastUpdateTime).count();
+		elapsedSec = (fixedStep > .0f) ? fixedStep : std::chrono::duration<float>(currentTime - lastUpdateTime).count();
 		lastUpdateTime = currentTime;
 	}
 
+	void SetFixedStep(float step)
+	{
+		fixedStep = step;
+	}
+
 }
\ No newline at end of file
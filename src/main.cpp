@@ -2,6 +2,8 @@
 // WASD  -> horizontal movement
 // E, Q  -> up, down
 // SHIFT -> double speed
+// L     -> toggle fragment / compute lighting
+// P     -> print gpu pass timings
 
 #include <iostream>
 #include "DynamicRenderingApp.h"
@@ -9,12 +11,12 @@
 // app that makes use of dynamic rendering
 using CurrentApp = DynamicRenderingApp;
 
-int main()
+int main(int argc, char* argv[])
 {
-	CurrentApp app{};
-
 	try
 	{
+		// numbers out of range throw while parsing
+		CurrentApp app{ Settings::FromCommandLine(argc, argv) };
 		app.Run();
 	}
 	catch (const std::exception& e)